@@ -19,8 +19,9 @@ from hysplit.met import (
     get_met_nam12,
     get_met_era5,
     get_met_hrrr,
+    MetField,
 )
-from hysplit.io import trajectory_read, dispersion_read
+from hysplit.io import trajectory_read, dispersion_read, concentration_read, emitimes_read
 from hysplit.viz import trajectory_plot, dispersion_plot
 
 # Workflow utilities for cluster computing
@@ -55,9 +56,12 @@ __all__ = [
     "get_met_nam12",
     "get_met_era5",
     "get_met_hrrr",
+    "MetField",
     # I/O
     "trajectory_read",
     "dispersion_read",
+    "concentration_read",
+    "emitimes_read",
     # Visualization
     "trajectory_plot",
     "dispersion_plot",
@@ -3,6 +3,12 @@
 from hysplit.core.trajectory import TrajectoryModel, hysplit_trajectory
 from hysplit.core.dispersion import DispersionModel, hysplit_dispersion
 from hysplit.core.config import set_config, set_ascdata
+from hysplit.core.transfer import TransferMatrix
+from hysplit.core.inverse import estimate_emissions, InversionResult
+from hysplit.core.cluster import cluster_trajectories, ClusterResult
+from hysplit.core.gridding import receptor_grid, ReceptorGrid, residence_grid, ResidenceGrid
+from hysplit.core.geodesy import trajectory_metrics, TrajectoryMetrics
+from hysplit.core.spatial_index import TrajectoryIndex
 
 __all__ = [
     "TrajectoryModel",
@@ -11,4 +17,16 @@ __all__ = [
     "hysplit_dispersion",
     "set_config",
     "set_ascdata",
+    "TransferMatrix",
+    "estimate_emissions",
+    "InversionResult",
+    "cluster_trajectories",
+    "ClusterResult",
+    "receptor_grid",
+    "ReceptorGrid",
+    "residence_grid",
+    "ResidenceGrid",
+    "trajectory_metrics",
+    "TrajectoryMetrics",
+    "TrajectoryIndex",
 ]
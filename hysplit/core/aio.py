@@ -0,0 +1,274 @@
+"""Asyncio API for model runs.
+
+``await model.run_async()`` runs a TrajectoryModel or DispersionModel from
+an event loop without a thread per run. HYSPLIT binaries are started by the
+native reactor (``hysplit.cpp._launcher``, Linux): children are spawned
+without waiting, and one epoll set watches their output pipes and pidfds.
+The loop watches the epoll descriptor, so pipes are drained and children
+reaped by callbacks on the loop thread as they finish. Without the reactor,
+asyncio's own subprocess support is used.
+
+An AsyncLauncher bounds the runs in flight: every run holds a slot (and the
+slot's warm working directory) from start to finish. Runs beyond
+``max_concurrent`` wait for a slot, and when ``max_queued`` runs are
+already waiting, new runs fail at once with LauncherBusyError, so a service
+can shed load (e.g. answer 503) instead of queueing without bound.
+
+Usage:
+    from hysplit.core.aio import AsyncLauncher
+
+    launcher = AsyncLauncher(max_concurrent=8, max_queued=64)
+    model = await TrajectoryModel(...).run_async(launcher)
+"""
+
+from __future__ import annotations
+
+import asyncio
+import contextlib
+import os
+import time
+import weakref
+from pathlib import Path
+from typing import AsyncIterator, Dict, List, Optional, Sequence, Union
+
+from hysplit.core.launcher import ExecDir, LaunchResult, temporary_exec_dir
+from hysplit.core.telemetry import RunTimer
+from hysplit.core.trajectory import LaunchStep, RunSteps, _finish_launch
+
+try:
+    from hysplit.cpp import _launcher as cpp_launcher
+    HAS_REACTOR = hasattr(cpp_launcher, "reactor_poll")
+except ImportError:
+    HAS_REACTOR = False
+
+
+class LauncherBusyError(RuntimeError):
+    """A run was refused because the launcher's wait queue is full."""
+
+
+class AsyncLauncher:
+    """Runs binaries and model runs on one event loop, with admission limits.
+
+    Bound to the event loop that first uses it.
+
+    Args:
+        max_concurrent: Runs in flight at once (default: CPU count)
+        max_queued: Runs allowed to wait for a slot; None for no limit
+    """
+
+    def __init__(self, max_concurrent: Optional[int] = None, max_queued: Optional[int] = None):
+        self.max_concurrent = max_concurrent or os.cpu_count() or 1
+        self.max_queued = max_queued
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._slots: Optional[asyncio.Semaphore] = None
+        self._reactor = None
+        self._jobs: Dict[int, asyncio.Future] = {}
+        self._dirs: List[ExecDir] = []
+        self._waiting = 0
+        self._active = 0
+        self.rejected = 0
+
+    def _attach(self) -> asyncio.AbstractEventLoop:
+        """Bind to the running loop on first use."""
+        loop = asyncio.get_running_loop()
+        if self._loop is None:
+            self._loop = loop
+            self._slots = asyncio.Semaphore(self.max_concurrent)
+            if HAS_REACTOR:
+                try:
+                    self._reactor = cpp_launcher.reactor()
+                except NotImplementedError:
+                    self._reactor = None
+                else:
+                    loop.add_reader(cpp_launcher.reactor_fileno(self._reactor), self._on_ready)
+        elif loop is not self._loop:
+            raise RuntimeError("AsyncLauncher is bound to another event loop")
+        return loop
+
+    def _on_ready(self):
+        """Reader callback of the reactor: resolve the runs that finished."""
+        for job, result in cpp_launcher.reactor_poll(self._reactor):
+            future = self._jobs.pop(job, None)
+            if future is not None and not future.done():
+                future.set_result(result)
+
+    @property
+    def running(self) -> int:
+        """Runs holding a slot."""
+        return self._active
+
+    @property
+    def queued(self) -> int:
+        """Runs waiting for a slot."""
+        return self._waiting
+
+    @property
+    def saturated(self) -> bool:
+        """Whether a new run would be refused."""
+        return (
+            self.max_queued is not None
+            and self._active >= self.max_concurrent
+            and self._waiting >= self.max_queued
+        )
+
+    @contextlib.asynccontextmanager
+    async def slot(self) -> AsyncIterator[ExecDir]:
+        """Hold a run slot; yields the slot's warm working directory.
+
+        Raises:
+            LauncherBusyError: ``max_queued`` runs are already waiting
+        """
+        self._attach()
+        if self.saturated:
+            self.rejected += 1
+            raise LauncherBusyError(
+                f"{self._active} runs in flight and {self._waiting} waiting"
+            )
+        self._waiting += 1
+        try:
+            await self._slots.acquire()
+        finally:
+            self._waiting -= 1
+        self._active += 1
+        workdir = self._dirs.pop() if self._dirs else temporary_exec_dir(f"hysplit_async_{os.getpid()}_")
+        try:
+            yield workdir
+        finally:
+            self._dirs.append(workdir)
+            self._active -= 1
+            self._slots.release()
+
+    async def launch(
+        self,
+        argv: Sequence[Union[str, Path]],
+        cwd: Optional[Union[str, Path]] = None,
+        timeout: Optional[float] = None,
+    ) -> LaunchResult:
+        """Run a program to completion and capture its output.
+
+        Does not take a slot. Cancelling the awaiting task kills the program.
+
+        Args:
+            argv: Program path and arguments
+            cwd: Working directory of the program
+            timeout: Seconds before the program is killed
+
+        Returns:
+            LaunchResult (``timed_out`` is set if the timeout killed it)
+        """
+        loop = self._attach()
+        argv = [str(a) for a in argv]
+        cwd = str(cwd) if cwd is not None else None
+        if self._reactor is None:
+            return await self._launch_subprocess(argv, cwd, timeout)
+
+        job = cpp_launcher.reactor_spawn(self._reactor, argv, cwd)
+        future = self._jobs[job] = loop.create_future()
+        expired = []
+
+        def expire():
+            expired.append(True)
+            cpp_launcher.reactor_kill(self._reactor, job)
+
+        timer = loop.call_later(timeout, expire) if timeout is not None else None
+        try:
+            result = await future
+        except asyncio.CancelledError:
+            # Reaped by a later poll; nobody waits for the result
+            self._jobs.pop(job, None)
+            cpp_launcher.reactor_kill(self._reactor, job)
+            raise
+        finally:
+            if timer is not None:
+                timer.cancel()
+        return LaunchResult(
+            returncode=result["returncode"],
+            stdout=result["stdout"].decode(errors="replace"),
+            stderr=result["stderr"].decode(errors="replace"),
+            elapsed=result["elapsed"],
+            spawn_elapsed=result["spawn_elapsed"],
+            timed_out=bool(expired),
+            cancelled=result["cancelled"] and not expired,
+        )
+
+    async def _launch_subprocess(self, argv: List[str], cwd: Optional[str], timeout: Optional[float]) -> LaunchResult:
+        """``launch()`` through asyncio's subprocess support."""
+        t0 = time.perf_counter()
+        process = await asyncio.create_subprocess_exec(
+            *argv, cwd=cwd, stdin=asyncio.subprocess.DEVNULL,
+            stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.PIPE,
+        )
+        spawned = time.perf_counter() - t0
+        timed_out = False
+        try:
+            stdout, stderr = await asyncio.wait_for(process.communicate(), timeout)
+        except asyncio.TimeoutError:
+            timed_out = True
+            process.kill()
+            stdout, stderr = await process.communicate()
+        except asyncio.CancelledError:
+            process.kill()
+            raise
+        return LaunchResult(
+            process.returncode, stdout.decode(errors="replace"), stderr.decode(errors="replace"),
+            time.perf_counter() - t0, spawned, timed_out,
+        )
+
+    async def drive(self, steps: RunSteps, timer: RunTimer, workdir: ExecDir):
+        """Execute the steps of a model run (see ``hysplit.core.trajectory.RunSteps``).
+
+        Binaries are launched in ``workdir``; blocking calls such as met
+        downloads run in the loop's default executor.
+        """
+        loop = self._attach()
+        try:
+            step = next(steps)
+            while True:
+                try:
+                    if isinstance(step, LaunchStep):
+                        start = time.monotonic_ns()
+                        result = await self.launch([step.binary_path], workdir.path, step.timeout)
+                        value = _finish_launch(timer, start, result, step.binary_path)
+                    else:
+                        value = await loop.run_in_executor(None, step)
+                except Exception as e:
+                    step = steps.throw(e)
+                else:
+                    step = steps.send(value)
+        except StopIteration:
+            pass
+        finally:
+            # A cancelled run removes its partial outputs
+            steps.close()
+
+    async def aclose(self):
+        """Kill the programs still running and release the reactor."""
+        if self._reactor is not None:
+            self._loop.remove_reader(cpp_launcher.reactor_fileno(self._reactor))
+            cpp_launcher.reactor_close(self._reactor)
+            self._reactor = None
+        for future in self._jobs.values():
+            if not future.done():
+                future.cancel()
+        self._jobs.clear()
+
+    async def __aenter__(self) -> "AsyncLauncher":
+        self._attach()
+        return self
+
+    async def __aexit__(self, *exc):
+        await self.aclose()
+
+
+_default_launchers: "weakref.WeakKeyDictionary[asyncio.AbstractEventLoop, AsyncLauncher]" = (
+    weakref.WeakKeyDictionary()
+)
+
+
+def get_launcher() -> AsyncLauncher:
+    """The default AsyncLauncher of the running event loop (no queue limit)."""
+    loop = asyncio.get_running_loop()
+    launcher = _default_launchers.get(loop)
+    if launcher is None:
+        launcher = _default_launchers[loop] = AsyncLauncher()
+    return launcher
@@ -0,0 +1,239 @@
+"""Content-addressed cache of parsed model runs.
+
+A trajectory run is fully determined by its CONTROL file, SETUP.CFG,
+ASCDATA.CFG, the met files it reads and the HYSPLIT executable. The cache
+key is a BLAKE2b hash of those inputs in canonical form: CONTROL is
+rendered for the single starting location of the run with placeholder
+paths for the working and met directories, and met files and the binary
+are identified by name, size and modification time, so re-downloading a
+met file or upgrading HYSPLIT invalidates the entries that used it. Keys do
+not depend on how runs were grouped into multi-start invocations, so a run
+computed inside a batch is a hit for a later single run and vice versa.
+
+Parsed trajectories are stored one file per run under
+``<directory>/<key[:2]>/``, in a columnar layout: a text header line with
+the row count and the name and dtype of every column, then the raw column
+arrays, each 8-byte aligned. A hit is one read and a numpy view per
+column. Entries are written to a temporary name and renamed, so concurrent
+writers never expose partial entries.
+
+Usage:
+    from hysplit.core.cache import RunCache
+
+    cache = RunCache("~/.cache/hysplit-runs")
+    model = TrajectoryModel(..., cache=cache).run()
+    print(cache.stats())
+"""
+
+from __future__ import annotations
+
+import hashlib
+import os
+import tempfile
+from datetime import datetime
+from pathlib import Path
+from typing import Dict, Optional, Sequence, Tuple, Union
+
+import numpy as np
+import pandas as pd
+
+KEY_VERSION = b"hysplit-run-cache 1\n"
+ENTRY_MAGIC = b"hysplit-run 1"
+EXEC_PLACEHOLDER = "$EXEC"
+MET_PLACEHOLDER = "$MET"
+
+
+def file_identity(path: Union[str, Path]) -> bytes:
+    """Name, size and modification time of a file (name only if missing)."""
+    path = Path(path)
+    try:
+        st = path.stat()
+    except OSError:
+        return path.name.encode() + b"\0missing\n"
+    return b"%s\0%d\0%d\n" % (path.name.encode(), st.st_size, st.st_mtime_ns)
+
+
+def run_key(
+    control: bytes,
+    setup: bytes,
+    ascdata: bytes,
+    met_files: Sequence[Union[str, Path]],
+    binary_path: Union[str, Path],
+) -> str:
+    """Cache key of a run from its canonical inputs.
+
+    Args:
+        control: CONTROL contents with placeholder directories
+        setup: SETUP.CFG contents
+        ascdata: ASCDATA.CFG contents
+        met_files: Paths of the met files the run reads
+        binary_path: HYSPLIT executable
+
+    Returns:
+        32-character hex digest
+    """
+    h = hashlib.blake2b(KEY_VERSION, digest_size=16)
+    for part in (control, setup, ascdata):
+        h.update(b"%d\n" % len(part))
+        h.update(part)
+    for met_file in met_files:
+        h.update(file_identity(met_file))
+    h.update(file_identity(binary_path))
+    return h.hexdigest()
+
+
+def trajectory_run_key(
+    model,
+    start_time: datetime,
+    location: Tuple[float, float, float],
+    met_dir: Union[str, Path],
+    met_files: Sequence[str],
+    binary_path: Union[str, Path],
+) -> str:
+    """Cache key of one trajectory run of a TrajectoryModel.
+
+    Args:
+        model: TrajectoryModel (its config already set up for the run)
+        start_time: Start time of the run
+        location: (lat, lon, height) starting location
+        met_dir: Directory holding the met files
+        met_files: Met file names, as written to CONTROL
+        binary_path: hyts_std executable
+    """
+    from hysplit.core.templates import render_ascdata, render_setup, render_trajectory_control
+
+    control = render_trajectory_control(
+        model, Path(EXEC_PLACEHOLDER), start_time, [location], list(met_files), "tdump"
+    )
+    if model.met_dir:
+        control = control.replace(os.fsencode(str(model.met_dir)), MET_PLACEHOLDER.encode())
+    return run_key(
+        control,
+        render_setup(model.config),
+        render_ascdata(model.ascdata),
+        [Path(met_dir) / name for name in met_files],
+        binary_path,
+    )
+
+
+def _pad(n: int) -> int:
+    return -n % 8
+
+
+def _encode(columns: Dict[str, np.ndarray], rows: int) -> bytes:
+    """Header line, then the 8-byte aligned column arrays."""
+    fields = [ENTRY_MAGIC, b"%d" % rows]
+    fields += [f"{name}={values.dtype.str}".encode() for name, values in columns.items()]
+    header = b"\t".join(fields) + b"\n"
+    parts = [header, bytes(_pad(len(header)))]
+    for values in columns.values():
+        raw = np.ascontiguousarray(values).tobytes()
+        parts += [raw, bytes(_pad(len(raw)))]
+    return b"".join(parts)
+
+
+def _decode(data: bytearray) -> Optional[pd.DataFrame]:
+    """Columns of an entry as views of ``data``; None if it is malformed."""
+    end = data.find(b"\n")
+    fields = bytes(data[:end]).split(b"\t") if end > 0 else []
+    if len(fields) < 2 or fields[0] != ENTRY_MAGIC:
+        return None
+    rows = int(fields[1])
+    offset = end + 1 + _pad(end + 1)
+    columns = {}
+    for field_ in fields[2:]:
+        name, _, dtype = field_.decode().rpartition("=")
+        dtype = np.dtype(dtype)
+        if offset + rows * dtype.itemsize > len(data):
+            return None
+        columns[name] = np.frombuffer(data, dtype=dtype, count=rows, offset=offset)
+        offset += rows * dtype.itemsize + _pad(rows * dtype.itemsize)
+    return pd.DataFrame(columns, copy=False)
+
+
+class RunCache:
+    """Directory of parsed run outputs keyed by ``run_key``.
+
+    Hit, miss and store counts are kept per instance (and so per process).
+
+    Args:
+        directory: Cache directory, created if missing
+    """
+
+    def __init__(self, directory: Union[str, Path]):
+        self.directory = Path(directory).expanduser()
+        self.directory.mkdir(parents=True, exist_ok=True)
+        self.hits = 0
+        self.misses = 0
+        self.stores = 0
+
+    def path(self, key: str) -> Path:
+        """File of an entry."""
+        return self.directory / key[:2] / f"{key}.run"
+
+    def get(self, key: str) -> Optional[pd.DataFrame]:
+        """Parsed output of a run, or None on a miss."""
+        try:
+            with open(self.path(key), "rb") as f:
+                data = bytearray(os.fstat(f.fileno()).st_size)
+                f.readinto(data)
+            df = _decode(data)
+        except (OSError, ValueError):
+            df = None
+        if df is None:
+            self.misses += 1
+            return None
+        self.hits += 1
+        return df
+
+    def put(self, key: str, df: pd.DataFrame) -> bool:
+        """Store the parsed output of a run.
+
+        Returns:
+            False if the frame has columns that cannot be stored without
+            pickling (object dtype) and was not cached
+        """
+        columns = {}
+        for name in df.columns:
+            values = df[name].to_numpy()
+            if values.dtype.hasobject:
+                return False
+            columns[str(name)] = values
+
+        path = self.path(key)
+        path.parent.mkdir(exist_ok=True)
+        fd, tmp = tempfile.mkstemp(dir=path.parent, prefix=f".{key}.")
+        try:
+            with os.fdopen(fd, "wb") as f:
+                f.write(_encode(columns, len(df)))
+            os.replace(tmp, path)
+        except BaseException:
+            os.unlink(tmp)
+            raise
+        self.stores += 1
+        return True
+
+    def __contains__(self, key: str) -> bool:
+        return self.path(key).exists()
+
+    @property
+    def hit_rate(self) -> float:
+        """Fraction of lookups that were hits."""
+        lookups = self.hits + self.misses
+        return self.hits / lookups if lookups else 0.0
+
+    def stats(self) -> Dict[str, float]:
+        """Hit, miss and store counts and the hit rate."""
+        return {
+            "hits": self.hits,
+            "misses": self.misses,
+            "stores": self.stores,
+            "hit_rate": self.hit_rate,
+        }
+
+
+def open_cache(cache: Union[None, str, Path, RunCache]) -> Optional[RunCache]:
+    """RunCache for a path argument; instances and None pass through."""
+    if cache is None or isinstance(cache, RunCache):
+        return cache
+    return RunCache(cache)
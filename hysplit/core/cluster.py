@@ -0,0 +1,258 @@
+"""Trajectory cluster analysis on total spatial variance (TSV).
+
+Groups back trajectories the way HYSPLIT's cluster analysis does:
+agglomeratively, merging at each step the two clusters whose union adds
+the least total spatial variance, i.e. the sum over clusters of the
+squared distances between each trajectory's endpoints and those of the
+cluster mean. The TSV curve (TSV against the number of clusters) shows
+where merging starts to join dissimilar clusters, which is how the
+cluster count is usually chosen.
+
+The native engine (``hysplit.cpp._cluster``) works on Earth-centred
+Cartesian endpoint coordinates, where TSV is exactly Ward's criterion, and
+needs memory for one n(n-1)/2 matrix of doubles: about 9 MB for a year of
+four trajectories a day, 400 MB for 10,000 trajectories.
+
+Usage:
+    from hysplit.core.cluster import cluster_trajectories
+
+    df, trajectories = run_batch_trajectories(config, return_trajectories=True)
+    clusters = cluster_trajectories(trajectories, n_clusters=[4, 5, 6])
+    print(clusters.tsv_curve(max_clusters=20))
+    labels = clusters.assignments(5)          # Series: run_index -> cluster
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+from typing import Dict, Iterable, Optional, Sequence, Tuple, Union
+
+import numpy as np
+import pandas as pd
+
+try:
+    from hysplit.cpp import _cluster as cpp_cluster
+    HAS_CLUSTER_ENGINE = True
+except ImportError:
+    HAS_CLUSTER_ENGINE = False
+
+# IUGG mean radius, as in hysplit/cpp/earth.h
+EARTH_RADIUS_KM = 6371.0088
+
+# Columns identifying a trajectory, in order of preference
+TRAJECTORY_KEYS = ("run_index", "run", "traj", "traj_dt_i")
+
+
+def trajectory_key(trajectories: pd.DataFrame, by: Optional[str] = None) -> str:
+    """Column identifying the trajectory of every point.
+
+    Defaults to ``run_index`` (batch results), ``run`` (``TrajectoryModel.traj_df``),
+    ``traj`` (service results) or ``traj_dt_i`` (start time), the first one present.
+
+    Raises:
+        ValueError: If there is no such column, or the column gives several
+                    trajectories the same value (e.g. ``traj_dt_i`` for runs
+                    from several receptors starting together)
+    """
+    if by is None:
+        by = next((c for c in TRAJECTORY_KEYS if c in trajectories.columns), None)
+        if by is None:
+            raise ValueError(f"No trajectory column ({', '.join(TRAJECTORY_KEYS)}); pass by=")
+    # One start point per trajectory
+    starts = trajectories.loc[trajectories["hour_along"].to_numpy() == 0, by]
+    if starts.duplicated().any():
+        raise ValueError(
+            f"Column '{by}' does not identify single trajectories "
+            f"({starts.duplicated().sum()} repeated start points); pass by="
+        )
+    return by
+
+
+def trajectory_arrays(
+    trajectories: pd.DataFrame,
+    by: Optional[str] = None,
+    step: int = 1,
+) -> Tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]:
+    """Endpoint arrays of the complete trajectories in a DataFrame.
+
+    Trajectories missing any of the endpoint hours (e.g. ended early at
+    the top of the model domain) are left out, as cluster analysis needs
+    trajectories of equal length.
+
+    Args:
+        trajectories: Trajectory points with ``hour_along``, ``lat`` and
+                      ``lon`` columns
+        by: Column identifying the trajectory; defaults to ``run_index``
+            (batch results), ``run``, ``traj`` or ``traj_dt_i``; see
+            ``trajectory_key()``
+        step: Use every ``step``-th hour of the trajectories
+
+    Returns:
+        Tuple of (trajectory ids, endpoint hours, lat, lon) with lat/lon of
+        shape (trajectories, endpoints)
+    """
+    by = trajectory_key(trajectories, by)
+    hours_along = trajectories["hour_along"].to_numpy(np.int64)
+    keep = hours_along % step == 0
+    ids, rows = np.unique(trajectories[by].to_numpy()[keep], return_inverse=True)
+    hours, cols = np.unique(hours_along[keep], return_inverse=True)
+    # Descending order starts back trajectories at hour 0
+    if len(hours) and hours[-1] <= 0:
+        hours, cols = hours[::-1], len(hours) - 1 - cols
+
+    lat = np.full((len(ids), len(hours)), np.nan)
+    lon = np.full((len(ids), len(hours)), np.nan)
+    lat[rows, cols] = trajectories["lat"].to_numpy(np.float64)[keep]
+    lon[rows, cols] = trajectories["lon"].to_numpy(np.float64)[keep]
+    complete = np.isfinite(lat).all(axis=1) & np.isfinite(lon).all(axis=1)
+    return ids[complete], hours, lat[complete], lon[complete]
+
+
+def _cut(linkage: np.ndarray, n: int, n_clusters: int) -> np.ndarray:
+    """Labels 1..k after the first n-k merges of a linkage; 1 is the largest."""
+    parent = np.arange(2 * n - 1)
+    merges = linkage[: n - n_clusters, :2].astype(np.int64)
+    parent[merges[:, 0]] = n + np.arange(len(merges))
+    parent[merges[:, 1]] = n + np.arange(len(merges))
+    roots = np.arange(n)
+    while True:
+        up = parent[roots]
+        if np.array_equal(up, roots):
+            break
+        roots = up
+    unique, first, inverse, counts = np.unique(
+        roots, return_index=True, return_inverse=True, return_counts=True
+    )
+    order = np.lexsort((first, -counts))
+    rank = np.empty(len(unique), dtype=np.int32)
+    rank[order] = np.arange(1, len(unique) + 1, dtype=np.int32)
+    return rank[inverse]
+
+
+def _to_xyz(lat: np.ndarray, lon: np.ndarray) -> np.ndarray:
+    phi, lam = np.radians(lat), np.radians(lon)
+    return EARTH_RADIUS_KM * np.stack(
+        [np.cos(phi) * np.cos(lam), np.cos(phi) * np.sin(lam), np.sin(phi)], axis=-1
+    )
+
+
+@dataclass
+class ClusterResult:
+    """Merge tree and TSV curve of a trajectory cluster analysis."""
+
+    ids: np.ndarray = field(repr=False)          # Trajectory id of each row
+    hours: np.ndarray = field(repr=False)        # Endpoint hours used
+    lat: np.ndarray = field(repr=False)          # (trajectories, endpoints)
+    lon: np.ndarray = field(repr=False)
+    linkage: np.ndarray = field(repr=False)      # scipy-compatible, heights = TSV increase
+    tsv: np.ndarray = field(repr=False)          # tsv[k - 1]: TSV of k clusters (km^2)
+    labels: Dict[int, np.ndarray] = field(default_factory=dict, repr=False)
+    dropped: int = 0                             # Incomplete trajectories left out
+
+    @property
+    def n_trajectories(self) -> int:
+        return len(self.ids)
+
+    def assignments(self, n_clusters: int) -> pd.Series:
+        """Cluster (1 = largest) of every trajectory for a cluster count."""
+        if not 1 <= n_clusters <= self.n_trajectories:
+            raise ValueError(f"n_clusters must be between 1 and {self.n_trajectories}")
+        labels = self.labels.get(n_clusters)
+        if labels is None:
+            labels = self.labels[n_clusters] = _cut(self.linkage, self.n_trajectories, n_clusters)
+        return pd.Series(labels, index=pd.Index(self.ids, name="trajectory"), name="cluster")
+
+    def tsv_curve(self, max_clusters: int = 30) -> pd.DataFrame:
+        """TSV and its percent change against the number of clusters.
+
+        ``tsv_change_pct`` at k is the increase of the TSV when going from
+        k + 1 to k clusters; a jump marks a merge of dissimilar clusters,
+        so the count just before it is a natural choice.
+        """
+        k = np.arange(1, min(max_clusters, self.n_trajectories) + 1)
+        tsv = self.tsv[k - 1]
+        finer = self.tsv[np.minimum(k, self.n_trajectories - 1)]
+        with np.errstate(divide="ignore", invalid="ignore"):
+            change = np.where(finer > 0, (tsv - finer) / finer * 100.0, np.nan)
+        change[k == self.n_trajectories] = np.nan
+        return pd.DataFrame({"n_clusters": k, "tsv": tsv, "tsv_change_pct": change})
+
+    def mean_trajectories(self, n_clusters: int) -> pd.DataFrame:
+        """Mean trajectory of every cluster (mean of the Cartesian endpoints).
+
+        Returns:
+            DataFrame with cluster, n_trajectories, hour_along, lat and lon
+        """
+        labels = self.assignments(n_clusters).to_numpy()
+        xyz = _to_xyz(self.lat, self.lon)
+        frames = []
+        for cluster in range(1, n_clusters + 1):
+            members = labels == cluster
+            x, y, z = xyz[members].mean(axis=0).T
+            frames.append(pd.DataFrame({
+                "cluster": cluster,
+                "n_trajectories": int(members.sum()),
+                "hour_along": self.hours,
+                "lat": np.degrees(np.arctan2(z, np.hypot(x, y))),
+                "lon": np.degrees(np.arctan2(y, x)),
+            }))
+        return pd.concat(frames, ignore_index=True)
+
+
+def cluster_trajectories(
+    trajectories: Union[pd.DataFrame, Tuple[np.ndarray, np.ndarray]],
+    n_clusters: Optional[Union[int, Iterable[int]]] = None,
+    by: Optional[str] = None,
+    step: int = 1,
+) -> ClusterResult:
+    """Cluster trajectories by total spatial variance.
+
+    Args:
+        trajectories: Trajectory points (see ``trajectory_arrays()``), or a
+                      (lat, lon) tuple of (trajectories, endpoints) arrays
+        n_clusters: Cluster count(s) to label right away; any other count
+                    can be labelled later with ``assignments()``
+        by: Column identifying the trajectory in a DataFrame
+        step: Use every ``step``-th hour of the trajectories
+
+    Returns:
+        ClusterResult with the merge tree, the TSV curve and the labels
+    """
+    if not HAS_CLUSTER_ENGINE:
+        raise RuntimeError(
+            "Native cluster engine not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+
+    if isinstance(trajectories, pd.DataFrame):
+        total = trajectories[trajectory_key(trajectories, by)].nunique()
+        ids, hours, lat, lon = trajectory_arrays(trajectories, by=by, step=step)
+    else:
+        lat, lon = (np.asarray(a, dtype=np.float64)[:, ::step] for a in trajectories)
+        total = len(lat)
+        complete = np.isfinite(lat).all(axis=1) & np.isfinite(lon).all(axis=1)
+        ids = np.flatnonzero(complete)
+        hours = np.arange(lat.shape[1]) * step
+        lat, lon = lat[complete], lon[complete]
+    if len(ids) == 0:
+        raise ValueError("No complete trajectories to cluster")
+
+    if n_clusters is None:
+        counts: Sequence[int] = []
+    elif isinstance(n_clusters, int):
+        counts = [n_clusters]
+    else:
+        counts = list(n_clusters)
+    result = cpp_cluster.cluster_trajectories(
+        np.ascontiguousarray(lat), np.ascontiguousarray(lon), np.asarray(counts, dtype=np.int64)
+    )
+    return ClusterResult(
+        ids=ids,
+        hours=hours,
+        lat=lat,
+        lon=lon,
+        linkage=result["linkage"],
+        tsv=result["tsv"],
+        labels={k: labels for k, labels in zip(counts, result["labels"])},
+        dropped=int(total - len(ids)),
+    )
@@ -2,7 +2,7 @@
 
 from __future__ import annotations
 
-from dataclasses import dataclass, field, asdict
+from dataclasses import dataclass, field, fields
 from pathlib import Path
 from typing import Optional, Union
 import os
@@ -94,15 +94,11 @@ class HysplitConfig:
         self.tm_terr = 1
         return self
 
-    def to_file(self, directory: Union[str, Path]) -> Path:
-        """Write SETUP.CFG file to directory."""
-        directory = Path(directory)
-        directory.mkdir(parents=True, exist_ok=True)
-
-        filepath = directory / "SETUP.CFG"
-
+    def to_string(self) -> str:
+        """Render the SETUP.CFG namelist."""
         lines = ["&SETUP"]
-        for key, value in asdict(self).items():
+        for f in fields(self):
+            key, value = f.name, getattr(self, f.name)
             if value is None:
                 formatted_value = "''"
             elif isinstance(value, str):
@@ -111,9 +107,16 @@ class HysplitConfig:
                 formatted_value = str(value)
             lines.append(f"{key} = {formatted_value},")
         lines.append("/")
+        return "\n".join(lines) + "\n"
 
+    def to_file(self, directory: Union[str, Path]) -> Path:
+        """Write SETUP.CFG file to directory."""
+        directory = Path(directory)
+        directory.mkdir(parents=True, exist_ok=True)
+
+        filepath = directory / "SETUP.CFG"
         with open(filepath, "w") as f:
-            f.write("\n".join(lines) + "\n")
+            f.write(self.to_string())
 
         return filepath
 
@@ -132,13 +135,8 @@ class AscdataConfig:
     roughness_l: float = 0.2        # Roughness length
     data_dir: str = "'.'"           # Data directory
 
-    def to_file(self, directory: Union[str, Path]) -> Path:
-        """Write ASCDATA.CFG file to directory."""
-        directory = Path(directory)
-        directory.mkdir(parents=True, exist_ok=True)
-
-        filepath = directory / "ASCDATA.CFG"
-
+    def to_string(self) -> str:
+        """Render the ASCDATA.CFG file."""
         lines = [
             f"{self.lat_ll}  {self.lon_ll}",
             f"{self.lat_spacing}  {self.lon_spacing}",
@@ -147,9 +145,16 @@ class AscdataConfig:
             str(self.roughness_l),
             self.data_dir
         ]
+        return "\n".join(lines) + "\n"
 
+    def to_file(self, directory: Union[str, Path]) -> Path:
+        """Write ASCDATA.CFG file to directory."""
+        directory = Path(directory)
+        directory.mkdir(parents=True, exist_ok=True)
+
+        filepath = directory / "ASCDATA.CFG"
         with open(filepath, "w") as f:
-            f.write("\n".join(lines) + "\n")
+            f.write(self.to_string())
 
         return filepath
 
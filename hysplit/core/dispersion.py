@@ -2,19 +2,26 @@
 
 from __future__ import annotations
 
-import shutil
-import subprocess
-import tempfile
+import asyncio
+import functools
 from dataclasses import dataclass, field
 from datetime import datetime, timedelta
 from pathlib import Path
-from typing import Optional, Union, List
+from typing import TYPE_CHECKING, Optional, Union, List
 
 import pandas as pd
 import numpy as np
 
 from hysplit.core.config import HysplitConfig, AscdataConfig, set_config, set_ascdata
-from hysplit.core.trajectory import get_binary_path, get_os
+from hysplit.core.launcher import ExecDir, RunCancelledError, RunTimeoutError, worker_exec_dir, worker_met_dir
+from hysplit.core.telemetry import RunTimer, run_timer
+from hysplit.core.templates import render_dispersion_control
+from hysplit.core.trajectory import LaunchStep, RunSteps, _drive, get_binary_path, get_os
+from hysplit.core.transfer import TransferMatrix
+from hysplit.met.field import MetField
+
+if TYPE_CHECKING:
+    from hysplit.core.aio import AsyncLauncher
 
 
 @dataclass
@@ -64,6 +71,15 @@ class DispersionModel:
     grid_span_lon: float = 10.0
     grid_levels: List[float] = field(default_factory=lambda: [100.0])
 
+    # Pollutant deposition (all zero disables deposition)
+    particle_diameter: float = 0.0       # Particle diameter (micrometers, 0 = gas)
+    particle_density: float = 0.0        # Particle density (g/cm^3)
+    particle_shape: float = 0.0          # Particle shape factor
+    deposition_velocity: float = 0.0     # Dry deposition velocity (m/s)
+    henry_constant: float = 0.0          # Henry's constant for gases (M/atm)
+    in_cloud_scavenging: float = 0.0     # In-cloud scavenging ratio (L/L)
+    below_cloud_scavenging: float = 0.0  # Below-cloud scavenging coefficient (1/s)
+
     # Output configuration
     sampling_start: int = 0
     sampling_stop: int = 24
@@ -73,16 +89,26 @@ class DispersionModel:
     config: Optional[HysplitConfig] = None
     ascdata: Optional[AscdataConfig] = None
 
+    # Engine ("hysplit" runs hycs_std, "native" runs the in-process particle engine,
+    # "tcm" runs the native engine at unit emission and builds a transfer matrix)
+    engine: str = "hysplit"
+    met_field: Optional[MetField] = field(default=None, repr=False)
+    tcm_period: float = 0.0              # Hours per transfer-matrix column (0 = whole release)
+
     # Naming and paths
     disp_name: Optional[str] = None
     binary_path: Optional[Union[str, Path]] = None
     met_dir: Optional[Union[str, Path]] = None
     exec_dir: Optional[Union[str, Path]] = None
     clean_up: bool = True
+    timeout: Optional[float] = None      # Seconds before hycs_std is killed
 
     # Output
     disp_df: Optional[pd.DataFrame] = field(default=None, repr=False)
     concentration_grid: Optional[np.ndarray] = field(default=None, repr=False)
+    deposition_grid: Optional[np.ndarray] = field(default=None, repr=False)
+    transfer_matrix: Optional[TransferMatrix] = field(default=None, repr=False)
+    timings: Optional[RunTimer] = field(default=None, repr=False)  # Phase spans of the last run()
 
     def __post_init__(self):
         """Initialize defaults."""
@@ -138,9 +164,32 @@ class DispersionModel:
         grid_center: Optional[tuple[float, float]] = None,
         grid_spacing: Optional[tuple[float, float]] = None,
         grid_span: Optional[tuple[float, float]] = None,
-        grid_levels: Optional[List[float]] = None
+        grid_levels: Optional[List[float]] = None,
+        sampling_interval: Optional[int] = None,
+        engine: Optional[str] = None,
+        met_field: Optional[MetField] = None,
+        tcm_period: Optional[float] = None,
+        particle_diameter: Optional[float] = None,
+        particle_density: Optional[float] = None,
+        particle_shape: Optional[float] = None,
+        deposition_velocity: Optional[float] = None,
+        henry_constant: Optional[float] = None,
+        in_cloud_scavenging: Optional[float] = None,
+        below_cloud_scavenging: Optional[float] = None
     ) -> "DispersionModel":
-        """Add or update dispersion parameters. Returns self for method chaining."""
+        """Add or update dispersion parameters. Returns self for method chaining.
+
+        The deposition parameters describe the pollutant and are written to the
+        deposition lines of the CONTROL file: particle diameter (um), density
+        (g/cm^3) and shape factor; dry deposition velocity (m/s); Henry's
+        constant (M/atm) for gases; in-cloud scavenging ratio (L/L) and
+        below-cloud scavenging coefficient (1/s) for particles.
+
+        ``engine="tcm"`` runs every source at unit emission in one native
+        simulation and stores the source-receptor matrix in
+        ``transfer_matrix``, with one column per source and ``tcm_period``
+        hours of release (0 = the whole release).
+        """
         if start_time is not None:
             self.start_time = start_time
         if end_time is not None:
@@ -163,6 +212,32 @@ class DispersionModel:
             self.grid_span_lat, self.grid_span_lon = grid_span
         if grid_levels is not None:
             self.grid_levels = grid_levels
+        if sampling_interval is not None:
+            self.sampling_interval = sampling_interval
+        if engine is not None:
+            if engine not in ("hysplit", "native", "tcm"):
+                raise ValueError(
+                    f"Unknown engine: '{engine}'. Valid engines are: hysplit, native, tcm"
+                )
+            self.engine = engine
+        if met_field is not None:
+            self.met_field = met_field
+        if tcm_period is not None:
+            self.tcm_period = tcm_period
+        if particle_diameter is not None:
+            self.particle_diameter = particle_diameter
+        if particle_density is not None:
+            self.particle_density = particle_density
+        if particle_shape is not None:
+            self.particle_shape = particle_shape
+        if deposition_velocity is not None:
+            self.deposition_velocity = deposition_velocity
+        if henry_constant is not None:
+            self.henry_constant = henry_constant
+        if in_cloud_scavenging is not None:
+            self.in_cloud_scavenging = in_cloud_scavenging
+        if below_cloud_scavenging is not None:
+            self.below_cloud_scavenging = below_cloud_scavenging
 
         return self
 
@@ -174,7 +249,23 @@ class DispersionModel:
     ) -> Path:
         """Write HYSPLIT CONTROL file for dispersion."""
         control_path = exec_dir / "CONTROL"
+        with open(control_path, "w") as f:
+            f.write(self._control_text(exec_dir, met_files, output_filename))
 
+        return control_path
+
+    def _control_text(
+        self,
+        exec_dir: Path,
+        met_files: List[str],
+        output_filename: str,
+        met_dir: Optional[Path] = None
+    ) -> str:
+        """Render the HYSPLIT CONTROL file for dispersion.
+
+        The met files are read from ``met_dir``, by default the model's
+        ``met_dir`` or else ``exec_dir``.
+        """
         # Duration direction
         duration = self.duration if self.direction == "forward" else -self.duration
 
@@ -201,7 +292,7 @@ class DispersionModel:
         ])
 
         # Add meteorological file paths
-        met_dir = self.met_dir or exec_dir
+        met_dir = met_dir or self.met_dir or exec_dir
         for met_file in met_files:
             lines.append(str(met_dir) + "/")
             lines.append(met_file)
@@ -243,28 +334,77 @@ class DispersionModel:
 
         # Deposition
         lines.append("1")  # Number of depositing pollutants
-        lines.append("0.0 0.0 0.0")  # Particle diameter, density, shape
-        lines.append("0.0 0.0 0.0 0.0 0.0")  # Deposition velocities
-        lines.append("0.0 0.0 0.0")  # Wet removal
+        # Particle diameter, density, shape
+        lines.append(f"{self.particle_diameter:g} {self.particle_density:g} {self.particle_shape:g}")
+        # Deposition velocity, molecular weight, surface reactivity, diffusivity ratio, Henry
+        lines.append(f"{self.deposition_velocity:g} 0.0 0.0 0.0 {self.henry_constant:g}")
+        # Wet removal: Henry's constant, in-cloud, below-cloud
+        lines.append(
+            f"{self.henry_constant:g} {self.in_cloud_scavenging:g} {self.below_cloud_scavenging:g}"
+        )
+        lines.append("0.0")  # Radioactive decay half-life (days)
+        lines.append("0.0")  # Pollutant resuspension factor (1/m)
 
-        with open(control_path, "w") as f:
-            f.write("\n".join(lines) + "\n")
-
-        return control_path
+        return "\n".join(lines) + "\n"
 
     def run(self) -> "DispersionModel":
-        """Execute the dispersion model. Returns self for method chaining."""
-        from hysplit.met import download_met_files
-        from hysplit.io import dispersion_read
+        """Execute the dispersion model. Returns self for method chaining.
+
+        The time spent in each phase is recorded in ``self.timings``.
+        """
+        timer = self.timings = run_timer()
+        self._check_emissions()
 
-        if not self.sources:
+        if self.engine in ("native", "tcm"):
+            return self._run_native(timer)
+
+        # Without an exec_dir the worker's warm one is reused
+        workdir = ExecDir(self.exec_dir) if self.exec_dir else worker_exec_dir()
+        _drive(self._run_steps(timer, workdir), timer, workdir)
+        return self
+
+    async def run_async(self, launcher: Optional["AsyncLauncher"] = None) -> "DispersionModel":
+        """Execute the dispersion model from an asyncio event loop.
+
+        Same as ``run()``, but hycs_std is started and awaited through an
+        AsyncLauncher (by default the one of the running loop); see
+        ``TrajectoryModel.run_async``. The in-process engines have no
+        binary and run in the loop's default executor instead.
+
+        Raises:
+            LauncherBusyError: The launcher's queue of waiting runs is full
+        """
+        from hysplit.core.aio import get_launcher
+
+        if self.engine in ("native", "tcm"):
+            return await asyncio.get_running_loop().run_in_executor(None, self.run)
+
+        timer = self.timings = run_timer()
+        self._check_emissions()
+        launcher = launcher or get_launcher()
+        async with launcher.slot() as slot_dir:
+            workdir = ExecDir(self.exec_dir) if self.exec_dir else slot_dir
+            await launcher.drive(self._run_steps(timer, workdir), timer, workdir)
+        return self
+
+    def _check_emissions(self):
+        """Fail before any met download or model run on missing or malformed emissions."""
+        from hysplit.io import emitimes_read
+
+        if not self.sources and not self.config.efile:
             raise ValueError("No emission sources defined. Use add_source() first.")
+        if self.config.efile:
+            emitimes_read(self.config.efile)
 
-        # Set up directories
-        exec_dir = Path(self.exec_dir) if self.exec_dir else Path(tempfile.mkdtemp())
-        met_dir = Path(self.met_dir) if self.met_dir else exec_dir
+    def _run_steps(self, timer: RunTimer, workdir: ExecDir) -> RunSteps:
+        """Body of ``run()`` for the hysplit engine as run steps (see ``RunSteps``)."""
+        from hysplit.met import download_met_files
+        from hysplit.io import dispersion_read
+
+        exec_dir = workdir.path
+        # Downloads go to the process's met directory, off the scratch space
+        met_dir = Path(self.met_dir) if self.met_dir else worker_met_dir()
 
-        exec_dir.mkdir(parents=True, exist_ok=True)
         met_dir.mkdir(parents=True, exist_ok=True)
 
         # Set binary path
@@ -273,9 +413,9 @@ class DispersionModel:
         else:
             binary_path = get_binary_path("hycs_std")
 
-        # Write configuration files
-        self.config.to_file(exec_dir)
-        self.ascdata.to_file(exec_dir)
+        # Write configuration files (skipped when unchanged since the last run)
+        with timer.phase("config"):
+            workdir.write_configs(self.config, self.ascdata)
 
         # Calculate days needed for meteorological data
         days = []
@@ -285,30 +425,34 @@ class DispersionModel:
             current += timedelta(days=1)
 
         # Download meteorological files
-        met_files = download_met_files(
-            met_type=self.met_type,
-            days=days,
-            duration=self.duration,
-            direction=self.direction,
-            met_dir=met_dir
-        )
+        with timer.phase("met"):
+            met_files = yield functools.partial(
+                download_met_files,
+                met_type=self.met_type,
+                days=days,
+                duration=self.duration,
+                direction=self.direction,
+                met_dir=met_dir
+            )
 
         output_filename = f"cdump-{self.disp_name or 'default'}"
 
         # Write CONTROL file
-        self._write_control_file(
-            exec_dir=exec_dir,
-            met_files=met_files,
-            output_filename=output_filename
-        )
-
-        # Execute HYSPLIT dispersion model
-        result = subprocess.run(
-            [str(binary_path)],
-            cwd=str(exec_dir),
-            capture_output=True,
-            text=True
-        )
+        with timer.phase("config"):
+            workdir.write("CONTROL", render_dispersion_control(
+                self,
+                exec_dir=exec_dir,
+                met_files=met_files,
+                output_filename=output_filename,
+                met_dir=met_dir
+            ))
+
+        # Execute HYSPLIT dispersion model; a killed or abandoned run may leave partial outputs
+        try:
+            result = yield LaunchStep(binary_path, self.timeout)
+        except (RunTimeoutError, RunCancelledError, GeneratorExit):
+            workdir.remove(output_filename, "PARDUMP")
+            raise
 
         if result.returncode != 0:
             print(f"Warning: HYSPLIT returned non-zero exit code: {result.returncode}")
@@ -319,12 +463,72 @@ class DispersionModel:
         output_path = exec_dir / output_filename
         pardump_path = exec_dir / "PARDUMP"
 
-        if pardump_path.exists():
-            self.disp_df = dispersion_read(pardump_path)
-
-        # Clean up if requested
-        if self.clean_up and self.exec_dir is None:
-            shutil.rmtree(exec_dir, ignore_errors=True)
+        with timer.phase("parse"):
+            if pardump_path.exists():
+                self.disp_df = yield functools.partial(dispersion_read, pardump_path)
+
+        # Clean up if requested; the warm directory itself stays for the next run
+        with timer.phase("cleanup"):
+            if self.clean_up and self.exec_dir is None:
+                workdir.remove(output_filename, "PARDUMP")
+
+    def _run_native(self, timer: RunTimer) -> "DispersionModel":
+        """Execute the dispersion model with the native particle engine.
+
+        Concentrations are gridded during the run into ``concentration_grid``
+        with shape (samples, levels, lat, lon) and deposition (mass/m^2 per
+        sampling period) into ``deposition_grid`` with shape (samples, lat,
+        lon). A cdump file is written only when ``exec_dir`` is set, since
+        nothing else needs a working directory. The "tcm" engine runs at unit
+        emission and additionally fills ``transfer_matrix``.
+        """
+        from hysplit.core.engine import run_native_dispersion
+
+        if self.met_field is None:
+            raise ValueError(
+                "The native engine needs in-memory meteorology. "
+                "Use add_dispersion_params(met_field=...) first."
+            )
+
+        cdump_path = None
+        if self.exec_dir:
+            exec_dir = Path(self.exec_dir)
+            exec_dir.mkdir(parents=True, exist_ok=True)
+            cdump_path = exec_dir / f"cdump-{self.disp_name or 'default'}"
+
+        tcm = self.engine == "tcm"
+        with timer.phase("execute"):
+            result = run_native_dispersion(
+                self, self.met_field, cdump_path=cdump_path,
+                transfer_matrix=tcm, release_period=self.tcm_period if tcm else 0.0
+            )
+
+        self.concentration_grid = result["concentration"]
+        self.deposition_grid = result["deposition"]
+        particles = result["particles"]
+        with timer.phase("parse"):
+            self.disp_df = pd.DataFrame({
+                "particle_i": particles[:, 0].astype(np.int64),
+                "lat": particles[:, 1],
+                "lon": particles[:, 2],
+                "height": particles[:, 3],
+            })
+
+        if tcm:
+            self.transfer_matrix = TransferMatrix(
+                indptr=result["tcm_indptr"],
+                indices=result["tcm_indices"],
+                data=result["tcm_data"],
+                grid_shape=self.concentration_grid.shape,
+                n_sources=result["n_sources"],
+                release_periods=result["release_periods"],
+                release_period=self.tcm_period,
+                sample_start=result["sample_start"],
+                sample_stop=result["sample_stop"],
+            )
+
+        if result["maxpar_reached"]:
+            print(f"Warning: particle count reached maxpar ({self.config.maxpar})")
 
         return self
 
@@ -373,7 +577,8 @@ def hysplit_dispersion(
     binary_path: Optional[str] = None,
     met_dir: Optional[str] = None,
     exec_dir: Optional[str] = None,
-    clean_up: bool = True
+    clean_up: bool = True,
+    timeout: Optional[float] = None
 ) -> pd.DataFrame:
     """Execute HYSPLIT dispersion model.
 
@@ -396,6 +601,7 @@ def hysplit_dispersion(
         met_dir: Directory for meteorological files
         exec_dir: Working directory for model execution
         clean_up: Remove temporary files after completion
+        timeout: Seconds before a hung hycs_std is killed (raises RunTimeoutError)
 
     Returns:
         DataFrame with particle positions or concentration data
@@ -426,7 +632,8 @@ def hysplit_dispersion(
         binary_path=binary_path,
         met_dir=met_dir,
         exec_dir=exec_dir,
-        clean_up=clean_up
+        clean_up=clean_up,
+        timeout=timeout
     )
 
     # Add sources
@@ -0,0 +1,208 @@
+"""Driver for the native particle engine.
+
+The native engine runs a DispersionModel in-process on a MetField instead of
+launching ``hycs_std``. Concentrations and deposition are gridded while the
+particles move, so the run never writes or re-reads a PARDUMP file.
+"""
+
+from __future__ import annotations
+
+from datetime import datetime
+from pathlib import Path
+from typing import TYPE_CHECKING, Optional, Union
+
+import numpy as np
+import pandas as pd
+
+from hysplit.io.readers import emitimes_read
+from hysplit.met.field import MetField
+
+if TYPE_CHECKING:
+    from hysplit.core.dispersion import DispersionModel
+
+try:
+    from hysplit.cpp import _particles as cpp_particles
+    HAS_PARTICLE_ENGINE = True
+except ImportError:
+    HAS_PARTICLE_ENGINE = False
+
+# Default turbulence for the random-displacement model (m^2/s)
+DEFAULT_HORIZONTAL_DIFFUSIVITY = 5000.0
+DEFAULT_VERTICAL_DIFFUSIVITY = 50.0
+
+_EPOCH = datetime(1970, 1, 1)
+
+
+def concentration_grid_spec(model: "DispersionModel", sources: Optional[dict] = None) -> dict:
+    """Concentration grid of a DispersionModel as lower-left corner and shape.
+
+    A grid center of (0, 0) follows the HYSPLIT convention of centering the
+    grid on the first source (of ``sources`` when given).
+    """
+    center_lat, center_lon = model.grid_lat, model.grid_lon
+    if center_lat == 0.0 and center_lon == 0.0:
+        if sources is not None and len(sources["lat"]):
+            center_lat, center_lon = sources["lat"][0], sources["lon"][0]
+        elif model.sources:
+            center_lat, center_lon = model.sources[0].lat, model.sources[0].lon
+
+    nlat = int(round(model.grid_span_lat / model.grid_spacing_lat)) + 1
+    nlon = int(round(model.grid_span_lon / model.grid_spacing_lon)) + 1
+
+    return {
+        "ll_lat": center_lat - (nlat - 1) * model.grid_spacing_lat / 2.0,
+        "ll_lon": center_lon - (nlon - 1) * model.grid_spacing_lon / 2.0,
+        "dlat": float(model.grid_spacing_lat),
+        "dlon": float(model.grid_spacing_lon),
+        "nlat": nlat,
+        "nlon": nlon,
+        "levels": np.asarray(model.grid_levels, dtype=np.float64),
+    }
+
+
+def emission_sources(model: "DispersionModel", efile: Union[str, Path]) -> dict:
+    """Source arrays for the native engine from an EMITIMES file.
+
+    Every distinct location in the file is a source; its records become the
+    engine's emission table with start times in hours along the run (for
+    backward runs, hours before the model start).
+    """
+    table = emitimes_read(efile)
+    hours = (table["start_time"] - model.start_time).dt.total_seconds().to_numpy() / 3600.0
+    duration = table["duration_hours"].to_numpy(dtype=np.float64)
+    if model.direction != "forward":
+        hours = -(hours + duration)
+
+    first = table.groupby("source", sort=True)
+    start = pd.Series(hours).groupby(table["source"]).min()
+    stop = pd.Series(hours + duration).groupby(table["source"]).max()
+
+    return {
+        "lat": first["lat"].first().to_numpy(),
+        "lon": first["lon"].first().to_numpy(),
+        "height": first["height"].first().to_numpy(),
+        "rate": first["rate"].mean().to_numpy(),
+        "start": np.maximum(start.to_numpy(), 0.0),
+        "duration": (stop - start).to_numpy(),
+        "emission_source": table["source"].to_numpy(dtype=np.float64),
+        "emission_start": hours,
+        "emission_duration": duration,
+        "emission_rate": table["rate"].to_numpy(dtype=np.float64),
+    }
+
+
+def run_native_dispersion(
+    model: "DispersionModel",
+    met: MetField,
+    cdump_path: Optional[Union[str, Path]] = None,
+    horizontal_diffusivity: float = DEFAULT_HORIZONTAL_DIFFUSIVITY,
+    vertical_diffusivity: float = DEFAULT_VERTICAL_DIFFUSIVITY,
+    time_step: float = 0.0,
+    seed: int = 0,
+    transfer_matrix: bool = False,
+    release_period: float = 0.0,
+) -> dict:
+    """Run a DispersionModel with the native particle engine.
+
+    Args:
+        model: Dispersion model with sources and grid definition
+        met: In-memory meteorology covering the run
+        cdump_path: Optional path for a HYSPLIT binary concentration file
+        horizontal_diffusivity: Horizontal turbulent diffusivity (m^2/s)
+        vertical_diffusivity: Vertical diffusivity in the mixed layer (m^2/s)
+        time_step: Integration step in minutes (0 selects it from tratio)
+        seed: Random seed for the turbulence model
+        transfer_matrix: Run every source at unit emission and record the
+                         sparse receptor x source-time matrix
+        release_period: Hours per transfer-matrix column (0 = one column
+                        per source)
+
+    When ``model.config.efile`` is set, sources and their time-varying
+    rates come from that EMITIMES file instead of ``model.sources``.
+
+    Returns:
+        Dictionary with ``concentration`` (samples, levels, lat, lon),
+        ``deposition`` (samples, lat, lon), ``sample_start``/``sample_stop``
+        (hours), ``particles`` (id, lat, lon, height, mass) and run statistics.
+        With ``transfer_matrix``, also ``tcm_indptr``, ``tcm_indices``,
+        ``tcm_data`` and ``release_periods``; ``n_sources`` is always set
+    """
+    if not HAS_PARTICLE_ENGINE:
+        raise RuntimeError(
+            "Native particle engine not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+    config = model.config
+    start_time = model.start_time
+
+    if config.efile:
+        sources = emission_sources(model, config.efile)
+    elif model.sources:
+        sources = {
+            "lat": [s.lat for s in model.sources],
+            "lon": [s.lon for s in model.sources],
+            "height": [s.height for s in model.sources],
+            "rate": [s.rate for s in model.sources],
+            "start": [
+                abs(((s.start_time or start_time) - start_time).total_seconds()) / 3600.0
+                for s in model.sources
+            ],
+            "duration": [s.duration_hours for s in model.sources],
+        }
+    else:
+        raise ValueError("No emission sources defined. Use add_source() first.")
+    sources = {key: np.asarray(values, dtype=np.float64) for key, values in sources.items()}
+    if transfer_matrix:
+        # Unit emission; scenarios are applied afterwards through the matrix
+        for key in ("rate", "emission_rate"):
+            if key in sources:
+                sources[key] = np.ones_like(sources[key])
+
+    # Sample from start to end time, as written to the CONTROL file
+    run_hours = (model.end_time - start_time).total_seconds() / 3600.0
+    duration = float(min(model.duration, run_hours)) if run_hours > 0 else float(model.duration)
+
+    options = {
+        "duration": duration,
+        "direction": 1 if model.direction == "forward" else -1,
+        "time_step": float(time_step),
+        "tratio": float(config.tratio),
+        "numpar": int(config.numpar),
+        "maxpar": int(config.maxpar),
+        "kmix0": float(config.kmix0),
+        "model_top": float(model.model_height),
+        "kh": float(horizontal_diffusivity),
+        "kz": float(vertical_diffusivity),
+        "sampling_start": float(model.sampling_start),
+        "sampling_stop": float(min(model.sampling_stop, duration)),
+        "sampling_interval": float(model.sampling_interval),
+        "seed": int(seed),
+        "transfer_matrix": int(transfer_matrix),
+        "release_period": float(release_period),
+        "kspl": float(config.kspl),
+        "krnd": float(config.krnd),
+        "frhs": float(config.frhs),
+        "frvs": float(config.frvs),
+        "frts": float(config.frts),
+        "frhmax": float(config.frhmax),
+        "splitf": float(config.splitf),
+        "cdump_path": str(cdump_path) if cdump_path is not None else None,
+        "start_minutes": int((start_time - _EPOCH).total_seconds() // 60),
+        "cpack": int(config.cpack),
+        "particle_diameter": float(model.particle_diameter),
+        "particle_density": float(model.particle_density),
+        "particle_shape": float(model.particle_shape),
+        "deposition_velocity": float(model.deposition_velocity),
+        "henry_constant": float(model.henry_constant),
+        "in_cloud_scavenging": float(model.in_cloud_scavenging),
+        "below_cloud_scavenging": float(model.below_cloud_scavenging),
+    }
+
+    result = cpp_particles.run_dispersion(
+        met.to_arrays(start_time),
+        sources,
+        concentration_grid_spec(model, sources),
+        options,
+    )
+    result["n_sources"] = len(sources["lat"])
+    return result
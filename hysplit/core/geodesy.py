@@ -0,0 +1,155 @@
+"""Geodesic metrics of trajectories: path length, speed, bearing, displacement.
+
+Works on the columns of trajectory output (``trajectory_read``,
+``run_batch_trajectories(..., return_trajectories=True)`` or a service
+``TrajectoryBatch``) in one native pass over all trajectories
+(``hysplit.cpp._geodesy``), instead of a ``groupby().apply()`` per run.
+
+Per point (the segment from the previous point of the same trajectory):
+
+    step_km      segment length
+    bearing      initial bearing, degrees clockwise from north
+    speed_kmh    segment length over its duration
+    origin_km    distance from the trajectory's first point
+
+Per trajectory: points, duration_h, path_km, origin_km (displacement of
+the last point), max_origin_km, mean_speed_kmh, max_speed_kmh and bearing
+(from the first to the last point).
+
+Distances are great-circle distances on a sphere of the mean Earth radius
+("haversine", vectorized) or ellipsoidal distances on WGS84 ("vincenty",
+within 0.5% of each other); bearings are spherical in both.
+
+Usage:
+    from hysplit.core.geodesy import trajectory_metrics
+
+    df = trajectory_read("output_dir")
+    metrics = trajectory_metrics(df)
+    metrics.runs[["path_km", "origin_km", "mean_speed_kmh"]]
+    df = df.join(metrics.points)     # per-point columns, aligned on the index
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass
+from typing import Optional
+
+import numpy as np
+import pandas as pd
+
+from hysplit.core.cluster import trajectory_key
+from hysplit.core.gridding import group_points
+
+try:
+    from hysplit.cpp import _geodesy as cpp_geodesy
+    HAS_GEODESY_ENGINE = True
+except ImportError:
+    HAS_GEODESY_ENGINE = False
+
+METHODS = ("haversine", "vincenty")
+POINT_COLUMNS = ("step_km", "bearing", "speed_kmh", "origin_km")
+
+
+@dataclass
+class TrajectoryMetrics:
+    """Per-point and per-trajectory geodesic metrics."""
+
+    points: pd.DataFrame  # indexed like the input points
+    runs: pd.DataFrame    # one row per trajectory, indexed by its id
+
+
+def path_metrics(
+    lat: np.ndarray,
+    lon: np.ndarray,
+    hour_along: np.ndarray,
+    offsets: np.ndarray,
+    method: str = "haversine",
+) -> TrajectoryMetrics:
+    """Metrics of trajectories in columnar form.
+
+    Args:
+        lat, lon, hour_along: Points grouped by trajectory, in time order
+                              within each
+        offsets: Start of every trajectory in the arrays, then the point
+                 count (as ``TrajectoryBatch.offsets``)
+        method: "haversine" or "vincenty"
+
+    Returns:
+        TrajectoryMetrics with positional point and trajectory indexes
+    """
+    if not HAS_GEODESY_ENGINE:
+        raise RuntimeError(
+            "Native geodesy engine not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+    if method not in METHODS:
+        raise ValueError(f"method must be one of {METHODS}")
+    lat = np.asarray(lat, dtype=np.float64)
+    lon = np.asarray(lon, dtype=np.float64)
+    hour = np.asarray(hour_along, dtype=np.float64)
+    offsets = np.asarray(offsets, dtype=np.int64)
+    if not (np.isfinite(lat).all() and np.isfinite(lon).all() and np.isfinite(hour).all()):
+        raise ValueError("lat, lon and hour_along must be finite")
+
+    result = cpp_geodesy.path_metrics(lat, lon, hour, offsets, method)
+    points = pd.DataFrame(result["points"], columns=list(POINT_COLUMNS))
+    # The first point of a trajectory ends no segment
+    first = offsets[:-1]
+    points.loc[first, ["bearing", "speed_kmh"]] = np.nan
+
+    runs = pd.DataFrame(result["runs"])
+    runs.insert(0, "points", np.diff(offsets))
+    duration = runs["duration_h"].to_numpy()
+    with np.errstate(divide="ignore", invalid="ignore"):
+        runs.insert(
+            runs.columns.get_loc("max_speed_kmh"),
+            "mean_speed_kmh",
+            np.where(duration > 0, runs["path_km"].to_numpy() / duration, np.nan),
+        )
+    runs.loc[runs["points"] < 2, ["max_speed_kmh", "bearing"]] = np.nan
+    runs = runs[["points", "duration_h", "path_km", "origin_km", "max_origin_km",
+                 "mean_speed_kmh", "max_speed_kmh", "bearing"]]
+    return TrajectoryMetrics(points=points, runs=runs)
+
+
+def trajectory_metrics(
+    trajectories,
+    by: Optional[str] = None,
+    method: str = "haversine",
+) -> TrajectoryMetrics:
+    """Geodesic metrics of every point and trajectory.
+
+    Args:
+        trajectories: DataFrame with ``lat``, ``lon`` and ``hour_along``
+                      columns, or a ``TrajectoryBatch``
+        by: Column identifying the trajectory; defaults to ``run_index``
+            (batch results), ``run``, ``traj`` or ``traj_dt_i``; see
+            ``trajectory_key()``
+        method: "haversine" or "vincenty"
+
+    Returns:
+        TrajectoryMetrics; ``points`` is indexed like the DataFrame (rows
+        without a position get NaN) and ``runs`` by the ``by`` values
+    """
+    if hasattr(trajectories, "offsets"):
+        return path_metrics(trajectories.lat, trajectories.lon, trajectories.hour_along,
+                            trajectories.offsets, method)
+
+    by = trajectory_key(trajectories, by)
+    lat = trajectories["lat"].to_numpy(np.float64)
+    lon = trajectories["lon"].to_numpy(np.float64)
+    hour = trajectories["hour_along"].to_numpy(np.float64)
+    codes, ids = pd.factorize(trajectories[by], sort=True)
+    rows = np.flatnonzero(np.isfinite(lat) & np.isfinite(lon) & np.isfinite(hour) & (codes >= 0))
+    codes = codes[rows]
+
+    order, offsets = group_points(codes, hour[rows])
+    if order is not None:
+        rows, codes = rows[order], codes[order]
+    metrics = path_metrics(lat[rows], lon[rows], hour[rows], offsets, method)
+
+    points = pd.DataFrame(np.nan, index=trajectories.index, columns=list(POINT_COLUMNS))
+    points.iloc[rows] = metrics.points.to_numpy()
+    runs = metrics.runs
+    runs.index = pd.Index(ids[codes[offsets[:-1]]], name=by)
+    return TrajectoryMetrics(points=points, runs=runs)
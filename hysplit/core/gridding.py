@@ -0,0 +1,400 @@
+"""Receptor-model grids from trajectory ensembles (PSCF and CWT).
+
+Joins back trajectories with the concentration measured at the receptor
+when each started, and counts their hourly endpoints on a lat/lon grid:
+
+    n_ij    endpoints in cell ij
+    m_ij    endpoints of runs whose concentration exceeds a threshold
+    PSCF    m_ij / n_ij       (Potential Source Contribution Function)
+    CWT     sum_l c_l * t_ijl / sum_l t_ijl   (Concentration-Weighted Trajectory)
+
+Cells crossed by few trajectories give noisy ratios, so WPSCF and WCWT
+multiply them by a step function of n_ij: by default 0.17, 0.42, 0.70 and
+1.0 for n_ij up to 1, 1.5 and 3 times the mean count of the cells with
+endpoints, and above.
+
+Residence-time grids, like HYSPLIT's trajfreq, follow every segment between
+consecutive endpoints across the cells it crosses instead of counting the
+endpoints alone, which would miss the cells a fast trajectory skips
+between hourly points. They give the hours spent in each cell and the
+share of trajectories passing through it, optionally per height band.
+
+The gridding runs natively (``hysplit.cpp._gridding``) with one set of
+grids per thread.
+
+Usage:
+    from hysplit.core.gridding import receptor_grid, residence_grid
+
+    df, trajectories = run_batch_trajectories(config, return_trajectories=True)
+    pm25 = observations.set_index("run_index")["pm25"]   # one value per run
+    grid = receptor_grid(trajectories, pm25, resolution=0.5)
+    grid.to_dataframe(min_endpoints=10)[["lat", "lon", "wpscf", "wcwt"]]
+
+    freq = residence_grid(trajectories, resolution=0.5, height_bands=[0, 500, 3000])
+    freq.frequency[0]      # % of trajectories crossing each cell below 500 m
+"""
+
+from __future__ import annotations
+
+import math
+from dataclasses import dataclass, field
+from typing import Mapping, Optional, Sequence, Tuple, Union
+
+import numpy as np
+import pandas as pd
+
+from hysplit.core.cluster import trajectory_key
+
+try:
+    from hysplit.cpp import _gridding as cpp_gridding
+    HAS_GRIDDING_ENGINE = True
+except ImportError:
+    HAS_GRIDDING_ENGINE = False
+
+# Weighting function: weight k up to breakpoint k (times the mean count)
+DEFAULT_BREAKPOINTS = (1.0, 1.5, 3.0)
+DEFAULT_WEIGHTS = (0.17, 0.42, 0.70, 1.0)
+
+
+@dataclass(frozen=True)
+class GridSpec:
+    """Regular lat/lon grid with square cells."""
+
+    lat_min: float
+    lat_max: float
+    lon_min: float
+    lon_max: float
+    resolution: float = 1.0  # degrees
+
+    @classmethod
+    def around(cls, lat: np.ndarray, lon: np.ndarray, resolution: float = 1.0) -> "GridSpec":
+        """Smallest grid aligned to ``resolution`` that holds the points.
+
+        Points on both sides of the date line get a grid across it, running
+        east from ``lon_min`` past 180 (e.g. 170 to 200); the native engines
+        place longitudes modulo 360 east of ``lon_min``.
+        """
+        def snap(value, rounding):
+            return rounding(value / resolution) * resolution
+        lat_max = snap(np.max(lat), math.floor) + resolution
+        lon_min = snap(np.min(lon), math.floor)
+        lon_max = snap(np.max(lon), math.floor) + resolution
+        if lon_max - lon_min > 180.0:
+            # Leave out the widest gap between occupied columns round the globe
+            west = np.unique(np.floor(np.mod(lon, 360.0) / resolution)) * resolution
+            gaps = np.diff(west, append=west[0] + 360.0)
+            widest = int(np.argmax(gaps))
+            lon_min = float(west[(widest + 1) % len(west)])
+            lon_max = lon_min + 360.0 - float(gaps[widest]) + resolution
+            if lon_min >= 180.0:
+                lon_min, lon_max = lon_min - 360.0, lon_max - 360.0
+        return cls(
+            snap(np.min(lat), math.floor), min(lat_max, 90.0),
+            lon_min, lon_max, resolution,
+        )
+
+    @property
+    def nlat(self) -> int:
+        return max(1, int(round((self.lat_max - self.lat_min) / self.resolution)))
+
+    @property
+    def nlon(self) -> int:
+        return max(1, int(round((self.lon_max - self.lon_min) / self.resolution)))
+
+    @property
+    def lat_centers(self) -> np.ndarray:
+        return self.lat_min + (np.arange(self.nlat) + 0.5) * self.resolution
+
+    @property
+    def lon_centers(self) -> np.ndarray:
+        return self.lon_min + (np.arange(self.nlon) + 0.5) * self.resolution
+
+    @property
+    def lon_centers_wrapped(self) -> np.ndarray:
+        """``lon_centers`` in [-180, 180); they exceed 180 on grids across the date line."""
+        return np.mod(self.lon_centers + 180.0, 360.0) - 180.0
+
+    def options(self) -> dict:
+        """Grid entries of the native options dict."""
+        return {
+            "lat0": float(self.lat_min), "lon0": float(self.lon_min),
+            "dlat": float(self.resolution), "dlon": float(self.resolution),
+            "nlat": self.nlat, "nlon": self.nlon,
+        }
+
+
+def group_points(codes: np.ndarray, hour_along: np.ndarray) -> Tuple[Optional[np.ndarray], np.ndarray]:
+    """Order grouping points by trajectory, in time order within each.
+
+    Args:
+        codes: Trajectory code of every point (e.g. from ``pd.factorize``)
+        hour_along: Hour of every point along its trajectory
+
+    Returns:
+        Tuple of (permutation to apply, or None when the points already are
+        in order, and the offsets of the trajectories in the ordered points)
+    """
+    along = np.abs(hour_along)
+    order = None
+    # Batch and service output already is in order
+    same = codes[1:] == codes[:-1]
+    if np.any(codes[1:] < codes[:-1]) or np.any(same & (along[1:] <= along[:-1])):
+        order = np.lexsort((along, codes))
+        codes = codes[order]
+    offsets = np.concatenate([[0], np.flatnonzero(codes[1:] != codes[:-1]) + 1, [len(codes)]])
+    return order, offsets.astype(np.int64)
+
+
+def _ratio(numerator: np.ndarray, n: np.ndarray) -> np.ndarray:
+    with np.errstate(divide="ignore", invalid="ignore"):
+        return np.where(n > 0, numerator / n, np.nan)
+
+
+@dataclass
+class ReceptorGrid:
+    """PSCF and CWT grids, (nlat, nlon) arrays with row 0 the southernmost."""
+
+    grid: GridSpec
+    n: np.ndarray = field(repr=False)       # endpoints per cell
+    m: np.ndarray = field(repr=False)       # endpoints of runs above the threshold
+    sum: np.ndarray = field(repr=False)     # concentration-weighted endpoints
+    weight: np.ndarray = field(repr=False)  # weighting function of n
+    threshold: float = 0.0
+    n_runs: int = 0
+    n_points: int = 0
+    outside: int = 0                        # endpoints off the grid
+
+    @property
+    def pscf(self) -> np.ndarray:
+        return _ratio(self.m, self.n)
+
+    @property
+    def wpscf(self) -> np.ndarray:
+        return self.pscf * self.weight
+
+    @property
+    def cwt(self) -> np.ndarray:
+        return _ratio(self.sum, self.n)
+
+    @property
+    def wcwt(self) -> np.ndarray:
+        return self.cwt * self.weight
+
+    def to_dataframe(self, min_endpoints: int = 1) -> pd.DataFrame:
+        """One row per cell with at least ``min_endpoints`` endpoints."""
+        lat, lon = np.meshgrid(self.grid.lat_centers, self.grid.lon_centers_wrapped, indexing="ij")
+        keep = self.n >= max(1, min_endpoints)
+        return pd.DataFrame({
+            "lat": lat[keep],
+            "lon": lon[keep],
+            "n": self.n[keep],
+            "m": self.m[keep],
+            "weight": self.weight[keep],
+            "pscf": self.pscf[keep],
+            "wpscf": self.wpscf[keep],
+            "cwt": self.cwt[keep],
+            "wcwt": self.wcwt[keep],
+        })
+
+
+def receptor_grid(
+    trajectories: pd.DataFrame,
+    concentrations: Union[pd.Series, Mapping],
+    by: Optional[str] = None,
+    resolution: float = 1.0,
+    grid: Optional[GridSpec] = None,
+    threshold: Optional[float] = None,
+    percentile: float = 75.0,
+    breakpoints: Sequence[float] = DEFAULT_BREAKPOINTS,
+    weights: Sequence[float] = DEFAULT_WEIGHTS,
+    relative: bool = True,
+    skip_origin: bool = True,
+) -> ReceptorGrid:
+    """PSCF and CWT grids of a trajectory ensemble.
+
+    Args:
+        trajectories: Trajectory points with ``lat``, ``lon`` and
+                      ``hour_along`` columns, e.g. from
+                      ``run_batch_trajectories(..., return_trajectories=True)``
+        concentrations: Receptor concentration per trajectory, indexed by
+                        the ``by`` column; trajectories without a value
+                        (or with NaN) are left out
+        by: Column identifying the trajectory; defaults to ``run_index``
+            (batch results), ``run``, ``traj`` or ``traj_dt_i``; see
+            ``trajectory_key()``
+        resolution: Cell size in degrees when ``grid`` is not given
+        grid: Grid to count on; defaults to the extent of the endpoints
+        threshold: Concentration above which a run counts towards PSCF;
+                   defaults to the ``percentile`` of the concentrations
+        percentile: Percentile used when ``threshold`` is None
+        breakpoints: Endpoint counts separating the weights, ascending
+        weights: Weight of each interval (one more than breakpoints)
+        relative: Breakpoints are multiples of the mean count of the cells
+                  with endpoints; False for absolute counts
+        skip_origin: Leave out hour 0, where every trajectory is at the receptor
+
+    Returns:
+        ReceptorGrid
+    """
+    if not HAS_GRIDDING_ENGINE:
+        raise RuntimeError(
+            "Native gridding engine not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+    if len(weights) != len(breakpoints) + 1:
+        raise ValueError("weights needs one more entry than breakpoints")
+
+    by = trajectory_key(trajectories, by)
+    values = pd.Series(concentrations, dtype=np.float64).dropna()
+    run = values.index.get_indexer(trajectories[by])
+    lat = trajectories["lat"].to_numpy(np.float64)
+    lon = trajectories["lon"].to_numpy(np.float64)
+    keep = (run >= 0) & np.isfinite(lat) & np.isfinite(lon)
+    if skip_origin:
+        keep &= trajectories["hour_along"].to_numpy() != 0
+    lat, lon, run = lat[keep], lon[keep], run[keep].astype(np.int64)
+    if len(run) == 0:
+        raise ValueError(f"No trajectory endpoints with a concentration (joined on '{by}')")
+
+    conc = values.to_numpy()
+    present = np.bincount(run, minlength=len(conc)) > 0
+    if threshold is None:
+        threshold = float(np.percentile(conc[present], percentile))
+    if grid is None:
+        grid = GridSpec.around(lat, lon, resolution)
+
+    options = dict(
+        grid.options(),
+        threshold=float(threshold),
+        breakpoints=np.asarray(breakpoints, dtype=np.float64),
+        weights=np.asarray(weights, dtype=np.float64),
+        relative=int(relative),
+    )
+    result = cpp_gridding.receptor_grid(lat, lon, run, conc, options)
+    return ReceptorGrid(
+        grid=grid,
+        n=result["n"],
+        m=result["m"],
+        sum=result["sum"],
+        weight=result["weight"],
+        threshold=float(threshold),
+        n_runs=int(present.sum()),
+        n_points=len(run),
+        outside=result["outside"],
+    )
+
+
+@dataclass
+class ResidenceGrid:
+    """Residence-time grids, (bands, nlat, nlon) arrays with row 0 the southernmost."""
+
+    grid: GridSpec
+    hours: np.ndarray = field(repr=False)         # time spent in the cell
+    trajectories: np.ndarray = field(repr=False)  # trajectories passing through
+    bands: np.ndarray = field(repr=False)         # height band edges (m AGL), empty for one band
+    n_trajectories: int = 0
+    total_hours: float = 0.0                      # duration of all segments
+    outside: float = 0.0                          # hours off the grid, within a band
+
+    @property
+    def frequency(self) -> np.ndarray:
+        """Percent of the trajectories passing through each cell."""
+        return 100.0 * self.trajectories / max(self.n_trajectories, 1)
+
+    @property
+    def residence(self) -> np.ndarray:
+        """Percent of the total trajectory time spent in each cell."""
+        return 100.0 * self.hours / self.total_hours if self.total_hours > 0 else np.zeros_like(self.hours)
+
+    def to_dataframe(self, min_trajectories: int = 1) -> pd.DataFrame:
+        """One row per band and cell with at least ``min_trajectories`` trajectories."""
+        lat, lon = np.meshgrid(self.grid.lat_centers, self.grid.lon_centers_wrapped, indexing="ij")
+        keep = self.trajectories >= max(1, min_trajectories)
+        band, _, _ = np.nonzero(keep)
+        frame = pd.DataFrame({
+            "lat": np.broadcast_to(lat, keep.shape)[keep],
+            "lon": np.broadcast_to(lon, keep.shape)[keep],
+            "hours": self.hours[keep],
+            "trajectories": self.trajectories[keep],
+            "frequency": self.frequency[keep],
+            "residence": self.residence[keep],
+        })
+        if len(self.bands):
+            frame.insert(0, "height_bottom", self.bands[band])
+            frame.insert(1, "height_top", self.bands[band + 1])
+        return frame
+
+
+def residence_grid(
+    trajectories: pd.DataFrame,
+    by: Optional[str] = None,
+    resolution: float = 1.0,
+    grid: Optional[GridSpec] = None,
+    height_bands: Optional[Sequence[float]] = None,
+) -> ResidenceGrid:
+    """Residence time and trajectory frequency of a trajectory ensemble.
+
+    Every segment between consecutive endpoints is followed across the
+    cells it crosses (straight in lat/lon, the short way round in
+    longitude), adding to each cell the time spent in it.
+
+    Args:
+        trajectories: Trajectory points with ``lat``, ``lon`` and
+                      ``hour_along`` columns (and ``height`` for bands)
+        by: Column identifying the trajectory; defaults to ``run_index``
+            (batch results), ``run``, ``traj`` or ``traj_dt_i``; see
+            ``trajectory_key()``
+        resolution: Cell size in degrees when ``grid`` is not given
+        grid: Grid to count on; defaults to the extent of the endpoints
+        height_bands: Ascending band edges in metres AGL, e.g. [0, 500, 3000];
+                      a segment counts in a band for the part of it within
+                      the band (heights interpolated linearly)
+
+    Returns:
+        ResidenceGrid
+    """
+    if not HAS_GRIDDING_ENGINE:
+        raise RuntimeError(
+            "Native gridding engine not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+
+    by = trajectory_key(trajectories, by)
+    lat = trajectories["lat"].to_numpy(np.float64)
+    lon = trajectories["lon"].to_numpy(np.float64)
+    hour = trajectories["hour_along"].to_numpy(np.float64)
+    if height_bands is not None:
+        height = trajectories["height"].to_numpy(np.float64)
+        bands = np.asarray(height_bands, dtype=np.float64)
+        if len(bands) < 2 or np.any(np.diff(bands) <= 0):
+            raise ValueError("height_bands needs at least two increasing edges")
+    else:
+        height = np.zeros(len(lat))
+        bands = np.empty(0)
+    keep = np.isfinite(lat) & np.isfinite(lon) & np.isfinite(hour) & np.isfinite(height)
+    codes, _ = pd.factorize(trajectories[by])
+    keep &= codes >= 0
+    if not keep.any():
+        raise ValueError("No trajectory points to grid")
+    lat, lon, hour, height, codes = lat[keep], lon[keep], hour[keep], height[keep], codes[keep]
+
+    order, offsets = group_points(codes, hour)
+    if order is not None:
+        lat, lon, hour, height = lat[order], lon[order], hour[order], height[order]
+
+    if grid is None:
+        grid = GridSpec.around(lat, lon, resolution)
+    options = dict(grid.options(), bands=bands if len(bands) else None)
+    result = cpp_gridding.residence_grid(lat, lon, height, hour, offsets, options)
+
+    segment_hours = np.abs(np.diff(hour))
+    segment_hours[offsets[1:-1] - 1] = 0.0
+    return ResidenceGrid(
+        grid=grid,
+        hours=result["hours"],
+        trajectories=result["trajectories"],
+        bands=bands,
+        n_trajectories=len(offsets) - 1,
+        total_hours=float(segment_hours.sum()),
+        outside=result["outside"],
+    )
@@ -0,0 +1,340 @@
+"""Launching the HYSPLIT binaries from warm working directories.
+
+Each model run needs SETUP.CFG, ASCDATA.CFG and CONTROL in the working
+directory of the binary. Creating a fresh temporary directory per run,
+rewriting every file and removing the tree afterwards costs thousands of
+filesystem operations per run in large batches. Instead, every worker
+(process and thread) keeps one ``ExecDir`` for its lifetime: config files
+are only rewritten when their content hash changes, so consecutive runs
+only write CONTROL. Binaries are started with posix_spawn from the native
+launcher when it is available.
+
+A launch can be bounded by a timeout and by a ``CancelFlag``, a byte in a
+file mapped by every process of a batch: the binary is killed when the
+timeout expires or another process sets the flag (e.g. because a duplicate
+of the run finished first). ``launch_limits()`` applies both to every
+launch of the calling thread, so model classes need no extra arguments.
+"""
+
+from __future__ import annotations
+
+import contextlib
+import hashlib
+import mmap
+import multiprocessing.util
+import os
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Dict, Iterator, Optional, Sequence, Union
+
+from hysplit.core.config import HysplitConfig, AscdataConfig
+from hysplit.core.scratch import scratch_dir
+from hysplit.core.templates import render_ascdata, render_setup
+
+try:
+    from hysplit.cpp import _launcher as cpp_launcher
+    HAS_NATIVE_LAUNCHER = os.name == "posix"
+except ImportError:
+    HAS_NATIVE_LAUNCHER = False
+
+
+@dataclass
+class LaunchResult:
+    """Exit status and captured output of a finished process."""
+
+    returncode: int
+    stdout: str
+    stderr: str
+    elapsed: float  # seconds
+    spawn_elapsed: float = 0.0  # seconds until the process was started
+    timed_out: bool = False  # killed because the timeout expired
+    cancelled: bool = False  # killed because its cancel flag was set
+
+
+class RunTimeoutError(TimeoutError):
+    """A model binary was killed after exceeding its timeout."""
+
+
+class RunCancelledError(Exception):
+    """A model binary was killed because its run was cancelled."""
+
+
+@dataclass(frozen=True)
+class CancelFlag:
+    """One cancellation byte in a shared flag file; picklable."""
+
+    path: str
+    index: int
+
+    def _buffer(self) -> mmap.mmap:
+        return _map_flags(self.path)
+
+    def is_set(self) -> bool:
+        return self._buffer()[self.index] != 0
+
+    def set(self):
+        self._buffer()[self.index] = 1
+
+
+_flag_maps: Dict[str, mmap.mmap] = {}
+
+
+def _map_flags(path: str) -> mmap.mmap:
+    """Map a flag file, once per process."""
+    mapped = _flag_maps.get(path)
+    if mapped is None:
+        fd = os.open(path, os.O_RDWR)
+        try:
+            mapped = _flag_maps[path] = mmap.mmap(fd, os.fstat(fd).st_size)
+        finally:
+            os.close(fd)
+    return mapped
+
+
+class CancelFlags:
+    """Shared file of cancellation flags, one byte per run.
+
+    Created by the parent of a batch; workers map it on first use of one of
+    its ``CancelFlag`` s. Lives in /dev/shm when available.
+    """
+
+    def __init__(self, n: int):
+        shm = "/dev/shm"
+        fd, self.path = tempfile.mkstemp(
+            prefix="hysplit_cancel_", dir=shm if os.path.isdir(shm) else None
+        )
+        try:
+            os.ftruncate(fd, max(1, n))
+        finally:
+            os.close(fd)
+
+    def flag(self, index: int) -> CancelFlag:
+        return CancelFlag(self.path, index)
+
+    def unlink(self):
+        mapped = _flag_maps.pop(self.path, None)
+        if mapped is not None:
+            mapped.close()
+        try:
+            os.unlink(self.path)
+        except FileNotFoundError:
+            pass
+
+
+_limits = threading.local()
+
+
+@contextlib.contextmanager
+def launch_limits(timeout: Optional[float] = None, cancel: Optional[CancelFlag] = None) -> Iterator[None]:
+    """Bound every launch of the calling thread inside the block.
+
+    Args:
+        timeout: Seconds before a binary is killed
+        cancel: Flag that kills the running binary when set
+    """
+    previous = getattr(_limits, "value", (None, None))
+    _limits.value = (timeout, cancel)
+    try:
+        yield
+    finally:
+        _limits.value = previous
+
+
+# Interval between cancel flag checks of the subprocess fallback
+CANCEL_POLL_SECONDS = 0.02
+
+
+def launch(
+    argv: Sequence[Union[str, Path]],
+    cwd: Optional[Union[str, Path]] = None,
+    timeout: Optional[float] = None,
+    cancel: Optional[CancelFlag] = None,
+) -> LaunchResult:
+    """Run a program to completion and capture its output.
+
+    Args:
+        argv: Program path and arguments
+        cwd: Working directory of the program
+        timeout: Seconds before the program is killed; defaults to the
+                 ``launch_limits()`` of the thread
+        cancel: Flag that kills the program when set; defaults to the
+                ``launch_limits()`` of the thread
+
+    Returns:
+        LaunchResult (a killed program has ``timed_out`` or ``cancelled`` set)
+    """
+    default_timeout, default_cancel = getattr(_limits, "value", (None, None))
+    timeout = timeout if timeout is not None else default_timeout
+    cancel = cancel if cancel is not None else default_cancel
+    argv = [str(a) for a in argv]
+    cwd = str(cwd) if cwd is not None else None
+    if HAS_NATIVE_LAUNCHER:
+        result = cpp_launcher.spawn(
+            argv, cwd,
+            timeout=timeout if timeout is not None else -1.0,
+            cancel=cancel._buffer() if cancel is not None else None,
+            cancel_index=cancel.index if cancel is not None else 0,
+        )
+        return LaunchResult(
+            returncode=result["returncode"],
+            stdout=result["stdout"].decode(errors="replace"),
+            stderr=result["stderr"].decode(errors="replace"),
+            elapsed=result["elapsed"],
+            spawn_elapsed=result["spawn_elapsed"],
+            timed_out=result["timed_out"],
+            cancelled=result["cancelled"],
+        )
+
+    t0 = time.perf_counter()
+    process = subprocess.Popen(
+        argv, cwd=cwd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True
+    )
+    spawned = time.perf_counter() - t0
+    timed_out = cancelled = False
+    while True:
+        wait = None if timeout is None else max(0.0, timeout - (time.perf_counter() - t0))
+        if cancel is not None:
+            wait = CANCEL_POLL_SECONDS if wait is None else min(wait, CANCEL_POLL_SECONDS)
+        try:
+            stdout, stderr = process.communicate(timeout=wait)
+            break
+        except subprocess.TimeoutExpired:
+            timed_out = timeout is not None and time.perf_counter() - t0 >= timeout
+            cancelled = not timed_out and cancel is not None and cancel.is_set()
+            if timed_out or cancelled:
+                process.kill()
+                stdout, stderr = process.communicate()
+                break
+    return LaunchResult(
+        process.returncode, stdout, stderr, time.perf_counter() - t0, spawned, timed_out, cancelled
+    )
+
+
+class ExecDir:
+    """Working directory reused across model runs.
+
+    Tracks the content hash of every file written through ``write()`` so
+    unchanged files are left alone, including files already on disk from a
+    previous run in the same directory.
+    """
+
+    def __init__(self, path: Union[str, Path]):
+        self.path = Path(path)
+        self.path.mkdir(parents=True, exist_ok=True)
+        self._hashes: dict[str, bytes] = {}
+        self.files_written = 0
+        self.files_reused = 0
+
+    def write(self, name: str, content: Union[str, bytes]) -> bool:
+        """Write a file unless it already holds this content.
+
+        Args:
+            name: File name inside the directory
+            content: File content
+
+        Returns:
+            True if the file was written, False if it was reused
+        """
+        data = content.encode() if isinstance(content, str) else content
+        digest = hashlib.blake2b(data, digest_size=16).digest()
+        filepath = self.path / name
+
+        known = self._hashes.get(name)
+        if known is None and filepath.exists():
+            known = hashlib.blake2b(filepath.read_bytes(), digest_size=16).digest()
+        if known == digest and filepath.exists():
+            self._hashes[name] = digest
+            self.files_reused += 1
+            return False
+
+        # One write call; the files are small
+        fd = os.open(filepath, os.O_WRONLY | os.O_CREAT | os.O_TRUNC | getattr(os, "O_BINARY", 0), 0o644)
+        try:
+            os.write(fd, data)
+        finally:
+            os.close(fd)
+        self._hashes[name] = digest
+        self.files_written += 1
+        return True
+
+    def write_configs(self, config: HysplitConfig, ascdata: AscdataConfig):
+        """Write SETUP.CFG and ASCDATA.CFG if their content changed."""
+        self.write("SETUP.CFG", render_setup(config))
+        self.write("ASCDATA.CFG", render_ascdata(ascdata))
+
+    def remove(self, *names: str):
+        """Delete files (e.g. model outputs) from the directory."""
+        for name in names:
+            self._hashes.pop(name, None)
+            try:
+                os.remove(self.path / name)
+            except FileNotFoundError:
+                pass
+
+    def run(self, binary_path: Union[str, Path], *args: str, timeout: Optional[float] = None) -> LaunchResult:
+        """Run a binary in this directory."""
+        return launch([binary_path, *args], cwd=self.path, timeout=timeout)
+
+
+_workers = threading.local()
+
+
+def worker_exec_dir() -> ExecDir:
+    """The warm working directory of the calling process and thread.
+
+    Created on first use on the scratch space or under the system temporary
+    directory (see ``temporary_exec_dir()``) and removed when the process
+    exits, including multiprocessing pool workers. Met files are not
+    downloaded here but into ``worker_met_dir()``.
+    """
+    pid = os.getpid()
+    cached = getattr(_workers, "exec_dir", None)
+    if cached is not None and cached[0] == pid and cached[1].path.is_dir():
+        return cached[1]
+
+    exec_dir = temporary_exec_dir(f"hysplit_worker_{pid}_")
+    _workers.exec_dir = (pid, exec_dir)
+    return exec_dir
+
+
+_met_dir_lock = threading.Lock()
+_met_dir: Optional[tuple] = None
+
+
+def worker_met_dir() -> Path:
+    """Directory of the met files downloaded by runs without a ``met_dir``.
+
+    One per process, shared by its threads, and always under the system
+    temporary directory: met files are far larger than a run's working
+    files and must not fill the scratch space, whose budget is only
+    checked when a directory is created. The files stay available to later
+    runs of the process and are removed when it exits.
+    """
+    global _met_dir
+    pid = os.getpid()
+    with _met_dir_lock:
+        if _met_dir is None or _met_dir[0] != pid or not _met_dir[1].is_dir():
+            path = tempfile.mkdtemp(prefix=f"hysplit_met_{pid}_")
+            multiprocessing.util.Finalize(
+                None, shutil.rmtree, args=(path,), kwargs={"ignore_errors": True}, exitpriority=10
+            )
+            _met_dir = (pid, Path(path))
+        return _met_dir[1]
+
+
+def temporary_exec_dir(prefix: str) -> ExecDir:
+    """New ExecDir on the process's scratch space (see hysplit.core.scratch)
+    or, if scratch is off or full, under the system temporary directory;
+    removed at exit."""
+    path = scratch_dir(prefix)
+    if path is None:
+        path = tempfile.mkdtemp(prefix=prefix)
+        multiprocessing.util.Finalize(
+            None, shutil.rmtree, args=(path,), kwargs={"ignore_errors": True}, exitpriority=10
+        )
+    return ExecDir(path)
@@ -0,0 +1,81 @@
+"""Planning of multi-start trajectory invocations.
+
+A CONTROL file can list many starting locations that share a start time,
+and ``hyts_std`` computes all of them in one process, numbering the
+trajectories 1..N in a single output file. Grouping the receptor x day x
+hour runs of a model by start time therefore replaces one process launch
+per run with one per start time (bounded by ``max_starts``), and the
+combined output is split back into per-run files afterwards with
+``split_trajectory_file``.
+
+One bad start point should not cost its whole group. When an invocation
+exits non-zero, or its output lacks some of the group's trajectories,
+``TrajectoryModel`` re-runs those runs one per invocation (groups of
+``max_starts=1``). After a non-zero exit that is every run of the group,
+as the trajectories that were written may have been cut short.
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+from datetime import datetime
+from typing import Dict, List, Sequence
+
+
+@dataclass
+class PlannedRun:
+    """One trajectory of a model: a receptor and a start time."""
+
+    index: int                 # Position in the model's run order
+    receptor: int              # 1-based receptor number
+    lat: float
+    lon: float
+    height: float
+    start_time: datetime
+    output_filename: str       # Per-run trajectory file name
+
+
+@dataclass
+class StartGroup:
+    """Runs computed together by one multi-start invocation."""
+
+    start_time: datetime
+    runs: List[PlannedRun] = field(default_factory=list)
+
+    @property
+    def locations(self) -> List[tuple[float, float, float]]:
+        """Starting locations in trajectory-number order."""
+        return [(run.lat, run.lon, run.height) for run in self.runs]
+
+    def output_filename(self, prefix: str, chunk: int) -> str:
+        """Name of the combined output file of this group."""
+        if len(self.runs) == 1:
+            return self.runs[0].output_filename
+        return f"tdump-{prefix}-{self.start_time.strftime('%Y%m%d%H')}-{chunk:03d}"
+
+
+def plan_start_groups(runs: Sequence[PlannedRun], max_starts: int = 100) -> List[StartGroup]:
+    """Group runs sharing a start time into multi-start invocations.
+
+    Groups follow the first appearance of each start time in ``runs`` and
+    keep the run order inside a group, so trajectory k of a group is its
+    k-th run. Start times with more than ``max_starts`` runs are split into
+    several groups.
+
+    Args:
+        runs: Runs of one model (same duration, direction and met files)
+        max_starts: Maximum starting locations per invocation (1 disables grouping)
+
+    Returns:
+        List of StartGroup objects
+    """
+    max_starts = max(1, int(max_starts))
+    by_time: Dict[datetime, List[PlannedRun]] = {}
+    for run in runs:
+        by_time.setdefault(run.start_time, []).append(run)
+
+    groups = []
+    for start_time, members in by_time.items():
+        for i in range(0, len(members), max_starts):
+            groups.append(StartGroup(start_time, list(members[i:i + max_starts])))
+    return groups
@@ -0,0 +1,320 @@
+"""Scratch space for run directories on tmpfs.
+
+Every run writes CONTROL, SETUP.CFG, MESSAGE, WARNING and its output files
+in its working directory. Under the system temporary directory these can
+land on a network home directory, where each of those small operations is
+a round trip. A ``ScratchSpace`` keeps the working directories on
+``/dev/shm`` or another configured tmpfs instead, within a size budget
+shared by all the processes using the same root; a directory that would
+not fit falls back to the system temporary directory.
+
+Each process owns one tree (``hysplit_scratch_<pid>_*``) and holds a POSIX
+lock on its ``.lock`` file, which child processes do not inherit. The tree
+is removed at exit, and the trees of processes that crashed (their lock is
+free) are removed by the next ScratchSpace created on the same root.
+
+An ``OutputSpool`` stages finished output files on the scratch and copies
+them to their persistent paths in batches, so a slow output filesystem
+sees a few large writes instead of one small write per run.
+
+Usage:
+    from hysplit.core import scratch
+
+    scratch.configure("/dev/shm", budget="2G")   # or HYSPLIT_SCRATCH=/dev/shm
+    model.run()  # the worker's working directory is created on /dev/shm
+"""
+
+from __future__ import annotations
+
+import multiprocessing.util
+import os
+import re
+import shutil
+import tempfile
+import time
+from collections import deque
+from pathlib import Path
+from typing import Any, Deque, List, Optional, Tuple, Union
+
+try:
+    import fcntl
+    HAS_LOCKF = True
+except ImportError:
+    HAS_LOCKF = False
+
+# Scratch root ("off" disables) and budget, e.g. "512M"
+SCRATCH_ENV = "HYSPLIT_SCRATCH"
+BUDGET_ENV = "HYSPLIT_SCRATCH_BUDGET"
+TMPFS_ROOT = Path("/dev/shm")
+DEFAULT_BUDGET = 1 << 30
+TREE_PREFIX = "hysplit_scratch_"
+LOCK_NAME = ".lock"
+# Space a new working directory must leave within the budget
+EXEC_DIR_RESERVE = 16 << 20
+# A tree without a lock file is only swept once this old (it may be starting)
+UNLOCKED_GRACE_SECONDS = 60.0
+
+
+def parse_size(size: Union[int, str]) -> int:
+    """Bytes of a size such as ``1073741824``, ``"512M"`` or ``"2G"``."""
+    if isinstance(size, int):
+        return size
+    match = re.fullmatch(r"\s*(\d+(?:\.\d+)?)\s*([KMGT]?)i?B?\s*", size, re.IGNORECASE)
+    if match is None:
+        raise ValueError(f"Invalid size: '{size}'")
+    scale = 1 << (10 * " KMGT".index(match.group(2).upper() or " "))
+    return int(float(match.group(1)) * scale)
+
+
+def tmpfs_root() -> Optional[Path]:
+    """``/dev/shm`` if it exists and is writable."""
+    if TMPFS_ROOT.is_dir() and os.access(TMPFS_ROOT, os.W_OK | os.X_OK):
+        return TMPFS_ROOT
+    return None
+
+
+def _lock(path: Path, blocking: bool) -> Optional[int]:
+    """Descriptor holding an exclusive lock on ``path``, or None if it is held."""
+    fd = os.open(path, os.O_RDWR | os.O_CREAT, 0o600)
+    try:
+        fcntl.lockf(fd, fcntl.LOCK_EX | (0 if blocking else fcntl.LOCK_NB))
+    except OSError:
+        os.close(fd)
+        return None
+    return fd
+
+
+def sweep_stale(root: Union[str, Path]) -> int:
+    """Remove the scratch trees of dead processes under ``root``.
+
+    Returns:
+        Number of trees removed
+    """
+    if not HAS_LOCKF:
+        return 0
+    removed = 0
+    own = f"{TREE_PREFIX}{os.getpid()}_"
+    for tree in Path(root).glob(f"{TREE_PREFIX}*"):
+        # POSIX locks never conflict within a process
+        if tree.name.startswith(own):
+            continue
+        lock = tree / LOCK_NAME
+        try:
+            if not lock.exists():
+                if time.time() - tree.stat().st_mtime < UNLOCKED_GRACE_SECONDS:
+                    continue
+                fd = None
+            else:
+                fd = _lock(lock, blocking=False)
+                if fd is None:
+                    continue  # owner alive
+        except OSError:
+            continue
+        shutil.rmtree(tree, ignore_errors=True)
+        if fd is not None:
+            os.close(fd)
+        removed += 1
+    return removed
+
+
+def tree_usage(root: Union[str, Path]) -> int:
+    """Bytes allocated by all scratch trees under ``root``."""
+    used = 0
+    for tree in Path(root).glob(f"{TREE_PREFIX}*"):
+        for dirpath, _, filenames in os.walk(tree):
+            for name in filenames:
+                try:
+                    used += os.lstat(os.path.join(dirpath, name)).st_blocks * 512
+                except (OSError, AttributeError):
+                    pass
+    return used
+
+
+class ScratchSpace:
+    """Scratch tree of this process under a (tmpfs) root, with a size budget.
+
+    Args:
+        root: Directory to create the tree in, e.g. /dev/shm
+        budget: Bytes all scratch trees under ``root`` may use together;
+                default ``HYSPLIT_SCRATCH_BUDGET`` or 1 GiB
+    """
+
+    def __init__(self, root: Union[str, Path], budget: Union[int, str, None] = None):
+        self.root = Path(root)
+        self.budget = parse_size(budget) if budget is not None else _env_budget()
+        self.swept = sweep_stale(self.root)
+        self.path = Path(tempfile.mkdtemp(prefix=f"{TREE_PREFIX}{os.getpid()}_", dir=self.root))
+        self._lock_fd = _lock(self.path / LOCK_NAME, blocking=True) if HAS_LOCKF else None
+        self.fallbacks = 0
+        self._finalizer = multiprocessing.util.Finalize(
+            self, _remove_tree, args=(self.path, self._lock_fd), exitpriority=10
+        )
+
+    def used(self) -> int:
+        """Bytes used by the scratch trees under the root."""
+        return tree_usage(self.root)
+
+    def fits(self, nbytes: int) -> bool:
+        """Whether ``nbytes`` more fit in the budget and on the filesystem."""
+        try:
+            stat = os.statvfs(self.root)
+            free = stat.f_bavail * stat.f_frsize
+        except (OSError, AttributeError):
+            free = nbytes
+        return nbytes <= free and self.used() + nbytes <= self.budget
+
+    def mkdtemp(self, prefix: str, reserve: int = EXEC_DIR_RESERVE) -> Optional[Path]:
+        """New directory in the tree, or None if ``reserve`` bytes do not fit."""
+        if not self.fits(reserve):
+            if not self.fallbacks:
+                print(f"Warning: scratch budget of {self.budget / (1 << 20):.1f} MiB under {self.root} "
+                      f"exhausted; using the temporary directory")
+            self.fallbacks += 1
+            return None
+        return Path(tempfile.mkdtemp(prefix=prefix, dir=self.path))
+
+    def close(self):
+        """Remove the tree."""
+        self._finalizer()
+
+
+def _remove_tree(path: Path, lock_fd: Optional[int]):
+    shutil.rmtree(path, ignore_errors=True)
+    if lock_fd is not None:
+        os.close(lock_fd)
+
+
+_configured: Optional[Tuple[Optional[str], int]] = None
+_space: Optional[Tuple[int, ScratchSpace]] = None
+
+
+def configure(root: Optional[Union[str, Path]], budget: Union[int, str, None] = None):
+    """Set the scratch root of this process; None turns scratch off.
+
+    Working directories created from then on (``worker_exec_dir()``) are
+    placed on it. Without a call, ``HYSPLIT_SCRATCH`` and
+    ``HYSPLIT_SCRATCH_BUDGET`` are used.
+    """
+    global _configured
+    root = str(root) if root is not None else None
+    budget = parse_size(budget) if budget is not None else _env_budget()
+    if _configured != (root, budget):
+        _configured = (root, budget)
+        _drop_space()
+
+
+def _env_budget() -> int:
+    return parse_size(os.environ.get(BUDGET_ENV) or DEFAULT_BUDGET)
+
+
+def _drop_space():
+    global _space
+    if _space is not None and _space[0] == os.getpid():
+        _space[1].close()
+    _space = None
+
+
+def process_scratch() -> Optional[ScratchSpace]:
+    """The ScratchSpace of the calling process, or None if scratch is off."""
+    global _space
+    if _space is not None and _space[0] == os.getpid() and _space[1].path.is_dir():
+        return _space[1]
+    if _configured is not None:
+        root, budget = _configured
+    else:
+        root = os.environ.get(SCRATCH_ENV) or None
+        budget = _env_budget()
+    if root is None or root.lower() == "off":
+        return None
+    try:
+        space = ScratchSpace(root, budget)
+    except OSError as e:
+        print(f"Warning: scratch space unavailable under {root} ({e}); using the temporary directory")
+        configure(None)
+        return None
+    _space = (os.getpid(), space)
+    return space
+
+
+def scratch_dir(prefix: str) -> Optional[Path]:
+    """New directory on this process's scratch, or None (off or full)."""
+    space = process_scratch()
+    return space.mkdtemp(prefix) if space is not None else None
+
+
+class OutputSpool:
+    """Output files staged on scratch and copied to their final paths in batches.
+
+    Producers write complete files into ``directory`` and ``add()`` them;
+    ``flush()`` copies every pending file to its final path (through a
+    temporary name, so a crash never leaves a partial file) and returns the
+    tokens of the files it made persistent, e.g. to journal those runs only.
+
+    Args:
+        space: ScratchSpace to stage the files in
+        flush_bytes: Pending bytes that make the spool due
+        flush_seconds: Age of the oldest pending file that makes it due
+    """
+
+    def __init__(self, space: ScratchSpace, flush_bytes: int = 64 << 20, flush_seconds: float = 10.0):
+        self.space = space
+        self.directory = Path(tempfile.mkdtemp(prefix="outbox_", dir=space.path))
+        # Staged files may use at most half the budget
+        self.flush_bytes = min(flush_bytes, space.budget // 2)
+        self.flush_seconds = flush_seconds
+        self._pending: Deque[Tuple[Path, Path, Any]] = deque()
+        self._pending_bytes = 0
+        self._oldest = 0.0
+        self.flushes = 0
+        self.files_flushed = 0
+        self.bytes_flushed = 0
+
+    def add(self, staged: Union[str, Path], final: Union[str, Path], token: Any = None):
+        """Queue a staged file for copying to ``final``."""
+        staged = Path(staged)
+        if not self._pending:
+            self._oldest = time.monotonic()
+        self._pending.append((staged, Path(final), token))
+        self._pending_bytes += staged.stat().st_size
+
+    @property
+    def pending(self) -> int:
+        return len(self._pending)
+
+    def due(self) -> bool:
+        """Whether enough bytes are pending, or for long enough, to flush."""
+        return bool(self._pending) and (
+            self._pending_bytes >= self.flush_bytes
+            or time.monotonic() - self._oldest >= self.flush_seconds
+        )
+
+    def flush(self) -> List[Any]:
+        """Copy the pending files to their final paths.
+
+        Returns:
+            Tokens of the files copied, in the order they were added
+        """
+        tokens = []
+        parents = set()
+        try:
+            while self._pending:
+                staged, final, token = self._pending[0]
+                if final.parent not in parents:
+                    final.parent.mkdir(parents=True, exist_ok=True)
+                    parents.add(final.parent)
+                tmp = final.with_name(f"{final.name}.{os.getpid()}.tmp")
+                # One copy of the whole file (sendfile on Linux)
+                shutil.copyfile(staged, tmp)
+                os.replace(tmp, final)
+                size = staged.stat().st_size
+                staged.unlink()
+                self._pending.popleft()
+                self._pending_bytes -= size
+                self.files_flushed += 1
+                self.bytes_flushed += size
+                tokens.append(token)
+        finally:
+            self._oldest = time.monotonic()
+            if tokens:
+                self.flushes += 1
+        return tokens
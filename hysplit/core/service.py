@@ -0,0 +1,413 @@
+"""Persistent trajectory service.
+
+Keeps a MetField resident in a long-running process and answers batched
+trajectory requests over a Unix domain socket, so a request costs one
+round trip and the integration itself instead of a process start, CONTROL
+file and met file reads. Results come back in columnar form.
+
+Start a daemon from the command line:
+
+    python -m hysplit.core.service --met field.npz --socket /tmp/hysplit.sock
+
+or from Python with ``TrajectoryService.start(met)``, then query it with a
+``TrajectoryClient``.
+"""
+
+from __future__ import annotations
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from dataclasses import dataclass, field
+from datetime import datetime, timedelta
+from typing import Optional, Sequence, Union
+
+import numpy as np
+import pandas as pd
+
+from hysplit.met.field import MetField
+
+try:
+    from hysplit.cpp import _trajectory_service as cpp_service
+    HAS_TRAJECTORY_SERVICE = True
+except ImportError:
+    HAS_TRAJECTORY_SERVICE = False
+
+
+# Wire protocol, see hysplit/cpp/trajectory_service.cpp
+PROTOCOL_MAGIC = 0x53545948  # "HYTS"
+PROTOCOL_VERSION = 1
+MSG_PING = 1
+MSG_TRAJECTORIES = 2
+MSG_SHUTDOWN = 3
+REPLY_OK = 0
+
+HEADER = struct.Struct("<IHHII")
+REQUEST_DTYPE = np.dtype([
+    ("lat", "<f8"), ("lon", "<f8"), ("height", "<f8"),
+    ("start", "<f8"), ("duration", "<f8"),
+    ("direction", "<i4"), ("reserved", "<i4"),
+])
+
+_EPOCH = datetime(1970, 1, 1)
+
+
+def _epoch_minutes(t: datetime) -> float:
+    """Minutes since 1970-01-01 of a naive datetime."""
+    return (t - _EPOCH).total_seconds() / 60.0
+
+
+def _require_native():
+    if not HAS_TRAJECTORY_SERVICE:
+        raise RuntimeError(
+            "Native trajectory service not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+
+
+@dataclass
+class TrajectoryBatch:
+    """Trajectories in columnar form.
+
+    Points of trajectory i are ``offsets[i]:offsets[i + 1]`` of the column
+    arrays, one point per hour starting at hour 0.
+    """
+
+    offsets: np.ndarray = field(repr=False)
+    hour_along: np.ndarray = field(repr=False)
+    lat: np.ndarray = field(repr=False)
+    lon: np.ndarray = field(repr=False)
+    height: np.ndarray = field(repr=False)
+    start_times: list = field(default_factory=list, repr=False)
+
+    def __len__(self) -> int:
+        return len(self.offsets) - 1
+
+    def trajectory(self, i: int) -> dict:
+        """Column slices of one trajectory."""
+        s = slice(self.offsets[i], self.offsets[i + 1])
+        return {
+            "hour_along": self.hour_along[s],
+            "lat": self.lat[s],
+            "lon": self.lon[s],
+            "height": self.height[s],
+        }
+
+    def to_dataframe(self) -> pd.DataFrame:
+        """Trajectories as a DataFrame in the layout of ``trajectory_read``."""
+        counts = np.diff(self.offsets)
+        df = pd.DataFrame({
+            "traj": np.repeat(np.arange(1, len(self) + 1), counts),
+            "hour_along": self.hour_along.astype(int),
+            "lat": self.lat,
+            "lon": self.lon,
+            "height": self.height,
+        })
+        if self.start_times:
+            start = np.repeat(pd.to_datetime(self.start_times).values, counts)
+            df["traj_dt"] = start + pd.to_timedelta(self.hour_along, unit="h").values
+            df["traj_dt_i"] = start
+        return df
+
+
+def trajectory_requests(
+    lats: Union[float, Sequence[float]],
+    lons: Union[float, Sequence[float]],
+    heights: Union[float, Sequence[float]],
+    start_times: Union[datetime, Sequence[datetime]],
+    duration: Union[int, Sequence[int]] = 24,
+    direction: str = "backward",
+) -> np.ndarray:
+    """Pack trajectory requests into wire records.
+
+    Scalars broadcast against sequences, so one start location can be run
+    at many start times and vice versa.
+
+    Args:
+        lats, lons, heights: Start locations (degrees, meters AGL)
+        start_times: Start times
+        duration: Run duration in hours
+        direction: "forward" or "backward"
+
+    Returns:
+        Structured array with dtype ``REQUEST_DTYPE``
+    """
+    if isinstance(start_times, datetime):
+        start_times = [start_times]
+    starts = np.array([_epoch_minutes(t) for t in start_times], dtype=np.float64)
+    lat, lon, height, start, hours = np.broadcast_arrays(
+        np.asarray(lats, dtype=np.float64), np.asarray(lons, dtype=np.float64),
+        np.asarray(heights, dtype=np.float64), starts, np.asarray(duration, dtype=np.float64),
+    )
+    records = np.zeros(lat.size, dtype=REQUEST_DTYPE)
+    records["lat"], records["lon"], records["height"] = lat.ravel(), lon.ravel(), height.ravel()
+    records["start"], records["duration"] = start.ravel(), np.abs(hours.ravel())
+    records["direction"] = -1 if direction == "backward" else 1
+    return records
+
+
+def _start_times(records: np.ndarray) -> list:
+    return [_EPOCH + timedelta(minutes=float(m)) for m in records["start"]]
+
+
+def _service_options(met: MetField, tratio: float, time_step: float, model_top: float) -> dict:
+    return {
+        "tratio": float(tratio),
+        "time_step": float(time_step),
+        "model_top": float(model_top),
+        "met_start": _epoch_minutes(met.start_time),
+    }
+
+
+def run_trajectories(
+    met: MetField,
+    requests: np.ndarray,
+    tratio: float = 0.75,
+    time_step: float = 0.0,
+    model_top: float = 20000.0,
+) -> TrajectoryBatch:
+    """Compute trajectories in this process with the native kernel.
+
+    Args:
+        met: Meteorology covering the requested runs
+        requests: Records from ``trajectory_requests()``
+        tratio: Maximum fraction of a grid cell advected per step
+        time_step: Fixed time step in minutes (0 selects one from tratio)
+        model_top: Model top (meters AGL)
+
+    Returns:
+        TrajectoryBatch
+    """
+    _require_native()
+    table = np.column_stack([
+        requests["lat"], requests["lon"], requests["height"],
+        requests["start"], requests["duration"], requests["direction"],
+    ]).astype(np.float64)
+    result = cpp_service.run_trajectories(
+        met.to_arrays(met.start_time), table, _service_options(met, tratio, time_step, model_top)
+    )
+    return TrajectoryBatch(start_times=_start_times(requests), **result)
+
+
+def serve_trajectories(
+    met: MetField,
+    socket_path: str,
+    tratio: float = 0.75,
+    time_step: float = 0.0,
+    model_top: float = 20000.0,
+) -> dict:
+    """Serve trajectory requests on a Unix domain socket until shut down.
+
+    Blocks the calling thread (without holding the GIL) until a client sends
+    SHUTDOWN or the process receives a signal.
+
+    Returns:
+        dict with connection, request and trajectory counts
+    """
+    _require_native()
+    return cpp_service.serve(
+        met.to_arrays(met.start_time), str(socket_path),
+        _service_options(met, tratio, time_step, model_top),
+    )
+
+
+class TrajectoryClient:
+    """Persistent connection to a trajectory service."""
+
+    def __init__(self, socket_path: str, timeout: Optional[float] = 60.0):
+        self.socket_path = str(socket_path)
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.settimeout(timeout)
+        self._sock.connect(self.socket_path)
+
+    def _send(self, message_type: int, count: int = 0, body: bytes = b""):
+        self._sock.sendall(
+            HEADER.pack(PROTOCOL_MAGIC, PROTOCOL_VERSION, message_type, count, len(body)) + body
+        )
+
+    def _recv_into(self, buffer: memoryview):
+        while len(buffer):
+            got = self._sock.recv_into(buffer)
+            if got == 0:
+                raise ConnectionError("Trajectory service closed the connection")
+            buffer = buffer[got:]
+
+    def _reply(self) -> tuple[int, bytearray]:
+        header = bytearray(HEADER.size)
+        self._recv_into(memoryview(header))
+        magic, version, status, count, size = HEADER.unpack(header)
+        if magic != PROTOCOL_MAGIC or version != PROTOCOL_VERSION:
+            raise ConnectionError("Unexpected reply from trajectory service")
+        body = bytearray(size)
+        self._recv_into(memoryview(body))
+        if status != REPLY_OK:
+            raise RuntimeError(f"Trajectory service error: {body.decode(errors='replace')}")
+        return count, body
+
+    def ping(self) -> float:
+        """Round-trip time of an empty request in seconds."""
+        t0 = time.perf_counter()
+        self._send(MSG_PING)
+        self._reply()
+        return time.perf_counter() - t0
+
+    def run(self, requests: np.ndarray) -> TrajectoryBatch:
+        """Compute a batch of trajectories.
+
+        Args:
+            requests: Records from ``trajectory_requests()``
+
+        Returns:
+            TrajectoryBatch whose columns are views of the reply buffer
+        """
+        requests = np.ascontiguousarray(requests, dtype=REQUEST_DTYPE)
+        self._send(MSG_TRAJECTORIES, len(requests), requests.tobytes())
+        count, body = self._reply()
+
+        offsets = np.frombuffer(body, dtype="<i8", count=count + 1)
+        n_points = int(offsets[-1])
+        columns = np.frombuffer(body, dtype="<f8", offset=offsets.nbytes).reshape(4, n_points)
+        return TrajectoryBatch(
+            offsets=offsets,
+            hour_along=columns[0],
+            lat=columns[1],
+            lon=columns[2],
+            height=columns[3],
+            start_times=_start_times(requests),
+        )
+
+    def shutdown(self):
+        """Ask the service to stop and close this connection."""
+        self._send(MSG_SHUTDOWN)
+        self._reply()
+        self.close()
+
+    def close(self):
+        self._sock.close()
+
+    def __enter__(self) -> "TrajectoryClient":
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class TrajectoryService:
+    """Trajectory daemon running in a child process."""
+
+    def __init__(self, process: subprocess.Popen, socket_path: str, workdir: Optional[str] = None):
+        self.process = process
+        self.socket_path = socket_path
+        self._workdir = workdir
+
+    @classmethod
+    def start(
+        cls,
+        met: Union[MetField, str],
+        socket_path: Optional[str] = None,
+        tratio: float = 0.75,
+        time_step: float = 0.0,
+        model_top: float = 20000.0,
+        timeout: float = 60.0,
+    ) -> "TrajectoryService":
+        """Start a daemon and wait until it accepts connections.
+
+        Args:
+            met: MetField, or path of a file written by ``MetField.save()``
+            socket_path: Socket path (default: inside a new temporary directory)
+            tratio, time_step, model_top: Integration settings
+            timeout: Seconds to wait for the daemon to come up
+
+        Returns:
+            TrajectoryService
+        """
+        workdir = tempfile.mkdtemp(prefix="hysplit_service_")
+        if isinstance(met, MetField):
+            met_path = met.save(os.path.join(workdir, "met.npz"))
+        else:
+            met_path = str(met)
+        socket_path = socket_path or os.path.join(workdir, "trajectory.sock")
+
+        process = subprocess.Popen([
+            sys.executable, "-m", "hysplit.core.service",
+            "--met", met_path, "--socket", socket_path,
+            "--tratio", str(tratio), "--time-step", str(time_step),
+            "--model-top", str(model_top),
+        ])
+        service = cls(process, socket_path, workdir)
+
+        deadline = time.monotonic() + timeout
+        while True:
+            if process.poll() is not None:
+                service._cleanup()
+                raise RuntimeError(f"Trajectory service exited with code {process.returncode}")
+            try:
+                with service.client() as client:
+                    client.ping()
+                return service
+            except OSError:
+                if time.monotonic() > deadline:
+                    service.stop()
+                    raise TimeoutError("Trajectory service did not start in time")
+                time.sleep(0.05)
+
+    def client(self) -> TrajectoryClient:
+        """Open a new connection to the daemon."""
+        return TrajectoryClient(self.socket_path)
+
+    def stop(self, timeout: float = 10.0):
+        """Shut the daemon down and remove its temporary files."""
+        if self.process.poll() is None:
+            try:
+                self.client().shutdown()
+                self.process.wait(timeout=timeout)
+            except (OSError, subprocess.TimeoutExpired):
+                self.process.kill()
+                self.process.wait()
+        self._cleanup()
+
+    def _cleanup(self):
+        if self._workdir:
+            for name in os.listdir(self._workdir):
+                os.remove(os.path.join(self._workdir, name))
+            os.rmdir(self._workdir)
+            self._workdir = None
+
+    def __enter__(self) -> "TrajectoryService":
+        return self
+
+    def __exit__(self, *exc):
+        self.stop()
+
+
+def main(argv: Optional[Sequence[str]] = None):
+    """Command-line entry point of the trajectory daemon."""
+    parser = argparse.ArgumentParser(description="HYSPLIT trajectory service")
+    parser.add_argument("--met", required=True, help="MetField .npz file")
+    parser.add_argument("--socket", required=True, help="Unix domain socket path")
+    parser.add_argument("--tratio", type=float, default=0.75)
+    parser.add_argument("--time-step", type=float, default=0.0)
+    parser.add_argument("--model-top", type=float, default=20000.0)
+    args = parser.parse_args(argv)
+
+    met = MetField.load(args.met)
+    try:
+        stats = serve_trajectories(
+            met, args.socket, tratio=args.tratio, time_step=args.time_step,
+            model_top=args.model_top,
+        )
+    except KeyboardInterrupt:
+        return
+    print(
+        f"Served {stats['trajectories']} trajectories in {stats['requests']} requests "
+        f"over {stats['connections']} connections"
+    )
+
+
+if __name__ == "__main__":
+    main()
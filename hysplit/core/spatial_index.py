@@ -0,0 +1,329 @@
+"""Spatial-temporal index of a trajectory archive.
+
+Answers "which trajectories passed within 50 km of this site, between these
+times and heights" in milliseconds instead of a filter over every stored
+point. The native index (``hysplit.cpp._spatial_index``) enters every
+segment between consecutive points in the cells of a global lat/lon grid
+that its bounding box overlaps, sorted by time within a cell; candidates
+are then tested exactly on the part of the segment inside the time window
+and height band. Three queries are supported:
+
+    within()       closest approach to a site within a radius
+    in_bbox()      passing through a lat/lon box (first entry)
+    in_corridor()  closest approach to a polyline within a half-width
+
+Each returns one row per matching trajectory, with the time, position and
+height of its closest approach (or entry into the box).
+
+An index is saved as a directory of ``.npy`` arrays plus ``index.json``
+and opened memory-mapped, so loading a large archive is instant and only
+the pages a query touches are read.
+
+Usage:
+    from hysplit.core.spatial_index import TrajectoryIndex
+
+    index = TrajectoryIndex.build(trajectories)      # e.g. a year of batch runs
+    index.save("archive.idx")
+
+    index = TrajectoryIndex.load("archive.idx")
+    hits = index.within(49.0, -123.0, radius_km=50,
+                        start="2015-07-01", end="2015-08-01", heights=(0, 1500))
+"""
+
+from __future__ import annotations
+
+import json
+import os
+import shutil
+import tempfile
+from datetime import datetime
+from pathlib import Path
+from typing import Dict, Optional, Sequence, Tuple, Union
+
+import numpy as np
+import pandas as pd
+
+from hysplit.core.cluster import trajectory_key
+from hysplit.core.gridding import group_points
+
+try:
+    from hysplit.cpp import _spatial_index as cpp_index
+    HAS_SPATIAL_INDEX = True
+except ImportError:
+    HAS_SPATIAL_INDEX = False
+
+INDEX_VERSION = 1
+META_NAME = "index.json"
+ARRAY_NAMES = ("lat", "lon", "height", "time", "offsets", "ids", "cell_start", "entries")
+SECONDS_PER_HOUR = 3600.0
+
+TimeLike = Union[datetime, pd.Timestamp, str, float, None]
+
+
+def _require_native():
+    if not HAS_SPATIAL_INDEX:
+        raise RuntimeError(
+            "Native spatial index not available. "
+            "Build the C++ extensions with: python setup.py build_ext --inplace"
+        )
+
+
+def _hours(times: pd.Series) -> np.ndarray:
+    """Hours since 1970-01-01 of datetime values."""
+    seconds = pd.to_datetime(times).to_numpy("datetime64[s]").astype(np.int64)
+    return seconds / SECONDS_PER_HOUR
+
+
+class TrajectoryIndex:
+    """Segment index over the points of a trajectory archive.
+
+    Build with ``TrajectoryIndex.build()`` or open a saved one with
+    ``TrajectoryIndex.load()``. Times are hours since 1970 when the
+    trajectories carry ``traj_dt``, else their ``hour_along``.
+    """
+
+    def __init__(self, arrays: Dict[str, np.ndarray], meta: dict):
+        self.arrays = arrays
+        self.meta = meta
+
+    def __len__(self) -> int:
+        return len(self.arrays["offsets"]) - 1
+
+    def __repr__(self) -> str:
+        return (f"TrajectoryIndex(trajectories={len(self)}, points={len(self.arrays['lat'])}, "
+                f"resolution={self.resolution})")
+
+    @property
+    def resolution(self) -> float:
+        return float(self.meta["resolution"])
+
+    @property
+    def absolute_time(self) -> bool:
+        return bool(self.meta["absolute_time"])
+
+    # -- Building and persistence ---------------------------------------------
+
+    @classmethod
+    def build(
+        cls,
+        trajectories: pd.DataFrame,
+        by: Optional[str] = None,
+        resolution: float = 1.0,
+    ) -> "TrajectoryIndex":
+        """Index the trajectories of a DataFrame.
+
+        Args:
+            trajectories: Trajectory points with ``lat``, ``lon`` and
+                          ``hour_along`` (and ``height``, ``traj_dt``) columns
+            by: Column identifying the trajectory; defaults to ``run_index``
+                (batch results), ``run``, ``traj`` or ``traj_dt_i``; see
+                ``trajectory_key()``
+            resolution: Cell size in degrees; must divide 360
+
+        Returns:
+            TrajectoryIndex
+        """
+        _require_native()
+        by = trajectory_key(trajectories, by)
+
+        lat = trajectories["lat"].to_numpy(np.float64)
+        lon = trajectories["lon"].to_numpy(np.float64)
+        hour_along = trajectories["hour_along"].to_numpy(np.float64)
+        absolute = "traj_dt" in trajectories.columns
+        if absolute:
+            time = _hours(trajectories["traj_dt"])
+        else:
+            time = hour_along
+        if "height" in trajectories.columns:
+            height = trajectories["height"].to_numpy(np.float64)
+        else:
+            height = np.zeros(len(lat))
+
+        codes, ids = pd.factorize(trajectories[by], sort=True)
+        keep = (np.isfinite(lat) & np.isfinite(lon) & np.isfinite(hour_along)
+                & np.isfinite(time) & np.isfinite(height) & (codes >= 0))
+        rows = np.flatnonzero(keep)
+        if len(rows) == 0:
+            raise ValueError("No trajectory points to index")
+        codes = codes[rows]
+        order, offsets = group_points(codes, hour_along[rows])
+        if order is not None:
+            rows, codes = rows[order], codes[order]
+
+        ids = np.asarray(ids[codes[offsets[:-1]]])
+        if ids.dtype == object:
+            ids = ids.astype(str)
+        arrays = {
+            "lat": lat[rows].astype(np.float32),
+            "lon": (((lon[rows] + 180.0) % 360.0) - 180.0).astype(np.float32),
+            "height": height[rows].astype(np.float32),
+            "time": np.ascontiguousarray(time[rows]),
+            "offsets": offsets,
+            "ids": ids,
+        }
+        index = cpp_index.build_index(arrays["lat"], arrays["lon"], arrays["height"],
+                                      arrays["time"], arrays["offsets"], float(resolution))
+        arrays["cell_start"] = index["cell_start"]
+        arrays["entries"] = index["entries"]
+        meta = {
+            "version": INDEX_VERSION,
+            "resolution": float(resolution),
+            "max_duration": index["max_duration"],
+            "absolute_time": absolute,
+            "by": by,
+            "time_range": [float(arrays["time"].min()), float(arrays["time"].max())],
+            "height_range": [float(arrays["height"].min()), float(arrays["height"].max())],
+        }
+        return cls(arrays, meta)
+
+    def save(self, path: Union[str, Path]) -> Path:
+        """Write the index to a directory (replacing an existing one).
+
+        Args:
+            path: Directory to write
+
+        Returns:
+            Path of the directory
+        """
+        path = Path(path)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        # Written next to the target and renamed, so readers never see a partial index
+        tmp = Path(tempfile.mkdtemp(prefix=f".{path.name}.", dir=path.parent))
+        try:
+            for name in ARRAY_NAMES:
+                np.save(tmp / f"{name}.npy", self.arrays[name], allow_pickle=False)
+            (tmp / META_NAME).write_text(json.dumps(self.meta, indent=1))
+            if path.exists():
+                shutil.rmtree(path)
+            os.replace(tmp, path)
+        except BaseException:
+            shutil.rmtree(tmp, ignore_errors=True)
+            raise
+        return path
+
+    @classmethod
+    def load(cls, path: Union[str, Path], mmap: bool = True) -> "TrajectoryIndex":
+        """Open an index written by ``save()``.
+
+        Args:
+            path: Index directory
+            mmap: Map the arrays instead of reading them into memory
+
+        Returns:
+            TrajectoryIndex
+        """
+        _require_native()
+        path = Path(path)
+        meta = json.loads((path / META_NAME).read_text())
+        if meta.get("version") != INDEX_VERSION:
+            raise ValueError(f"Unsupported index version {meta.get('version')} in {path}")
+        mode = "r" if mmap else None
+        arrays = {name: np.load(path / f"{name}.npy", mmap_mode=mode, allow_pickle=False)
+                  for name in ARRAY_NAMES}
+        return cls(arrays, meta)
+
+    # -- Queries --------------------------------------------------------------
+
+    def within(
+        self,
+        lat: float,
+        lon: float,
+        radius_km: float,
+        start: TimeLike = None,
+        end: TimeLike = None,
+        heights: Optional[Tuple[Optional[float], Optional[float]]] = None,
+    ) -> pd.DataFrame:
+        """Trajectories passing within ``radius_km`` of a site.
+
+        Args:
+            lat, lon: Site
+            radius_km: Search radius
+            start, end: Time window (datetimes, or hours without ``traj_dt``)
+            heights: (bottom, top) height band in m AGL; either may be None
+
+        Returns:
+            DataFrame with one row per trajectory at its closest approach,
+            nearest first
+        """
+        query = {"kind": "radius", "lat": np.array([lat], dtype=np.float64),
+                 "lon": np.array([lon], dtype=np.float64), "distance_km": float(radius_km)}
+        return self._query(query, start, end, heights)
+
+    def in_bbox(
+        self,
+        lat_min: float,
+        lat_max: float,
+        lon_min: float,
+        lon_max: float,
+        start: TimeLike = None,
+        end: TimeLike = None,
+        heights: Optional[Tuple[Optional[float], Optional[float]]] = None,
+    ) -> pd.DataFrame:
+        """Trajectories passing through a lat/lon box.
+
+        ``lon_max < lon_min`` selects a box across the date line.
+
+        Returns:
+            DataFrame with one row per trajectory where it first enters the box
+        """
+        query = {"kind": "bbox", "lat_lo": float(lat_min), "lat_hi": float(lat_max),
+                 "lon_lo": float(lon_min), "lon_hi": float(lon_max)}
+        return self._query(query, start, end, heights)
+
+    def in_corridor(
+        self,
+        lats: Sequence[float],
+        lons: Sequence[float],
+        width_km: float,
+        start: TimeLike = None,
+        end: TimeLike = None,
+        heights: Optional[Tuple[Optional[float], Optional[float]]] = None,
+    ) -> pd.DataFrame:
+        """Trajectories passing within ``width_km`` of a polyline.
+
+        Args:
+            lats, lons: Vertices of the corridor's centre line
+            width_km: Largest distance from the centre line
+
+        Returns:
+            DataFrame with one row per trajectory at its closest approach,
+            nearest first
+        """
+        query = {"kind": "corridor", "lat": np.asarray(lats, dtype=np.float64),
+                 "lon": np.asarray(lons, dtype=np.float64), "distance_km": float(width_km)}
+        return self._query(query, start, end, heights)
+
+    def _time(self, value: TimeLike) -> float:
+        if not self.absolute_time or isinstance(value, (int, float, np.number)):
+            return float(value)
+        return float(_hours(pd.Series([pd.Timestamp(value)]))[0])
+
+    def _query(self, query: dict, start: TimeLike, end: TimeLike, heights) -> pd.DataFrame:
+        # Open bounds become the data range: the kernel needs finite windows
+        if start is not None or end is not None:
+            t_lo, t_hi = self.meta["time_range"]
+            query["t0"] = self._time(start) if start is not None else t_lo - 1.0
+            query["t1"] = self._time(end) if end is not None else t_hi + 1.0
+        if heights is not None and (heights[0] is not None or heights[1] is not None):
+            z_lo, z_hi = self.meta["height_range"]
+            query["z0"] = float(heights[0]) if heights[0] is not None else z_lo - 1.0
+            query["z1"] = float(heights[1]) if heights[1] is not None else z_hi + 1.0
+
+        a = self.arrays
+        result = cpp_index.query_index(
+            a["lat"], a["lon"], a["height"], a["time"], a["offsets"],
+            a["cell_start"], a["entries"], self.resolution, float(self.meta["max_duration"]), query,
+        )
+        if self.absolute_time:
+            time = pd.to_datetime(np.round(result["time"] * SECONDS_PER_HOUR), unit="s")
+        else:
+            time = result["time"]
+        hits = pd.DataFrame({
+            self.meta["by"]: np.asarray(a["ids"])[result["trajectory"]],
+            "time": time,
+            "lat": result["lat"],
+            "lon": result["lon"],
+            "height": result["height"],
+            "distance_km": result["distance_km"],
+        })
+        return hits.sort_values("distance_km", kind="stable", ignore_index=True)
@@ -0,0 +1,283 @@
+"""Per-phase timing telemetry of model runs.
+
+``TrajectoryModel.run`` and ``DispersionModel.run`` record the spans of
+their phases (config writing, met resolution, run cache lookups, process
+spawn, binary execution, output parsing and cleanup) on the monotonic clock into a
+``RunTimer``, at the cost of two clock reads per span. The clock is
+system-wide on Linux, so spans from different worker processes line up.
+
+For batches, ``BatchTelemetry`` aggregates the per-run phase totals into
+HDR-style histograms (log-linear buckets with under 1% relative error and
+a fixed memory footprint however many runs are recorded) and keeps the
+spans for a Chrome trace-event file (chrome://tracing or Perfetto), which
+shows stragglers and the idle gaps between runs of each worker.
+
+Usage:
+    from hysplit.core.telemetry import BatchTelemetry
+
+    telemetry = BatchTelemetry()
+    run_batch_trajectories(config, telemetry=telemetry)
+    print(telemetry.summary())
+    telemetry.to_json("timings.json")
+    telemetry.to_chrome_trace("trace.json")
+"""
+
+from __future__ import annotations
+
+import json
+import threading
+import time
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Dict, Iterator, List, Sequence, Tuple, Union
+
+import numpy as np
+
+PHASES = ("config", "met", "cache", "spawn", "execute", "parse", "cleanup")
+
+# (phase, start ns, duration ns)
+Span = Tuple[str, int, int]
+
+
+class _PhaseSpan:
+    """Context manager recording one span; lighter than a generator."""
+
+    __slots__ = ("timer", "name", "start")
+
+    def __init__(self, timer: "RunTimer", name: str):
+        self.timer = timer
+        self.name = name
+
+    def __enter__(self):
+        self.start = time.monotonic_ns()
+        return self
+
+    def __exit__(self, *exc):
+        self.timer.spans.append((self.name, self.start, time.monotonic_ns() - self.start))
+
+
+class RunTimer:
+    """Phase spans of one model run."""
+
+    __slots__ = ("spans",)
+
+    def __init__(self):
+        self.spans: List[Span] = []
+
+    def phase(self, name: str) -> _PhaseSpan:
+        """Time a block as one span of ``name``."""
+        return _PhaseSpan(self, name)
+
+    def add(self, name: str, start_ns: int, duration_ns: int):
+        """Record a span measured elsewhere."""
+        self.spans.append((name, start_ns, duration_ns))
+
+    def totals(self) -> Dict[str, int]:
+        """Nanoseconds per phase, summed over the spans of the run."""
+        totals: Dict[str, int] = {}
+        for name, _, duration in self.spans:
+            totals[name] = totals.get(name, 0) + duration
+        return totals
+
+
+_collectors = threading.local()
+
+
+def run_timer() -> RunTimer:
+    """New timer for a model run, registered with an active ``collect()``."""
+    timer = RunTimer()
+    active = getattr(_collectors, "stack", None)
+    if active:
+        active[-1].append(timer)
+    return timer
+
+
+@contextmanager
+def collect() -> Iterator[List[RunTimer]]:
+    """Collect the timers of all model runs started in this thread."""
+    if not hasattr(_collectors, "stack"):
+        _collectors.stack = []
+    timers: List[RunTimer] = []
+    _collectors.stack.append(timers)
+    try:
+        yield timers
+    finally:
+        _collectors.stack.pop()
+
+
+class HdrHistogram:
+    """Log-linear histogram of non-negative integers (HDR histogram layout).
+
+    Values below ``2**sub_bucket_bits`` have exact buckets; above, each
+    power of two is split into ``2**(sub_bucket_bits - 1)`` linear buckets,
+    so a bucket's width is under ``2**-(sub_bucket_bits - 1)`` of its value.
+    Count, min, max and sum are exact.
+    """
+
+    def __init__(self, sub_bucket_bits: int = 8):
+        self.sub_bucket_bits = sub_bucket_bits
+        self._half = 1 << (sub_bucket_bits - 1)
+        self.counts = np.zeros((64 - sub_bucket_bits + 2) * self._half + (1 << sub_bucket_bits), dtype=np.int64)
+        self.count = 0
+        self.total = 0
+        self.min = 0
+        self.max = 0
+
+    def _index(self, values: np.ndarray) -> np.ndarray:
+        # frexp gives the bit length exactly for values below 2**53 (104 days in ns)
+        shift = np.maximum(np.frexp(values.astype(np.float64))[1] - self.sub_bucket_bits, 0)
+        mantissa = values >> shift
+        return np.where(shift == 0, values, (shift << (self.sub_bucket_bits - 1)) + mantissa)
+
+    def _lower_bound(self, index: np.ndarray) -> np.ndarray:
+        index = np.asarray(index, dtype=np.int64)
+        shift = np.maximum((index >> (self.sub_bucket_bits - 1)) - 1, 0)
+        mantissa = index - (shift << (self.sub_bucket_bits - 1))
+        return np.where(index < (1 << self.sub_bucket_bits), index, mantissa << shift)
+
+    def record(self, values: Union[int, Sequence[int], np.ndarray]):
+        """Record one value or an array of values."""
+        if isinstance(values, int):
+            value = max(values, 0)
+            shift = max(value.bit_length() - self.sub_bucket_bits, 0)
+            index = value if shift == 0 else (shift << (self.sub_bucket_bits - 1)) + (value >> shift)
+            self.counts[index] += 1
+            self.min = value if self.count == 0 else min(self.min, value)
+            self.max = max(self.max, value)
+            self.count += 1
+            self.total += value
+            return
+        values = np.atleast_1d(np.asarray(values, dtype=np.int64))
+        if values.size == 0:
+            return
+        values = np.maximum(values, 0)
+        np.add.at(self.counts, self._index(values), 1)
+        self.min = int(values.min()) if self.count == 0 else min(self.min, int(values.min()))
+        self.max = max(self.max, int(values.max()))
+        self.count += int(values.size)
+        self.total += int(values.sum())
+
+    def merge(self, other: "HdrHistogram"):
+        """Add the counts of a histogram with the same layout."""
+        if other.count == 0:
+            return
+        self.counts += other.counts
+        self.min = other.min if self.count == 0 else min(self.min, other.min)
+        self.max = max(self.max, other.max)
+        self.count += other.count
+        self.total += other.total
+
+    @property
+    def mean(self) -> float:
+        return self.total / self.count if self.count else 0.0
+
+    def percentile(self, q: float) -> int:
+        """Lower bound of the bucket holding the q-th percentile (0-100)."""
+        if self.count == 0:
+            return 0
+        rank = max(1, int(np.ceil(q / 100.0 * self.count)))
+        index = int(np.searchsorted(np.cumsum(self.counts), rank))
+        return int(min(max(self._lower_bound(index), self.min), self.max))
+
+    def to_dict(self) -> Dict:
+        """Summary statistics and the non-empty buckets as [lower bound, count]."""
+        nonzero = np.flatnonzero(self.counts)
+        return {
+            "count": self.count,
+            "min": self.min,
+            "max": self.max,
+            "mean": self.mean,
+            "p50": self.percentile(50),
+            "p90": self.percentile(90),
+            "p99": self.percentile(99),
+            "p999": self.percentile(99.9),
+            "buckets": [[int(v), int(c)] for v, c in zip(self._lower_bound(nonzero), self.counts[nonzero])],
+        }
+
+
+class BatchTelemetry:
+    """Phase histograms and trace spans of the runs of a batch.
+
+    Args:
+        keep_spans: Keep every span for ``to_chrome_trace`` and
+                    ``stragglers`` (about 100 bytes per span)
+    """
+
+    def __init__(self, keep_spans: bool = True):
+        self.keep_spans = keep_spans
+        self.histograms: Dict[str, HdrHistogram] = {}
+        self.n_runs = 0
+        # (run index, pid, spans)
+        self.runs: List[Tuple[int, int, List[Span]]] = []
+
+    def add_run(self, run_index: int, spans: Sequence[Span], pid: int = 0):
+        """Record the spans of one run; phase totals go into the histograms."""
+        totals: Dict[str, int] = {}
+        for name, _, duration in spans:
+            totals[name] = totals.get(name, 0) + duration
+        for name, value in totals.items():
+            if name not in self.histograms:
+                self.histograms[name] = HdrHistogram()
+            self.histograms[name].record(value)
+        self.n_runs += 1
+        if self.keep_spans:
+            self.runs.append((run_index, pid, list(spans)))
+
+    def stragglers(self, n: int = 10, phase: str = "total") -> List[Tuple[int, int]]:
+        """Slowest runs as (run index, ns) by one phase's total."""
+        durations = []
+        for run_index, _, spans in self.runs:
+            durations.append((run_index, sum(d for name, _, d in spans if name == phase)))
+        return sorted(durations, key=lambda item: -item[1])[:n]
+
+    def summary(self) -> str:
+        """Table of per-phase percentiles in milliseconds."""
+        lines = [f"{'Phase':<10} {'Count':>8} {'Mean':>10} {'p50':>10} {'p99':>10} {'Max':>10}"]
+        order = [p for p in (*PHASES, "total") if p in self.histograms]
+        order += sorted(set(self.histograms) - set(order))
+        for name in order:
+            h = self.histograms[name]
+            lines.append(
+                f"{name:<10} {h.count:>8} {h.mean / 1e6:>9.2f}ms {h.percentile(50) / 1e6:>9.2f}ms "
+                f"{h.percentile(99) / 1e6:>9.2f}ms {h.max / 1e6:>9.2f}ms"
+            )
+        return "\n".join(lines)
+
+    def to_dict(self) -> Dict:
+        """Histograms per phase, values in nanoseconds."""
+        return {
+            "unit": "ns",
+            "runs": self.n_runs,
+            "phases": {name: h.to_dict() for name, h in self.histograms.items()},
+        }
+
+    def to_json(self, filepath: Union[str, Path]) -> Path:
+        """Write the histograms as JSON."""
+        filepath = Path(filepath)
+        with open(filepath, "w") as f:
+            json.dump(self.to_dict(), f, indent=2)
+        return filepath
+
+    def to_chrome_trace(self, filepath: Union[str, Path]) -> Path:
+        """Write the spans as a Chrome trace-event file, one track per worker."""
+        origin = min((start for _, _, spans in self.runs for _, start, _ in spans), default=0)
+        events = [
+            {"name": "process_name", "ph": "M", "pid": pid, "args": {"name": f"worker {pid}"}}
+            for pid in sorted({pid for _, pid, _ in self.runs})
+        ]
+        for run_index, pid, spans in self.runs:
+            for name, start, duration in spans:
+                events.append({
+                    "name": name,
+                    "cat": "hysplit",
+                    "ph": "X",
+                    "ts": (start - origin) / 1000.0,
+                    "dur": duration / 1000.0,
+                    "pid": pid,
+                    "tid": pid,
+                    "args": {"run_index": run_index},
+                })
+        filepath = Path(filepath)
+        with open(filepath, "w") as f:
+            json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, f)
+        return filepath
@@ -0,0 +1,157 @@
+"""Rendering of HYSPLIT input files from precompiled layouts.
+
+The CONTROL and SETUP.CFG layouts below are compiled once per process by
+the native renderer (``hysplit.cpp._templates``), which formats numbers
+with ``std::to_chars`` into a reused buffer, so rendering a run's files is
+one native call instead of building lists of f-strings. The output is
+byte-for-byte what the Python ``to_string()`` / ``_control_text()``
+methods produce, and those are used when the extension is not built.
+
+Repeated sections (starting locations, met files, vertical levels) are
+rendered from a row layout once per row.
+"""
+
+from __future__ import annotations
+
+from dataclasses import fields
+from datetime import datetime
+from pathlib import Path
+from typing import Dict, List, Optional, Sequence, Tuple
+
+try:
+    from hysplit.cpp import _templates as cpp_templates
+    HAS_NATIVE_TEMPLATES = True
+except ImportError:
+    HAS_NATIVE_TEMPLATES = False
+
+# Shared by both CONTROL layouts
+CONTROL_HEAD = "{:02d} {:02d} {:02d} {:02d}\n{}\n"  # Start time (YY MM DD HH), number of starts
+CONTROL_RUN = "{}\n{}\n{}\n{}\n"     # Run time, vertical motion, model top, met file count
+CONTROL_MET = "{}/\n{}\n"            # Met directory, met file
+CONTROL_OUTPUT = "{}/\n{}\n"         # Output directory, output file
+
+TRAJECTORY_START = "{:.4f} {:.4f} {:.1f}\n"
+DISPERSION_SOURCE = "{:.4f} {:.4f} {:.1f} {:.4f} {:.1f} {:.1f}\n"
+DISPERSION_POLLUTANT = (
+    "1\nPART\n1.0\n{}\n00 00 00 00 00\n"       # Species, id, rate, hours, release start
+    "1\n{:.4f} {:.4f}\n{:.4f} {:.4f}\n{:.4f} {:.4f}\n"  # Grid count, center, spacing, span
+    "{}/\n{}\n{}\n"                             # Output directory, file, level count
+)
+DISPERSION_LEVEL = "{:.1f}\n"
+DISPERSION_TAIL = (
+    "{:02d} {:02d} {:02d} {:02d} 00\n"           # Sampling start
+    "{:02d} {:02d} {:02d} {:02d} 00\n"           # Sampling stop
+    "00 {:02d} 00\n"                             # Sampling interval
+    "1\n{:g} {:g} {:g}\n{:g} 0.0 0.0 0.0 {:g}\n{:g} {:g} {:g}\n0.0\n0.0\n"  # Deposition
+)
+ASCDATA = "{}  {}\n{}  {}\n{}  {}\n{}\n{}\n{}\n"
+
+_compiled: Dict[str, object] = {}
+
+
+def _layout(fmt: str):
+    """Compiled form of a layout, cached for the life of the process."""
+    layout = _compiled.get(fmt)
+    if layout is None:
+        layout = _compiled[fmt] = cpp_templates.compile(fmt)
+    return layout
+
+
+def _yymmddhh(time: datetime) -> Tuple[int, int, int, int]:
+    """Fields of strftime("%y %m %d %H"), formatted by the layout."""
+    return time.year % 100, time.month, time.day, time.hour
+
+
+_setup_layouts: Dict[type, Tuple[object, Tuple[str, ...]]] = {}
+
+
+def _setup_layout(config_type: type) -> Tuple[object, Tuple[str, ...]]:
+    """SETUP.CFG layout of a config dataclass and its field names."""
+    cached = _setup_layouts.get(config_type)
+    if cached is None:
+        names = tuple(f.name for f in fields(config_type))
+        fmt = "&SETUP\n" + "".join(f"{name} = {{:q}},\n" for name in names) + "/\n"
+        cached = _setup_layouts[config_type] = (_layout(fmt), names)
+    return cached
+
+
+def render_setup(config) -> bytes:
+    """SETUP.CFG of a HysplitConfig."""
+    if not HAS_NATIVE_TEMPLATES:
+        return config.to_string().encode()
+    layout, names = _setup_layout(type(config))
+    return cpp_templates.render([(layout, tuple(getattr(config, name) for name in names))])
+
+
+def render_ascdata(ascdata) -> bytes:
+    """ASCDATA.CFG of an AscdataConfig."""
+    if not HAS_NATIVE_TEMPLATES:
+        return ascdata.to_string().encode()
+    return cpp_templates.render([(_layout(ASCDATA), (
+        ascdata.lat_ll, ascdata.lon_ll, ascdata.lat_spacing, ascdata.lon_spacing,
+        ascdata.lat_n, ascdata.lon_n, ascdata.lu_category, ascdata.roughness_l,
+        ascdata.data_dir,
+    ))])
+
+
+def render_trajectory_control(
+    model,
+    exec_dir: Path,
+    start_time: datetime,
+    locations: Sequence[tuple],
+    met_files: List[str],
+    output_filename: str,
+    met_dir: Optional[Path] = None
+) -> bytes:
+    """CONTROL of a TrajectoryModel invocation; see ``TrajectoryModel._control_text``."""
+    if not HAS_NATIVE_TEMPLATES:
+        return model._control_text(exec_dir, start_time, locations, met_files, output_filename, met_dir).encode()
+
+    duration = model.duration if model.direction == "forward" else -model.duration
+    met_dir = str(met_dir or model.met_dir or exec_dir)
+    return cpp_templates.render([
+        (_layout(CONTROL_HEAD), (*_yymmddhh(start_time), len(locations))),
+        (_layout(TRAJECTORY_START), list(locations)),
+        (_layout(CONTROL_RUN), (duration, model.vert_motion, model.model_height, len(met_files))),
+        (_layout(CONTROL_MET), [(met_dir, met_file) for met_file in met_files]),
+        (_layout(CONTROL_OUTPUT), (str(exec_dir), output_filename)),
+    ])
+
+
+def render_dispersion_control(
+    model,
+    exec_dir: Path,
+    met_files: List[str],
+    output_filename: str,
+    met_dir: Optional[Path] = None
+) -> bytes:
+    """CONTROL of a DispersionModel run; see ``DispersionModel._control_text``."""
+    if not HAS_NATIVE_TEMPLATES:
+        return model._control_text(exec_dir, met_files, output_filename, met_dir).encode()
+
+    duration = model.duration if model.direction == "forward" else -model.duration
+    met_dir = str(met_dir or model.met_dir or exec_dir)
+    return cpp_templates.render([
+        (_layout(CONTROL_HEAD), (*_yymmddhh(model.start_time), len(model.sources))),
+        (_layout(DISPERSION_SOURCE), [
+            (s.lat, s.lon, s.height, s.rate, s.area, s.heat) for s in model.sources
+        ]),
+        (_layout(CONTROL_RUN), (duration, model.vert_motion, model.model_height, len(met_files))),
+        (_layout(CONTROL_MET), [(met_dir, met_file) for met_file in met_files]),
+        (_layout(DISPERSION_POLLUTANT), (
+            int(model.duration),
+            model.grid_lat, model.grid_lon,
+            model.grid_spacing_lat, model.grid_spacing_lon,
+            model.grid_span_lat, model.grid_span_lon,
+            str(exec_dir), output_filename, len(model.grid_levels),
+        )),
+        (_layout(DISPERSION_LEVEL), [(level,) for level in model.grid_levels]),
+        (_layout(DISPERSION_TAIL), (
+            *_yymmddhh(model.start_time),
+            *_yymmddhh(model.end_time),
+            model.sampling_interval,
+            model.particle_diameter, model.particle_density, model.particle_shape,
+            model.deposition_velocity, model.henry_constant,
+            model.henry_constant, model.in_cloud_scavenging, model.below_cloud_scavenging,
+        )),
+    ])
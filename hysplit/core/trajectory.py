@@ -2,20 +2,31 @@
 
 from __future__ import annotations
 
+import functools
 import os
 import platform
 import shutil
-import subprocess
-import tempfile
+import time
+from collections import deque
 from dataclasses import dataclass, field
 from datetime import datetime, timedelta
 from pathlib import Path
-from typing import Optional, Union, List
+from typing import TYPE_CHECKING, Generator, Optional, Union, List
 
 import pandas as pd
 import numpy as np
 
+from hysplit.core.cache import RunCache, open_cache, trajectory_run_key
 from hysplit.core.config import HysplitConfig, AscdataConfig, set_config, set_ascdata
+from hysplit.core.launcher import (
+    ExecDir, LaunchResult, RunCancelledError, RunTimeoutError, worker_exec_dir, worker_met_dir,
+)
+from hysplit.core.planner import PlannedRun, plan_start_groups
+from hysplit.core.telemetry import RunTimer, run_timer
+from hysplit.core.templates import render_trajectory_control
+
+if TYPE_CHECKING:
+    from hysplit.core.aio import AsyncLauncher
 
 
 def get_os() -> str:
@@ -32,10 +43,18 @@ def get_os() -> str:
 def get_binary_path(binary_name: str = "hyts_std") -> Path:
     """Get the path to the HYSPLIT binary for the current platform.
 
-    If the binary is not found in the package, it will look for it in PATH.
+    A directory named by the HYSPLIT_BIN environment variable is searched
+    first (e.g. ``hysplit/bin/standin`` for the benchmark stand-ins). If the
+    binary is not found in the package, it will look for it in PATH.
     """
     os_type = get_os()
 
+    override = os.environ.get("HYSPLIT_BIN")
+    if override:
+        candidate = Path(override) / (binary_name + ".exe" if os_type == "win" else binary_name)
+        if candidate.exists():
+            return candidate
+
     # Try to find in the package's binaries directory
     pkg_dir = Path(__file__).parent.parent
     binary_dir = pkg_dir / "bin" / os_type
@@ -75,6 +94,63 @@ def to_short_day(date: datetime) -> str:
     return date.strftime("%d")
 
 
+@dataclass(frozen=True)
+class LaunchStep:
+    """Step of a model run: launch a binary in the run's working directory."""
+
+    binary_path: Path
+    timeout: Optional[float] = None
+
+
+# Model runs are generators of steps: a LaunchStep for each binary
+# invocation and a callable for each blocking call (met downloads). The
+# driver sends back the LaunchResult or return value, or throws what was
+# raised; run() drives them in the calling thread, run_async() on an
+# AsyncLauncher.
+RunSteps = Generator[object, object, None]
+
+
+def _finish_launch(timer: RunTimer, start: int, result: LaunchResult, binary_path: Path) -> LaunchResult:
+    """Record the spawn and execute spans of a launch that began at ``start`` (ns).
+
+    Raises:
+        RunTimeoutError: The binary was killed after its timeout
+        RunCancelledError: The binary was killed through its cancel flag
+    """
+    spawned = int(result.spawn_elapsed * 1e9)
+    timer.add("spawn", start, spawned)
+    timer.add("execute", start + spawned, time.monotonic_ns() - start - spawned)
+    if result.timed_out:
+        raise RunTimeoutError(f"{Path(binary_path).name} killed after {result.elapsed:.1f}s")
+    if result.cancelled:
+        raise RunCancelledError(f"{Path(binary_path).name} cancelled after {result.elapsed:.1f}s")
+    return result
+
+
+def _timed_run(timer: RunTimer, workdir: ExecDir, binary_path: Path, timeout: Optional[float] = None):
+    """Run a binary in an ExecDir, recording its spawn and execute spans."""
+    start = time.monotonic_ns()
+    return _finish_launch(timer, start, workdir.run(binary_path, timeout=timeout), binary_path)
+
+
+def _drive(steps: RunSteps, timer: RunTimer, workdir: ExecDir):
+    """Execute the steps of a model run in the calling thread."""
+    try:
+        step = next(steps)
+        while True:
+            try:
+                if isinstance(step, LaunchStep):
+                    value = _timed_run(timer, workdir, step.binary_path, step.timeout)
+                else:
+                    value = step()
+            except Exception as e:
+                step = steps.throw(e)
+            else:
+                step = steps.send(value)
+    except StopIteration:
+        pass
+
+
 @dataclass
 class TrajectoryModel:
     """HYSPLIT Trajectory Model.
@@ -99,6 +175,7 @@ class TrajectoryModel:
     vert_motion: int = 0
     model_height: int = 20000
     extended_met: bool = False
+    max_starts: int = 100             # Starting locations per hyts_std invocation
 
     # Configuration
     config: Optional[HysplitConfig] = None
@@ -110,9 +187,12 @@ class TrajectoryModel:
     met_dir: Optional[Union[str, Path]] = None
     exec_dir: Optional[Union[str, Path]] = None
     clean_up: bool = True
+    cache: Optional[Union[str, Path, RunCache]] = field(default=None, repr=False)  # Run cache (see hysplit.core.cache)
+    timeout: Optional[float] = None   # Seconds before a hyts_std invocation is killed
 
     # Output
     traj_df: Optional[pd.DataFrame] = field(default=None, repr=False)
+    timings: Optional[RunTimer] = field(default=None, repr=False)  # Phase spans of the last run()
 
     def __post_init__(self):
         """Initialize defaults after dataclass creation."""
@@ -145,7 +225,8 @@ class TrajectoryModel:
         met_type: Optional[str] = None,
         vert_motion: Optional[int] = None,
         model_height: Optional[int] = None,
-        extended_met: Optional[bool] = None
+        extended_met: Optional[bool] = None,
+        max_starts: Optional[int] = None
     ) -> "TrajectoryModel":
         """Add or update trajectory parameters. Supports method chaining."""
         if lat is not None:
@@ -170,6 +251,8 @@ class TrajectoryModel:
             self.model_height = model_height
         if extended_met is not None:
             self.extended_met = extended_met
+        if max_starts is not None:
+            self.max_starts = max_starts
 
         return self
 
@@ -185,7 +268,27 @@ class TrajectoryModel:
     ) -> Path:
         """Write HYSPLIT CONTROL file."""
         control_path = exec_dir / "CONTROL"
+        with open(control_path, "w") as f:
+            f.write(self._control_text(
+                exec_dir, start_time, [(lat, lon, height)], met_files, output_filename
+            ))
 
+        return control_path
+
+    def _control_text(
+        self,
+        exec_dir: Path,
+        start_time: datetime,
+        locations: List[tuple],
+        met_files: List[str],
+        output_filename: str,
+        met_dir: Optional[Path] = None
+    ) -> str:
+        """Render the HYSPLIT CONTROL file for one or more starting locations.
+
+        The met files are read from ``met_dir``, by default the model's
+        ``met_dir`` or else ``exec_dir``.
+        """
         # Determine direction sign for duration
         duration = self.duration if self.direction == "forward" else -self.duration
 
@@ -193,9 +296,13 @@ class TrajectoryModel:
             # Start time: YY MM DD HH
             f"{start_time.strftime('%y %m %d %H')}",
             # Number of starting locations
-            "1",
-            # Starting location: lat lon height
-            f"{lat:.4f} {lon:.4f} {height:.1f}",
+            str(len(locations)),
+        ]
+        # Starting locations: lat lon height
+        for lat, lon, height in locations:
+            lines.append(f"{lat:.4f} {lon:.4f} {height:.1f}")
+
+        lines.extend([
             # Total run time (hours)
             str(duration),
             # Vertical motion method
@@ -204,10 +311,10 @@ class TrajectoryModel:
             str(self.model_height),
             # Number of input meteorological data files
             str(len(met_files)),
-        ]
+        ])
 
         # Add meteorological file paths
-        met_dir = self.met_dir or exec_dir
+        met_dir = met_dir or self.met_dir or exec_dir
         for met_file in met_files:
             lines.append(str(met_dir) + "/")
             lines.append(met_file)
@@ -216,10 +323,7 @@ class TrajectoryModel:
         lines.append(str(exec_dir) + "/")
         lines.append(output_filename)
 
-        with open(control_path, "w") as f:
-            f.write("\n".join(lines) + "\n")
-
-        return control_path
+        return "\n".join(lines) + "\n"
 
     def _get_output_filename(
         self,
@@ -247,17 +351,47 @@ class TrajectoryModel:
     def run(self) -> "TrajectoryModel":
         """Execute the trajectory model.
 
-        Returns self for method chaining.
+        Returns self for method chaining. The time spent in each phase is
+        recorded in ``self.timings``. With a ``cache``, runs found in it
+        are not launched and the parsed outputs of new runs are stored,
+        except for runs whose invocation exited non-zero.
+        """
+        timer = self.timings = run_timer()
+        # Without an exec_dir the worker's warm one is reused
+        workdir = ExecDir(self.exec_dir) if self.exec_dir else worker_exec_dir()
+        _drive(self._run_steps(timer, workdir), timer, workdir)
+        return self
+
+    async def run_async(self, launcher: Optional["AsyncLauncher"] = None) -> "TrajectoryModel":
+        """Execute the trajectory model from an asyncio event loop.
+
+        Same as ``run()``, but hyts_std is started and awaited through an
+        AsyncLauncher (by default the one of the running loop), so many
+        concurrent runs share the loop's thread. The run holds one of the
+        launcher's slots, and its warm working directory, until it ends.
+
+        Raises:
+            LauncherBusyError: The launcher's queue of waiting runs is full
         """
+        from hysplit.core.aio import get_launcher
+
+        launcher = launcher or get_launcher()
+        timer = self.timings = run_timer()
+        async with launcher.slot() as slot_dir:
+            workdir = ExecDir(self.exec_dir) if self.exec_dir else slot_dir
+            await launcher.drive(self._run_steps(timer, workdir), timer, workdir)
+        return self
+
+    def _run_steps(self, timer: RunTimer, workdir: ExecDir) -> RunSteps:
+        """Body of ``run()`` as run steps (see ``RunSteps``)."""
         from hysplit.met import download_met_files
-        from hysplit.io import trajectory_read
+        from hysplit.io import trajectory_read, split_trajectory_file
 
-        # Set up directories
-        exec_dir = Path(self.exec_dir) if self.exec_dir else Path(tempfile.mkdtemp())
-        met_dir = Path(self.met_dir) if self.met_dir else exec_dir
+        exec_dir = workdir.path
+        # Downloads go to the process's met directory, off the scratch space
+        met_dir = Path(self.met_dir) if self.met_dir else worker_met_dir()
 
         # Ensure directories exist
-        exec_dir.mkdir(parents=True, exist_ok=True)
         met_dir.mkdir(parents=True, exist_ok=True)
 
         # Set binary path
@@ -266,20 +400,22 @@ class TrajectoryModel:
         else:
             binary_path = get_binary_path("hyts_std")
 
-        # Write configuration files
-        if self.extended_met:
-            self.config.enable_extended_met()
-        self.config.to_file(exec_dir)
-        self.ascdata.to_file(exec_dir)
+        # Write configuration files (skipped when unchanged since the last run)
+        with timer.phase("config"):
+            if self.extended_met:
+                self.config.enable_extended_met()
+            workdir.write_configs(self.config, self.ascdata)
 
         # Download meteorological files
-        met_files = download_met_files(
-            met_type=self.met_type,
-            days=self.days,
-            duration=self.duration,
-            direction=self.direction,
-            met_dir=met_dir
-        )
+        with timer.phase("met"):
+            met_files = yield functools.partial(
+                download_met_files,
+                met_type=self.met_type,
+                days=self.days,
+                duration=self.duration,
+                direction=self.direction,
+                met_dir=met_dir
+            )
 
         # Generate receptor combinations
         receptors = []
@@ -288,65 +424,133 @@ class TrajectoryModel:
                 for height in self.height:
                     receptors.append((lat, lon, height))
 
-        all_trajectories = []
-        all_output_files = []
-
-        # Run for each receptor
+        # Plan runs in receptor, day, hour order
+        runs = []
         for receptor_idx, (lat, lon, height) in enumerate(receptors, 1):
-            # Run for each day and hour
             for day in self.days:
                 for hour in self.daily_hours:
                     start_time = day.replace(hour=hour, minute=0, second=0, microsecond=0)
-
-                    output_filename = self._get_output_filename(
-                        receptor_idx, start_time, lat, lon, height
-                    )
-
-                    # Write CONTROL file
-                    self._write_control_file(
-                        exec_dir=exec_dir,
-                        start_time=start_time,
+                    runs.append(PlannedRun(
+                        index=len(runs),
+                        receptor=receptor_idx,
                         lat=lat,
                         lon=lon,
                         height=height,
-                        met_files=met_files,
-                        output_filename=output_filename
-                    )
-
-                    # Execute HYSPLIT
-                    result = subprocess.run(
-                        [str(binary_path)],
-                        cwd=str(exec_dir),
-                        capture_output=True,
-                        text=True
+                        start_time=start_time,
+                        output_filename=self._get_output_filename(
+                            receptor_idx, start_time, lat, lon, height
+                        )
+                    ))
+
+        # Runs already in the cache are not launched
+        run_cache = open_cache(self.cache)
+        cached_frames = {}
+        run_keys = {}
+        if run_cache is not None:
+            with timer.phase("cache"):
+                for run in runs:
+                    key = trajectory_run_key(
+                        self, run.start_time, (run.lat, run.lon, run.height),
+                        met_dir, met_files, binary_path
                     )
-
-                    if result.returncode != 0:
-                        print(f"Warning: HYSPLIT returned non-zero exit code: {result.returncode}")
-                        if result.stderr:
-                            print(f"stderr: {result.stderr}")
-
-                    output_path = exec_dir / output_filename
-                    if output_path.exists():
-                        all_output_files.append(output_path)
-
-        # Read and combine all trajectory outputs
-        if all_output_files:
+                    df = run_cache.get(key)
+                    if df is None:
+                        run_keys[run.index] = key
+                    else:
+                        cached_frames[run.index] = df
+            runs = [run for run in runs if run.index not in cached_frames]
+
+        # Runs sharing a start time go into one multi-start invocation. The
+        # runs of an invocation that fails or leaves trajectories out are
+        # retried one per invocation, so a bad start point only loses itself
+        output_files = {}
+        succeeded = set()  # Runs whose invocation exited 0, the only ones cached
+        groups = deque(plan_start_groups(runs, self.max_starts))
+        chunk = 0
+        while groups:
+            group = groups.popleft()
+            combined_filename = group.output_filename(self.traj_name or "default", chunk)
+            chunk += 1
+
+            # Write CONTROL file
+            with timer.phase("config"):
+                workdir.write("CONTROL", render_trajectory_control(
+                    self,
+                    exec_dir=exec_dir,
+                    start_time=group.start_time,
+                    locations=group.locations,
+                    met_files=met_files,
+                    output_filename=combined_filename,
+                    met_dir=met_dir
+                ))
+
+            # Execute HYSPLIT; a killed or abandoned invocation may leave a partial output
+            try:
+                result = yield LaunchStep(binary_path, self.timeout)
+            except (RunTimeoutError, RunCancelledError, GeneratorExit):
+                workdir.remove(combined_filename)
+                raise
+
+            if result.returncode != 0:
+                print(f"Warning: HYSPLIT returned non-zero exit code: {result.returncode}")
+                if result.stderr:
+                    print(f"stderr: {result.stderr}")
+
+            combined_path = exec_dir / combined_filename
+            if len(group.runs) == 1:
+                if combined_path.exists():
+                    output_files[group.runs[0].index] = combined_path
+                    if result.returncode == 0:
+                        succeeded.add(group.runs[0].index)
+                continue
+
+            # Split the combined output back into per-run files by trajectory number
+            written = set()
+            if combined_path.exists():
+                with timer.phase("parse"):
+                    written = set(split_trajectory_file(
+                        combined_path, [exec_dir / run.output_filename for run in group.runs]
+                    ))
+                    workdir.remove(combined_filename)
+
+            # A failed invocation may have cut every trajectory short
+            retry = []
+            for run in group.runs:
+                if result.returncode == 0 and exec_dir / run.output_filename in written:
+                    output_files[run.index] = exec_dir / run.output_filename
+                    succeeded.add(run.index)
+                else:
+                    retry.append(run)
+            if retry:
+                workdir.remove(*(run.output_filename for run in retry))
+                groups.extendleft(reversed(plan_start_groups(retry, max_starts=1)))
+
+        all_output_files = [output_files[i] for i in sorted(output_files)]
+
+        # Read and combine all trajectory outputs; a blocking step, which
+        # run_async() keeps off the event loop
+        def read_outputs() -> Optional[pd.DataFrame]:
             traj_dfs = []
-            for i, output_file in enumerate(all_output_files):
-                df = trajectory_read(output_file)
+            for i, index in enumerate(sorted(set(output_files) | set(cached_frames))):
+                df = cached_frames.get(index)
+                if df is None:
+                    df = trajectory_read(output_files[index])
+                    if df is not None and not df.empty and index in run_keys and index in succeeded:
+                        run_cache.put(run_keys[index], df)
                 if df is not None and not df.empty:
                     df["run"] = i + 1
                     traj_dfs.append(df)
+            return pd.concat(traj_dfs, ignore_index=True) if traj_dfs else None
 
-            if traj_dfs:
-                self.traj_df = pd.concat(traj_dfs, ignore_index=True)
+        with timer.phase("parse"):
+            traj_df = yield read_outputs
+        if traj_df is not None:
+            self.traj_df = traj_df
 
-        # Clean up if requested
-        if self.clean_up and self.exec_dir is None:
-            shutil.rmtree(exec_dir, ignore_errors=True)
-
-        return self
+        # Clean up if requested; the warm directory itself stays for the next run
+        with timer.phase("cleanup"):
+            if self.clean_up and self.exec_dir is None:
+                workdir.remove(*(path.name for path in all_output_files))
 
     def get_output(self) -> Optional[pd.DataFrame]:
         """Get the trajectory output DataFrame."""
@@ -395,7 +599,10 @@ def hysplit_trajectory(
     binary_path: Optional[str] = None,
     met_dir: Optional[str] = None,
     exec_dir: Optional[str] = None,
-    clean_up: bool = True
+    clean_up: bool = True,
+    max_starts: int = 100,
+    cache: Optional[Union[str, Path, RunCache]] = None,
+    timeout: Optional[float] = None
 ) -> pd.DataFrame:
     """Execute HYSPLIT trajectory model runs.
 
@@ -421,6 +628,12 @@ def hysplit_trajectory(
         met_dir: Directory for meteorological files
         exec_dir: Working directory for model execution
         clean_up: Remove temporary files after completion
+        max_starts: Maximum starting locations computed by one HYSPLIT
+                    invocation; runs sharing a start time are grouped
+        cache: Run cache directory or RunCache; runs already computed with
+               the same inputs are read from it instead of launched
+        timeout: Seconds before a hung hyts_std invocation is killed
+                 (raises RunTimeoutError)
 
     Returns:
         DataFrame with trajectory data
@@ -458,7 +671,10 @@ def hysplit_trajectory(
         binary_path=binary_path,
         met_dir=met_dir,
         exec_dir=exec_dir,
-        clean_up=clean_up
+        clean_up=clean_up,
+        max_starts=max_starts,
+        cache=cache,
+        timeout=timeout
     )
 
     model.run()
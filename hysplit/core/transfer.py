@@ -0,0 +1,105 @@
+"""Transfer-coefficient (source-receptor) matrices.
+
+A transfer matrix holds the concentration every receptor cell receives per
+unit emission rate of every source-time column, so the concentrations of
+any emission scenario are one sparse matrix-vector product instead of a new
+dispersion run.
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+from typing import Optional, Sequence, Union
+
+import numpy as np
+
+
+@dataclass
+class TransferMatrix:
+    """Sparse receptor x source-time matrix in CSR form.
+
+    Rows are receptor cells of the concentration grid flattened in
+    (sample, level, lat, lon) order. Columns are ``source * release_periods
+    + period``; with a ``release_period`` of 0 every source has a single
+    column covering its whole release. Entries are concentrations (mass/m^3,
+    or mass/m^2 on level-0 deposition layers) per unit emission rate
+    (mass/hour) of that source during that period.
+    """
+
+    indptr: np.ndarray = field(repr=False)
+    indices: np.ndarray = field(repr=False)
+    data: np.ndarray = field(repr=False)
+    grid_shape: tuple[int, int, int, int]
+    n_sources: int
+    release_periods: int = 1
+    release_period: float = 0.0
+    sample_start: Optional[np.ndarray] = field(default=None, repr=False)
+    sample_stop: Optional[np.ndarray] = field(default=None, repr=False)
+    _row_of_entry: Optional[np.ndarray] = field(default=None, init=False, repr=False)
+
+    @property
+    def shape(self) -> tuple[int, int]:
+        """Matrix shape (receptor cells, source-time columns)."""
+        return (len(self.indptr) - 1, self.n_sources * self.release_periods)
+
+    @property
+    def nnz(self) -> int:
+        """Number of stored entries."""
+        return len(self.data)
+
+    @property
+    def column_source(self) -> np.ndarray:
+        """Source index of every column."""
+        return np.repeat(np.arange(self.n_sources), self.release_periods)
+
+    @property
+    def column_start(self) -> np.ndarray:
+        """Release period start of every column (hours after model start)."""
+        return np.tile(np.arange(self.release_periods) * self.release_period, self.n_sources)
+
+    def emission_vector(self, rates: Union[Sequence[float], np.ndarray]) -> np.ndarray:
+        """Expand emission rates to one value per column.
+
+        Args:
+            rates: Rates (mass/hour) per source, shape (n_sources,), or per
+                   source and release period, shape (n_sources, release_periods)
+
+        Returns:
+            Column vector of length ``shape[1]``
+        """
+        rates = np.asarray(rates, dtype=np.float64)
+        if rates.shape == (self.n_sources,):
+            return np.repeat(rates, self.release_periods)
+        if rates.shape == (self.n_sources, self.release_periods):
+            return rates.reshape(-1)
+        if rates.shape == (self.shape[1],):
+            return rates
+        raise ValueError(
+            f"Emission rates must have shape ({self.n_sources},) or "
+            f"({self.n_sources}, {self.release_periods})"
+        )
+
+    def apply(self, rates: Union[Sequence[float], np.ndarray]) -> np.ndarray:
+        """Concentrations of an emission scenario.
+
+        Args:
+            rates: Emission rates accepted by ``emission_vector()``
+
+        Returns:
+            Concentration array with shape (samples, levels, lat, lon)
+        """
+        x = self.emission_vector(rates)
+        if self._row_of_entry is None:
+            self._row_of_entry = np.repeat(
+                np.arange(self.shape[0]), np.diff(self.indptr)
+            )
+        conc = np.bincount(
+            self._row_of_entry, weights=self.data * x[self.indices], minlength=self.shape[0]
+        )
+        return conc.reshape(self.grid_shape)
+
+    def to_scipy(self):
+        """Matrix as a ``scipy.sparse.csr_matrix`` (requires scipy)."""
+        from scipy.sparse import csr_matrix
+
+        return csr_matrix((self.data, self.indices, self.indptr), shape=self.shape)
@@ -4,11 +4,108 @@ This package contains C++ implementations for performance-critical operations.
 """
 
 try:
-    from hysplit.cpp._parsers import parse_trajectory_file, parse_pardump_file
+    from hysplit.cpp._parsers import (
+        parse_trajectory_file, parse_pardump_file, parse_emitimes_file
+    )
     HAS_CPP_EXTENSION = True
 except ImportError:
     HAS_CPP_EXTENSION = False
     parse_trajectory_file = None
     parse_pardump_file = None
+    parse_emitimes_file = None
 
-__all__ = ["parse_trajectory_file", "parse_pardump_file", "HAS_CPP_EXTENSION"]
+try:
+    from hysplit.cpp._particles import run_dispersion
+    HAS_PARTICLE_ENGINE = True
+except ImportError:
+    HAS_PARTICLE_ENGINE = False
+    run_dispersion = None
+
+try:
+    from hysplit.cpp._inverse import solve_nnls
+    HAS_INVERSE_SOLVER = True
+except ImportError:
+    HAS_INVERSE_SOLVER = False
+    solve_nnls = None
+
+try:
+    from hysplit.cpp._trajectory_service import run_trajectories, serve
+    HAS_TRAJECTORY_SERVICE = True
+except ImportError:
+    HAS_TRAJECTORY_SERVICE = False
+    run_trajectories = None
+    serve = None
+
+try:
+    from hysplit.cpp._launcher import spawn
+    HAS_NATIVE_LAUNCHER = True
+except ImportError:
+    HAS_NATIVE_LAUNCHER = False
+    spawn = None
+
+try:
+    from hysplit.cpp._templates import compile as compile_template, render as render_template
+    HAS_NATIVE_TEMPLATES = True
+except ImportError:
+    HAS_NATIVE_TEMPLATES = False
+    compile_template = None
+    render_template = None
+
+try:
+    from hysplit.cpp._cluster import cluster_trajectories
+    HAS_CLUSTER_ENGINE = True
+except ImportError:
+    HAS_CLUSTER_ENGINE = False
+    cluster_trajectories = None
+
+try:
+    from hysplit.cpp._gridding import receptor_grid, residence_grid
+    HAS_GRIDDING_ENGINE = True
+except ImportError:
+    HAS_GRIDDING_ENGINE = False
+    receptor_grid = None
+    residence_grid = None
+
+try:
+    from hysplit.cpp._geodesy import path_metrics
+    HAS_GEODESY_ENGINE = True
+except ImportError:
+    HAS_GEODESY_ENGINE = False
+    path_metrics = None
+
+try:
+    from hysplit.cpp._spatial_index import build_index, query_index
+    HAS_SPATIAL_INDEX = True
+except ImportError:
+    HAS_SPATIAL_INDEX = False
+    build_index = None
+    query_index = None
+
+__all__ = [
+    "parse_trajectory_file",
+    "parse_pardump_file",
+    "parse_emitimes_file",
+    "run_dispersion",
+    "solve_nnls",
+    "run_trajectories",
+    "serve",
+    "spawn",
+    "compile_template",
+    "render_template",
+    "cluster_trajectories",
+    "receptor_grid",
+    "residence_grid",
+    "path_metrics",
+    "build_index",
+    "query_index",
+    "HAS_CPP_EXTENSION",
+    "HAS_PARTICLE_ENGINE",
+    "HAS_INVERSE_SOLVER",
+    "HAS_TRAJECTORY_SERVICE",
+    "HAS_NATIVE_LAUNCHER",
+    "HAS_NATIVE_TEMPLATES",
+    "HAS_CLUSTER_ENGINE",
+    "HAS_GRIDDING_ENGINE",
+    "HAS_GEODESY_ENGINE",
+    "HAS_SPATIAL_INDEX",
+]
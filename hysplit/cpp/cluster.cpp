@@ -0,0 +1,474 @@
+/**
+ * Trajectory cluster analysis on total spatial variance (TSV).
+ *
+ * HYSPLIT clusters trajectories agglomeratively, merging at each step the
+ * two clusters whose union increases the total spatial variance (the sum
+ * over clusters of squared endpoint distances to the cluster mean) the
+ * least. With endpoints as Earth-centred Cartesian coordinates in km this
+ * is exactly Ward's criterion, so:
+ *
+ *   1. Pairwise squared distances between the trajectory vectors are
+ *      computed over cache-sized tiles of trajectories, four pairs at a
+ *      time so each endpoint load is reused, with vectorized reductions
+ *      over the endpoints and OpenMP across tile rows.
+ *   2. The merges are found with a nearest-neighbour chain, updating the
+ *      merge costs with the Lance-Williams formula for Ward: O(n^2) time
+ *      and one condensed n(n-1)/2 matrix of doubles.
+ *   3. Merges are sorted by cost and relabelled into a scipy-compatible
+ *      linkage; TSV(k) is the sum of the costs of the first n-k merges.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "earth.h"
+#include "py_args.h"
+
+constexpr double DEG_TO_RAD = M_PI / 180.0;
+
+// Trajectory vectors per tile: two tiles of 72-hour trajectories
+// (219 doubles each) stay within a 64 KiB L1/L2 working set
+constexpr int64_t TILE = 16;
+
+// Vector lengths are padded to this many doubles (one AVX-512 register)
+constexpr int64_t PAD = 8;
+
+// ---------------------------------------------------------------------------
+// Trajectory vectors
+// ---------------------------------------------------------------------------
+
+/**
+ * Row-major (n, dim) matrix of endpoint coordinates: x of every endpoint,
+ * then y, then z, zero-padded to a multiple of PAD doubles.
+ */
+struct Vectors {
+    int64_t n = 0, dim = 0;
+    std::vector<double> data;
+
+    const double* row(int64_t i) const { return data.data() + i * dim; }
+};
+
+static Vectors to_vectors(const double* lat, const double* lon, int64_t n, int64_t m) {
+    Vectors v;
+    v.n = n;
+    v.dim = (3 * m + PAD - 1) / PAD * PAD;
+    v.data.assign(static_cast<size_t>(n * v.dim), 0.0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t i = 0; i < n; i++) {
+        double* out = v.data.data() + i * v.dim;
+        for (int64_t e = 0; e < m; e++) {
+            const double phi = lat[i * m + e] * DEG_TO_RAD;
+            const double lam = lon[i * m + e] * DEG_TO_RAD;
+            out[e] = EARTH_RADIUS_KM * std::cos(phi) * std::cos(lam);
+            out[m + e] = EARTH_RADIUS_KM * std::cos(phi) * std::sin(lam);
+            out[2 * m + e] = EARTH_RADIUS_KM * std::sin(phi);
+        }
+    }
+    return v;
+}
+
+// ---------------------------------------------------------------------------
+// Condensed pairwise matrix
+// ---------------------------------------------------------------------------
+
+// Position of pair (i, j), i < j, in the condensed upper triangle
+static inline int64_t pair_index(int64_t n, int64_t i, int64_t j) {
+    return n * i - i * (i + 1) / 2 + (j - i - 1);
+}
+
+/**
+ * Half the squared distance of every pair, i.e. the Ward merge cost of two
+ * single trajectories, in condensed order.
+ */
+static void pairwise_costs(const Vectors& v, double* out) {
+    const int64_t n = v.n, dim = v.dim;
+    const int64_t tiles = (n + TILE - 1) / TILE;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int64_t ti = 0; ti < tiles; ti++) {
+        const int64_t i0 = ti * TILE, i1 = std::min(n, i0 + TILE);
+        for (int64_t tj = ti; tj < tiles; tj++) {
+            const int64_t j0 = tj * TILE, j1 = std::min(n, j0 + TILE);
+            for (int64_t i = i0; i < i1; i++) {
+                const double* a = v.row(i);
+                int64_t j = std::max(j0, i + 1);
+                // Four pairs at a time share the loads of a
+                for (; j + 4 <= j1; j += 4) {
+                    const double* b0 = v.row(j);
+                    const double* b1 = v.row(j + 1);
+                    const double* b2 = v.row(j + 2);
+                    const double* b3 = v.row(j + 3);
+                    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : s0, s1, s2, s3)
+#endif
+                    for (int64_t k = 0; k < dim; k++) {
+                        const double d0 = a[k] - b0[k], d1 = a[k] - b1[k];
+                        const double d2 = a[k] - b2[k], d3 = a[k] - b3[k];
+                        s0 += d0 * d0;
+                        s1 += d1 * d1;
+                        s2 += d2 * d2;
+                        s3 += d3 * d3;
+                    }
+                    double* row = out + pair_index(n, i, j);
+                    row[0] = 0.5 * s0;
+                    row[1] = 0.5 * s1;
+                    row[2] = 0.5 * s2;
+                    row[3] = 0.5 * s3;
+                }
+                for (; j < j1; j++) {
+                    const double* b = v.row(j);
+                    double s = 0.0;
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : s)
+#endif
+                    for (int64_t k = 0; k < dim; k++) {
+                        const double d = a[k] - b[k];
+                        s += d * d;
+                    }
+                    out[pair_index(n, i, j)] = 0.5 * s;
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Nearest-neighbour chain
+// ---------------------------------------------------------------------------
+
+struct Merge {
+    int64_t a, b;  // a member of each cluster
+    double cost;   // increase of the TSV
+};
+
+/**
+ * Ward merges by nearest-neighbour chain on the condensed cost matrix,
+ * which is overwritten. The cluster kept in slot s always contains
+ * trajectory s. Merges come out of cost order.
+ */
+static std::vector<Merge> nn_chain(double* cost, int64_t n) {
+    std::vector<Merge> merges;
+    merges.reserve(n > 0 ? n - 1 : 0);
+    std::vector<int64_t> size(n, 1);
+    // Active slots as a linked list, so searches skip merged clusters
+    std::vector<int64_t> next(n + 1), prev(n + 1);
+    for (int64_t i = 0; i <= n; i++) {
+        next[i] = i + 1;
+        prev[i] = i - 1;
+    }
+    const int64_t head = n;  // sentinel: next[head] is the first active slot
+    next[head] = 0;
+    auto at = [&](int64_t i, int64_t j) -> double& {
+        return i < j ? cost[pair_index(n, i, j)] : cost[pair_index(n, j, i)];
+    };
+    auto unlink = [&](int64_t s) {
+        if (prev[s] >= 0) next[prev[s]] = next[s]; else next[head] = next[s];
+        if (next[s] < n) prev[next[s]] = prev[s];
+    };
+
+    std::vector<int64_t> chain;
+    chain.reserve(n);
+    for (int64_t remaining = n; remaining > 1; remaining--) {
+        if (chain.empty()) chain.push_back(next[head]);
+        int64_t a, b;
+        while (true) {
+            a = chain.back();
+            // Prefer the previous chain element on ties, so the chain ends
+            b = chain.size() >= 2 ? chain[chain.size() - 2] : -1;
+            double best = b >= 0 ? at(a, b) : std::numeric_limits<double>::max();
+            for (int64_t x = next[head]; x < n; x = next[x]) {
+                if (x == a) continue;
+                const double d = at(a, x);
+                if (d < best) {
+                    best = d;
+                    b = x;
+                }
+            }
+            if (chain.size() >= 2 && b == chain[chain.size() - 2]) break;
+            chain.push_back(b);
+        }
+        chain.pop_back();
+        chain.pop_back();
+
+        // Merge a into b (Lance-Williams for Ward)
+        const double ab = at(a, b);
+        merges.push_back({a, b, ab});
+        const double na = static_cast<double>(size[a]), nb = static_cast<double>(size[b]);
+        unlink(a);
+        for (int64_t x = next[head]; x < n; x = next[x]) {
+            if (x == b) continue;
+            const double nx = static_cast<double>(size[x]);
+            double& bx = at(b, x);
+            bx = ((nx + na) * at(a, x) + (nx + nb) * bx - nx * ab) / (nx + na + nb);
+        }
+        size[b] += size[a];
+    }
+    return merges;
+}
+
+// ---------------------------------------------------------------------------
+// Union-find over trajectories
+// ---------------------------------------------------------------------------
+
+struct DisjointSets {
+    std::vector<int64_t> parent;
+
+    explicit DisjointSets(int64_t n) : parent(n) { std::iota(parent.begin(), parent.end(), 0); }
+
+    int64_t find(int64_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+};
+
+static void sort_merges(std::vector<Merge>& merges) {
+    std::stable_sort(merges.begin(), merges.end(),
+                     [](const Merge& x, const Merge& y) { return x.cost < y.cost; });
+}
+
+/**
+ * Cluster labels 1..k after the first n-k sorted merges: cluster 1 is the
+ * largest, ties broken by the lowest trajectory index.
+ */
+static void labels_for(const std::vector<Merge>& merges, int64_t n, int64_t k, int32_t* labels) {
+    DisjointSets sets(n);
+    for (int64_t m = 0; m < n - k; m++) {
+        sets.parent[sets.find(merges[m].a)] = sets.find(merges[m].b);
+    }
+    std::vector<int64_t> root(n), count(n, 0), first(n, -1);
+    for (int64_t i = 0; i < n; i++) {
+        root[i] = sets.find(i);
+        count[root[i]]++;
+        if (first[root[i]] < 0) first[root[i]] = i;
+    }
+    std::vector<int64_t> roots;
+    for (int64_t i = 0; i < n; i++) {
+        if (root[i] == i) roots.push_back(i);
+    }
+    std::sort(roots.begin(), roots.end(), [&](int64_t x, int64_t y) {
+        return count[x] != count[y] ? count[x] > count[y] : first[x] < first[y];
+    });
+    std::vector<int32_t> label(n, 0);
+    for (size_t r = 0; r < roots.size(); r++) label[roots[r]] = static_cast<int32_t>(r + 1);
+    for (int64_t i = 0; i < n; i++) labels[i] = label[root[i]];
+}
+
+// ---------------------------------------------------------------------------
+// Python interface
+// ---------------------------------------------------------------------------
+
+static bool load_endpoints(PyObject* obj, const char* name, PyArrayObject*& out) {
+    out = reinterpret_cast<PyArrayObject*>(
+        PyArray_FROMANY(obj, NPY_DOUBLE, 2, 2, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST));
+    if (!out) {
+        PyErr_Format(PyExc_ValueError, "'%s' must be a 2-D (trajectories, endpoints) array", name);
+        return false;
+    }
+    return true;
+}
+
+// Linkage matrix (n-1, 4) and labels of the requested cluster counts
+static bool build_outputs(const std::vector<Merge>& merges, int64_t n, const int64_t* ks,
+                          int64_t n_ks, PyObject* result) {
+    // The dict owns the arrays once they are set
+    npy_intp ldims[2] = {static_cast<npy_intp>(std::max<int64_t>(n - 1, 0)), 4};
+    PyObject* linkage = PyArray_SimpleNew(2, ldims, NPY_DOUBLE);
+    if (set_item(result, "linkage", linkage) < 0) return false;
+    npy_intp tdims[1] = {static_cast<npy_intp>(n)};
+    PyObject* tsv = PyArray_SimpleNew(1, tdims, NPY_DOUBLE);
+    if (set_item(result, "tsv", tsv) < 0) return false;
+    npy_intp adims[2] = {static_cast<npy_intp>(n_ks), static_cast<npy_intp>(n)};
+    PyObject* labels = PyArray_SimpleNew(2, adims, NPY_INT32);
+    if (set_item(result, "labels", labels) < 0) return false;
+    double* link = static_cast<double*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(linkage)));
+    double* tsv_out = static_cast<double*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(tsv)));
+    int32_t* label_out = static_cast<int32_t*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(labels)));
+
+    Py_BEGIN_ALLOW_THREADS
+    // scipy numbering: trajectories 0..n-1, the cluster of merge m is n+m
+    DisjointSets sets(n);
+    std::vector<int64_t> id(n), size(n, 1);
+    std::iota(id.begin(), id.end(), 0);
+    for (int64_t m = 0; m + 1 < n; m++) {
+        const int64_t ra = sets.find(merges[m].a), rb = sets.find(merges[m].b);
+        link[4 * m] = static_cast<double>(std::min(id[ra], id[rb]));
+        link[4 * m + 1] = static_cast<double>(std::max(id[ra], id[rb]));
+        link[4 * m + 2] = merges[m].cost;
+        link[4 * m + 3] = static_cast<double>(size[ra] + size[rb]);
+        sets.parent[ra] = rb;
+        id[rb] = n + m;
+        size[rb] += size[ra];
+    }
+    // TSV with k clusters, k = 1..n
+    double total = 0.0;
+    if (n > 0) tsv_out[n - 1] = 0.0;
+    for (int64_t m = 0; m + 1 < n; m++) {
+        total += merges[m].cost;
+        tsv_out[n - 2 - m] = total;
+    }
+    for (int64_t c = 0; c < n_ks; c++) labels_for(merges, n, ks[c], label_out + c * n);
+    Py_END_ALLOW_THREADS
+    return true;
+}
+
+/**
+ * Cluster trajectories by TSV.
+ *
+ * Takes (n, m) arrays of endpoint latitudes and longitudes and the cluster
+ * counts to label, and returns a dict with the linkage, the TSV curve and
+ * the labels.
+ */
+static PyObject* cluster_trajectories(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj, *ks_obj;
+    if (!PyArg_ParseTuple(args, "OOO", &lat_obj, &lon_obj, &ks_obj)) {
+        return NULL;
+    }
+    PyArrayObject *lat = nullptr, *lon = nullptr;
+    if (!load_endpoints(lat_obj, "lat", lat)) return NULL;
+    if (!load_endpoints(lon_obj, "lon", lon)) {
+        Py_DECREF(lat);
+        return NULL;
+    }
+    PyArrayObject* ks = reinterpret_cast<PyArrayObject*>(
+        PyArray_FROMANY(ks_obj, NPY_INT64, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST));
+    PyObject* result = nullptr;
+    const int64_t n = PyArray_DIM(lat, 0), m = PyArray_DIM(lat, 1);
+    const int64_t* k_data = ks ? static_cast<const int64_t*>(PyArray_DATA(ks)) : nullptr;
+    const int64_t n_ks = ks ? PyArray_SIZE(ks) : 0;
+
+    if (!ks) {
+        PyErr_SetString(PyExc_ValueError, "'n_clusters' must be a 1-D integer array");
+    } else if (PyArray_DIM(lon, 0) != n || PyArray_DIM(lon, 1) != m) {
+        PyErr_SetString(PyExc_ValueError, "lat and lon must have the same shape");
+    } else if (n < 1 || m < 1) {
+        PyErr_SetString(PyExc_ValueError, "at least one trajectory with one endpoint is needed");
+    } else if (std::any_of(k_data, k_data + n_ks, [n](int64_t k) { return k < 1 || k > n; })) {
+        PyErr_SetString(PyExc_ValueError, "cluster counts must be between 1 and the number of trajectories");
+    } else {
+        std::vector<Merge> merges;
+        bool ok = true;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            const Vectors v = to_vectors(static_cast<const double*>(PyArray_DATA(lat)),
+                                         static_cast<const double*>(PyArray_DATA(lon)), n, m);
+            std::vector<double> cost(static_cast<size_t>(n * (n - 1) / 2));
+            pairwise_costs(v, cost.data());
+            merges = nn_chain(cost.data(), n);
+            sort_merges(merges);
+        } catch (const std::bad_alloc&) {
+            ok = false;
+        }
+        Py_END_ALLOW_THREADS
+        if (!ok) {
+            PyErr_NoMemory();
+        } else if ((result = PyDict_New()) != nullptr &&
+                   !build_outputs(merges, n, k_data, n_ks, result)) {
+            Py_CLEAR(result);
+        }
+    }
+    Py_DECREF(lat);
+    Py_DECREF(lon);
+    Py_XDECREF(ks);
+    return result;
+}
+
+/**
+ * Condensed pairwise merge costs (half the squared distance in km^2), for
+ * checking and for other linkage methods.
+ */
+static PyObject* pairwise_distances(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj;
+    if (!PyArg_ParseTuple(args, "OO", &lat_obj, &lon_obj)) {
+        return NULL;
+    }
+    PyArrayObject *lat = nullptr, *lon = nullptr;
+    if (!load_endpoints(lat_obj, "lat", lat)) return NULL;
+    if (!load_endpoints(lon_obj, "lon", lon)) {
+        Py_DECREF(lat);
+        return NULL;
+    }
+    PyObject* out = nullptr;
+    const int64_t n = PyArray_DIM(lat, 0), m = PyArray_DIM(lat, 1);
+    if (PyArray_DIM(lon, 0) != n || PyArray_DIM(lon, 1) != m) {
+        PyErr_SetString(PyExc_ValueError, "lat and lon must have the same shape");
+    } else {
+        npy_intp dims[1] = {static_cast<npy_intp>(n * (n - 1) / 2)};
+        out = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+        if (out) {
+            double* data = static_cast<double*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(out)));
+            Py_BEGIN_ALLOW_THREADS
+            const Vectors v = to_vectors(static_cast<const double*>(PyArray_DATA(lat)),
+                                         static_cast<const double*>(PyArray_DATA(lon)), n, m);
+            pairwise_costs(v, data);
+            // Squared distances
+            for (npy_intp i = 0; i < dims[0]; i++) data[i] *= 2.0;
+            Py_END_ALLOW_THREADS
+        }
+    }
+    Py_DECREF(lat);
+    Py_DECREF(lon);
+    return out;
+}
+
+// Method definitions
+static PyMethodDef ClusterMethods[] = {
+    {"cluster_trajectories", cluster_trajectories, METH_VARARGS,
+     "Agglomerative TSV (Ward) clustering of equal-length trajectories.\n\n"
+     "Args:\n"
+     "    lat (numpy.ndarray): Endpoint latitudes, (trajectories, endpoints)\n"
+     "    lon (numpy.ndarray): Endpoint longitudes, same shape\n"
+     "    n_clusters (numpy.ndarray): Cluster counts to label\n\n"
+     "Returns:\n"
+     "    dict: linkage (n-1, 4) scipy-compatible with TSV increases as heights,\n"
+     "          tsv (n,) with tsv[k-1] the TSV of k clusters (km^2),\n"
+     "          labels (len(n_clusters), n) int32, 1 = largest cluster"},
+
+    {"pairwise_distances", pairwise_distances, METH_VARARGS,
+     "Condensed squared distances between trajectories (km^2).\n\n"
+     "Args:\n"
+     "    lat (numpy.ndarray): Endpoint latitudes, (trajectories, endpoints)\n"
+     "    lon (numpy.ndarray): Endpoint longitudes, same shape\n\n"
+     "Returns:\n"
+     "    numpy.ndarray: n(n-1)/2 distances in scipy's condensed order"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef clustermodule = {
+    PyModuleDef_HEAD_INIT,
+    "_cluster",
+    "Trajectory cluster analysis on total spatial variance.",
+    -1,
+    ClusterMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__cluster(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&clustermodule);
+}
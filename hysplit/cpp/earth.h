@@ -0,0 +1,13 @@
+/**
+ * Earth constants shared by the native extensions, so that all of them
+ * convert between degrees and distances the same way.
+ */
+
+#ifndef HYSPLIT_EARTH_H
+#define HYSPLIT_EARTH_H
+
+// IUGG mean radius
+constexpr double EARTH_RADIUS_KM = 6371.0088;
+constexpr double EARTH_RADIUS_M = EARTH_RADIUS_KM * 1000.0;
+
+#endif  // HYSPLIT_EARTH_H
@@ -0,0 +1,356 @@
+/**
+ * Geodesic metrics of trajectories in columnar form.
+ *
+ * Walks every trajectory once and returns, per point, the length, bearing
+ * and speed of the segment ending there and the distance from the
+ * trajectory's origin, and per trajectory the path length, displacement,
+ * largest distance from the origin, mean and peak speed and net bearing.
+ *
+ * Distances are great-circle (haversine, on a sphere of the mean Earth
+ * radius) or ellipsoidal (Vincenty's inverse formula on WGS84). The
+ * haversine loop over the points of a trajectory has no branches, so with
+ * -ffast-math and OpenMP SIMD GCC vectorizes it, trigonometry included,
+ * through glibc's vector math library. Trajectories are split between
+ * threads; each writes only its own slice of the outputs.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "earth.h"
+#include "py_args.h"
+
+// ---------------------------------------------------------------------------
+// Argument helpers
+// ---------------------------------------------------------------------------
+
+// New 1-D array of doubles, or NULL with the Python error set
+static PyArrayObject* new_vector(npy_intp n) {
+    npy_intp dims[1] = {n};
+    return reinterpret_cast<PyArrayObject*>(PyArray_ZEROS(1, dims, NPY_DOUBLE, 0));
+}
+
+static double* vector_data(PyArrayObject* array) {
+    return static_cast<double*>(PyArray_DATA(array));
+}
+
+// ---------------------------------------------------------------------------
+// Geodesy
+// ---------------------------------------------------------------------------
+
+constexpr double DEG = M_PI / 180.0;
+
+// WGS84 ellipsoid
+constexpr double WGS84_A_KM = 6378.137;
+constexpr double WGS84_F = 1.0 / 298.257223563;
+constexpr double WGS84_B_KM = WGS84_A_KM * (1.0 - WGS84_F);
+constexpr int VINCENTY_MAX_ITER = 200;
+
+// Initial bearing (degrees clockwise from north, [0, 360)) from 1 to 2
+static inline double initial_bearing(double sin1, double cos1, double sin2, double cos2,
+                                     double sin_dlam, double cos_dlam) {
+    const double b = std::atan2(sin_dlam * cos2, cos1 * sin2 - sin1 * cos2 * cos_dlam) / DEG;
+    return b < 0.0 ? b + 360.0 : b;
+}
+
+// Great-circle distance (km) from the haversine of the central angle
+static inline double haversine_km(double sin_half_dphi, double sin_half_dlam, double cos1,
+                                  double cos2) {
+    const double h = sin_half_dphi * sin_half_dphi + cos1 * cos2 * sin_half_dlam * sin_half_dlam;
+    return 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(std::min(h, 1.0)));
+}
+
+// Cosine of an angle in [-pi/2, pi/2] from its sine
+static inline double cos_from_sin(double s) {
+    return std::sqrt(std::max(1.0 - s * s, 0.0));
+}
+
+/**
+ * Ellipsoidal distance (km) by Vincenty's inverse formula.
+ *
+ * Nearly antipodal points, where the iteration does not settle, keep the
+ * last iterate, which is within a few km.
+ */
+static double vincenty_km(double lat1, double lon1, double lat2, double lon2) {
+    const double L = (lon2 - lon1) * DEG;
+    const double U1 = std::atan((1.0 - WGS84_F) * std::tan(lat1 * DEG));
+    const double U2 = std::atan((1.0 - WGS84_F) * std::tan(lat2 * DEG));
+    const double sinU1 = std::sin(U1), cosU1 = std::cos(U1);
+    const double sinU2 = std::sin(U2), cosU2 = std::cos(U2);
+
+    double lambda = L, sin_sigma = 0.0, cos_sigma = 1.0, sigma = 0.0;
+    double cos2_alpha = 1.0, cos_2sigma_m = 0.0;
+    for (int iter = 0; iter < VINCENTY_MAX_ITER; iter++) {
+        const double sin_lambda = std::sin(lambda), cos_lambda = std::cos(lambda);
+        const double t1 = cosU2 * sin_lambda;
+        const double t2 = cosU1 * sinU2 - sinU1 * cosU2 * cos_lambda;
+        sin_sigma = std::sqrt(t1 * t1 + t2 * t2);
+        if (sin_sigma == 0.0) return 0.0;  // coincident points
+        cos_sigma = sinU1 * sinU2 + cosU1 * cosU2 * cos_lambda;
+        sigma = std::atan2(sin_sigma, cos_sigma);
+        const double sin_alpha = cosU1 * cosU2 * sin_lambda / sin_sigma;
+        cos2_alpha = 1.0 - sin_alpha * sin_alpha;
+        // Equatorial lines have cos2_alpha = 0
+        cos_2sigma_m = cos2_alpha != 0.0 ? cos_sigma - 2.0 * sinU1 * sinU2 / cos2_alpha : 0.0;
+        const double C = WGS84_F / 16.0 * cos2_alpha * (4.0 + WGS84_F * (4.0 - 3.0 * cos2_alpha));
+        const double previous = lambda;
+        lambda = L + (1.0 - C) * WGS84_F * sin_alpha *
+                 (sigma + C * sin_sigma *
+                  (cos_2sigma_m + C * cos_sigma * (-1.0 + 2.0 * cos_2sigma_m * cos_2sigma_m)));
+        if (std::fabs(lambda - previous) < 1e-12) break;
+    }
+
+    const double u2 = cos2_alpha * (WGS84_A_KM * WGS84_A_KM - WGS84_B_KM * WGS84_B_KM) /
+                      (WGS84_B_KM * WGS84_B_KM);
+    const double A = 1.0 + u2 / 16384.0 * (4096.0 + u2 * (-768.0 + u2 * (320.0 - 175.0 * u2)));
+    const double B = u2 / 1024.0 * (256.0 + u2 * (-128.0 + u2 * (74.0 - 47.0 * u2)));
+    const double c2m = cos_2sigma_m * cos_2sigma_m;
+    const double delta_sigma =
+        B * sin_sigma *
+        (cos_2sigma_m + B / 4.0 *
+         (cos_sigma * (-1.0 + 2.0 * c2m) -
+          B / 6.0 * cos_2sigma_m * (-3.0 + 4.0 * sin_sigma * sin_sigma) * (-3.0 + 4.0 * c2m)));
+    return WGS84_B_KM * A * (sigma - delta_sigma);
+}
+
+// ---------------------------------------------------------------------------
+// Trajectory metrics
+// ---------------------------------------------------------------------------
+
+struct PointMetrics {
+    double* step_km;     // length of the segment ending at the point
+    double* bearing;     // its initial bearing
+    double* speed_kmh;   // its mean speed
+    double* origin_km;   // distance from the trajectory's first point
+};
+
+struct RunMetrics {
+    double* path_km;         // sum of the segment lengths
+    double* origin_km;       // distance of the last point from the first
+    double* max_origin_km;   // largest distance from the first point
+    double* duration_h;      // hours between the first and last points
+    double* max_speed_kmh;   // fastest segment
+    double* bearing;         // initial bearing from the first to the last point
+};
+
+/**
+ * Metrics of the points [start, end) of one trajectory; the first point
+ * keeps zeros.
+ */
+static void trajectory_metrics(const double* lat, const double* lon, const double* hour,
+                               int64_t start, int64_t end, bool vincenty,
+                               const PointMetrics& point, const RunMetrics& run, int64_t k) {
+    const double phi0 = lat[start] * DEG, lam0 = lon[start] * DEG;
+    const double sin0 = std::sin(phi0), cos0 = std::cos(phi0);
+    double path = 0.0, max_origin = 0.0, max_speed = 0.0;
+    // Local pointers, so stores through them cannot alias the struct
+    double* __restrict step_out = point.step_km;
+    double* __restrict bearing_out = point.bearing;
+    double* __restrict speed_out = point.speed_kmh;
+    double* __restrict origin_out = point.origin_km;
+
+    if (!vincenty) {
+        // Only sines and square roots: GCC fuses a sine and cosine of the
+        // same angle into sincos, which has no vector variant
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : path) reduction(max : max_origin, max_speed)
+#endif
+        for (int64_t p = start + 1; p < end; p++) {
+            const double phi1 = lat[p - 1] * DEG, phi2 = lat[p] * DEG;
+            double dlam = (lon[p] - lon[p - 1]) * DEG;
+            dlam -= 2.0 * M_PI * std::floor((dlam + M_PI) / (2.0 * M_PI));  // [-pi, pi)
+            const double sin1 = std::sin(phi1), cos1 = cos_from_sin(sin1);
+            const double sin2 = std::sin(phi2), cos2 = cos_from_sin(sin2);
+            const double sin_half_dlam = std::sin(0.5 * dlam);
+            const double cos_half_dlam = cos_from_sin(sin_half_dlam);
+
+            const double step = haversine_km(std::sin(0.5 * (phi2 - phi1)), sin_half_dlam, cos1, cos2);
+            const double origin = haversine_km(std::sin(0.5 * (phi2 - phi0)),
+                                               std::sin(0.5 * (lon[p] * DEG - lam0)), cos0, cos2);
+            const double dt = std::fabs(hour[p] - hour[p - 1]);
+            const double speed = dt > 0.0 ? step / (dt > 0.0 ? dt : 1.0) : 0.0;
+
+            step_out[p] = step;
+            bearing_out[p] = initial_bearing(sin1, cos1, sin2, cos2,
+                                             2.0 * sin_half_dlam * cos_half_dlam,
+                                             1.0 - 2.0 * sin_half_dlam * sin_half_dlam);
+            speed_out[p] = speed;
+            origin_out[p] = origin;
+            path += step;
+            max_origin = std::max(max_origin, origin);
+            max_speed = std::max(max_speed, speed);
+        }
+    } else {
+        for (int64_t p = start + 1; p < end; p++) {
+            const double phi1 = lat[p - 1] * DEG, phi2 = lat[p] * DEG;
+            const double step = vincenty_km(lat[p - 1], lon[p - 1], lat[p], lon[p]);
+            const double origin = vincenty_km(lat[start], lon[start], lat[p], lon[p]);
+            const double dt = std::fabs(hour[p] - hour[p - 1]);
+            const double speed = dt > 0.0 ? step / dt : 0.0;
+            const double dlam = (lon[p] - lon[p - 1]) * DEG;
+
+            step_out[p] = step;
+            bearing_out[p] = initial_bearing(std::sin(phi1), std::cos(phi1), std::sin(phi2),
+                                             std::cos(phi2), std::sin(dlam), std::cos(dlam));
+            speed_out[p] = speed;
+            origin_out[p] = origin;
+            path += step;
+            max_origin = std::max(max_origin, origin);
+            max_speed = std::max(max_speed, speed);
+        }
+    }
+
+    const int64_t last = end - 1;
+    run.path_km[k] = path;
+    run.origin_km[k] = origin_out[last];
+    run.max_origin_km[k] = max_origin;
+    run.duration_h[k] = std::fabs(hour[last] - hour[start]);
+    run.max_speed_kmh[k] = max_speed;
+    const double phi_last = lat[last] * DEG;
+    const double dlam_last = lon[last] * DEG - lam0;
+    run.bearing[k] = initial_bearing(sin0, cos0, std::sin(phi_last), std::cos(phi_last),
+                                     std::sin(dlam_last), std::cos(dlam_last));
+}
+
+/**
+ * Per-point and per-trajectory geodesic metrics.
+ *
+ * Takes point lat/lon/hour arrays grouped by trajectory and in time order
+ * within each, the trajectory offsets into them and the method, and
+ * returns a dict of point arrays and trajectory arrays.
+ */
+static PyObject* path_metrics(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj, *hour_obj, *offsets_obj;
+    const char* method = "haversine";
+    if (!PyArg_ParseTuple(args, "OOOO|s", &lat_obj, &lon_obj, &hour_obj, &offsets_obj, &method)) {
+        return NULL;
+    }
+
+    bool vincenty;
+    if (std::strcmp(method, "haversine") == 0) {
+        vincenty = false;
+    } else if (std::strcmp(method, "vincenty") == 0) {
+        vincenty = true;
+    } else {
+        PyErr_Format(PyExc_ValueError, "Unknown method '%s' (haversine or vincenty)", method);
+        return NULL;
+    }
+
+    Array1D lat, lon, hour, offsets;
+    if (!lat.load(lat_obj, NPY_DOUBLE, "lat") || !lon.load(lon_obj, NPY_DOUBLE, "lon") ||
+        !hour.load(hour_obj, NPY_DOUBLE, "hour") || !offsets.load(offsets_obj, NPY_INT64, "offsets")) {
+        return NULL;
+    }
+    const npy_intp n_points = lat.size();
+    if (lon.size() != n_points || hour.size() != n_points) {
+        PyErr_SetString(PyExc_ValueError, "lat, lon and hour must have the same length");
+        return NULL;
+    }
+    const int64_t* offs = offsets.data<int64_t>();
+    const npy_intp n_runs = offsets.size() - 1;
+    if (n_runs < 0 || offs[0] != 0 || offs[n_runs] != n_points) {
+        PyErr_SetString(PyExc_ValueError, "offsets must run from 0 to the number of points");
+        return NULL;
+    }
+    for (npy_intp k = 0; k < n_runs; k++) {
+        if (offs[k + 1] <= offs[k]) {
+            PyErr_SetString(PyExc_ValueError, "every trajectory needs at least one point");
+            return NULL;
+        }
+    }
+
+    static const char* point_names[] = {"step_km", "bearing", "speed_kmh", "origin_km"};
+    static const char* run_names[] = {"path_km", "origin_km", "max_origin_km", "duration_h",
+                                      "max_speed_kmh", "bearing"};
+    PyObject* points = PyDict_New();
+    PyObject* runs = PyDict_New();
+    PyObject* result = PyDict_New();
+    double* point_data[4];
+    double* run_data[6];
+    bool ok = points && runs && result;
+    for (int i = 0; ok && i < 4; i++) {
+        PyArrayObject* array = new_vector(n_points);
+        ok = array != nullptr;
+        if (ok) point_data[i] = vector_data(array);
+        ok = ok && set_item(points, point_names[i], reinterpret_cast<PyObject*>(array)) == 0;
+    }
+    for (int i = 0; ok && i < 6; i++) {
+        PyArrayObject* array = new_vector(n_runs);
+        ok = array != nullptr;
+        if (ok) run_data[i] = vector_data(array);
+        ok = ok && set_item(runs, run_names[i], reinterpret_cast<PyObject*>(array)) == 0;
+    }
+    if (!ok) {
+        Py_XDECREF(points);
+        Py_XDECREF(runs);
+        Py_XDECREF(result);
+        return NULL;
+    }
+
+    const PointMetrics point{point_data[0], point_data[1], point_data[2], point_data[3]};
+    const RunMetrics run{run_data[0], run_data[1], run_data[2], run_data[3], run_data[4], run_data[5]};
+    const double* lat_p = lat.data<double>();
+    const double* lon_p = lon.data<double>();
+    const double* hour_p = hour.data<double>();
+
+    Py_BEGIN_ALLOW_THREADS
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (npy_intp k = 0; k < n_runs; k++) {
+        trajectory_metrics(lat_p, lon_p, hour_p, offs[k], offs[k + 1], vincenty, point, run, k);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (set_item(result, "points", points) < 0 || set_item(result, "runs", runs) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Method definitions
+static PyMethodDef GeodesyMethods[] = {
+    {"path_metrics", path_metrics, METH_VARARGS,
+     "Geodesic metrics of trajectories in columnar form.\n\n"
+     "Args:\n"
+     "    lat, lon, hour (numpy.ndarray): Points grouped by trajectory,\n"
+     "        in time order within each\n"
+     "    offsets (numpy.ndarray): Start of every trajectory, then the point count\n"
+     "    method (str): 'haversine' (sphere, vectorized) or 'vincenty' (WGS84)\n\n"
+     "Returns:\n"
+     "    dict: 'points' (step_km, bearing, speed_kmh, origin_km; zero at the\n"
+     "          first point of a trajectory) and 'runs' (path_km, origin_km,\n"
+     "          max_origin_km, duration_h, max_speed_kmh, bearing) arrays"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef geodesymodule = {
+    PyModuleDef_HEAD_INIT,
+    "_geodesy",
+    "Geodesic metrics of trajectories in columnar form.",
+    -1,
+    GeodesyMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__geodesy(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&geodesymodule);
+}
@@ -0,0 +1,522 @@
+/**
+ * Gridding of trajectory ensembles for receptor models and residence time.
+ *
+ * Accumulates the endpoints of many back trajectories on a lat/lon grid:
+ * the number of endpoints per cell (n), the number of endpoints of runs
+ * whose receptor concentration exceeds a threshold (m), and the
+ * concentration-weighted endpoint sum. From these come the Potential
+ * Source Contribution Function (PSCF = m / n) and the Concentration-
+ * Weighted Trajectory field (CWT = sum / n). Cells with few endpoints are
+ * down-weighted with the usual step weighting function of n.
+ *
+ * Residence-time grids (like HYSPLIT's trajfreq) rasterize every segment
+ * between consecutive endpoints across the cells it crosses, so a fast
+ * trajectory that skips cells between hourly points still counts in them:
+ * each cell gets the time spent in it and the number of trajectories that
+ * passed through, optionally per height band.
+ *
+ * Points (or trajectories) are split between OpenMP threads, each with its
+ * own grids, which are summed at the end, so no atomics are needed in the
+ * hot loop.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "py_args.h"
+
+// ---------------------------------------------------------------------------
+// Argument helpers
+// ---------------------------------------------------------------------------
+
+// New (nlat, nlon) array holding a copy of values
+template <typename T>
+static PyObject* grid_array(const std::vector<T>& values, long nlat, long nlon, int type_num) {
+    npy_intp dims[2] = {nlat, nlon};
+    PyObject* array = PyArray_SimpleNew(2, dims, type_num);
+    if (array && !values.empty()) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), values.data(),
+                    values.size() * sizeof(T));
+    }
+    return array;
+}
+
+// New (bands, nlat, nlon) array holding a copy of values
+template <typename T>
+static PyObject* band_array(const std::vector<T>& values, long bands, long nlat, long nlon,
+                            int type_num) {
+    npy_intp dims[3] = {bands, nlat, nlon};
+    PyObject* array = PyArray_SimpleNew(3, dims, type_num);
+    if (array && !values.empty()) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), values.data(),
+                    values.size() * sizeof(T));
+    }
+    return array;
+}
+
+// ---------------------------------------------------------------------------
+// Grid
+// ---------------------------------------------------------------------------
+
+// Regular lat/lon grid; cell (0, 0) has its south-west corner at (lat0, lon0)
+struct Grid {
+    double lat0 = -90.0, lon0 = -180.0;
+    double dlat = 1.0, dlon = 1.0;
+    long nlat = 180, nlon = 360;
+
+    size_t cells() const { return static_cast<size_t>(nlat) * static_cast<size_t>(nlon); }
+
+    // Cell index of a point, or -1 outside the grid
+    inline int64_t cell(double lat, double lon) const {
+        const double y = (lat - lat0) / dlat;
+        // Longitudes east of lon0, in [0, 360)
+        double east = std::fmod(lon - lon0, 360.0);
+        east += east < 0.0 ? 360.0 : 0.0;
+        const double x = east / dlon;
+        if (y < 0.0 || x < 0.0 || y >= static_cast<double>(nlat) || x >= static_cast<double>(nlon)) {
+            return -1;
+        }
+        return static_cast<int64_t>(y) * nlon + static_cast<int64_t>(x);
+    }
+};
+
+static bool parse_grid(PyObject* dict, Grid& grid) {
+    if (!dict_double(dict, "lat0", grid.lat0) || !dict_double(dict, "lon0", grid.lon0) ||
+        !dict_double(dict, "dlat", grid.dlat) || !dict_double(dict, "dlon", grid.dlon) ||
+        !dict_long(dict, "nlat", grid.nlat) || !dict_long(dict, "nlon", grid.nlon)) {
+        return false;
+    }
+    if (!(grid.dlat > 0.0) || !(grid.dlon > 0.0) || grid.nlat < 1 || grid.nlon < 1) {
+        PyErr_SetString(PyExc_ValueError, "grid spacing and size must be positive");
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Receptor-model accumulation
+// ---------------------------------------------------------------------------
+
+struct ReceptorSums {
+    std::vector<int64_t> n, m;   // endpoints, endpoints of high-concentration runs
+    std::vector<double> sum;     // concentration-weighted endpoints
+    int64_t outside = 0;         // endpoints off the grid
+
+    explicit ReceptorSums(size_t cells) : n(cells, 0), m(cells, 0), sum(cells, 0.0) {}
+};
+
+/**
+ * Grid the endpoints [0, n_points) with per-thread sums.
+ *
+ * run[p] indexes conc; runs whose concentration exceeds the threshold
+ * count towards m.
+ */
+static void accumulate(const Grid& grid, const double* lat, const double* lon,
+                       const int64_t* run, int64_t n_points, const double* conc,
+                       double threshold, ReceptorSums& total) {
+    const size_t cells = grid.cells();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        ReceptorSums local(cells);
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+        for (int64_t p = 0; p < n_points; p++) {
+            const int64_t c = grid.cell(lat[p], lon[p]);
+            if (c < 0) {
+                local.outside++;
+                continue;
+            }
+            const double value = conc[run[p]];
+            local.n[c]++;
+            local.m[c] += value > threshold;
+            local.sum[c] += value;
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (size_t c = 0; c < cells; c++) {
+                total.n[c] += local.n[c];
+                total.m[c] += local.m[c];
+                total.sum[c] += local.sum[c];
+            }
+            total.outside += local.outside;
+        }
+    }
+}
+
+/**
+ * Step weighting function of the endpoint count.
+ *
+ * A cell gets weights[k] for the first breakpoint k with n <= breakpoints[k]
+ * and the last weight above all of them; with relative breakpoints these
+ * are multiples of the mean count of the cells with endpoints.
+ */
+static std::vector<double> cell_weights(const std::vector<int64_t>& n, const double* breakpoints,
+                                        size_t n_breaks, const double* weights, bool relative) {
+    double scale = 1.0;
+    if (relative) {
+        int64_t total = 0, occupied = 0;
+        for (int64_t count : n) {
+            total += count;
+            occupied += count > 0;
+        }
+        scale = occupied ? static_cast<double>(total) / static_cast<double>(occupied) : 0.0;
+    }
+    std::vector<double> w(n.size(), 0.0);
+    for (size_t c = 0; c < n.size(); c++) {
+        if (n[c] == 0) continue;
+        const double count = static_cast<double>(n[c]);
+        size_t k = 0;
+        while (k < n_breaks && count > breakpoints[k] * scale) k++;
+        w[c] = weights[k];
+    }
+    return w;
+}
+
+/**
+ * PSCF/CWT sums of trajectory endpoints.
+ *
+ * Takes endpoint lat/lon, the run index of every endpoint, the
+ * concentration of every run, the grid and weighting options, and returns
+ * a dict of (nlat, nlon) grids.
+ */
+static PyObject* receptor_grid(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj, *run_obj, *conc_obj, *opt_dict;
+    if (!PyArg_ParseTuple(args, "OOOOO!", &lat_obj, &lon_obj, &run_obj, &conc_obj,
+                          &PyDict_Type, &opt_dict)) {
+        return NULL;
+    }
+
+    Array1D lat, lon, run, conc, breakpoints, weights;
+    if (!lat.load(lat_obj, NPY_DOUBLE, "lat") || !lon.load(lon_obj, NPY_DOUBLE, "lon") ||
+        !run.load(run_obj, NPY_INT64, "run") || !conc.load(conc_obj, NPY_DOUBLE, "concentrations")) {
+        return NULL;
+    }
+    PyObject* obj = PyDict_GetItemString(opt_dict, "breakpoints");
+    if (!breakpoints.load(obj ? obj : Py_None, NPY_DOUBLE, "breakpoints")) return NULL;
+    obj = PyDict_GetItemString(opt_dict, "weights");
+    if (!weights.load(obj ? obj : Py_None, NPY_DOUBLE, "weights")) return NULL;
+
+    Grid grid;
+    double threshold = 0.0;
+    long relative = 1;
+    if (!parse_grid(opt_dict, grid) || !dict_double(opt_dict, "threshold", threshold) ||
+        !dict_long(opt_dict, "relative", relative)) {
+        return NULL;
+    }
+
+    const npy_intp n_points = lat.size();
+    if (lon.size() != n_points || run.size() != n_points) {
+        PyErr_SetString(PyExc_ValueError, "lat, lon and run must have the same length");
+        return NULL;
+    }
+    if (weights.size() != breakpoints.size() + 1) {
+        PyErr_SetString(PyExc_ValueError, "weights needs one more entry than breakpoints");
+        return NULL;
+    }
+    const int64_t* runs = run.data<int64_t>();
+    const npy_intp n_runs = conc.size();
+    for (npy_intp p = 0; p < n_points; p++) {
+        if (runs[p] < 0 || runs[p] >= n_runs) {
+            PyErr_SetString(PyExc_ValueError, "run index out of range of the concentrations");
+            return NULL;
+        }
+    }
+
+    ReceptorSums sums(grid.cells());
+    std::vector<double> w;
+    Py_BEGIN_ALLOW_THREADS
+    accumulate(grid, lat.data<double>(), lon.data<double>(), runs, n_points, conc.data<double>(),
+               threshold, sums);
+    w = cell_weights(sums.n, breakpoints.data<double>(), breakpoints.size(),
+                     weights.data<double>(), relative != 0);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    if (set_item(result, "n", grid_array(sums.n, grid.nlat, grid.nlon, NPY_INT64)) < 0 ||
+        set_item(result, "m", grid_array(sums.m, grid.nlat, grid.nlon, NPY_INT64)) < 0 ||
+        set_item(result, "sum", grid_array(sums.sum, grid.nlat, grid.nlon, NPY_DOUBLE)) < 0 ||
+        set_item(result, "weight", grid_array(w, grid.nlat, grid.nlon, NPY_DOUBLE)) < 0 ||
+        set_item(result, "outside", PyLong_FromLongLong(sums.outside)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Residence time
+// ---------------------------------------------------------------------------
+
+/**
+ * Walk the segment from (lat_a, lon_a) to (lat_b, lon_b) across the grid
+ * lines (Amanatides-Woo DDA) and call visit(cell, t0, t1) for every piece,
+ * in order, with t the fraction along the segment and cell -1 off the grid.
+ * Longitudes go the short way round, so segments cross the date line.
+ */
+template <typename Visit>
+static void rasterize(const Grid& grid, double lat_a, double lon_a, double lat_b, double lon_b,
+                      Visit&& visit) {
+    double dlon_deg = lon_b - lon_a;
+    dlon_deg -= 360.0 * std::floor((dlon_deg + 180.0) / 360.0);
+    const double dlat_deg = lat_b - lat_a;
+    const double x0 = (lon_a - grid.lon0) / grid.dlon, y0 = (lat_a - grid.lat0) / grid.dlat;
+    const double dx = dlon_deg / grid.dlon, dy = dlat_deg / grid.dlat;
+
+    // Fraction along the segment of the next vertical / horizontal grid
+    // line, and between successive ones; anything past 1 means never
+    const double fx = std::floor(x0), fy = std::floor(y0);
+    double tx = 2.0, ty = 2.0, step_x = 2.0, step_y = 2.0;
+    if (dx != 0.0) {
+        tx = ((dx > 0.0 ? fx + 1.0 : fx) - x0) / dx;
+        step_x = 1.0 / std::fabs(dx);
+    }
+    if (dy != 0.0) {
+        ty = ((dy > 0.0 ? fy + 1.0 : fy) - y0) / dy;
+        step_y = 1.0 / std::fabs(dy);
+    }
+
+    double t = 0.0;
+    while (t < 1.0) {
+        const double next = std::min(std::min(tx, ty), 1.0);
+        if (next > t) {
+            // The midpoint lies inside a single cell
+            const double mid = 0.5 * (t + next);
+            visit(grid.cell(lat_a + dlat_deg * mid, lon_a + dlon_deg * mid), t, next);
+        }
+        t = next;
+        if (tx <= ty) {
+            tx += step_x;
+        } else {
+            ty += step_y;
+        }
+    }
+}
+
+struct ResidenceSums {
+    std::vector<double> hours;           // (bands, cells) time in cell
+    std::vector<int64_t> trajectories;   // (bands, cells) trajectories through the cell
+    double outside = 0.0;                // hours off the grid (within a band)
+
+    explicit ResidenceSums(size_t size) : hours(size, 0.0), trajectories(size, 0) {}
+};
+
+/**
+ * Residence time of the trajectories [0, n_traj); trajectory k has the
+ * points [offsets[k], offsets[k + 1]) in time order.
+ *
+ * With height band edges (ascending, n_edges >= 2) a piece counts in band b
+ * for the fraction of it with edges[b] <= height < edges[b + 1], heights
+ * interpolated linearly along the segment; without, every piece counts in
+ * the single band.
+ */
+static void accumulate_residence(const Grid& grid, const double* lat, const double* lon,
+                                 const double* height, const double* hour,
+                                 const int64_t* offsets, int64_t n_traj,
+                                 const double* edges, size_t n_edges, ResidenceSums& total) {
+    const size_t cells = grid.cells();
+    const size_t bands = n_edges >= 2 ? n_edges - 1 : 1;
+    const size_t size = bands * cells;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        ResidenceSums local(size);
+        // Last trajectory (+1) counted in each cell
+        std::vector<int64_t> seen(size, 0);
+        // Fraction of the current segment within each band
+        std::vector<double> band_lo(bands, 0.0), band_hi(bands, 1.0);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64) nowait
+#endif
+        for (int64_t k = 0; k < n_traj; k++) {
+            for (int64_t p = offsets[k]; p + 1 < offsets[k + 1]; p++) {
+                const double dt = std::fabs(hour[p + 1] - hour[p]);
+                if (!(dt > 0.0)) continue;
+                if (n_edges >= 2) {
+                    const double z0 = height[p], dz = height[p + 1] - height[p];
+                    for (size_t b = 0; b < bands; b++) {
+                        double lo = 0.0, hi = 0.0;
+                        if (dz == 0.0) {
+                            hi = edges[b] <= z0 && z0 < edges[b + 1] ? 1.0 : 0.0;
+                        } else {
+                            lo = (edges[b] - z0) / dz;
+                            hi = (edges[b + 1] - z0) / dz;
+                            if (lo > hi) std::swap(lo, hi);
+                        }
+                        band_lo[b] = std::max(lo, 0.0);
+                        band_hi[b] = std::min(hi, 1.0);
+                    }
+                }
+                rasterize(grid, lat[p], lon[p], lat[p + 1], lon[p + 1],
+                          [&](int64_t c, double t0, double t1) {
+                    for (size_t b = 0; b < bands; b++) {
+                        const double overlap = std::min(t1, band_hi[b]) - std::max(t0, band_lo[b]);
+                        if (!(overlap > 0.0)) continue;
+                        if (c < 0) {
+                            local.outside += dt * overlap;
+                            continue;
+                        }
+                        const size_t i = b * cells + static_cast<size_t>(c);
+                        local.hours[i] += dt * overlap;
+                        if (seen[i] != k + 1) {
+                            seen[i] = k + 1;
+                            local.trajectories[i]++;
+                        }
+                    }
+                });
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (size_t i = 0; i < size; i++) {
+                total.hours[i] += local.hours[i];
+                total.trajectories[i] += local.trajectories[i];
+            }
+            total.outside += local.outside;
+        }
+    }
+}
+
+/**
+ * Residence-time grids of trajectories.
+ *
+ * Takes point lat/lon/height/hour arrays grouped by trajectory and in time
+ * order within each, the trajectory offsets into them, the grid options
+ * and the height band edges, and returns a dict of (bands, nlat, nlon)
+ * grids.
+ */
+static PyObject* residence_grid(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj, *height_obj, *hour_obj, *offsets_obj, *opt_dict;
+    if (!PyArg_ParseTuple(args, "OOOOOO!", &lat_obj, &lon_obj, &height_obj, &hour_obj,
+                          &offsets_obj, &PyDict_Type, &opt_dict)) {
+        return NULL;
+    }
+
+    Array1D lat, lon, height, hour, offsets, edges;
+    if (!lat.load(lat_obj, NPY_DOUBLE, "lat") || !lon.load(lon_obj, NPY_DOUBLE, "lon") ||
+        !height.load(height_obj, NPY_DOUBLE, "height") || !hour.load(hour_obj, NPY_DOUBLE, "hour") ||
+        !offsets.load(offsets_obj, NPY_INT64, "offsets")) {
+        return NULL;
+    }
+    PyObject* obj = PyDict_GetItemString(opt_dict, "bands");
+    if (obj && obj != Py_None && !edges.load(obj, NPY_DOUBLE, "bands")) return NULL;
+
+    Grid grid;
+    if (!parse_grid(opt_dict, grid)) return NULL;
+
+    const npy_intp n_points = lat.size();
+    if (lon.size() != n_points || height.size() != n_points || hour.size() != n_points) {
+        PyErr_SetString(PyExc_ValueError, "lat, lon, height and hour must have the same length");
+        return NULL;
+    }
+    const int64_t* offs = offsets.data<int64_t>();
+    const npy_intp n_traj = offsets.size() - 1;
+    if (n_traj < 0 || offs[0] != 0 || offs[n_traj] != n_points) {
+        PyErr_SetString(PyExc_ValueError, "offsets must run from 0 to the number of points");
+        return NULL;
+    }
+    for (npy_intp k = 0; k < n_traj; k++) {
+        if (offs[k + 1] < offs[k]) {
+            PyErr_SetString(PyExc_ValueError, "offsets must be non-decreasing");
+            return NULL;
+        }
+    }
+    const npy_intp n_edges = edges.size();
+    const double* edge = edges.data<double>();
+    if (n_edges == 1) {
+        PyErr_SetString(PyExc_ValueError, "height bands need at least two edges");
+        return NULL;
+    }
+    for (npy_intp b = 0; b + 1 < n_edges; b++) {
+        if (!(edge[b + 1] > edge[b])) {
+            PyErr_SetString(PyExc_ValueError, "height band edges must be increasing");
+            return NULL;
+        }
+    }
+
+    const long bands = n_edges >= 2 ? static_cast<long>(n_edges - 1) : 1;
+    ResidenceSums sums(static_cast<size_t>(bands) * grid.cells());
+    Py_BEGIN_ALLOW_THREADS
+    accumulate_residence(grid, lat.data<double>(), lon.data<double>(), height.data<double>(),
+                         hour.data<double>(), offs, n_traj, edge, static_cast<size_t>(n_edges),
+                         sums);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    if (set_item(result, "hours", band_array(sums.hours, bands, grid.nlat, grid.nlon, NPY_DOUBLE)) < 0 ||
+        set_item(result, "trajectories",
+                 band_array(sums.trajectories, bands, grid.nlat, grid.nlon, NPY_INT64)) < 0 ||
+        set_item(result, "outside", PyFloat_FromDouble(sums.outside)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Method definitions
+static PyMethodDef GriddingMethods[] = {
+    {"receptor_grid", receptor_grid, METH_VARARGS,
+     "Grid trajectory endpoints for PSCF and CWT.\n\n"
+     "Args:\n"
+     "    lat, lon (numpy.ndarray): Endpoint positions\n"
+     "    run (numpy.ndarray): Index into concentrations of every endpoint\n"
+     "    concentrations (numpy.ndarray): Receptor concentration of every run\n"
+     "    options (dict): lat0, lon0, dlat, dlon, nlat, nlon, threshold,\n"
+     "        breakpoints, weights, relative\n\n"
+     "Returns:\n"
+     "    dict: (nlat, nlon) grids n, m, sum and weight, and the count of\n"
+     "          endpoints outside the grid"},
+
+    {"residence_grid", residence_grid, METH_VARARGS,
+     "Rasterize trajectory segments into residence-time grids.\n\n"
+     "Args:\n"
+     "    lat, lon, height, hour (numpy.ndarray): Points grouped by trajectory,\n"
+     "        in time order within each\n"
+     "    offsets (numpy.ndarray): Start of every trajectory, then the point count\n"
+     "    options (dict): lat0, lon0, dlat, dlon, nlat, nlon, and bands\n"
+     "        (ascending height band edges; omitted for a single band)\n\n"
+     "Returns:\n"
+     "    dict: (bands, nlat, nlon) grids hours and trajectories, and the\n"
+     "          hours spent outside the grid"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef griddingmodule = {
+    PyModuleDef_HEAD_INIT,
+    "_gridding",
+    "Gridding of trajectory ensembles for receptor models and residence time.",
+    -1,
+    GriddingMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__gridding(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&griddingmodule);
+}
@@ -0,0 +1,433 @@
+/**
+ * Sparse non-negative least squares for emission inversion.
+ *
+ * Solves
+ *
+ *     min_x  1/2 sum_i w_i (A x - b)_i^2 + lambda/2 sum_j p_j (x_j - x0_j)^2,  x >= 0
+ *
+ * for a CSR source-receptor matrix A with accelerated projected gradient
+ * (FISTA with adaptive restart). Only A and its transpose are stored, so
+ * memory grows with the non-zeros rather than rows x columns. Both products
+ * are row-parallel with OpenMP.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "py_args.h"
+
+// Power iterations used to bound the largest eigenvalue of A^T W A
+constexpr int POWER_ITERATIONS = 30;
+
+// Safety factor on the Lipschitz estimate
+constexpr double LIPSCHITZ_MARGIN = 1.05;
+
+// ---------------------------------------------------------------------------
+// Argument helpers
+// ---------------------------------------------------------------------------
+
+static bool optional_array(PyObject* dict, const char* key, Array1D& out) {
+    PyObject* obj = PyDict_GetItemString(dict, key);
+    if (obj == nullptr || obj == Py_None) return true;
+    return out.load(obj, NPY_DOUBLE, key);
+}
+
+// ---------------------------------------------------------------------------
+// Sparse matrix
+// ---------------------------------------------------------------------------
+
+struct CsrMatrix {
+    int64_t n_rows = 0, n_cols = 0;
+    std::vector<int64_t> indptr;
+    std::vector<int64_t> indices;
+    std::vector<double> data;
+
+    // y = A x
+    void multiply(const double* x, double* y) const {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1024)
+#endif
+        for (int64_t r = 0; r < n_rows; r++) {
+            double sum = 0.0;
+            for (int64_t e = indptr[r]; e < indptr[r + 1]; e++) sum += data[e] * x[indices[e]];
+            y[r] = sum;
+        }
+    }
+
+    // Transpose by counting sort on the column index
+    CsrMatrix transpose() const {
+        CsrMatrix t;
+        t.n_rows = n_cols;
+        t.n_cols = n_rows;
+        t.indptr.assign(n_cols + 1, 0);
+        for (int64_t c : indices) t.indptr[c + 1]++;
+        for (int64_t c = 0; c < n_cols; c++) t.indptr[c + 1] += t.indptr[c];
+        t.indices.resize(indices.size());
+        t.data.resize(data.size());
+        std::vector<int64_t> next(t.indptr.begin(), t.indptr.end() - 1);
+        for (int64_t r = 0; r < n_rows; r++) {
+            for (int64_t e = indptr[r]; e < indptr[r + 1]; e++) {
+                const int64_t slot = next[indices[e]]++;
+                t.indices[slot] = r;
+                t.data[slot] = data[e];
+            }
+        }
+        return t;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Solver
+// ---------------------------------------------------------------------------
+
+struct Problem {
+    const CsrMatrix* a;
+    const CsrMatrix* at;
+    const double* b;
+    const double* obs_weight;    // w_i, may be null (all ones)
+    const double* prior;         // x0_j, may be null (zero)
+    const double* prior_weight;  // p_j, may be null (all ones)
+    double lambda = 0.0;
+};
+
+struct SolverOptions {
+    long max_iter = 500;
+    double tol = 1e-6;        // relative projected-gradient norm
+    long check_every = 10;    // iterations between convergence checks
+};
+
+struct Solution {
+    std::vector<double> x;
+    long iterations = 0;
+    double objective = 0.0;
+    double residual_norm = 0.0;
+    double gradient_norm = 0.0;
+    double lipschitz = 0.0;
+    bool converged = false;
+};
+
+// Gradient at x; leaves the weighted residual W (A x - b) in resid and returns the objective
+static double gradient(const Problem& pb, const double* x, std::vector<double>& resid,
+                       std::vector<double>& grad) {
+    const CsrMatrix& a = *pb.a;
+    a.multiply(x, resid.data());
+    double misfit = 0.0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : misfit)
+#endif
+    for (int64_t r = 0; r < a.n_rows; r++) {
+        const double d = resid[r] - pb.b[r];
+        const double w = pb.obs_weight ? pb.obs_weight[r] : 1.0;
+        misfit += w * d * d;
+        resid[r] = w * d;
+    }
+    pb.at->multiply(resid.data(), grad.data());
+
+    double penalty = 0.0;
+    if (pb.lambda > 0.0) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : penalty)
+#endif
+        for (int64_t c = 0; c < a.n_cols; c++) {
+            const double d = x[c] - (pb.prior ? pb.prior[c] : 0.0);
+            const double p = pb.lambda * (pb.prior_weight ? pb.prior_weight[c] : 1.0);
+            penalty += p * d * d;
+            grad[c] += p * d;
+        }
+    }
+    return 0.5 * (misfit + penalty);
+}
+
+// Norm of the gradient projected onto the feasible directions at x
+static double projected_norm(const double* x, const std::vector<double>& grad) {
+    const int64_t n = static_cast<int64_t>(grad.size());
+    double sum = 0.0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : sum)
+#endif
+    for (int64_t c = 0; c < n; c++) {
+        const double g = x[c] > 0.0 ? grad[c] : std::min(grad[c], 0.0);
+        sum += g * g;
+    }
+    return std::sqrt(sum);
+}
+
+// Upper bound on the largest eigenvalue of A^T W A + lambda P by power iteration
+static double lipschitz_bound(const Problem& pb) {
+    const CsrMatrix& a = *pb.a;
+    std::vector<double> v(a.n_cols, 1.0 / std::sqrt(static_cast<double>(std::max<int64_t>(1, a.n_cols))));
+    std::vector<double> av(a.n_rows), atav(a.n_cols);
+    double eigen = 0.0;
+    for (int it = 0; it < POWER_ITERATIONS; it++) {
+        a.multiply(v.data(), av.data());
+        if (pb.obs_weight) {
+            for (int64_t r = 0; r < a.n_rows; r++) av[r] *= pb.obs_weight[r];
+        }
+        pb.at->multiply(av.data(), atav.data());
+        double norm = 0.0;
+        for (double value : atav) norm += value * value;
+        norm = std::sqrt(norm);
+        if (norm == 0.0) break;
+        eigen = norm;
+        for (int64_t c = 0; c < a.n_cols; c++) v[c] = atav[c] / norm;
+    }
+    double max_prior = 0.0;
+    if (pb.lambda > 0.0) {
+        max_prior = 1.0;
+        if (pb.prior_weight) {
+            max_prior = *std::max_element(pb.prior_weight, pb.prior_weight + a.n_cols);
+        }
+    }
+    return LIPSCHITZ_MARGIN * eigen + pb.lambda * max_prior;
+}
+
+/**
+ * FISTA with function-value restart.
+ *
+ * Each iteration costs one product with A and one with A^T. Convergence is
+ * checked every check_every iterations on the projected gradient at the
+ * current iterate, relative to its value at the start.
+ */
+static void solve(const Problem& pb, const SolverOptions& opt, Solution& sol) {
+    const int64_t n = pb.a->n_cols;
+    std::vector<double>& x = sol.x;
+    std::vector<double> x_prev(x), y(x), grad(n), resid(pb.a->n_rows);
+
+    const double lipschitz = lipschitz_bound(pb);
+    sol.lipschitz = lipschitz;
+    if (lipschitz <= 0.0) {
+        sol.objective = gradient(pb, x.data(), resid, grad);
+        sol.converged = true;
+        return;
+    }
+    const double step = 1.0 / lipschitz;
+
+    double f_prev = gradient(pb, x.data(), resid, grad);
+    const double g0 = std::max(projected_norm(x.data(), grad), 1e-300);
+    double t = 1.0;
+
+    for (long it = 1; it <= opt.max_iter; it++) {
+        // Projected gradient step from the extrapolated point y
+        gradient(pb, y.data(), resid, grad);
+        x_prev.swap(x);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int64_t c = 0; c < n; c++) x[c] = std::max(0.0, y[c] - step * grad[c]);
+
+        const bool check = it % opt.check_every == 0 || it == opt.max_iter;
+        double f = 0.0;
+        if (check) {
+            f = gradient(pb, x.data(), resid, grad);
+            sol.gradient_norm = projected_norm(x.data(), grad);
+            sol.iterations = it;
+            if (sol.gradient_norm <= opt.tol * g0) {
+                sol.converged = true;
+                break;
+            }
+        }
+
+        // Restart the momentum when it points against the last step
+        double dot = 0.0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : dot)
+#endif
+        for (int64_t c = 0; c < n; c++) dot += (y[c] - x[c]) * (x[c] - x_prev[c]);
+        if (dot > 0.0 || (check && f > f_prev)) t = 1.0;
+        if (check) f_prev = f;
+
+        const double t_next = 0.5 * (1.0 + std::sqrt(1.0 + 4.0 * t * t));
+        const double beta = (t - 1.0) / t_next;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int64_t c = 0; c < n; c++) y[c] = x[c] + beta * (x[c] - x_prev[c]);
+        t = t_next;
+        sol.iterations = it;
+    }
+
+    sol.objective = gradient(pb, x.data(), resid, grad);
+    sol.gradient_norm = projected_norm(x.data(), grad);
+    double rss = 0.0;
+    pb.a->multiply(x.data(), resid.data());
+    for (int64_t r = 0; r < pb.a->n_rows; r++) {
+        const double d = resid[r] - pb.b[r];
+        rss += d * d;
+    }
+    sol.residual_norm = std::sqrt(rss);
+}
+
+// ---------------------------------------------------------------------------
+// Python interface
+// ---------------------------------------------------------------------------
+
+/**
+ * Solve a sparse non-negative least-squares problem.
+ *
+ * Takes the CSR arrays of A, its number of columns, the observations and
+ * an options dict, and returns a dict with the solution and diagnostics.
+ */
+static PyObject* solve_nnls(PyObject* self, PyObject* args) {
+    PyObject *indptr_obj, *indices_obj, *data_obj, *b_obj, *opt_dict;
+    long long n_cols = 0;
+    if (!PyArg_ParseTuple(args, "OOOLOO!", &indptr_obj, &indices_obj, &data_obj, &n_cols, &b_obj,
+                          &PyDict_Type, &opt_dict)) {
+        return NULL;
+    }
+
+    Array1D indptr, indices, values, b, obs_weight, prior, prior_weight, x0;
+    if (!indptr.load(indptr_obj, NPY_INT64, "indptr") ||
+        !indices.load(indices_obj, NPY_INT64, "indices") ||
+        !values.load(data_obj, NPY_DOUBLE, "data") || !b.load(b_obj, NPY_DOUBLE, "observations") ||
+        !optional_array(opt_dict, "observation_weights", obs_weight) ||
+        !optional_array(opt_dict, "prior", prior) ||
+        !optional_array(opt_dict, "prior_weights", prior_weight) ||
+        !optional_array(opt_dict, "x0", x0)) {
+        return NULL;
+    }
+
+    Problem pb;
+    SolverOptions opt;
+    if (!dict_double(opt_dict, "regularization", pb.lambda) ||
+        !dict_long(opt_dict, "max_iter", opt.max_iter) || !dict_double(opt_dict, "tol", opt.tol) ||
+        !dict_long(opt_dict, "check_every", opt.check_every)) {
+        return NULL;
+    }
+
+    const npy_intp n_rows = indptr.size() - 1;
+    if (n_rows < 0 || n_cols < 0 || values.size() != indices.size() || b.size() != n_rows) {
+        PyErr_SetString(PyExc_ValueError, "inconsistent CSR arrays or observation length");
+        return NULL;
+    }
+    if ((!obs_weight.empty() && obs_weight.size() != n_rows) ||
+        (!prior.empty() && prior.size() != n_cols) ||
+        (!prior_weight.empty() && prior_weight.size() != n_cols) ||
+        (!x0.empty() && x0.size() != n_cols)) {
+        PyErr_SetString(PyExc_ValueError, "weight, prior and x0 arrays must match the matrix shape");
+        return NULL;
+    }
+    if (pb.lambda < 0.0 || opt.max_iter < 0 || opt.check_every < 1) {
+        PyErr_SetString(PyExc_ValueError, "regularization, max_iter and check_every must be non-negative");
+        return NULL;
+    }
+
+    CsrMatrix a;
+    a.n_rows = n_rows;
+    a.n_cols = n_cols;
+    const int64_t* ip = indptr.data<int64_t>();
+    const int64_t* ix = indices.data<int64_t>();
+    const int64_t nnz = static_cast<int64_t>(values.size());
+    if (ip[0] != 0 || ip[n_rows] != nnz) {
+        PyErr_SetString(PyExc_ValueError, "indptr does not match the number of entries");
+        return NULL;
+    }
+    for (npy_intp r = 0; r < n_rows; r++) {
+        if (ip[r + 1] < ip[r]) {
+            PyErr_SetString(PyExc_ValueError, "indptr must be non-decreasing");
+            return NULL;
+        }
+    }
+    for (int64_t e = 0; e < nnz; e++) {
+        if (ix[e] < 0 || ix[e] >= n_cols) {
+            PyErr_SetString(PyExc_ValueError, "column index out of range");
+            return NULL;
+        }
+    }
+
+    Solution sol;
+    Py_BEGIN_ALLOW_THREADS
+    a.indptr.assign(ip, ip + n_rows + 1);
+    a.indices.assign(ix, ix + nnz);
+    a.data.assign(values.data<double>(), values.data<double>() + nnz);
+    const CsrMatrix at = a.transpose();
+
+    pb.a = &a;
+    pb.at = &at;
+    pb.b = b.data<double>();
+    pb.obs_weight = obs_weight.data<double>();
+    pb.prior = prior.data<double>();
+    pb.prior_weight = prior_weight.data<double>();
+
+    if (!x0.empty()) {
+        sol.x.assign(x0.data<double>(), x0.data<double>() + n_cols);
+        for (double& v : sol.x) v = std::max(v, 0.0);
+    } else if (pb.prior) {
+        sol.x.assign(pb.prior, pb.prior + n_cols);
+        for (double& v : sol.x) v = std::max(v, 0.0);
+    } else {
+        sol.x.assign(n_cols, 0.0);
+    }
+    solve(pb, opt, sol);
+    Py_END_ALLOW_THREADS
+
+    npy_intp dims[1] = {static_cast<npy_intp>(n_cols)};
+    PyObject* x = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    if (!x) return NULL;
+    if (n_cols > 0) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(x)), sol.x.data(),
+                    n_cols * sizeof(double));
+    }
+
+    PyObject* result = PyDict_New();
+    if (!result) {
+        Py_DECREF(x);
+        return NULL;
+    }
+    if (set_item(result, "x", x) < 0 ||
+        set_item(result, "iterations", PyLong_FromLong(sol.iterations)) < 0 ||
+        set_item(result, "objective", PyFloat_FromDouble(sol.objective)) < 0 ||
+        set_item(result, "residual_norm", PyFloat_FromDouble(sol.residual_norm)) < 0 ||
+        set_item(result, "gradient_norm", PyFloat_FromDouble(sol.gradient_norm)) < 0 ||
+        set_item(result, "lipschitz", PyFloat_FromDouble(sol.lipschitz)) < 0 ||
+        set_item(result, "converged", PyBool_FromLong(sol.converged)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Method definitions
+static PyMethodDef InverseMethods[] = {
+    {"solve_nnls", solve_nnls, METH_VARARGS,
+     "Solve min 1/2 ||W^(1/2) (A x - b)||^2 + lambda/2 ||P^(1/2) (x - x0)||^2, x >= 0.\n\n"
+     "Args:\n"
+     "    indptr, indices, data: CSR arrays of A\n"
+     "    n_cols (int): Number of columns of A\n"
+     "    observations (numpy.ndarray): Right-hand side b\n"
+     "    options (dict): regularization, prior, prior_weights, observation_weights,\n"
+     "        x0, max_iter, tol, check_every\n\n"
+     "Returns:\n"
+     "    dict: Solution x and solver diagnostics"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef inversemodule = {
+    PyModuleDef_HEAD_INIT,
+    "_inverse",
+    "Sparse non-negative least squares for emission inversion.",
+    -1,
+    InverseMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__inverse(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&inversemodule);
+}
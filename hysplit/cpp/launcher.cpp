@@ -0,0 +1,737 @@
+/**
+ * Native process launcher for the HYSPLIT binaries.
+ *
+ * Starts a program with posix_spawn in a given working directory, captures
+ * its stdout and stderr through pipes and waits for it, all without holding
+ * the GIL, so thread pools can keep many model runs in flight.
+ *
+ * A run can be bounded by a timeout and by a cancellation flag (a byte in a
+ * buffer shared with other processes, e.g. an mmap); the child is killed
+ * with SIGKILL when either fires.
+ *
+ * On Linux, a reactor runs many children from one thread: it spawns them
+ * without waiting, and an epoll set watches their pipes and pidfds. Its
+ * epoll descriptor is readable whenever a child has output or has exited,
+ * so an event loop (asyncio's add_reader) can call reactor_poll() to drain
+ * pipes and reap children as they finish, with no thread per child.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#define HAVE_REACTOR 1
+#endif
+
+extern char** environ;
+
+// posix_spawn_file_actions_addchdir_np: glibc 2.29+, macOS 10.15+
+#if (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))) || \
+    defined(__APPLE__)
+#define HAVE_SPAWN_CHDIR 1
+#endif
+
+struct SpawnResult {
+    int status = 0;
+    std::string out, err;
+    double elapsed = 0.0;
+    double spawn_elapsed = 0.0;  // until the child was started
+    bool timed_out = false;
+    bool cancelled = false;
+    std::string error;  // set when the program could not be started
+};
+
+// Limits of a run; checked while its output is drained and while waiting
+struct RunLimits {
+    double timeout = -1.0;                        // seconds, <= 0 for none
+    const volatile unsigned char* cancel = nullptr;  // non-zero byte cancels
+};
+
+// Interval between checks of the cancellation flag
+static const int CANCEL_POLL_MS = 20;
+// Time allowed to drain the pipes after a kill (grandchildren may hold them)
+static const double KILL_DRAIN_SECONDS = 1.0;
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Kill the child if a limit fired; returns true once the child was killed
+static bool enforce_limits(pid_t pid, const RunLimits& limits, Clock::time_point t0,
+                           SpawnResult& res) {
+    if (res.timed_out || res.cancelled) return true;
+    if (limits.timeout > 0.0 && seconds_since(t0) >= limits.timeout) {
+        res.timed_out = true;
+    } else if (limits.cancel && *limits.cancel) {
+        res.cancelled = true;
+    } else {
+        return false;
+    }
+    kill(pid, SIGKILL);
+    return true;
+}
+
+// poll() timeout until the next limit check (-1: none needed)
+static int next_check_ms(const RunLimits& limits, Clock::time_point t0) {
+    int wait_ms = -1;
+    if (limits.timeout > 0.0) {
+        const double left = limits.timeout - seconds_since(t0);
+        wait_ms = left <= 0.0 ? 0 : static_cast<int>(std::min(left * 1000.0 + 1.0, 3600e3));
+    }
+    if (limits.cancel) wait_ms = wait_ms < 0 ? CANCEL_POLL_MS : std::min(wait_ms, CANCEL_POLL_MS);
+    return wait_ms;
+}
+
+static bool make_pipe(int fds[2]) {
+    if (pipe(fds) < 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+#ifndef HAVE_SPAWN_CHDIR
+// Fallback for C libraries without the chdir file action
+static pid_t fork_exec(const std::vector<char*>& argv, const char* cwd, int out_fd, int err_fd,
+                       int null_fd) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(null_fd, STDIN_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+        dup2(err_fd, STDERR_FILENO);
+        if (cwd && chdir(cwd) < 0) _exit(127);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+#endif
+
+// Start argv[0] in cwd with stdout and stderr on new pipes, whose read ends
+// are returned in out_fd / err_fd; returns the pid, or -1 with error set
+static pid_t start_child(const std::vector<std::string>& args, const char* cwd, int& out_fd,
+                         int& err_fd, std::string& error) {
+    std::vector<char*> argv;
+    for (const auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+
+    int out_pipe[2], err_pipe[2];
+    out_fd = err_fd = -1;
+    if (!make_pipe(out_pipe)) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    if (!make_pipe(err_pipe)) {
+        error = std::strerror(errno);
+        close(out_pipe[0]); close(out_pipe[1]);
+        return -1;
+    }
+    const int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    pid_t pid = -1;
+#ifdef HAVE_SPAWN_CHDIR
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (null_fd >= 0) posix_spawn_file_actions_adddup2(&actions, null_fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+    if (cwd) posix_spawn_file_actions_addchdir_np(&actions, cwd);
+    const int rc = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) {
+        error = std::strerror(rc);
+        pid = -1;
+    }
+#else
+    pid = fork_exec(argv, cwd, out_pipe[1], err_pipe[1], null_fd);
+    if (pid < 0) error = std::strerror(errno);
+#endif
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if (null_fd >= 0) close(null_fd);
+    if (pid < 0) {
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return -1;
+    }
+    out_fd = out_pipe[0];
+    err_fd = err_pipe[0];
+    return pid;
+}
+
+#ifndef HAVE_SPAWN_CHDIR
+// exec failures of the fork fallback surface as exit code 127
+static void check_exec_failure(SpawnResult& res) {
+    if (WIFEXITED(res.status) && WEXITSTATUS(res.status) == 127 && res.out.empty() &&
+        res.err.empty()) {
+        res.error = "could not execute program";
+    }
+}
+#endif
+
+// Run argv[0] in cwd and collect its output; the program path is used as given
+static void spawn_and_wait(const std::vector<std::string>& args, const char* cwd,
+                           const RunLimits& limits, SpawnResult& res) {
+    const auto t0 = Clock::now();
+    int out_fd, err_fd;
+    const pid_t pid = start_child(args, cwd, out_fd, err_fd, res.error);
+    res.spawn_elapsed = seconds_since(t0);
+    if (pid < 0) return;
+
+    // Drain both pipes until the child closes them
+    pollfd fds[2] = {{out_fd, POLLIN, 0}, {err_fd, POLLIN, 0}};
+    std::string* sinks[2] = {&res.out, &res.err};
+    int open_pipes = 2;
+    char buffer[65536];
+    Clock::time_point killed_at;
+    bool killed = false;
+    while (open_pipes > 0) {
+        int wait_ms = -1;
+        if (!killed && enforce_limits(pid, limits, t0, res)) {
+            killed = true;
+            killed_at = Clock::now();
+        }
+        if (killed) {
+            const double left = KILL_DRAIN_SECONDS - seconds_since(killed_at);
+            if (left <= 0.0) break;
+            wait_ms = static_cast<int>(left * 1000.0) + 1;
+        } else {
+            wait_ms = next_check_ms(limits, t0);
+        }
+        const int ready = poll(fds, 2, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].fd < 0 || !fds[i].revents) continue;
+            const ssize_t got = read(fds[i].fd, buffer, sizeof(buffer));
+            if (got > 0) {
+                sinks[i]->append(buffer, static_cast<size_t>(got));
+            } else if (got == 0 || errno != EINTR) {
+                fds[i].fd = -1;
+                open_pipes--;
+            }
+        }
+    }
+    close(out_fd);
+    close(err_fd);
+
+    // A child can close its output and keep running, so limits still apply
+    if (!killed && (limits.timeout > 0.0 || limits.cancel)) {
+        while (true) {
+            const pid_t done = waitpid(pid, &res.status, WNOHANG);
+            if (done == pid || (done < 0 && errno != EINTR)) break;
+            if (enforce_limits(pid, limits, t0, res)) {
+                killed = true;
+                break;
+            }
+            const int wait_ms = next_check_ms(limits, t0);
+            poll(nullptr, 0, std::min(wait_ms < 0 ? CANCEL_POLL_MS : wait_ms, CANCEL_POLL_MS));
+        }
+        if (killed) {
+            while (waitpid(pid, &res.status, 0) < 0 && errno == EINTR) {
+            }
+        }
+    } else {
+        while (waitpid(pid, &res.status, 0) < 0 && errno == EINTR) {
+        }
+    }
+#ifndef HAVE_SPAWN_CHDIR
+    check_exec_failure(res);
+#endif
+    res.elapsed = seconds_since(t0);
+}
+
+#ifdef HAVE_REACTOR
+// ---------------------------------------------------------------------------
+// Reactor
+// ---------------------------------------------------------------------------
+
+// A child of the reactor and the output collected so far
+struct Job {
+    pid_t pid = -1;
+    int pidfd = -1;
+    int fds[2] = {-1, -1};  // stdout, stderr read ends
+    bool exited = false;
+    bool killed = false;
+    Clock::time_point t0;
+    SpawnResult res;
+};
+
+struct Reactor {
+    int epfd = -1;
+    uint64_t next_id = 1;
+    std::unordered_map<uint64_t, Job> jobs;
+};
+
+// epoll data: job id shifted left by two, the source in the low bits
+enum : uint64_t { SRC_STDOUT = 0, SRC_STDERR = 1, SRC_EXIT = 2 };
+
+static const char* kReactorName = "hysplit.launcher.Reactor";
+
+static void unwatch(Reactor& r, int& fd) {
+    if (fd < 0) return;
+    epoll_ctl(r.epfd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    fd = -1;
+}
+
+static bool watch(Reactor& r, int fd, uint64_t id, uint64_t source) {
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = id << 2 | source;
+    return epoll_ctl(r.epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+// Read what a pipe holds; closes it at end of file
+static void drain(Reactor& r, Job& job, int source) {
+    char buffer[65536];
+    std::string& sink = source == SRC_STDOUT ? job.res.out : job.res.err;
+    while (job.fds[source] >= 0) {
+        const ssize_t got = read(job.fds[source], buffer, sizeof(buffer));
+        if (got > 0) {
+            sink.append(buffer, static_cast<size_t>(got));
+        } else if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            unwatch(r, job.fds[source]);
+        }
+    }
+}
+
+static void reap(Reactor& r, Job& job, int options) {
+    const pid_t done = waitpid(job.pid, &job.res.status, options);
+    if (done == job.pid || (done < 0 && errno == ECHILD)) {
+        job.exited = true;
+        unwatch(r, job.pidfd);
+    }
+}
+
+// A job is done once its child exited and its pipes are closed; a killed
+// job does not wait for grandchildren holding the pipes
+static bool finished(const Job& job) {
+    return job.exited && (job.killed || (job.fds[0] < 0 && job.fds[1] < 0));
+}
+
+static void close_reactor(Reactor& r) {
+    for (auto& entry : r.jobs) {
+        Job& job = entry.second;
+        if (!job.exited) {
+            kill(job.pid, SIGKILL);
+            while (waitpid(job.pid, &job.res.status, 0) < 0 && errno == EINTR) {
+            }
+        }
+        for (int& fd : job.fds) unwatch(r, fd);
+        unwatch(r, job.pidfd);
+    }
+    r.jobs.clear();
+    if (r.epfd >= 0) close(r.epfd);
+    r.epfd = -1;
+}
+
+static Reactor* get_reactor(PyObject* capsule) {
+    auto* r = static_cast<Reactor*>(PyCapsule_GetPointer(capsule, kReactorName));
+    if (r && r->epfd < 0) {
+        PyErr_SetString(PyExc_ValueError, "reactor is closed");
+        return nullptr;
+    }
+    return r;
+}
+
+static void free_reactor(PyObject* capsule) {
+    auto* r = static_cast<Reactor*>(PyCapsule_GetPointer(capsule, kReactorName));
+    if (!r) return;
+    close_reactor(*r);
+    delete r;
+}
+#endif  // HAVE_REACTOR
+
+#endif  // _WIN32
+
+#ifndef _WIN32
+// Program path and arguments of a Python sequence, encoded for the OS
+static bool parse_argv(PyObject* argv_obj, std::vector<std::string>& argv) {
+    PyObject* seq = PySequence_Fast(argv_obj, "argv must be a sequence of strings");
+    if (!seq) return false;
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject* item = PyOS_FSPath(PySequence_Fast_GET_ITEM(seq, i));
+        PyObject* encoded = item ? PyUnicode_EncodeFSDefault(item) : NULL;
+        Py_XDECREF(item);
+        if (!encoded) {
+            Py_DECREF(seq);
+            return false;
+        }
+        argv.emplace_back(PyBytes_AS_STRING(encoded), PyBytes_GET_SIZE(encoded));
+        Py_DECREF(encoded);
+    }
+    Py_DECREF(seq);
+    if (argv.empty()) {
+        PyErr_SetString(PyExc_ValueError, "argv must not be empty");
+        return false;
+    }
+    return true;
+}
+
+static PyObject* result_dict(const SpawnResult& res) {
+    const long returncode = WIFSIGNALED(res.status) ? -WTERMSIG(res.status)
+                                                     : WEXITSTATUS(res.status);
+    return Py_BuildValue("{s:l,s:y#,s:y#,s:d,s:d,s:O,s:O}", "returncode", returncode,
+                         "stdout", res.out.data(), static_cast<Py_ssize_t>(res.out.size()),
+                         "stderr", res.err.data(), static_cast<Py_ssize_t>(res.err.size()),
+                         "elapsed", res.elapsed, "spawn_elapsed", res.spawn_elapsed,
+                         "timed_out", res.timed_out ? Py_True : Py_False,
+                         "cancelled", res.cancelled ? Py_True : Py_False);
+}
+#endif
+
+/**
+ * Spawn a program and wait for it.
+ *
+ * Returns a dict with returncode (negative signal number if the child was
+ * killed, as in subprocess), stdout and stderr bytes, elapsed seconds and
+ * whether the timeout or the cancellation flag killed the child.
+ */
+static PyObject* spawn(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = {"argv", "cwd", "timeout", "cancel", "cancel_index", NULL};
+    PyObject* argv_obj;
+    const char* cwd = nullptr;
+    double timeout = -1.0;
+    PyObject* cancel_obj = Py_None;
+    Py_ssize_t cancel_index = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|zdOn", const_cast<char**>(kwlist),
+                                     &argv_obj, &cwd, &timeout, &cancel_obj, &cancel_index)) {
+        return NULL;
+    }
+
+#ifdef _WIN32
+    PyErr_SetString(PyExc_NotImplementedError, "the native launcher needs posix_spawn");
+    return NULL;
+#else
+    std::vector<std::string> argv;
+    if (!parse_argv(argv_obj, argv)) return NULL;
+
+    // The flag buffer stays exported (and so alive) until the run is over
+    RunLimits limits;
+    limits.timeout = timeout;
+    Py_buffer cancel_view = {};
+    if (cancel_obj != Py_None) {
+        if (PyObject_GetBuffer(cancel_obj, &cancel_view, PyBUF_SIMPLE) < 0) return NULL;
+        if (cancel_index < 0 || cancel_index >= cancel_view.len) {
+            PyBuffer_Release(&cancel_view);
+            PyErr_SetString(PyExc_IndexError, "cancel_index out of range");
+            return NULL;
+        }
+        limits.cancel = static_cast<const volatile unsigned char*>(cancel_view.buf) + cancel_index;
+    }
+
+    SpawnResult res;
+    Py_BEGIN_ALLOW_THREADS
+    spawn_and_wait(argv, cwd, limits, res);
+    Py_END_ALLOW_THREADS
+    if (cancel_obj != Py_None) PyBuffer_Release(&cancel_view);
+
+    if (!res.error.empty()) {
+        PyErr_Format(PyExc_OSError, "Cannot run '%s': %s", argv[0].c_str(), res.error.c_str());
+        return NULL;
+    }
+    return result_dict(res);
+#endif
+}
+
+/**
+ * Create a reactor (Linux).
+ */
+static PyObject* reactor(PyObject* self, PyObject* args) {
+#ifndef HAVE_REACTOR
+    PyErr_SetString(PyExc_NotImplementedError, "the reactor needs epoll and pidfd_open (Linux)");
+    return NULL;
+#else
+    // pidfd_open needs Linux 5.3
+    const int probe = static_cast<int>(syscall(SYS_pidfd_open, getpid(), 0));
+    if (probe < 0) {
+        PyErr_SetFromErrno(errno == ENOSYS ? PyExc_NotImplementedError : PyExc_OSError);
+        return NULL;
+    }
+    close(probe);
+    auto* r = new Reactor();
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epfd < 0) {
+        delete r;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    PyObject* capsule = PyCapsule_New(r, kReactorName, free_reactor);
+    if (!capsule) {
+        close_reactor(*r);
+        delete r;
+    }
+    return capsule;
+#endif
+}
+
+#ifdef HAVE_REACTOR
+/**
+ * Epoll descriptor of a reactor; readable when reactor_poll() has work.
+ */
+static PyObject* reactor_fileno(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
+    Reactor* r = get_reactor(capsule);
+    if (!r) return NULL;
+    return PyLong_FromLong(r->epfd);
+}
+
+/**
+ * Start a program under a reactor without waiting for it.
+ */
+static PyObject* reactor_spawn(PyObject* self, PyObject* args) {
+    PyObject *capsule, *argv_obj;
+    const char* cwd = nullptr;
+    if (!PyArg_ParseTuple(args, "OO|z", &capsule, &argv_obj, &cwd)) return NULL;
+    Reactor* r = get_reactor(capsule);
+    if (!r) return NULL;
+    std::vector<std::string> argv;
+    if (!parse_argv(argv_obj, argv)) return NULL;
+
+    Job job;
+    job.t0 = Clock::now();
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    job.pid = start_child(argv, cwd, job.fds[0], job.fds[1], error);
+    Py_END_ALLOW_THREADS
+    job.res.spawn_elapsed = seconds_since(job.t0);
+    if (job.pid < 0) {
+        PyErr_Format(PyExc_OSError, "Cannot run '%s': %s", argv[0].c_str(), error.c_str());
+        return NULL;
+    }
+
+    // A child that already exited still has a pidfd until it is reaped
+    const uint64_t id = r->next_id++;
+    job.pidfd = static_cast<int>(syscall(SYS_pidfd_open, job.pid, 0));
+    bool ok = job.pidfd >= 0;
+    for (int source = 0; ok && source < 2; source++) {
+        fcntl(job.fds[source], F_SETFL, fcntl(job.fds[source], F_GETFL) | O_NONBLOCK);
+        ok = watch(*r, job.fds[source], id, source);
+    }
+    ok = ok && watch(*r, job.pidfd, id, SRC_EXIT);
+    if (!ok) {
+        const int saved = errno;
+        kill(job.pid, SIGKILL);
+        while (waitpid(job.pid, &job.res.status, 0) < 0 && errno == EINTR) {
+        }
+        for (int& fd : job.fds) unwatch(*r, fd);
+        unwatch(*r, job.pidfd);
+        errno = saved;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    r->jobs.emplace(id, std::move(job));
+    return PyLong_FromUnsignedLongLong(id);
+}
+
+/**
+ * Drain ready pipes and reap exited children without blocking.
+ */
+static PyObject* reactor_poll(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
+    Reactor* r = get_reactor(capsule);
+    if (!r) return NULL;
+
+    std::vector<uint64_t> touched;
+    epoll_event events[64];
+    int n;
+    do {
+        n = epoll_wait(r->epfd, events, 64, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+        for (int i = 0; i < n; i++) {
+            const uint64_t id = events[i].data.u64 >> 2;
+            const uint64_t source = events[i].data.u64 & 3;
+            auto it = r->jobs.find(id);
+            if (it == r->jobs.end()) continue;
+            if (source == SRC_EXIT) {
+                reap(*r, it->second, WNOHANG);
+            } else {
+                drain(*r, it->second, static_cast<int>(source));
+            }
+            touched.push_back(id);
+        }
+    } while (n == 64);
+
+    PyObject* done = PyList_New(0);
+    if (!done) return NULL;
+    for (uint64_t id : touched) {
+        auto it = r->jobs.find(id);
+        if (it == r->jobs.end() || !finished(it->second)) continue;
+        Job& job = it->second;
+        // Output still buffered in the pipes of a killed job is kept
+        for (int source = 0; source < 2; source++) {
+            drain(*r, job, source);
+            unwatch(*r, job.fds[source]);
+        }
+        job.res.cancelled = job.killed;
+        job.res.elapsed = seconds_since(job.t0);
+#ifndef HAVE_SPAWN_CHDIR
+        check_exec_failure(job.res);
+#endif
+        PyObject* entry = Py_BuildValue("(KN)", static_cast<unsigned long long>(id),
+                                        result_dict(job.res));
+        r->jobs.erase(it);
+        if (!entry || PyList_Append(done, entry) < 0) {
+            Py_XDECREF(entry);
+            Py_DECREF(done);
+            return NULL;
+        }
+        Py_DECREF(entry);
+    }
+    return done;
+}
+
+/**
+ * Kill a running child of a reactor with SIGKILL.
+ */
+static PyObject* reactor_kill(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    unsigned long long id;
+    if (!PyArg_ParseTuple(args, "OK", &capsule, &id)) return NULL;
+    Reactor* r = get_reactor(capsule);
+    if (!r) return NULL;
+    auto it = r->jobs.find(id);
+    if (it == r->jobs.end() || it->second.exited) Py_RETURN_FALSE;
+    kill(it->second.pid, SIGKILL);
+    it->second.killed = true;
+    Py_RETURN_TRUE;
+}
+
+/**
+ * Number of children of a reactor not yet returned by reactor_poll().
+ */
+static PyObject* reactor_len(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
+    Reactor* r = get_reactor(capsule);
+    if (!r) return NULL;
+    return PyLong_FromSize_t(r->jobs.size());
+}
+
+/**
+ * Kill and reap all children of a reactor and close it.
+ */
+static PyObject* reactor_close(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
+    auto* r = static_cast<Reactor*>(PyCapsule_GetPointer(capsule, kReactorName));
+    if (!r) return NULL;
+    close_reactor(*r);
+    Py_RETURN_NONE;
+}
+#endif  // HAVE_REACTOR
+
+// Method definitions
+static PyMethodDef LauncherMethods[] = {
+    {"spawn", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(spawn)),
+     METH_VARARGS | METH_KEYWORDS,
+     "Run a program with posix_spawn and capture its output.\n\n"
+     "Args:\n"
+     "    argv (list): Program path and arguments\n"
+     "    cwd (str, optional): Working directory of the child\n"
+     "    timeout (float, optional): Seconds before the child is killed\n"
+     "    cancel (buffer, optional): Shared flags; the child is killed when\n"
+     "        the byte at cancel_index becomes non-zero\n"
+     "    cancel_index (int, optional): Offset of the flag in cancel\n\n"
+     "Returns:\n"
+     "    dict: returncode, stdout, stderr (bytes), elapsed seconds,\n"
+     "    spawn_elapsed (seconds until the child was started), timed_out\n"
+     "    and cancelled"},
+
+    {"reactor", reactor, METH_NOARGS,
+     "Create a reactor that runs children from one thread (Linux).\n\n"
+     "Returns:\n"
+     "    capsule: Reactor, closed when garbage collected"},
+
+#ifdef HAVE_REACTOR
+    {"reactor_fileno", reactor_fileno, METH_VARARGS,
+     "Epoll descriptor of a reactor.\n\n"
+     "Args:\n"
+     "    reactor: Reactor capsule\n\n"
+     "Returns:\n"
+     "    int: Descriptor that is readable when reactor_poll() has work"},
+
+    {"reactor_spawn", reactor_spawn, METH_VARARGS,
+     "Start a program under a reactor without waiting for it.\n\n"
+     "Args:\n"
+     "    reactor: Reactor capsule\n"
+     "    argv (list): Program path and arguments\n"
+     "    cwd (str, optional): Working directory of the child\n\n"
+     "Returns:\n"
+     "    int: Job id"},
+
+    {"reactor_poll", reactor_poll, METH_VARARGS,
+     "Drain ready pipes and reap exited children without blocking.\n\n"
+     "Args:\n"
+     "    reactor: Reactor capsule\n\n"
+     "Returns:\n"
+     "    list: (job id, result) of every finished child; results are dicts\n"
+     "    as returned by spawn(), with cancelled set for killed children"},
+
+    {"reactor_kill", reactor_kill, METH_VARARGS,
+     "Kill a running child of a reactor.\n\n"
+     "Args:\n"
+     "    reactor: Reactor capsule\n"
+     "    job (int): Job id\n\n"
+     "Returns:\n"
+     "    bool: False if the child had already exited"},
+
+    {"reactor_len", reactor_len, METH_VARARGS,
+     "Number of children of a reactor not yet returned by reactor_poll()."},
+
+    {"reactor_close", reactor_close, METH_VARARGS,
+     "Kill and reap all children of a reactor and close it."},
+#endif
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef launchermodule = {
+    PyModuleDef_HEAD_INIT,
+    "_launcher",
+    "Native posix_spawn launcher for HYSPLIT binaries.",
+    -1,
+    LauncherMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__launcher(void) {
+    return PyModule_Create(&launchermodule);
+}
@@ -0,0 +1,208 @@
+/**
+ * Shared pieces of the native engines: the in-memory gridded meteorology
+ * with its interpolation routines.
+ *
+ * Include after Python.h and numpy/arrayobject.h.
+ */
+
+#ifndef HYSPLIT_MET_FIELD_H
+#define HYSPLIT_MET_FIELD_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "earth.h"
+#include "py_args.h"
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double DEG_TO_RAD = PI / 180.0;
+constexpr double METERS_PER_DEGREE = EARTH_RADIUS_M * DEG_TO_RAD;
+
+// Time steps (minutes) that divide an hour, so sampling boundaries stay aligned
+constexpr int STEP_CHOICES[] = {60, 30, 20, 15, 12, 10, 6, 5, 4, 3, 2, 1};
+
+// ---------------------------------------------------------------------------
+// Meteorology
+// ---------------------------------------------------------------------------
+
+// Gridded meteorology: 4-D fields are (time, height, lat, lon), 2-D are (time, lat, lon)
+struct MetField {
+    int nt = 0, nz = 0, ny = 0, nx = 0;
+    const double* times = nullptr;    // hours relative to model start
+    const double* lats = nullptr;
+    const double* lons = nullptr;
+    const double* heights = nullptr;  // meters AGL
+    const double* u = nullptr;        // m/s
+    const double* v = nullptr;
+    const double* w = nullptr;
+    const double* mixd = nullptr;     // mixing depth (m), optional
+    const double* prec = nullptr;     // precipitation rate (mm/h), optional
+
+    size_t index(int t, int k, int j, int i) const {
+        return ((static_cast<size_t>(t) * nz + k) * ny + j) * nx + i;
+    }
+    size_t index2d(int t, int j, int i) const {
+        return (static_cast<size_t>(t) * ny + j) * nx + i;
+    }
+
+    // Shift a longitude by 360 degrees so it falls inside the met domain if possible
+    double wrap_lon(double lon) const {
+        if (lon < lons[0]) lon += 360.0;
+        else if (lon > lons[nx - 1]) lon -= 360.0;
+        return lon;
+    }
+};
+
+// Pair of neighbouring indices and the interpolation weight of the upper one
+struct Bracket {
+    int i0, i1;
+    double f;
+};
+
+// Bracket x on a monotonically increasing axis, clamping at the ends
+inline Bracket bracket_clamped(const double* axis, int n, double x) {
+    if (n == 1 || x <= axis[0]) return {0, 0, 0.0};
+    if (x >= axis[n - 1]) return {n - 1, n - 1, 0.0};
+    const int i = static_cast<int>(std::upper_bound(axis, axis + n, x) - axis) - 1;
+    return {i, i + 1, (x - axis[i]) / (axis[i + 1] - axis[i])};
+}
+
+// Bracket x on an axis, failing when it is outside the axis range
+inline bool bracket_inside(const double* axis, int n, double x, Bracket& b) {
+    if (x < axis[0] || x > axis[n - 1]) return false;
+    b = bracket_clamped(axis, n, x);
+    return true;
+}
+
+struct Wind {
+    double u, v, w;
+};
+
+// Interpolate the wind linearly in time and trilinearly in space
+inline bool sample_wind(const MetField& m, double t, double lat, double lon, double z, Wind& out) {
+    Bracket by, bx;
+    if (!bracket_inside(m.lats, m.ny, lat, by)) return false;
+    if (!bracket_inside(m.lons, m.nx, lon, bx)) return false;
+    const Bracket bt = bracket_clamped(m.times, m.nt, t);
+    const Bracket bz = bracket_clamped(m.heights, m.nz, z);
+
+    const int ts[2] = {bt.i0, bt.i1};
+    const int ks[2] = {bz.i0, bz.i1};
+    const int js[2] = {by.i0, by.i1};
+    const int is[2] = {bx.i0, bx.i1};
+    const double wt[2] = {1.0 - bt.f, bt.f};
+    const double wz[2] = {1.0 - bz.f, bz.f};
+    const double wy[2] = {1.0 - by.f, by.f};
+    const double wx[2] = {1.0 - bx.f, bx.f};
+
+    double u = 0.0, v = 0.0, w = 0.0;
+    for (int a = 0; a < 2; a++) {
+        for (int b = 0; b < 2; b++) {
+            for (int c = 0; c < 2; c++) {
+                for (int d = 0; d < 2; d++) {
+                    const double weight = wt[a] * wz[b] * wy[c] * wx[d];
+                    const size_t idx = m.index(ts[a], ks[b], js[c], is[d]);
+                    u += weight * m.u[idx];
+                    v += weight * m.v[idx];
+                    w += weight * m.w[idx];
+                }
+            }
+        }
+    }
+    out = {u, v, w};
+    return true;
+}
+
+// Interpolate a (time, lat, lon) surface field; the position must be inside the domain
+inline double sample_surface(const MetField& m, const double* field, double t, double lat,
+                             double lon) {
+    const Bracket bt = bracket_clamped(m.times, m.nt, t);
+    const Bracket by = bracket_clamped(m.lats, m.ny, lat);
+    const Bracket bx = bracket_clamped(m.lons, m.nx, lon);
+    const int ts[2] = {bt.i0, bt.i1};
+    const int js[2] = {by.i0, by.i1};
+    const int is[2] = {bx.i0, bx.i1};
+    const double wt[2] = {1.0 - bt.f, bt.f};
+    const double wy[2] = {1.0 - by.f, by.f};
+    const double wx[2] = {1.0 - bx.f, bx.f};
+
+    double value = 0.0;
+    for (int a = 0; a < 2; a++)
+        for (int c = 0; c < 2; c++)
+            for (int d = 0; d < 2; d++)
+                value += wt[a] * wy[c] * wx[d] * field[m.index2d(ts[a], js[c], is[d])];
+    return value;
+}
+
+// Pick the largest hour-dividing step that keeps displacement below tratio grid cells
+inline double select_time_step(const MetField& m, double tratio) {
+    double max_speed = 0.0;
+    const size_t n = static_cast<size_t>(m.nt) * m.nz * m.ny * m.nx;
+    for (size_t idx = 0; idx < n; idx++) {
+        max_speed = std::max(max_speed, std::hypot(m.u[idx], m.v[idx]));
+    }
+    double spacing = 1e30;
+    for (int j = 1; j < m.ny; j++) spacing = std::min(spacing, m.lats[j] - m.lats[j - 1]);
+    for (int i = 1; i < m.nx; i++) spacing = std::min(spacing, m.lons[i] - m.lons[i - 1]);
+    if (max_speed <= 0.0 || spacing >= 1e30) return 60.0;
+
+    const double limit = tratio * spacing * METERS_PER_DEGREE / max_speed / 60.0;
+    for (int step : STEP_CHOICES) {
+        if (step <= limit) return step;
+    }
+    return 1.0;
+}
+
+// Arrays of a met dict (as built by MetField.to_arrays), kept alive while in use
+struct MetArrays {
+    DoubleArray times, lats, lons, heights, u, v, w, mixd, prec;
+
+    // Load and validate the arrays and point met at them; sets a Python error on failure
+    bool load(PyObject* met_dict, MetField& met) {
+        if (!dict_array(met_dict, "times", 1, times, true) ||
+            !dict_array(met_dict, "lats", 1, lats, true) ||
+            !dict_array(met_dict, "lons", 1, lons, true) ||
+            !dict_array(met_dict, "heights", 1, heights, true) ||
+            !dict_array(met_dict, "u", 4, u, true) || !dict_array(met_dict, "v", 4, v, true) ||
+            !dict_array(met_dict, "w", 4, w, true) ||
+            !dict_array(met_dict, "mixing_depth", 3, mixd, false) ||
+            !dict_array(met_dict, "precipitation", 3, prec, false)) {
+            return false;
+        }
+
+        met.nt = static_cast<int>(times.size());
+        met.nz = static_cast<int>(heights.size());
+        met.ny = static_cast<int>(lats.size());
+        met.nx = static_cast<int>(lons.size());
+        if (met.nt < 1 || met.nz < 1 || met.ny < 2 || met.nx < 2) {
+            PyErr_SetString(PyExc_ValueError, "met field needs at least one time and height and two lats and lons");
+            return false;
+        }
+        const DoubleArray* fields[3] = {&u, &v, &w};
+        for (const DoubleArray* f : fields) {
+            if (f->dim(0) != met.nt || f->dim(1) != met.nz || f->dim(2) != met.ny || f->dim(3) != met.nx) {
+                PyErr_SetString(PyExc_ValueError, "wind arrays must have shape (times, heights, lats, lons)");
+                return false;
+            }
+        }
+        const DoubleArray* surfaces[2] = {&mixd, &prec};
+        for (const DoubleArray* f : surfaces) {
+            if (!f->empty() && (f->dim(0) != met.nt || f->dim(1) != met.ny || f->dim(2) != met.nx)) {
+                PyErr_SetString(PyExc_ValueError, "surface fields must have shape (times, lats, lons)");
+                return false;
+            }
+        }
+        met.times = times.data();
+        met.lats = lats.data();
+        met.lons = lons.data();
+        met.heights = heights.data();
+        met.u = u.data();
+        met.v = v.data();
+        met.w = w.data();
+        met.mixd = mixd.data();
+        met.prec = prec.data();
+        return true;
+    }
+};
+
+#endif  // HYSPLIT_MET_FIELD_H
@@ -18,9 +18,13 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cstdint>
 #include <fstream>
+#include <map>
+#include <numeric>
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <vector>
 
 // Maximum columns for trajectory data
@@ -295,6 +299,169 @@ static PyObject* parse_pardump_file(PyObject* self, PyObject* args) {
     return array;
 }
 
+// Columns of a parsed EMITIMES table
+constexpr int EMITIMES_COLS = 9;
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t days_from_civil(int64_t y, int64_t m, int64_t d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Days in a month of the proleptic Gregorian calendar
+static int days_in_month(int64_t y, int64_t m) {
+    const int64_t next = m == 12 ? days_from_civil(y + 1, 1, 1) : days_from_civil(y, m + 1, 1);
+    return static_cast<int>(next - days_from_civil(y, m, 1));
+}
+
+// Read up to max_values numbers from a line; stops at the first non-number
+static int read_numbers(const char* p, const char* end, double* values, int max_values) {
+    int n = 0;
+    while (n < max_values) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p >= end) break;
+        char* next = nullptr;
+        const double value = std::strtod(p, &next);
+        if (next == p || next > end) break;
+        values[n++] = value;
+        p = next;
+    }
+    return n;
+}
+
+static PyObject* emitimes_error(long line_number, const char* message) {
+    PyErr_Format(PyExc_ValueError, "EMITIMES line %ld: %s", line_number, message);
+    return NULL;
+}
+
+/**
+ * Parse a HYSPLIT EMITIMES (temporal emissions) file.
+ *
+ * The file holds one or more cycles, each a header line
+ * "YYYY MM DD HH DURATION(hhhh) #RECORDS" followed by #RECORDS lines
+ * "YYYY MM DD HH MM DURATION(hhmm) LAT LON HGT RATE [AREA HEAT]". Text
+ * lines outside the cycles (the usual column headings) are skipped.
+ *
+ * Sources are numbered by distinct (lat, lon, height) in order of first
+ * appearance, and the returned rows are sorted by source and start time so
+ * each source's records form one contiguous, time-ordered block.
+ */
+static PyObject* parse_emitimes_file(PyObject* self, PyObject* args) {
+    const char* filepath;
+
+    if (!PyArg_ParseTuple(args, "s", &filepath)) {
+        return NULL;
+    }
+
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        PyErr_SetString(PyExc_FileNotFoundError, "Cannot open file");
+        return NULL;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    // Rows: source, start (minutes since 1970), duration (hours), lat, lon, height, rate, area, heat
+    std::vector<double> rows;
+    std::map<std::tuple<double, double, double>, int> source_ids;
+    long pending = 0;          // records still expected in the current cycle
+    long line_number = 0;
+    long cycle_line = 0;
+
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t eol = content.find('\n', pos);
+        if (eol == std::string::npos) eol = content.size();
+        const char* begin = content.data() + pos;
+        const char* end = content.data() + eol;
+        pos = eol + 1;
+        line_number++;
+
+        double v[12];
+        const int n = read_numbers(begin, end, v, 12);
+        if (n == 0) {
+            bool blank = true;
+            for (const char* c = begin; c < end; c++) {
+                if (*c != ' ' && *c != '\t' && *c != '\r') { blank = false; break; }
+            }
+            if (pending > 0 && !blank) return emitimes_error(line_number, "expected an emission record");
+            continue;
+        }
+
+        if (pending == 0) {
+            // Cycle header: year month day hour duration records
+            if (n != 6) return emitimes_error(line_number, "expected a cycle header with 6 fields");
+            if (v[5] < 0 || v[5] != std::floor(v[5])) {
+                return emitimes_error(line_number, "invalid record count");
+            }
+            pending = static_cast<long>(v[5]);
+            cycle_line = line_number;
+            continue;
+        }
+
+        if (n < 10) return emitimes_error(line_number, "emission record needs at least 10 fields");
+        int year = static_cast<int>(v[0]);
+        if (year < 50) year += 2000;
+        else if (year < 100) year += 1900;
+        const int month = static_cast<int>(v[1]), day = static_cast<int>(v[2]);
+        const int hour = static_cast<int>(v[3]), minute = static_cast<int>(v[4]);
+        if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month) || hour < 0 ||
+            hour > 23 || minute < 0 || minute > 59) {
+            return emitimes_error(line_number, "invalid date");
+        }
+        const long hhmm = static_cast<long>(v[5]);
+        if (v[5] < 0 || hhmm % 100 > 59) return emitimes_error(line_number, "invalid duration");
+        if (v[9] < 0) return emitimes_error(line_number, "negative emission rate");
+        if (v[6] < -90.0 || v[6] > 90.0 || v[7] < -180.0 || v[7] > 360.0) {
+            return emitimes_error(line_number, "location out of range");
+        }
+
+        const auto key = std::make_tuple(v[6], v[7], v[8]);
+        auto found = source_ids.find(key);
+        if (found == source_ids.end()) {
+            found = source_ids.emplace(key, static_cast<int>(source_ids.size())).first;
+        }
+
+        const int64_t minutes = days_from_civil(year, month, day) * 1440 + hour * 60 + minute;
+        const double row[EMITIMES_COLS] = {
+            static_cast<double>(found->second), static_cast<double>(minutes),
+            (hhmm / 100) + (hhmm % 100) / 60.0, v[6], v[7], v[8], v[9],
+            n > 10 ? v[10] : 0.0, n > 11 ? v[11] : 0.0};
+        rows.insert(rows.end(), row, row + EMITIMES_COLS);
+        pending--;
+    }
+    if (pending > 0) {
+        return emitimes_error(cycle_line, "file ends before all records of the cycle");
+    }
+
+    // Order by source, then start time (stable, so same-time records keep file order)
+    const npy_intp n_rows = static_cast<npy_intp>(rows.size() / EMITIMES_COLS);
+    std::vector<npy_intp> order(n_rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&rows](npy_intp a, npy_intp b) {
+        const double* ra = &rows[a * EMITIMES_COLS];
+        const double* rb = &rows[b * EMITIMES_COLS];
+        return std::tie(ra[0], ra[1]) < std::tie(rb[0], rb[1]);
+    });
+
+    npy_intp dims[2] = {n_rows, EMITIMES_COLS};
+    PyObject* array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (!array) {
+        return NULL;
+    }
+    double* out = static_cast<double*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)));
+    for (npy_intp r = 0; r < n_rows; r++) {
+        std::memcpy(out + r * EMITIMES_COLS, &rows[order[r] * EMITIMES_COLS],
+                    EMITIMES_COLS * sizeof(double));
+    }
+
+    return array;
+}
+
 // Method definitions
 static PyMethodDef ParserMethods[] = {
     {"parse_trajectory_file", parse_trajectory_file, METH_VARARGS,
@@ -311,6 +478,16 @@ static PyMethodDef ParserMethods[] = {
      "Returns:\n"
      "    numpy.ndarray: 2D array of particle positions"},
 
+    {"parse_emitimes_file", parse_emitimes_file, METH_VARARGS,
+     "Parse a HYSPLIT EMITIMES temporal emissions file.\n\n"
+     "Args:\n"
+     "    filepath (str): Path to the EMITIMES file\n\n"
+     "Returns:\n"
+     "    numpy.ndarray: 2D array (source, start minutes since 1970, duration hours,\n"
+     "    lat, lon, height, rate, area, heat) sorted by source and start time\n\n"
+     "Raises:\n"
+     "    ValueError: If the file is malformed"},
+
     {NULL, NULL, 0, NULL}
 };
 
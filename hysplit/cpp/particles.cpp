@@ -0,0 +1,1391 @@
+/**
+ * Native Lagrangian particle engine for HYSPLIT-style dispersion runs.
+ *
+ * Particles are advected through an in-memory gridded wind field with a
+ * predictor-corrector scheme and a random-displacement turbulence model, and
+ * lose mass to gravitational settling, dry deposition and wet scavenging.
+ * Co-located particles are merged and heavy particles split at the SETUP.CFG
+ * krnd/kspl intervals, which keeps the particle count bounded on long runs.
+ * Concentrations and deposition are accumulated onto the DispersionModel grid
+ * while the simulation runs, so no PARDUMP has to be written and re-binned.
+ * In transfer-matrix mode every source-time column also accumulates its own
+ * sparse column of receptor concentrations.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "met_field.h"
+
+// Remove inactive particles from the arrays every this many steps
+constexpr int COMPACT_INTERVAL = 12;
+
+// Depth of the surface layer in which dry deposition acts (m)
+constexpr double DEPOSITION_LAYER = 75.0;
+
+// Assumed depth of precipitating cloud above the mixed layer (m)
+constexpr double CLOUD_DEPTH = 3000.0;
+
+inline int thread_count() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int thread_id() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int team_size() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Random numbers
+// ---------------------------------------------------------------------------
+
+// SplitMix64 finalizer, used as a counter-based generator so that results do
+// not depend on how particles are distributed over threads
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Two independent standard normal deviates for a counter key (Box-Muller)
+inline void normal_pair(uint64_t key, double& a, double& b) {
+    const double u1 = static_cast<double>((mix64(key) >> 11) + 1) * 0x1.0p-53;
+    const double u2 = static_cast<double>(mix64(key ^ 0xD1B54A32D192ED03ULL) >> 11) * 0x1.0p-53;
+    const double r = std::sqrt(-2.0 * std::log(u1));
+    a = r * std::cos(2.0 * PI * u2);
+    b = r * std::sin(2.0 * PI * u2);
+}
+
+// ---------------------------------------------------------------------------
+// Deposition
+// ---------------------------------------------------------------------------
+
+// Pollutant properties, as on the deposition lines of the CONTROL file
+struct Species {
+    double diameter = 0.0;      // particle diameter (um), 0 for a gas
+    double density = 0.0;       // particle density (g/cm^3)
+    double shape = 0.0;         // dynamic shape factor (0 treated as a sphere)
+    double dep_velocity = 0.0;  // explicit dry deposition velocity (m/s)
+    double henry = 0.0;         // Henry's constant for gases (M/atm)
+    double in_cloud = 0.0;      // in-cloud scavenging ratio (L/L)
+    double below_cloud = 0.0;   // below-cloud scavenging coefficient (1/s)
+};
+
+// Step-independent removal constants derived from a Species
+struct Removal {
+    double settling = 0.0;      // gravitational settling velocity (m/s)
+    double dry_rate = 0.0;      // dry loss rate inside the deposition layer (1/s)
+    double below_cloud = 0.0;   // loss rate below cloud base while raining (1/s)
+    double wet_ratio = 0.0;     // in-cloud scavenging ratio (dimensionless)
+    bool gas = true;
+
+    bool enabled() const {
+        return settling > 0.0 || dry_rate > 0.0 || below_cloud > 0.0 || wet_ratio > 0.0;
+    }
+};
+
+// Stokes settling velocity with the Cunningham slip correction
+static double settling_velocity(const Species& sp) {
+    if (sp.diameter <= 0.0 || sp.density <= 0.0) return 0.0;
+    const double gravity = 9.81;
+    const double viscosity = 1.81e-5;   // air dynamic viscosity (kg/m/s)
+    const double free_path = 0.065e-6;  // mean free path of air (m)
+    const double d = sp.diameter * 1e-6;
+    const double rho = sp.density * 1000.0;
+    const double slip = 1.0 + 2.0 * free_path / d * (1.257 + 0.4 * std::exp(-0.55 * d / free_path));
+    const double shape = sp.shape > 0.0 ? sp.shape : 1.0;
+    return rho * gravity * d * d * slip / (18.0 * viscosity * shape);
+}
+
+static Removal removal_constants(const Species& sp) {
+    Removal r;
+    r.gas = sp.diameter <= 0.0;
+    r.settling = settling_velocity(sp);
+    r.dry_rate = (sp.dep_velocity + r.settling) / DEPOSITION_LAYER;
+    if (r.gas) {
+        // Equilibrium partitioning into rain water: H * R * T
+        r.wet_ratio = sp.henry * 0.082057 * 290.0;
+    } else {
+        r.below_cloud = sp.below_cloud;
+        r.wet_ratio = sp.in_cloud;
+    }
+    return r;
+}
+
+/**
+ * Remove deposited mass from particles [begin, end) over one step.
+ *
+ * Branch-free over structure-of-arrays inputs so the compiler can vectorize
+ * it; the removed mass is written to lost[] for the deposition grid.
+ */
+static void removal_kernel(const Removal& r, long begin, long end, double dt_s,
+                           const uint8_t* active, const double* z, const double* mixd,
+                           const double* prec, double* mass, double* lost) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (long p = begin; p < end; p++) {
+        const double rain = prec[p] / 3.6e6;  // mm/h to m/s
+        const bool raining = rain > 0.0 && z[p] < mixd[p] + CLOUD_DEPTH;
+        const bool below = z[p] < mixd[p] && !r.gas;
+        double rate = z[p] < DEPOSITION_LAYER ? r.dry_rate : 0.0;
+        rate += raining ? (below ? r.below_cloud : r.wet_ratio * rain / CLOUD_DEPTH) : 0.0;
+        const double removed = active[p] ? mass[p] * (1.0 - std::exp(-rate * dt_s)) : 0.0;
+        mass[p] -= removed;
+        lost[p] = removed;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Particles and sources
+// ---------------------------------------------------------------------------
+
+// Structure-of-arrays particle storage
+struct Particles {
+    std::vector<double> lat, lon, z, mass;
+    std::vector<double> release;  // release time, hours after model start
+    std::vector<int32_t> source;
+    std::vector<uint64_t> id;
+    std::vector<uint8_t> active;
+
+    // Per-step scratch: environment seen by each particle and mass it deposited
+    std::vector<double> env_mixd, env_prec, lost;
+
+    size_t size() const { return lat.size(); }
+
+    void reserve(size_t n) {
+        lat.reserve(n); lon.reserve(n); z.reserve(n); mass.reserve(n); release.reserve(n);
+        source.reserve(n); id.reserve(n); active.reserve(n);
+        env_mixd.reserve(n); env_prec.reserve(n); lost.reserve(n);
+    }
+
+    void push(double plat, double plon, double pz, double pmass, double prelease, int32_t src,
+              uint64_t pid) {
+        lat.push_back(plat); lon.push_back(plon); z.push_back(pz); mass.push_back(pmass);
+        release.push_back(prelease);
+        source.push_back(src); id.push_back(pid); active.push_back(1);
+        env_mixd.push_back(0.0); env_prec.push_back(0.0); lost.push_back(0.0);
+    }
+
+    // Release n identical particles at once; ids run from first_id
+    void append(size_t n, double plat, double plon, double pz, double pmass, double prelease,
+                int32_t src, uint64_t first_id) {
+        const size_t begin = size();
+        lat.resize(begin + n, plat); lon.resize(begin + n, plon); z.resize(begin + n, pz);
+        mass.resize(begin + n, pmass); release.resize(begin + n, prelease);
+        source.resize(begin + n, src); active.resize(begin + n, 1);
+        env_mixd.resize(begin + n, 0.0); env_prec.resize(begin + n, 0.0); lost.resize(begin + n, 0.0);
+        id.resize(begin + n);
+        for (size_t p = 0; p < n; p++) id[begin + p] = first_id + p;
+    }
+
+    // Drop inactive particles, keeping release order
+    void compact() {
+        size_t out = 0;
+        for (size_t p = 0; p < size(); p++) {
+            if (!active[p]) continue;
+            lat[out] = lat[p]; lon[out] = lon[p]; z[out] = z[p]; mass[out] = mass[p];
+            release[out] = release[p];
+            source[out] = source[p]; id[out] = id[p]; active[out] = 1;
+            out++;
+        }
+        resize(out);
+    }
+
+    void resize(size_t n) {
+        lat.resize(n); lon.resize(n); z.resize(n); mass.resize(n); release.resize(n);
+        source.resize(n); id.resize(n); active.resize(n, 1);
+        env_mixd.resize(n); env_prec.resize(n); lost.resize(n);
+    }
+};
+
+struct Source {
+    double lat, lon, height;
+    double rate;      // mass per hour
+    double start;     // release start, hours after model start
+    double duration;  // release duration, hours
+};
+
+// One line of a time-varying emission table (EMITIMES record)
+struct EmissionRecord {
+    int32_t source;
+    double start;     // hours after model start
+    double duration;  // hours
+    double rate;      // mass per hour
+};
+
+// Mass emitted by each source in each time step, so releases are an O(1) lookup
+struct EmissionTable {
+    long n_sources = 0, n_steps = 0;
+    std::vector<double> mass;    // n_sources * n_steps
+    std::vector<long> count;     // particles per release step, per source
+    std::vector<long> pending;   // particles released from step on, n_steps + 1 entries
+
+    double step_mass(size_t s, long step) const { return mass[s * n_steps + step]; }
+};
+
+/**
+ * Rasterize emission records onto the model time steps.
+ *
+ * Records are sorted by source and start time and each one adds rate x
+ * overlap to the steps it covers, so the cost is linear in records plus
+ * covered steps. Every source releases the same number of particles in
+ * each step it emits, sharing numpar evenly between sources.
+ */
+static EmissionTable build_emission_table(std::vector<EmissionRecord> records, long n_sources,
+                                          long n_steps, double dt_h, long numpar) {
+    const double eps = 1e-9;
+    EmissionTable table;
+    table.n_sources = n_sources;
+    table.n_steps = n_steps;
+    table.mass.assign(static_cast<size_t>(n_sources) * n_steps, 0.0);
+    table.count.assign(n_sources, 0);
+    table.pending.assign(n_steps + 1, 0);
+
+    std::sort(records.begin(), records.end(), [](const EmissionRecord& a, const EmissionRecord& b) {
+        return std::tie(a.source, a.start) < std::tie(b.source, b.start);
+    });
+
+    const double end_time = n_steps * dt_h;
+    for (const EmissionRecord& rec : records) {
+        const double t0 = std::max(rec.start, 0.0);
+        const double t1 = std::min(rec.start + rec.duration, end_time);
+        if (t1 <= t0 + eps || rec.rate <= 0.0) continue;
+        double* row = &table.mass[static_cast<size_t>(rec.source) * n_steps];
+        for (long step = static_cast<long>(std::floor(t0 / dt_h + eps)); step < n_steps; step++) {
+            const double lo = std::max(t0, step * dt_h);
+            const double hi = std::min(t1, (step + 1) * dt_h);
+            if (hi <= lo + eps) break;
+            row[step] += rec.rate * (hi - lo);
+        }
+    }
+
+    const long per_source = std::max(1L, numpar / std::max(1L, n_sources));
+    for (long s = 0; s < n_sources; s++) {
+        const double* row = &table.mass[static_cast<size_t>(s) * n_steps];
+        const long active_steps = std::count_if(row, row + n_steps, [](double m) { return m > 0.0; });
+        table.count[s] = active_steps > 0 ? std::max(1L, per_source / active_steps) : 0;
+    }
+    for (long step = n_steps - 1; step >= 0; step--) {
+        long released = 0;
+        for (long s = 0; s < n_sources; s++) {
+            if (table.step_mass(s, step) > 0.0) released += table.count[s];
+        }
+        table.pending[step] = table.pending[step + 1] + released;
+    }
+    return table;
+}
+
+// ---------------------------------------------------------------------------
+// Concentration grid
+// ---------------------------------------------------------------------------
+
+struct ConcGrid {
+    int nlat = 0, nlon = 0, nlev = 0;
+    double ll_lat = 0.0, ll_lon = 0.0, dlat = 1.0, dlon = 1.0;
+    std::vector<double> levels;  // layer tops (m AGL), ascending
+
+    size_t plane() const { return static_cast<size_t>(nlat) * nlon; }
+    size_t cells() const { return plane() * nlev; }
+
+    // Horizontal cell of the nearest grid node, or -1 outside the grid
+    long column(double lat, double lon) const {
+        double rel = lon - ll_lon;
+        if (rel < -0.5 * dlon) rel += 360.0;
+        else if (rel >= 360.0 - 0.5 * dlon) rel -= 360.0;
+        const long i = static_cast<long>(std::floor(rel / dlon + 0.5));
+        const long j = static_cast<long>(std::floor((lat - ll_lat) / dlat + 0.5));
+        if (i < 0 || i >= nlon || j < 0 || j >= nlat) return -1;
+        return j * nlon + i;
+    }
+
+    // Layer containing height z, or -1 above the top level
+    int layer(double z) const {
+        for (int k = 0; k < nlev; k++) {
+            if (levels[k] > 0.0 && z <= levels[k]) return k;
+        }
+        return -1;
+    }
+
+    double layer_depth(int k) const {
+        double bottom = 0.0;
+        for (int l = 0; l < k; l++) bottom = std::max(bottom, levels[l]);
+        return std::max(levels[k] - bottom, 0.0);
+    }
+
+    double cell_area(int j) const {
+        const double lat = ll_lat + j * dlat;
+        return dlat * METERS_PER_DEGREE * dlon * METERS_PER_DEGREE *
+               std::max(std::cos(lat * DEG_TO_RAD), 1e-6);
+    }
+};
+
+// Per-thread accumulation grids, reduced into one snapshot at each sampling boundary
+class GridAccumulator {
+public:
+    GridAccumulator(size_t cells, int n_threads)
+        : cells_(cells), n_threads_(n_threads), data_(cells * n_threads, 0.0) {}
+
+    double* local(int tid) { return data_.data() + static_cast<size_t>(tid) * cells_; }
+
+    // Sum the thread grids into out (overwriting it) and zero them for the next period
+    void reduce(double* out) {
+        const long n = static_cast<long>(cells_);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long c = 0; c < n; c++) {
+            double sum = 0.0;
+            for (int t = 0; t < n_threads_; t++) {
+                double& v = data_[static_cast<size_t>(t) * cells_ + c];
+                sum += v;
+                v = 0.0;
+            }
+            out[c] = sum;
+        }
+    }
+
+private:
+    size_t cells_;
+    int n_threads_;
+    std::vector<double> data_;
+};
+
+// ---------------------------------------------------------------------------
+// Splitting and merging
+// ---------------------------------------------------------------------------
+
+// SETUP.CFG splitting/merging parameters
+struct SplitMerge {
+    double kspl = 1.0;     // splitting interval (hours), 0 disables
+    double krnd = 6.0;     // merging interval (hours), 0 disables
+    double frhs = 1.0;     // horizontal rounding, fraction of the grid spacing
+    double frvs = 0.01;    // vertical rounding, fraction of the model top
+    double frts = 0.10;    // temporal rounding, fraction of the merge interval
+    double frhmax = 3.0;   // upper limit for frhs
+    double splitf = 1.0;   // split particles heavier than splitf x mean mass of their source
+};
+
+// Rounded particle position; particles with equal keys are merged
+struct MergeKey {
+    uint64_t hash;
+    int32_t source, period, age, k, j, i;
+    uint32_t index;
+
+    bool same_cell(const MergeKey& o) const {
+        return hash == o.hash && source == o.source && period == o.period && age == o.age &&
+               k == o.k && j == o.j && i == o.i;
+    }
+};
+
+// Sort each thread's chunk, then merge sorted runs pairwise
+template <typename T, typename Less>
+static void parallel_sort(std::vector<T>& items, Less less) {
+    const long n = static_cast<long>(items.size());
+    const int chunks = std::max(1, std::min(thread_count(), static_cast<int>(n / 4096)));
+    std::vector<long> bounds(chunks + 1);
+    for (int c = 0; c <= chunks; c++) bounds[c] = n * c / chunks;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int c = 0; c < chunks; c++) {
+        std::sort(items.begin() + bounds[c], items.begin() + bounds[c + 1], less);
+    }
+
+    for (int width = 1; width < chunks; width *= 2) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int c = 0; c < chunks; c += 2 * width) {
+            if (c + width >= chunks) continue;
+            const long mid = bounds[c + width];
+            const long last = bounds[std::min(c + 2 * width, chunks)];
+            std::inplace_merge(items.begin() + bounds[c], items.begin() + mid, items.begin() + last, less);
+        }
+    }
+}
+
+/**
+ * Merge particles that share a rounded position, source and age.
+ *
+ * Keys are hashed and sorted in parallel; each run of equal keys is then
+ * reduced to one particle carrying the total mass at the mass-weighted mean
+ * position. A positive release_period also keeps particles released in
+ * different periods apart. Returns the number of particles removed.
+ */
+static long merge_particles(Particles& parts, const SplitMerge& sm, double dlat, double dlon,
+                            double model_top, double elapsed, double release_period) {
+    parts.compact();
+    const long n = static_cast<long>(parts.size());
+    if (n < 2) return 0;
+
+    const double hround = std::min(sm.frhs, sm.frhmax);
+    const double bin_lat = std::max(hround * dlat, 1e-6);
+    const double bin_lon = std::max(hround * dlon, 1e-6);
+    const double bin_z = std::max(sm.frvs * model_top, 1e-3);
+    const double bin_age = std::max(sm.frts * sm.krnd, 1e-6);
+
+    std::vector<MergeKey> keys(n);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long p = 0; p < n; p++) {
+        MergeKey& key = keys[p];
+        key.source = parts.source[p];
+        key.period = release_period > 0.0
+                         ? static_cast<int32_t>(std::floor(parts.release[p] / release_period + 1e-9))
+                         : 0;
+        key.age = static_cast<int32_t>(std::floor((elapsed - parts.release[p]) / bin_age));
+        key.k = static_cast<int32_t>(std::floor(parts.z[p] / bin_z));
+        key.j = static_cast<int32_t>(std::floor(parts.lat[p] / bin_lat));
+        key.i = static_cast<int32_t>(std::floor(parts.lon[p] / bin_lon));
+        key.index = static_cast<uint32_t>(p);
+        uint64_t h = mix64(static_cast<uint64_t>(static_cast<uint32_t>(key.source)));
+        h = mix64(h ^ static_cast<uint32_t>(key.period));
+        h = mix64(h ^ static_cast<uint32_t>(key.age));
+        h = mix64(h ^ static_cast<uint32_t>(key.k));
+        h = mix64(h ^ static_cast<uint32_t>(key.j));
+        key.hash = mix64(h ^ static_cast<uint32_t>(key.i));
+    }
+
+    parallel_sort(keys, [](const MergeKey& a, const MergeKey& b) {
+        return std::tie(a.hash, a.index) < std::tie(b.hash, b.index);
+    });
+
+    std::vector<long> starts;
+    starts.reserve(n);
+    for (long q = 0; q < n; q++) {
+        if (q == 0 || !keys[q].same_cell(keys[q - 1])) starts.push_back(q);
+    }
+    const long n_out = static_cast<long>(starts.size());
+    if (n_out == n) return 0;
+    starts.push_back(n);
+
+    // Segmented reduction into fresh arrays
+    Particles merged;
+    merged.resize(n_out);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long s = 0; s < n_out; s++) {
+        double m = 0.0, lat = 0.0, lon = 0.0, z = 0.0, release = 0.0;
+        uint64_t id = UINT64_MAX;
+        for (long q = starts[s]; q < starts[s + 1]; q++) {
+            const uint32_t p = keys[q].index;
+            const double w = parts.mass[p];
+            m += w;
+            lat += w * parts.lat[p];
+            lon += w * parts.lon[p];
+            z += w * parts.z[p];
+            release += w * parts.release[p];
+            id = std::min(id, parts.id[p]);
+        }
+        const uint32_t first = keys[starts[s]].index;
+        const double inv = m > 0.0 ? 1.0 / m : 0.0;
+        merged.lat[s] = m > 0.0 ? lat * inv : parts.lat[first];
+        merged.lon[s] = m > 0.0 ? lon * inv : parts.lon[first];
+        merged.z[s] = m > 0.0 ? z * inv : parts.z[first];
+        merged.release[s] = m > 0.0 ? release * inv : parts.release[first];
+        merged.mass[s] = m;
+        merged.source[s] = parts.source[first];
+        merged.id[s] = id;
+    }
+    std::swap(parts, merged);
+    return n - n_out;
+}
+
+/**
+ * Split particles heavier than splitf times the mean mass of their source
+ * into two halves.
+ *
+ * Only runs while the plume holds fewer than target particles, so merged
+ * particles are re-resolved when there is room. The halves get new ids and
+ * therefore independent turbulence from the next step on. The threshold is
+ * per source so that which particles split does not depend on the relative
+ * emission rates: a transfer-matrix run at unit rates then splits exactly
+ * like a run with the real ones.
+ */
+static long split_particles(Particles& parts, const SplitMerge& sm, long target, size_t n_sources,
+                            uint64_t& next_id) {
+    if (sm.splitf <= 0.0) return 0;
+    parts.compact();
+    const long n = static_cast<long>(parts.size());
+    if (n == 0 || n >= target) return 0;
+
+    std::vector<double> threshold(n_sources, 0.0);
+    std::vector<long> count(n_sources, 0);
+    for (long p = 0; p < n; p++) {
+        threshold[parts.source[p]] += parts.mass[p];
+        count[parts.source[p]]++;
+    }
+    for (size_t s = 0; s < n_sources; s++) {
+        if (count[s] > 0) threshold[s] = sm.splitf * threshold[s] / count[s];
+    }
+
+    long added = 0;
+    for (long p = 0; p < n && n + added < target; p++) {
+        if (parts.mass[p] <= threshold[parts.source[p]]) continue;
+        parts.mass[p] *= 0.5;
+        parts.push(parts.lat[p], parts.lon[p], parts.z[p], parts.mass[p], parts.release[p],
+                   parts.source[p], next_id++);
+        added++;
+    }
+    return added;
+}
+
+// ---------------------------------------------------------------------------
+// Transfer-coefficient matrix
+// ---------------------------------------------------------------------------
+
+/**
+ * Sparse receptor x source-time matrix accumulated during the run.
+ *
+ * Threads append (cell, column, mass-hours) contributions to their own
+ * buffers, which are sorted and reduced whenever they grow large and at each
+ * sampling boundary. Closed samples are appended as CSR rows, row index
+ * sample * cells + cell, so the final matrix needs no further sorting.
+ */
+class TransferMatrix {
+public:
+    // Sort-and-reduce a thread buffer once it holds this many entries
+    static constexpr size_t BUFFER_LIMIT = size_t(1) << 22;
+
+    TransferMatrix(size_t n_columns, int n_threads)
+        : n_columns_(n_columns), buffers_(n_threads) {
+        indptr.push_back(0);
+    }
+
+    size_t n_columns() const { return n_columns_; }
+
+    void add(int tid, size_t cell, size_t column, double value) {
+        std::vector<Entry>& buffer = buffers_[tid];
+        buffer.push_back({static_cast<uint64_t>(cell) * n_columns_ + column, value});
+        if (buffer.size() >= BUFFER_LIMIT) reduce_entries(buffer, false);
+    }
+
+    // Reduce the period's contributions, scale them per cell and append the rows
+    void close_sample(size_t cells, const std::vector<double>& scale) {
+        std::vector<Entry> entries;
+        size_t total = 0;
+        for (const auto& buffer : buffers_) total += buffer.size();
+        entries.reserve(total);
+        for (auto& buffer : buffers_) {
+            entries.insert(entries.end(), buffer.begin(), buffer.end());
+            buffer.clear();
+        }
+        reduce_entries(entries, true);
+
+        std::vector<int64_t> row_count(cells, 0);
+        for (const Entry& e : entries) {
+            const size_t cell = static_cast<size_t>(e.key / n_columns_);
+            const double value = e.value * scale[cell];
+            if (value == 0.0) continue;
+            indices.push_back(static_cast<int32_t>(e.key % n_columns_));
+            data.push_back(value);
+            row_count[cell]++;
+        }
+        for (size_t c = 0; c < cells; c++) indptr.push_back(indptr.back() + row_count[c]);
+    }
+
+    std::vector<int64_t> indptr;
+    std::vector<int32_t> indices;
+    std::vector<double> data;
+
+private:
+    struct Entry {
+        uint64_t key;
+        double value;
+    };
+
+    static void reduce_entries(std::vector<Entry>& entries, bool parallel) {
+        const auto less = [](const Entry& a, const Entry& b) { return a.key < b.key; };
+        if (parallel) {
+            parallel_sort(entries, less);
+        } else {
+            std::sort(entries.begin(), entries.end(), less);
+        }
+        size_t out = 0;
+        for (size_t e = 0; e < entries.size(); e++) {
+            if (out > 0 && entries[out - 1].key == entries[e].key) {
+                entries[out - 1].value += entries[e].value;
+            } else {
+                entries[out++] = entries[e];
+            }
+        }
+        entries.resize(out);
+    }
+
+    size_t n_columns_;
+    std::vector<std::vector<Entry>> buffers_;
+};
+
+// ---------------------------------------------------------------------------
+// cdump output
+// ---------------------------------------------------------------------------
+
+// Proleptic Gregorian date for a count of days since 1970-01-01
+static void civil_from_days(int64_t z, int& y, int& m, int& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    y = static_cast<int>(yoe + era * 400 + (m <= 2));
+}
+
+// Calendar stamp (2-digit year, month, day, hour, minute) at an offset from the start
+struct Stamp {
+    int year, month, day, hour, minute;
+};
+
+static Stamp stamp_at(int64_t start_minutes, double offset_hours) {
+    const int64_t total = start_minutes + static_cast<int64_t>(std::llround(offset_hours * 60.0));
+    int64_t days = total / 1440;
+    int64_t rem = total % 1440;
+    if (rem < 0) {
+        rem += 1440;
+        days -= 1;
+    }
+    Stamp s;
+    civil_from_days(days, s.year, s.month, s.day);
+    s.year %= 100;
+    s.hour = static_cast<int>(rem / 60);
+    s.minute = static_cast<int>(rem % 60);
+    return s;
+}
+
+// Fortran sequential unformatted records: big-endian, 4-byte length markers
+class FortranWriter {
+public:
+    ~FortranWriter() { close(); }
+
+    bool open(const std::string& path) {
+        fp_ = std::fopen(path.c_str(), "wb");
+        return fp_ != nullptr;
+    }
+
+    void close() {
+        if (fp_) std::fclose(fp_);
+        fp_ = nullptr;
+    }
+
+    void put_i32(int32_t value) { put_be(static_cast<uint32_t>(value), 4); }
+    void put_i16(int16_t value) { put_be(static_cast<uint16_t>(value), 2); }
+    void put_f32(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put_be(bits, 4);
+    }
+    void put_chars(const std::string& text, size_t width) {
+        for (size_t i = 0; i < width; i++) rec_.push_back(i < text.size() ? text[i] : ' ');
+    }
+
+    bool end_record() {
+        const uint32_t n = static_cast<uint32_t>(rec_.size());
+        unsigned char marker[4] = {static_cast<unsigned char>(n >> 24),
+                                   static_cast<unsigned char>(n >> 16),
+                                   static_cast<unsigned char>(n >> 8),
+                                   static_cast<unsigned char>(n)};
+        bool ok = std::fwrite(marker, 1, 4, fp_) == 4;
+        ok = ok && std::fwrite(rec_.data(), 1, rec_.size(), fp_) == rec_.size();
+        ok = ok && std::fwrite(marker, 1, 4, fp_) == 4;
+        rec_.clear();
+        return ok;
+    }
+
+private:
+    void put_be(uint32_t value, int bytes) {
+        for (int b = bytes - 1; b >= 0; b--) rec_.push_back(static_cast<unsigned char>(value >> (8 * b)));
+    }
+
+    FILE* fp_ = nullptr;
+    std::vector<unsigned char> rec_;
+};
+
+struct CdumpHeader {
+    std::string path;
+    std::string met_id = "NATV";
+    std::string pollutant = "PART";
+    int64_t start_minutes = 0;  // model start, minutes since 1970-01-01
+    bool packed = true;
+};
+
+// Write grids in the HYSPLIT binary concentration (cdump) format
+static bool write_cdump(const CdumpHeader& header, const ConcGrid& grid,
+                        const std::vector<Source>& sources, const std::vector<double>& samples,
+                        const std::vector<double>& sample_start,
+                        const std::vector<double>& sample_stop) {
+    FortranWriter out;
+    if (!out.open(header.path)) return false;
+
+    const Stamp t0 = stamp_at(header.start_minutes, 0.0);
+    out.put_chars(header.met_id, 4);
+    out.put_i32(t0.year); out.put_i32(t0.month); out.put_i32(t0.day); out.put_i32(t0.hour);
+    out.put_i32(0);
+    out.put_i32(static_cast<int32_t>(sources.size()));
+    out.put_i32(header.packed ? 1 : 0);
+    bool ok = out.end_record();
+
+    for (const Source& src : sources) {
+        const Stamp s = stamp_at(header.start_minutes, src.start);
+        out.put_i32(s.year); out.put_i32(s.month); out.put_i32(s.day); out.put_i32(s.hour);
+        out.put_f32(static_cast<float>(src.lat));
+        out.put_f32(static_cast<float>(src.lon));
+        out.put_f32(static_cast<float>(src.height));
+        out.put_i32(s.minute);
+        ok = ok && out.end_record();
+    }
+
+    out.put_i32(grid.nlat); out.put_i32(grid.nlon);
+    out.put_f32(static_cast<float>(grid.dlat)); out.put_f32(static_cast<float>(grid.dlon));
+    out.put_f32(static_cast<float>(grid.ll_lat)); out.put_f32(static_cast<float>(grid.ll_lon));
+    ok = ok && out.end_record();
+
+    out.put_i32(grid.nlev);
+    for (double level : grid.levels) out.put_i32(static_cast<int32_t>(std::lround(level)));
+    ok = ok && out.end_record();
+
+    out.put_i32(1);
+    out.put_chars(header.pollutant, 4);
+    ok = ok && out.end_record();
+
+    for (size_t s = 0; s < sample_start.size() && ok; s++) {
+        const double bounds[2] = {sample_start[s], sample_stop[s]};
+        for (double hours : bounds) {
+            const Stamp st = stamp_at(header.start_minutes, hours);
+            out.put_i32(st.year); out.put_i32(st.month); out.put_i32(st.day);
+            out.put_i32(st.hour); out.put_i32(st.minute); out.put_i32(0);
+            ok = ok && out.end_record();
+        }
+
+        for (int k = 0; k < grid.nlev; k++) {
+            const double* layer = samples.data() + s * grid.cells() + k * grid.plane();
+            out.put_chars(header.pollutant, 4);
+            out.put_i32(static_cast<int32_t>(std::lround(grid.levels[k])));
+            if (header.packed) {
+                int32_t nonzero = 0;
+                for (size_t c = 0; c < grid.plane(); c++) nonzero += layer[c] > 0.0;
+                out.put_i32(nonzero);
+                for (int j = 0; j < grid.nlat; j++) {
+                    for (int i = 0; i < grid.nlon; i++) {
+                        const double value = layer[static_cast<size_t>(j) * grid.nlon + i];
+                        if (value <= 0.0) continue;
+                        out.put_i16(static_cast<int16_t>(i + 1));
+                        out.put_i16(static_cast<int16_t>(j + 1));
+                        out.put_f32(static_cast<float>(value));
+                    }
+                }
+            } else {
+                for (size_t c = 0; c < grid.plane(); c++) out.put_f32(static_cast<float>(layer[c]));
+            }
+            ok = ok && out.end_record();
+        }
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Simulation
+// ---------------------------------------------------------------------------
+
+struct Options {
+    double duration = 24.0;         // hours
+    int direction = 1;              // 1 forward, -1 backward
+    double time_step = 0.0;         // minutes, 0 selects from tratio
+    double tratio = 0.75;
+    long numpar = 2500;
+    long maxpar = 10000;
+    double kmix0 = 250.0;           // minimum mixing depth (m)
+    double model_top = 20000.0;     // m AGL
+    double kh = 5000.0;             // horizontal diffusivity (m^2/s)
+    double kz = 50.0;               // vertical diffusivity in the mixed layer (m^2/s)
+    double sampling_start = 0.0;    // hours
+    double sampling_stop = 24.0;
+    double sampling_interval = 1.0;
+    long seed = 0;
+    Species species;
+    SplitMerge split_merge;
+    bool transfer_matrix = false;   // record the receptor x source-time matrix
+    double release_period = 0.0;    // hours per matrix column, 0 = whole release
+};
+
+struct Result {
+    std::vector<double> samples;     // n_samples * cells
+    std::vector<double> deposition;  // n_samples * plane, mass per m^2
+    std::vector<double> sample_start, sample_stop;
+    Particles particles;
+    double time_step = 0.0;
+    long n_steps = 0;
+    long n_released = 0;
+    long n_merged = 0;
+    long n_split = 0;
+    bool maxpar_reached = false;
+
+    // Transfer-coefficient matrix in CSR form, rows sample * cells + cell and
+    // columns source * release_periods + period
+    std::vector<int64_t> tcm_indptr;
+    std::vector<int32_t> tcm_indices;
+    std::vector<double> tcm_data;
+    long release_periods = 0;
+};
+
+// Advance one particle by dt seconds; returns false when it leaves the met domain.
+// The mixing depth and precipitation at the start position are stored for the
+// removal kernel.
+static bool advance_particle(const MetField& m, const Options& opt, double settling, double t0,
+                             double dt_s, uint64_t key, double& lat, double& lon, double& z,
+                             double& env_mixd, double& env_prec) {
+    const double dt_h = dt_s / 3600.0;
+    const double t1 = t0 + opt.direction * dt_h;
+    const double sdt = opt.direction * dt_s;
+
+    lon = m.wrap_lon(lon);
+    Wind w0, w1;
+    if (!sample_wind(m, t0, lat, lon, z, w0)) return false;
+
+    // Predictor step
+    double plat = lat + w0.v * sdt / METERS_PER_DEGREE;
+    double plon = lon + w0.u * sdt / (METERS_PER_DEGREE * std::max(std::cos(lat * DEG_TO_RAD), 1e-6));
+    double pz = std::max(z + w0.w * sdt, 0.0);
+    plon = m.wrap_lon(plon);
+    if (!sample_wind(m, t1, plat, plon, pz, w1)) return false;
+
+    // Corrector step with the mean of both velocities
+    const double u = 0.5 * (w0.u + w1.u);
+    const double v = 0.5 * (w0.v + w1.v);
+    const double w = 0.5 * (w0.w + w1.w);
+
+    double mixd = opt.kmix0;
+    if (m.mixd) mixd = std::max(mixd, sample_surface(m, m.mixd, t0, lat, lon));
+    env_mixd = mixd;
+    env_prec = m.prec ? sample_surface(m, m.prec, t0, lat, lon) : 0.0;
+
+    double n1, n2, n3, n4;
+    normal_pair(key, n1, n2);
+    normal_pair(key ^ 0x632BE59BD9B4E019ULL, n3, n4);
+    const double sigma_h = std::sqrt(2.0 * opt.kh * dt_s);
+    const double kz = z < mixd ? opt.kz : 0.01 * opt.kz;
+    const double sigma_z = std::sqrt(2.0 * kz * dt_s);
+
+    const double dx = u * sdt + sigma_h * n1;
+    const double dy = v * sdt + sigma_h * n2;
+    lat += dy / METERS_PER_DEGREE;
+    lon += dx / (METERS_PER_DEGREE * std::max(std::cos(lat * DEG_TO_RAD), 1e-6));
+    z += (w - settling) * sdt + sigma_z * n3;
+
+    // Reflect at the ground and the model top
+    if (z < 0.0) z = -z;
+    if (z > opt.model_top) z = std::max(2.0 * opt.model_top - z, 0.0);
+
+    if (lat > 90.0 || lat < -90.0) return false;
+    lon = m.wrap_lon(lon);
+    return lat >= m.lats[0] && lat <= m.lats[m.ny - 1] && lon >= m.lons[0] &&
+           lon <= m.lons[m.nx - 1];
+}
+
+static void simulate(const MetField& met, const std::vector<Source>& sources,
+                     const std::vector<EmissionRecord>& records,
+                     const ConcGrid& grid, const Options& opt, Result& res) {
+    const double dt_min = opt.time_step > 0.0 ? opt.time_step : select_time_step(met, opt.tratio);
+    const double dt_h = dt_min / 60.0;
+    const double dt_s = dt_min * 60.0;
+    const double eps = 1e-9;
+    const long n_steps = static_cast<long>(std::ceil(opt.duration / dt_h - eps));
+    res.time_step = dt_min;
+    res.n_steps = n_steps;
+
+    // Sampling periods, clipped to the run duration
+    const double stop = std::min(opt.sampling_stop, opt.duration);
+    for (double s = opt.sampling_start; s + opt.sampling_interval <= stop + eps;
+         s += opt.sampling_interval) {
+        res.sample_start.push_back(s);
+        res.sample_stop.push_back(s + opt.sampling_interval);
+    }
+    const size_t n_samples = res.sample_start.size();
+    res.samples.assign(n_samples * grid.cells(), 0.0);
+    res.deposition.assign(n_samples * grid.plane(), 0.0);
+
+    const EmissionTable emissions =
+        build_emission_table(records, static_cast<long>(sources.size()), n_steps, dt_h, opt.numpar);
+
+    const int n_threads = thread_count();
+    GridAccumulator accumulator(grid.cells(), n_threads);
+    GridAccumulator deposited(grid.plane(), n_threads);
+    const Removal removal = removal_constants(opt.species);
+    Particles& parts = res.particles;
+    parts.reserve(static_cast<size_t>(std::max(0L, opt.maxpar)));
+    uint64_t next_id = 1;
+    const uint64_t seed_key = mix64(static_cast<uint64_t>(opt.seed));
+    size_t sample = 0;
+
+    // Inverse volume of each cell, shared by every sampling period
+    std::vector<double> inv_volume(grid.cells(), 0.0);
+    for (int k = 0; k < grid.nlev; k++) {
+        const double depth = grid.layer_depth(k);
+        for (int j = 0; j < grid.nlat; j++) {
+            const double volume = depth * grid.cell_area(j);
+            for (int i = 0; i < grid.nlon; i++) {
+                inv_volume[k * grid.plane() + static_cast<size_t>(j) * grid.nlon + i] =
+                    volume > 0.0 ? 1.0 / volume : 0.0;
+            }
+        }
+    }
+
+    // Transfer matrix columns and the per-cell factor that turns mass-hours into
+    // concentration (or deposited mass into mass per area on level-0 layers)
+    const double period = opt.release_period;
+    const long n_periods =
+        period > 0.0 ? std::max(1L, static_cast<long>(std::ceil(n_steps * dt_h / period - eps))) : 1;
+    TransferMatrix tcm(opt.transfer_matrix ? sources.size() * n_periods : 1, n_threads);
+    std::vector<double> tcm_scale;
+    std::vector<int> deposition_layers;
+    for (int k = 0; k < grid.nlev; k++) {
+        if (grid.levels[k] <= 0.0) deposition_layers.push_back(k);
+    }
+    if (opt.transfer_matrix) {
+        tcm_scale.resize(grid.cells());
+        for (size_t c = 0; c < grid.cells(); c++) {
+            const int k = static_cast<int>(c / grid.plane());
+            const int j = static_cast<int>((c % grid.plane()) / grid.nlon);
+            tcm_scale[c] = grid.levels[k] <= 0.0 ? 1.0 / grid.cell_area(j)
+                                                 : inv_volume[c] / opt.sampling_interval;
+        }
+    }
+
+    for (long step = 0; step < n_steps; step++) {
+        const double elapsed = step * dt_h;
+
+        // Release this step's particles of each emitting source in one block
+        for (size_t s = 0; s < sources.size(); s++) {
+            const double step_mass = emissions.step_mass(s, step);
+            if (step_mass <= 0.0) continue;
+            const long room = std::max(0L, opt.maxpar - static_cast<long>(parts.size()));
+            const long n = std::min(emissions.count[s], room);
+            if (n < emissions.count[s]) res.maxpar_reached = true;
+            if (n == 0) continue;
+            const Source& src = sources[s];
+            parts.append(static_cast<size_t>(n), src.lat, src.lon, src.height,
+                         step_mass / emissions.count[s], elapsed, static_cast<int32_t>(s), next_id);
+            next_id += n;
+            res.n_released += n;
+        }
+
+        const double t0 = opt.direction * elapsed;
+        const long n_parts = static_cast<long>(parts.size());
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            // Each thread owns one contiguous chunk of particles for every phase
+            const int tid = thread_id();
+            const int team = team_size();
+            const long begin = n_parts * tid / team;
+            const long end = n_parts * (tid + 1) / team;
+
+            for (long p = begin; p < end; p++) {
+                if (!parts.active[p]) continue;
+                const uint64_t key = mix64(seed_key ^ mix64(parts.id[p])) + static_cast<uint64_t>(step);
+                if (!advance_particle(met, opt, removal.settling, t0, dt_s, key, parts.lat[p],
+                                      parts.lon[p], parts.z[p], parts.env_mixd[p],
+                                      parts.env_prec[p])) {
+                    parts.active[p] = 0;
+                }
+            }
+
+            if (removal.enabled()) {
+                removal_kernel(removal, begin, end, dt_s, parts.active.data(), parts.z.data(),
+                               parts.env_mixd.data(), parts.env_prec.data(), parts.mass.data(),
+                               parts.lost.data());
+            }
+        }
+
+        // Credit the step to every sampling period it overlaps, by the hours of
+        // overlap, so steps need not divide the sampling interval
+        const double step_end = elapsed + dt_h;
+        while (sample < n_samples && res.sample_start[sample] < step_end - eps) {
+            const double overlap = std::min(step_end, res.sample_stop[sample]) -
+                                   std::max(elapsed, res.sample_start[sample]);
+            if (overlap > eps) {
+                const double lost_share = overlap / dt_h;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+                {
+                    const int tid = thread_id();
+                    const int team = team_size();
+                    const long begin = n_parts * tid / team;
+                    const long end = n_parts * (tid + 1) / team;
+                    double* local = accumulator.local(tid);
+                    double* local_dep = deposited.local(tid);
+                    for (long p = begin; p < end; p++) {
+                        if (!parts.active[p]) continue;
+                        const long column = grid.column(parts.lat[p], parts.lon[p]);
+                        if (column < 0) continue;
+                        const double lost = removal.enabled() ? parts.lost[p] * lost_share : 0.0;
+                        local_dep[column] += lost;
+                        const int k = grid.layer(parts.z[p]);
+                        if (k >= 0) local[k * grid.plane() + column] += parts.mass[p] * overlap;
+
+                        if (opt.transfer_matrix) {
+                            long q = 0;
+                            if (period > 0.0) {
+                                q = std::min(n_periods - 1,
+                                             static_cast<long>(std::floor(parts.release[p] / period + eps)));
+                            }
+                            const size_t source_time = static_cast<size_t>(parts.source[p]) * n_periods + q;
+                            if (k >= 0) {
+                                tcm.add(tid, k * grid.plane() + column, source_time, parts.mass[p] * overlap);
+                            }
+                            if (lost > 0.0) {
+                                for (int kd : deposition_layers) {
+                                    tcm.add(tid, kd * grid.plane() + column, source_time, lost);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            if (res.sample_stop[sample] > step_end + eps) break;
+
+            // Close the sampling period: mass-hours become mean concentration, deposited
+            // mass becomes mass per unit area (also reported on any level-0 layer)
+            double* out = res.samples.data() + sample * grid.cells();
+            double* dep = res.deposition.data() + sample * grid.plane();
+            accumulator.reduce(out);
+            deposited.reduce(dep);
+            const double inv_period = 1.0 / opt.sampling_interval;
+            for (size_t c = 0; c < grid.cells(); c++) out[c] *= inv_volume[c] * inv_period;
+            for (int j = 0; j < grid.nlat; j++) {
+                const double inv_area = 1.0 / grid.cell_area(j);
+                for (int i = 0; i < grid.nlon; i++) dep[static_cast<size_t>(j) * grid.nlon + i] *= inv_area;
+            }
+            for (int k : deposition_layers) std::copy(dep, dep + grid.plane(), out + k * grid.plane());
+            if (opt.transfer_matrix) tcm.close_sample(grid.cells(), tcm_scale);
+            sample++;
+        }
+
+        // Periodic merging and splitting on whole-hour boundaries
+        const SplitMerge& sm = opt.split_merge;
+        const double done = elapsed + dt_h;
+        if (sm.krnd > 0.0 && std::fabs(std::remainder(done, sm.krnd)) < eps) {
+            res.n_merged += merge_particles(parts, sm, grid.dlat, grid.dlon, opt.model_top, done,
+                                            opt.transfer_matrix ? period : 0.0);
+        }
+        if (sm.kspl > 0.0 && std::fabs(std::remainder(done, sm.kspl)) < eps) {
+            // Leave room for the particles that are still to be released
+            const long target = std::min(opt.numpar, opt.maxpar) - emissions.pending[step + 1];
+            res.n_split += split_particles(parts, sm, target, sources.size(), next_id);
+        }
+
+        if ((step + 1) % COMPACT_INTERVAL == 0) parts.compact();
+    }
+    parts.compact();
+
+    if (opt.transfer_matrix) {
+        res.tcm_indptr = std::move(tcm.indptr);
+        res.tcm_indices = std::move(tcm.indices);
+        res.tcm_data = std::move(tcm.data);
+        res.release_periods = n_periods;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Python interface
+// ---------------------------------------------------------------------------
+
+static PyObject* vector_to_array(const std::vector<double>& values, int ndim, npy_intp* dims) {
+    PyObject* array = PyArray_SimpleNew(ndim, dims, NPY_DOUBLE);
+    if (!array) return NULL;
+    if (!values.empty()) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), values.data(),
+                    values.size() * sizeof(double));
+    }
+    return array;
+}
+
+template <typename T>
+static PyObject* typed_array(const std::vector<T>& values, int type_num) {
+    npy_intp dims[1] = {static_cast<npy_intp>(values.size())};
+    PyObject* array = PyArray_SimpleNew(1, dims, type_num);
+    if (!array) return NULL;
+    if (!values.empty()) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), values.data(),
+                    values.size() * sizeof(T));
+    }
+    return array;
+}
+
+/**
+ * Run a dispersion simulation on an in-memory met field.
+ *
+ * Takes four dictionaries (met, sources, grid, options) and returns a dict
+ * with the concentration and deposition grids, sampling periods and final
+ * particle state.
+ */
+static PyObject* run_dispersion(PyObject* self, PyObject* args) {
+    PyObject *met_dict, *src_dict, *grid_dict, *opt_dict;
+    if (!PyArg_ParseTuple(args, "O!O!O!O!", &PyDict_Type, &met_dict, &PyDict_Type, &src_dict,
+                          &PyDict_Type, &grid_dict, &PyDict_Type, &opt_dict)) {
+        return NULL;
+    }
+
+    // Meteorology
+    MetField met;
+    MetArrays met_arrays;
+    if (!met_arrays.load(met_dict, met)) {
+        return NULL;
+    }
+
+    // Sources
+    DoubleArray s_lat, s_lon, s_height, s_rate, s_start, s_duration;
+    if (!dict_array(src_dict, "lat", 1, s_lat, true) ||
+        !dict_array(src_dict, "lon", 1, s_lon, true) ||
+        !dict_array(src_dict, "height", 1, s_height, true) ||
+        !dict_array(src_dict, "rate", 1, s_rate, true) ||
+        !dict_array(src_dict, "start", 1, s_start, true) ||
+        !dict_array(src_dict, "duration", 1, s_duration, true)) {
+        return NULL;
+    }
+    const npy_intp n_sources = s_lat.size();
+    if (s_lon.size() != n_sources || s_height.size() != n_sources || s_rate.size() != n_sources ||
+        s_start.size() != n_sources || s_duration.size() != n_sources) {
+        PyErr_SetString(PyExc_ValueError, "source arrays must all have the same length");
+        return NULL;
+    }
+    std::vector<Source> sources(n_sources);
+    for (npy_intp s = 0; s < n_sources; s++) {
+        sources[s] = {s_lat.data()[s], s_lon.data()[s], s_height.data()[s],
+                      s_rate.data()[s], s_start.data()[s], s_duration.data()[s]};
+    }
+
+    // Optional time-varying emissions; otherwise each source emits its constant rate
+    DoubleArray e_source, e_start, e_duration, e_rate;
+    if (!dict_array(src_dict, "emission_source", 1, e_source, false) ||
+        !dict_array(src_dict, "emission_start", 1, e_start, false) ||
+        !dict_array(src_dict, "emission_duration", 1, e_duration, false) ||
+        !dict_array(src_dict, "emission_rate", 1, e_rate, false)) {
+        return NULL;
+    }
+    std::vector<EmissionRecord> records;
+    if (e_source.empty()) {
+        for (npy_intp s = 0; s < n_sources; s++) {
+            records.push_back({static_cast<int32_t>(s), sources[s].start, sources[s].duration,
+                               sources[s].rate});
+        }
+    } else {
+        const npy_intp n_records = e_source.size();
+        if (e_start.size() != n_records || e_duration.size() != n_records ||
+            e_rate.size() != n_records) {
+            PyErr_SetString(PyExc_ValueError, "emission arrays must all have the same length");
+            return NULL;
+        }
+        records.resize(n_records);
+        for (npy_intp r = 0; r < n_records; r++) {
+            const double src = e_source.data()[r];
+            if (!(src >= 0.0 && src < static_cast<double>(n_sources))) {
+                PyErr_SetString(PyExc_ValueError, "emission_source index out of range");
+                return NULL;
+            }
+            records[r] = {static_cast<int32_t>(src), e_start.data()[r], e_duration.data()[r],
+                          e_rate.data()[r]};
+        }
+    }
+
+    // Concentration grid
+    ConcGrid grid;
+    DoubleArray levels;
+    long nlat = 0, nlon = 0;
+    if (!dict_double(grid_dict, "ll_lat", grid.ll_lat) ||
+        !dict_double(grid_dict, "ll_lon", grid.ll_lon) ||
+        !dict_double(grid_dict, "dlat", grid.dlat) || !dict_double(grid_dict, "dlon", grid.dlon) ||
+        !dict_long(grid_dict, "nlat", nlat) || !dict_long(grid_dict, "nlon", nlon) ||
+        !dict_array(grid_dict, "levels", 1, levels, true)) {
+        return NULL;
+    }
+    if (nlat < 1 || nlon < 1 || grid.dlat <= 0.0 || grid.dlon <= 0.0 || levels.size() < 1) {
+        PyErr_SetString(PyExc_ValueError, "concentration grid must have positive size and spacing");
+        return NULL;
+    }
+    grid.nlat = static_cast<int>(nlat);
+    grid.nlon = static_cast<int>(nlon);
+    grid.levels.assign(levels.data(), levels.data() + levels.size());
+    grid.nlev = static_cast<int>(grid.levels.size());
+
+    // Run options
+    Options opt;
+    long direction = 1;
+    long transfer_matrix = 0;
+    CdumpHeader cdump;
+    long start_minutes = 0, packed = 1;
+    if (!dict_double(opt_dict, "duration", opt.duration) ||
+        !dict_long(opt_dict, "direction", direction) ||
+        !dict_double(opt_dict, "time_step", opt.time_step) ||
+        !dict_double(opt_dict, "tratio", opt.tratio) ||
+        !dict_long(opt_dict, "numpar", opt.numpar) || !dict_long(opt_dict, "maxpar", opt.maxpar) ||
+        !dict_double(opt_dict, "kmix0", opt.kmix0) ||
+        !dict_double(opt_dict, "model_top", opt.model_top) ||
+        !dict_double(opt_dict, "kh", opt.kh) || !dict_double(opt_dict, "kz", opt.kz) ||
+        !dict_double(opt_dict, "sampling_start", opt.sampling_start) ||
+        !dict_double(opt_dict, "sampling_stop", opt.sampling_stop) ||
+        !dict_double(opt_dict, "sampling_interval", opt.sampling_interval) ||
+        !dict_long(opt_dict, "seed", opt.seed) ||
+        !dict_long(opt_dict, "transfer_matrix", transfer_matrix) ||
+        !dict_double(opt_dict, "release_period", opt.release_period) ||
+        !dict_double(opt_dict, "kspl", opt.split_merge.kspl) ||
+        !dict_double(opt_dict, "krnd", opt.split_merge.krnd) ||
+        !dict_double(opt_dict, "frhs", opt.split_merge.frhs) ||
+        !dict_double(opt_dict, "frvs", opt.split_merge.frvs) ||
+        !dict_double(opt_dict, "frts", opt.split_merge.frts) ||
+        !dict_double(opt_dict, "frhmax", opt.split_merge.frhmax) ||
+        !dict_double(opt_dict, "splitf", opt.split_merge.splitf) ||
+        !dict_double(opt_dict, "particle_diameter", opt.species.diameter) ||
+        !dict_double(opt_dict, "particle_density", opt.species.density) ||
+        !dict_double(opt_dict, "particle_shape", opt.species.shape) ||
+        !dict_double(opt_dict, "deposition_velocity", opt.species.dep_velocity) ||
+        !dict_double(opt_dict, "henry_constant", opt.species.henry) ||
+        !dict_double(opt_dict, "in_cloud_scavenging", opt.species.in_cloud) ||
+        !dict_double(opt_dict, "below_cloud_scavenging", opt.species.below_cloud) ||
+        !dict_string(opt_dict, "cdump_path", cdump.path) ||
+        !dict_string(opt_dict, "met_id", cdump.met_id) ||
+        !dict_long(opt_dict, "start_minutes", start_minutes) ||
+        !dict_long(opt_dict, "cpack", packed)) {
+        return NULL;
+    }
+    opt.direction = direction < 0 ? -1 : 1;
+    opt.transfer_matrix = transfer_matrix != 0;
+    cdump.start_minutes = start_minutes;
+    cdump.packed = packed != 0;
+    if (opt.duration <= 0.0 || opt.sampling_interval <= 0.0) {
+        PyErr_SetString(PyExc_ValueError, "duration and sampling_interval must be positive");
+        return NULL;
+    }
+
+    Result res;
+    bool written = true;
+    Py_BEGIN_ALLOW_THREADS
+    simulate(met, sources, records, grid, opt, res);
+    if (!cdump.path.empty()) {
+        written = write_cdump(cdump, grid, sources, res.samples, res.sample_start, res.sample_stop);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!written) {
+        PyErr_Format(PyExc_OSError, "Cannot write concentration file '%s'", cdump.path.c_str());
+        return NULL;
+    }
+
+    // Final particle state: id, lat, lon, height, mass
+    const Particles& parts = res.particles;
+    std::vector<double> state(parts.size() * 5);
+    for (size_t p = 0; p < parts.size(); p++) {
+        state[p * 5 + 0] = static_cast<double>(parts.id[p]);
+        state[p * 5 + 1] = parts.lat[p];
+        state[p * 5 + 2] = parts.lon[p];
+        state[p * 5 + 3] = parts.z[p];
+        state[p * 5 + 4] = parts.mass[p];
+    }
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    npy_intp conc_dims[4] = {static_cast<npy_intp>(res.sample_start.size()), grid.nlev, grid.nlat,
+                             grid.nlon};
+    npy_intp dep_dims[3] = {static_cast<npy_intp>(res.sample_start.size()), grid.nlat, grid.nlon};
+    npy_intp sample_dims[1] = {static_cast<npy_intp>(res.sample_start.size())};
+    npy_intp part_dims[2] = {static_cast<npy_intp>(parts.size()), 5};
+    if (set_item(result, "concentration", vector_to_array(res.samples, 4, conc_dims)) < 0 ||
+        set_item(result, "deposition", vector_to_array(res.deposition, 3, dep_dims)) < 0 ||
+        set_item(result, "sample_start", vector_to_array(res.sample_start, 1, sample_dims)) < 0 ||
+        set_item(result, "sample_stop", vector_to_array(res.sample_stop, 1, sample_dims)) < 0 ||
+        set_item(result, "particles", vector_to_array(state, 2, part_dims)) < 0 ||
+        set_item(result, "time_step", PyFloat_FromDouble(res.time_step)) < 0 ||
+        set_item(result, "n_steps", PyLong_FromLong(res.n_steps)) < 0 ||
+        set_item(result, "n_released", PyLong_FromLong(res.n_released)) < 0 ||
+        set_item(result, "n_merged", PyLong_FromLong(res.n_merged)) < 0 ||
+        set_item(result, "n_split", PyLong_FromLong(res.n_split)) < 0 ||
+        set_item(result, "maxpar_reached", PyBool_FromLong(res.maxpar_reached)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    if (opt.transfer_matrix &&
+        (set_item(result, "tcm_indptr", typed_array(res.tcm_indptr, NPY_INT64)) < 0 ||
+         set_item(result, "tcm_indices", typed_array(res.tcm_indices, NPY_INT32)) < 0 ||
+         set_item(result, "tcm_data", typed_array(res.tcm_data, NPY_DOUBLE)) < 0 ||
+         set_item(result, "release_periods", PyLong_FromLong(res.release_periods)) < 0)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Method definitions
+static PyMethodDef ParticleMethods[] = {
+    {"run_dispersion", run_dispersion, METH_VARARGS,
+     "Run a particle dispersion simulation with online concentration gridding.\n\n"
+     "Args:\n"
+     "    met (dict): Met field arrays (times, lats, lons, heights, u, v, w)\n"
+     "    sources (dict): Source arrays (lat, lon, height, rate, start, duration) and\n"
+     "        optional emission records (emission_source, emission_start,\n"
+     "        emission_duration, emission_rate)\n"
+     "    grid (dict): Concentration grid (ll_lat, ll_lon, dlat, dlon, nlat, nlon, levels)\n"
+     "    options (dict): Run options (duration, direction, sampling, physics, deposition)\n\n"
+     "Returns:\n"
+     "    dict: Concentration and deposition grids, sampling periods and final particles,\n"
+     "    plus the CSR transfer matrix (tcm_indptr, tcm_indices, tcm_data) when the\n"
+     "    transfer_matrix option is set"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef particlesmodule = {
+    PyModuleDef_HEAD_INIT,
+    "_particles",
+    "Native Lagrangian particle engine for HYSPLIT dispersion runs.",
+    -1,
+    ParticleMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__particles(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&particlesmodule);
+}
@@ -0,0 +1,111 @@
+/**
+ * Argument helpers shared by the native extensions: views of numpy
+ * arguments, optional entries of options dicts and result dicts.
+ *
+ * Include after Python.h and numpy/arrayobject.h.
+ */
+
+#ifndef HYSPLIT_PY_ARGS_H
+#define HYSPLIT_PY_ARGS_H
+
+#include <string>
+
+// C-contiguous float64 view of a numpy argument, released on destruction
+class DoubleArray {
+public:
+    PyArrayObject* array = nullptr;
+
+    ~DoubleArray() { Py_XDECREF(array); }
+
+    bool load(PyObject* obj, int ndim, const char* name) {
+        array = reinterpret_cast<PyArrayObject*>(
+            PyArray_FROMANY(obj, NPY_DOUBLE, ndim, ndim, NPY_ARRAY_IN_ARRAY));
+        if (!array) {
+            PyErr_Format(PyExc_ValueError, "'%s' must be a %d-D numeric array", name, ndim);
+            return false;
+        }
+        return true;
+    }
+
+    bool empty() const { return array == nullptr; }
+    const double* data() const {
+        return array ? static_cast<const double*>(PyArray_DATA(array)) : nullptr;
+    }
+    npy_intp dim(int i) const { return PyArray_DIM(array, i); }
+    npy_intp size() const { return array ? PyArray_SIZE(array) : 0; }
+};
+
+// C-contiguous view of a 1-D numpy argument of a fixed dtype
+class Array1D {
+public:
+    PyArrayObject* array = nullptr;
+
+    ~Array1D() { Py_XDECREF(array); }
+
+    bool load(PyObject* obj, int type_num, const char* name) {
+        array = reinterpret_cast<PyArrayObject*>(
+            PyArray_FROMANY(obj, type_num, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST));
+        if (!array) {
+            PyErr_Format(PyExc_ValueError, "'%s' must be a 1-D numeric array", name);
+            return false;
+        }
+        return true;
+    }
+
+    bool empty() const { return array == nullptr; }
+    npy_intp size() const { return array ? PyArray_SIZE(array) : 0; }
+    template <typename T>
+    const T* data() const {
+        return array ? static_cast<const T*>(PyArray_DATA(array)) : nullptr;
+    }
+};
+
+inline bool dict_array(PyObject* dict, const char* key, int ndim, DoubleArray& out,
+                       bool required) {
+    PyObject* obj = PyDict_GetItemString(dict, key);
+    if (obj == nullptr || obj == Py_None) {
+        if (required) {
+            PyErr_Format(PyExc_KeyError, "missing required array '%s'", key);
+            return false;
+        }
+        return true;
+    }
+    return out.load(obj, ndim, key);
+}
+
+inline bool dict_double(PyObject* dict, const char* key, double& out) {
+    PyObject* obj = PyDict_GetItemString(dict, key);
+    if (obj == nullptr || obj == Py_None) return true;
+    double value = PyFloat_AsDouble(obj);
+    if (value == -1.0 && PyErr_Occurred()) return false;
+    out = value;
+    return true;
+}
+
+inline bool dict_long(PyObject* dict, const char* key, long& out) {
+    PyObject* obj = PyDict_GetItemString(dict, key);
+    if (obj == nullptr || obj == Py_None) return true;
+    long value = PyLong_AsLong(obj);
+    if (value == -1 && PyErr_Occurred()) return false;
+    out = value;
+    return true;
+}
+
+inline bool dict_string(PyObject* dict, const char* key, std::string& out) {
+    PyObject* obj = PyDict_GetItemString(dict, key);
+    if (obj == nullptr || obj == Py_None) return true;
+    const char* value = PyUnicode_AsUTF8(obj);
+    if (!value) return false;
+    out = value;
+    return true;
+}
+
+// Stores a new reference in a dict, stealing it; -1 (error set) if value is NULL
+inline int set_item(PyObject* dict, const char* key, PyObject* value) {
+    if (!value) return -1;
+    int rc = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+    return rc;
+}
+
+#endif  // HYSPLIT_PY_ARGS_H
@@ -0,0 +1,742 @@
+/**
+ * Spatial-temporal index over trajectory segments.
+ *
+ * Answers "which trajectories passed within r km of a site / through a box
+ * / along a corridor, between two times and two heights" without scanning
+ * the archive. Every segment between consecutive points is entered in the
+ * cells of a global lat/lon grid that its bounding box overlaps (hourly
+ * segments are short and similar in size, so a uniform grid prunes as well
+ * as an R-tree and is built in two linear passes). Within a cell, entries
+ * are sorted by the segment's start time, so a time window is a binary
+ * search plus a contiguous scan.
+ *
+ * A candidate segment is tested exactly on the part of it inside the time
+ * window and height band (positions, times and heights interpolated
+ * linearly along it, the short way round in longitude):
+ *   radius    closest approach to the site in a local tangent plane
+ *   corridor  closest approach to each leg of a polyline, likewise
+ *   bbox      Liang-Barsky clipping against the box
+ * and hits are reduced to one row per trajectory, at its closest approach
+ * (the first entry, for boxes). Reported distances are great-circle.
+ *
+ * The index itself is three arrays (cell offsets, segment entries and the
+ * largest segment duration), which the Python side persists next to the
+ * point arrays.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "earth.h"
+#include "py_args.h"
+
+// ---------------------------------------------------------------------------
+// Argument helpers
+// ---------------------------------------------------------------------------
+
+// New 1-D array holding a copy of values
+template <typename T>
+static PyObject* vector_array(const std::vector<T>& values, int type_num) {
+    npy_intp dims[1] = {static_cast<npy_intp>(values.size())};
+    PyObject* array = PyArray_SimpleNew(1, dims, type_num);
+    if (array && !values.empty()) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), values.data(),
+                    values.size() * sizeof(T));
+    }
+    return array;
+}
+
+// ---------------------------------------------------------------------------
+// Geometry
+// ---------------------------------------------------------------------------
+
+constexpr double DEG = M_PI / 180.0;
+constexpr double KM_PER_DEG = EARTH_RADIUS_KM * DEG;
+constexpr double HUGE_VALUE = std::numeric_limits<double>::max();
+
+// Longitude difference the short way round, in [-180, 180)
+static inline double wrap_lon(double dlon) {
+    return dlon - 360.0 * std::floor((dlon + 180.0) / 360.0);
+}
+
+static double haversine_km(double lat1, double lon1, double lat2, double lon2) {
+    const double s_phi = std::sin(0.5 * (lat2 - lat1) * DEG);
+    const double s_lam = std::sin(0.5 * wrap_lon(lon2 - lon1) * DEG);
+    const double h = s_phi * s_phi + std::cos(lat1 * DEG) * std::cos(lat2 * DEG) * s_lam * s_lam;
+    return 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(std::min(h, 1.0)));
+}
+
+// Narrow [ta, tb] to where v0 + (v1 - v0) t lies in [lo, hi]; false if empty
+static inline bool clip_linear(double v0, double v1, double lo, double hi, double& ta, double& tb) {
+    const double dv = v1 - v0;
+    if (dv == 0.0) return lo <= v0 && v0 <= hi && ta <= tb;
+    double a = (lo - v0) / dv, b = (hi - v0) / dv;
+    if (a > b) std::swap(a, b);
+    ta = std::max(ta, a);
+    tb = std::min(tb, b);
+    return ta <= tb;
+}
+
+struct Vec2 {
+    double x, y;
+};
+
+static inline Vec2 operator-(Vec2 a, Vec2 b) { return {a.x - b.x, a.y - b.y}; }
+static inline Vec2 operator+(Vec2 a, Vec2 b) { return {a.x + b.x, a.y + b.y}; }
+static inline Vec2 operator*(double s, Vec2 a) { return {s * a.x, s * a.y}; }
+static inline double dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+
+// Local tangent plane (km) about a reference point
+struct Plane {
+    double lat0, lon0, kx;
+
+    Plane(double lat, double lon) : lat0(lat), lon0(lon), kx(KM_PER_DEG * std::cos(lat * DEG)) {}
+
+    Vec2 project(double lat, double lon) const {
+        return {kx * wrap_lon(lon - lon0), KM_PER_DEG * (lat - lat0)};
+    }
+};
+
+/**
+ * Closest points of segments p0-p1 and q0-q1 (Ericson, Real-Time Collision
+ * Detection 5.1.9); s and u are the parameters along them.
+ */
+static void closest_segments(Vec2 p0, Vec2 p1, Vec2 q0, Vec2 q1, double& s, double& u) {
+    const Vec2 d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+    const double a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+    constexpr double EPS = 1e-12;
+    if (a <= EPS && e <= EPS) {
+        s = u = 0.0;
+        return;
+    }
+    if (a <= EPS) {
+        s = 0.0;
+        u = std::clamp(f / e, 0.0, 1.0);
+        return;
+    }
+    const double c = dot(d1, r);
+    if (e <= EPS) {
+        u = 0.0;
+        s = std::clamp(-c / a, 0.0, 1.0);
+        return;
+    }
+    const double b = dot(d1, d2), denom = a * e - b * b;
+    s = denom > EPS ? std::clamp((b * f - c * e) / denom, 0.0, 1.0) : 0.0;
+    u = (b * s + f) / e;
+    if (u < 0.0) {
+        u = 0.0;
+        s = std::clamp(-c / a, 0.0, 1.0);
+    } else if (u > 1.0) {
+        u = 1.0;
+        s = std::clamp((b - c) / a, 0.0, 1.0);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Index
+// ---------------------------------------------------------------------------
+
+// Global grid of the index; column 0 starts at 180 W
+struct CellGrid {
+    double res = 1.0;
+    int64_t nlat = 180, nlon = 360;
+
+    explicit CellGrid(double resolution)
+        : res(resolution),
+          nlat(static_cast<int64_t>(std::ceil(180.0 / resolution))),
+          nlon(static_cast<int64_t>(std::ceil(360.0 / resolution))) {}
+
+    int64_t cells() const { return nlat * nlon; }
+
+    int64_t row(double lat) const {
+        return std::clamp(static_cast<int64_t>(std::floor((lat + 90.0) / res)), int64_t(0), nlat - 1);
+    }
+
+    // Visit the cells overlapping [lat_lo, lat_hi] x [lon_lo, lon_hi]; the
+    // longitudes may run past +-180 (unwrapped)
+    template <typename Visit>
+    void for_cells(double lat_lo, double lat_hi, double lon_lo, double lon_hi, Visit&& visit) const {
+        const int64_t r0 = row(lat_lo), r1 = row(lat_hi);
+        int64_t c0 = static_cast<int64_t>(std::floor((lon_lo + 180.0) / res));
+        int64_t c1 = static_cast<int64_t>(std::floor((lon_hi + 180.0) / res));
+        if (c1 - c0 + 1 >= nlon) {
+            c0 = 0;
+            c1 = nlon - 1;
+        }
+        for (int64_t r = r0; r <= r1; r++) {
+            for (int64_t c = c0; c <= c1; c++) {
+                const int64_t col = ((c % nlon) + nlon) % nlon;
+                visit(r * nlon + col);
+            }
+        }
+    }
+};
+
+struct Archive {
+    const float* lat;
+    const float* lon;
+    const float* height;
+    const double* time;
+    const int64_t* offsets;
+    int64_t n_traj;
+    int64_t n_points;
+};
+
+// Bounding box of segment p -> p + 1 with unwrapped longitudes
+static inline void segment_box(const Archive& a, int64_t p, double& lat_lo, double& lat_hi,
+                               double& lon_lo, double& lon_hi) {
+    const double lon0 = a.lon[p], lon1 = lon0 + wrap_lon(a.lon[p + 1] - lon0);
+    lat_lo = std::min<double>(a.lat[p], a.lat[p + 1]);
+    lat_hi = std::max<double>(a.lat[p], a.lat[p + 1]);
+    lon_lo = std::min(lon0, lon1);
+    lon_hi = std::max(lon0, lon1);
+}
+
+static inline double segment_tmin(const Archive& a, uint32_t p) {
+    return std::min(a.time[p], a.time[p + 1]);
+}
+
+// Cells of every segment (CSR), sorted by segment start time within a cell
+static void build(const Archive& a, const CellGrid& grid, std::vector<int64_t>& cell_start,
+                  std::vector<uint32_t>& entries, double& max_duration) {
+    const int64_t cells = grid.cells();
+    cell_start.assign(cells + 1, 0);
+    max_duration = 0.0;
+    for (int64_t k = 0; k < a.n_traj; k++) {
+        for (int64_t p = a.offsets[k]; p + 1 < a.offsets[k + 1]; p++) {
+            double lat_lo, lat_hi, lon_lo, lon_hi;
+            segment_box(a, p, lat_lo, lat_hi, lon_lo, lon_hi);
+            grid.for_cells(lat_lo, lat_hi, lon_lo, lon_hi, [&](int64_t c) { cell_start[c + 1]++; });
+            max_duration = std::max(max_duration, std::fabs(a.time[p + 1] - a.time[p]));
+        }
+    }
+    for (int64_t c = 0; c < cells; c++) cell_start[c + 1] += cell_start[c];
+
+    entries.resize(static_cast<size_t>(cell_start[cells]));
+    std::vector<int64_t> fill(cell_start.begin(), cell_start.end() - 1);
+    for (int64_t k = 0; k < a.n_traj; k++) {
+        for (int64_t p = a.offsets[k]; p + 1 < a.offsets[k + 1]; p++) {
+            double lat_lo, lat_hi, lon_lo, lon_hi;
+            segment_box(a, p, lat_lo, lat_hi, lon_lo, lon_hi);
+            grid.for_cells(lat_lo, lat_hi, lon_lo, lon_hi,
+                           [&](int64_t c) { entries[fill[c]++] = static_cast<uint32_t>(p); });
+        }
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for (int64_t c = 0; c < cells; c++) {
+        std::sort(entries.begin() + cell_start[c], entries.begin() + cell_start[c + 1],
+                  [&](uint32_t x, uint32_t y) {
+                      const double tx = segment_tmin(a, x), ty = segment_tmin(a, y);
+                      return tx < ty || (tx == ty && x < y);
+                  });
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+// ---------------------------------------------------------------------------
+
+enum class Kind { Radius, BBox, Corridor };
+
+struct Query {
+    Kind kind = Kind::Radius;
+    double t0 = 0.0, t1 = 0.0;                  // time window
+    double z0 = 0.0, z1 = 0.0;                  // height band
+    bool timed = false, banded = false;
+    double distance_km = 0.0;                   // radius or corridor half-width
+    double lat_lo = 0.0, lat_hi = 0.0, lon_lo = 0.0, lon_hi = 0.0;   // bbox
+    const double* path_lat = nullptr;           // site (one point) or corridor
+    const double* path_lon = nullptr;
+    int64_t path_points = 0;
+};
+
+struct Hit {
+    int64_t segment;
+    double t;          // fraction along the segment
+    double distance;   // km
+
+    // Closest, then first along the trajectory
+    bool better(const Hit& other) const {
+        if (distance != other.distance) return distance < other.distance;
+        if (segment != other.segment) return segment < other.segment;
+        return t < other.t;
+    }
+};
+
+// Best hit of every trajectory hit so far
+class BestHits {
+public:
+    // A zeroed slot per trajectory: large vectors come from fresh zero pages,
+    // so only the pages of the trajectories hit are touched
+    explicit BestHits(const Archive& a) : archive(a), slot(static_cast<size_t>(a.n_traj), 0) {}
+
+    void add(const Hit& hit) {
+        const int64_t k = trajectory_of(hit.segment);
+        int32_t& s = slot[k];
+        if (s == 0) {
+            hits.push_back({k, hit});
+            s = static_cast<int32_t>(hits.size());
+        } else if (hit.better(hits[s - 1].second)) {
+            hits[s - 1].second = hit;
+        }
+    }
+
+    // (trajectory, hit) pairs by trajectory
+    std::vector<std::pair<int64_t, Hit>> sorted() const {
+        std::vector<std::pair<int64_t, Hit>> out(hits);
+        std::sort(out.begin(), out.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+        return out;
+    }
+
+private:
+    const Archive& archive;
+    std::vector<int32_t> slot;                    // 1 + position in hits, 0 if none
+    std::vector<std::pair<int64_t, Hit>> hits;
+
+    // Trajectory holding point p (branch-free binary search of the offsets)
+    int64_t trajectory_of(int64_t p) const {
+        const int64_t* base = archive.offsets;
+        int64_t n = archive.n_traj;
+        while (n > 1) {
+            const int64_t half = n / 2;
+            base = base[half] <= p ? base + half : base;
+            n -= half;
+        }
+        return base - archive.offsets;
+    }
+};
+
+// Part [ta, tb] of segment p within the time window and height band
+static inline bool window(const Archive& a, const Query& q, int64_t p, double& ta, double& tb) {
+    ta = 0.0;
+    tb = 1.0;
+    if (q.timed && !clip_linear(a.time[p], a.time[p + 1], q.t0, q.t1, ta, tb)) return false;
+    if (q.banded && !clip_linear(a.height[p], a.height[p + 1], q.z0, q.z1, ta, tb)) return false;
+    return true;
+}
+
+static inline void position(const Archive& a, int64_t p, double t, double& lat, double& lon) {
+    lat = a.lat[p] + (static_cast<double>(a.lat[p + 1]) - a.lat[p]) * t;
+    lon = a.lon[p] + wrap_lon(static_cast<double>(a.lon[p + 1]) - a.lon[p]) * t;
+}
+
+// A leg q0-q1 of the query polyline, projected on its own tangent plane
+struct Leg {
+    double lat0, lon0, lat1, lon1;
+    double lat_lo, lat_hi;   // latitudes within reach of the leg
+    Plane plane;
+    Vec2 q0, q1;
+    double x_lo, x_hi;       // plane x within reach of the leg at those latitudes
+    double reject_sq;        // squared plane distance beyond which nothing is in reach
+
+    Leg(double lat0_, double lon0_, double lat1_, double lon1_, double distance_km)
+        : lat0(lat0_), lon0(lon0_), lat1(lat1_), lon1(lon1_),
+          plane(0.5 * (lat0_ + lat1_), lon0_ + 0.5 * wrap_lon(lon1_ - lon0_)),
+          q0(plane.project(lat0_, lon0_)), q1(plane.project(lat1_, lon1_)) {
+        // No point is closer to the leg than its distance along a meridian
+        const double dlat = distance_km / KM_PER_DEG + 1e-6;
+        lat_lo = std::min(lat0, lat1) - dlat;
+        lat_hi = std::max(lat0, lat1) + dlat;
+        // Longitude reach as for the candidate cells, scaled to the plane
+        const double coslat = std::cos(std::min(std::max(std::fabs(lat_lo), std::fabs(lat_hi)), 90.0) * DEG);
+        x_lo = -HUGE_VALUE;
+        x_hi = HUGE_VALUE;
+        reject_sq = HUGE_VALUE;
+        if (coslat * 180.0 * KM_PER_DEG > 2.0 * distance_km) {
+            // The plane stretches east-west distances by at most this much
+            const double stretch = std::max(plane.kx / (KM_PER_DEG * coslat), 1.0);
+            const double reach = distance_km * stretch + 1e-6;
+            x_lo = std::min(q0.x, q1.x) - reach;
+            x_hi = std::max(q0.x, q1.x) + reach;
+            const double far = 1.01 * reach + 1.0;
+            reject_sq = far * far;
+        }
+    }
+};
+
+// Closest approach of the windowed segment to a polyline leg
+static bool test_leg(const Archive& a, const Query& q, int64_t p, double ta, double tb, const Leg& leg,
+                     Hit& hit) {
+    if (std::max(a.lat[p], a.lat[p + 1]) < leg.lat_lo || std::min(a.lat[p], a.lat[p + 1]) > leg.lat_hi) {
+        return false;
+    }
+    const Vec2 A = leg.plane.project(a.lat[p], a.lon[p]);
+    const Vec2 d = leg.plane.project(a.lat[p + 1], a.lon[p + 1]) - A;
+    if (std::max(A.x, A.x + d.x) < leg.x_lo || std::min(A.x, A.x + d.x) > leg.x_hi) return false;
+    double s, u;
+    const Vec2 P0 = A + ta * d, P1 = A + tb * d;
+    closest_segments(P0, P1, leg.q0, leg.q1, s, u);
+    const Vec2 gap = (P0 + s * (P1 - P0)) - (leg.q0 + u * (leg.q1 - leg.q0));
+    if (dot(gap, gap) > leg.reject_sq) return false;
+    const double t = ta + (tb - ta) * s;
+    double lat, lon;
+    position(a, p, t, lat, lon);
+    const double dist = haversine_km(lat, lon, leg.lat0 + (leg.lat1 - leg.lat0) * u,
+                                     leg.lon0 + wrap_lon(leg.lon1 - leg.lon0) * u);
+    if (dist > q.distance_km) return false;
+    hit = {p, t, dist};
+    return true;
+}
+
+// First entry of the windowed segment into the box (Liang-Barsky)
+static bool test_box(const Archive& a, const Query& q, int64_t p, double ta, double tb, Hit& hit) {
+    if (std::max(a.lat[p], a.lat[p + 1]) < q.lat_lo || std::min(a.lat[p], a.lat[p + 1]) > q.lat_hi) {
+        return false;
+    }
+    const double dlon = wrap_lon(static_cast<double>(a.lon[p + 1]) - a.lon[p]);
+    const double lon_lo = a.lon[p] + std::min(dlon, 0.0), lon_hi = a.lon[p] + std::max(dlon, 0.0);
+    double best = HUGE_VALUE;
+    // The segment may meet the box a turn of the globe either way
+    for (double shift : {-360.0, 0.0, 360.0}) {
+        if (lon_hi + shift < q.lon_lo || lon_lo + shift > q.lon_hi) continue;
+        double lo = ta, hi = tb;
+        if (clip_linear(a.lon[p] + shift, a.lon[p] + shift + dlon, q.lon_lo, q.lon_hi, lo, hi) &&
+            clip_linear(a.lat[p], a.lat[p + 1], q.lat_lo, q.lat_hi, lo, hi)) {
+            best = std::min(best, lo);
+        }
+    }
+    if (best == HUGE_VALUE) return false;
+    hit = {p, best, 0.0};
+    return true;
+}
+
+// Candidate cells of a query leg (or the box), with a margin in km
+template <typename Visit>
+static void candidate_cells(const CellGrid& grid, double lat0, double lon0, double lat1, double lon1,
+                            double margin_km, Visit&& visit) {
+    const double lon_a = lon0, lon_b = lon0 + wrap_lon(lon1 - lon0);
+    const double dlat = margin_km / KM_PER_DEG;
+    const double lat_lo = std::max(std::min(lat0, lat1) - dlat, -90.0);
+    const double lat_hi = std::min(std::max(lat0, lat1) + dlat, 90.0);
+    const double coslat = std::cos(std::max(std::fabs(lat_lo), std::fabs(lat_hi)) * DEG);
+    double dlon = 360.0;
+    if (coslat * 180.0 * KM_PER_DEG > margin_km) dlon = margin_km / (KM_PER_DEG * coslat);
+    grid.for_cells(lat_lo, lat_hi, std::min(lon_a, lon_b) - dlon, std::max(lon_a, lon_b) + dlon,
+                   std::forward<Visit>(visit));
+}
+
+static void run_query(const Archive& a, const CellGrid& grid, const int64_t* cell_start,
+                      const uint32_t* entries, double max_duration, const Query& q,
+                      BestHits& hits) {
+    auto scan_cell = [&](int64_t c, auto&& test) {
+        const uint32_t* begin = entries + cell_start[c];
+        const uint32_t* end = entries + cell_start[c + 1];
+        if (q.timed) {
+            // Segments overlapping [t0, t1] start within [t0 - max_duration, t1]
+            const double from = q.t0 - max_duration;
+            begin = std::lower_bound(begin, end, from,
+                                     [&](uint32_t p, double t) { return segment_tmin(a, p) < t; });
+        }
+        for (const uint32_t* e = begin; e != end; e++) {
+            if (q.timed && segment_tmin(a, *e) > q.t1) break;
+            double ta, tb;
+            if (!window(a, q, *e, ta, tb)) continue;
+            Hit hit;
+            if (test(*e, ta, tb, hit)) hits.add(hit);
+        }
+    };
+
+    if (q.kind == Kind::BBox) {
+        auto test = [&](int64_t p, double ta, double tb, Hit& hit) { return test_box(a, q, p, ta, tb, hit); };
+        const double width = q.lon_hi - q.lon_lo;
+        grid.for_cells(q.lat_lo, q.lat_hi, q.lon_lo, q.lon_lo + width,
+                       [&](int64_t c) { scan_cell(c, test); });
+        return;
+    }
+    // Radius: a single-point polyline
+    const int64_t legs = std::max<int64_t>(q.path_points - 1, 1);
+    for (int64_t leg = 0; leg < legs; leg++) {
+        const int64_t i0 = leg, i1 = std::min(leg + 1, q.path_points - 1);
+        const Leg l(q.path_lat[i0], q.path_lon[i0], q.path_lat[i1], q.path_lon[i1], q.distance_km);
+        auto test = [&](int64_t p, double ta, double tb, Hit& hit) { return test_leg(a, q, p, ta, tb, l, hit); };
+        candidate_cells(grid, l.lat0, l.lon0, l.lat1, l.lon1, q.distance_km,
+                        [&](int64_t c) { scan_cell(c, test); });
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Python interface
+// ---------------------------------------------------------------------------
+
+struct ArchiveArgs {
+    Array1D lat, lon, height, time, offsets;
+    Archive archive{};
+
+    bool load(PyObject* lat_obj, PyObject* lon_obj, PyObject* height_obj, PyObject* time_obj,
+              PyObject* offsets_obj) {
+        if (!lat.load(lat_obj, NPY_FLOAT32, "lat") || !lon.load(lon_obj, NPY_FLOAT32, "lon") ||
+            !height.load(height_obj, NPY_FLOAT32, "height") ||
+            !time.load(time_obj, NPY_DOUBLE, "time") || !offsets.load(offsets_obj, NPY_INT64, "offsets")) {
+            return false;
+        }
+        const npy_intp n = lat.size();
+        if (lon.size() != n || height.size() != n || time.size() != n) {
+            PyErr_SetString(PyExc_ValueError, "lat, lon, height and time must have the same length");
+            return false;
+        }
+        const int64_t* offs = offsets.data<int64_t>();
+        const npy_intp n_traj = offsets.size() - 1;
+        if (n_traj < 0 || offs[0] != 0 || offs[n_traj] != n) {
+            PyErr_SetString(PyExc_ValueError, "offsets must run from 0 to the number of points");
+            return false;
+        }
+        if (static_cast<uint64_t>(n) > std::numeric_limits<uint32_t>::max()) {
+            PyErr_SetString(PyExc_ValueError, "at most 2**32 - 1 points per index");
+            return false;
+        }
+        archive = {lat.data<float>(), lon.data<float>(), height.data<float>(), time.data<double>(),
+                   offs, static_cast<int64_t>(n_traj), static_cast<int64_t>(n)};
+        return true;
+    }
+};
+
+/**
+ * Build the segment index of an archive.
+ *
+ * Returns a dict with cell_start (cells + 1 offsets into entries), entries
+ * (segment start points, by cell) and max_duration.
+ */
+static PyObject* build_index(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj, *height_obj, *time_obj, *offsets_obj;
+    double resolution = 1.0;
+    if (!PyArg_ParseTuple(args, "OOOOO|d", &lat_obj, &lon_obj, &height_obj, &time_obj,
+                          &offsets_obj, &resolution)) {
+        return NULL;
+    }
+    ArchiveArgs archive;
+    if (!archive.load(lat_obj, lon_obj, height_obj, time_obj, offsets_obj)) return NULL;
+    // Columns must tile the globe, so wrapped longitudes land in the same cells
+    if (!(resolution > 0.0 && resolution <= 90.0) ||
+        std::fabs(360.0 / resolution - std::round(360.0 / resolution)) > 1e-9) {
+        PyErr_SetString(PyExc_ValueError, "resolution must divide 360 degrees (at most 90)");
+        return NULL;
+    }
+    const int64_t* offs = archive.archive.offsets;
+    for (int64_t k = 0; k < archive.archive.n_traj; k++) {
+        if (offs[k + 1] < offs[k]) {
+            PyErr_SetString(PyExc_ValueError, "offsets must be non-decreasing");
+            return NULL;
+        }
+    }
+
+    const CellGrid grid(resolution);
+    std::vector<int64_t> cell_start;
+    std::vector<uint32_t> entries;
+    double max_duration = 0.0;
+    Py_BEGIN_ALLOW_THREADS
+    build(archive.archive, grid, cell_start, entries, max_duration);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    if (set_item(result, "cell_start", vector_array(cell_start, NPY_INT64)) < 0 ||
+        set_item(result, "entries", vector_array(entries, NPY_UINT32)) < 0 ||
+        set_item(result, "max_duration", PyFloat_FromDouble(max_duration)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static bool parse_query(PyObject* dict, Query& q, Array1D& path_lat, Array1D& path_lon) {
+    PyObject* kind = PyDict_GetItemString(dict, "kind");
+    const char* name = kind ? PyUnicode_AsUTF8(kind) : nullptr;
+    if (!name) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "query needs a 'kind'");
+        return false;
+    }
+    if (std::strcmp(name, "radius") == 0) {
+        q.kind = Kind::Radius;
+    } else if (std::strcmp(name, "corridor") == 0) {
+        q.kind = Kind::Corridor;
+    } else if (std::strcmp(name, "bbox") == 0) {
+        q.kind = Kind::BBox;
+    } else {
+        PyErr_Format(PyExc_ValueError, "Unknown query kind '%s'", name);
+        return false;
+    }
+    // Windows need both (finite) bounds: -ffast-math assumes no infinities
+    q.timed = PyDict_GetItemString(dict, "t0") != nullptr;
+    q.banded = PyDict_GetItemString(dict, "z0") != nullptr;
+    if (q.timed != (PyDict_GetItemString(dict, "t1") != nullptr) ||
+        q.banded != (PyDict_GetItemString(dict, "z1") != nullptr)) {
+        PyErr_SetString(PyExc_ValueError, "time and height windows need both bounds");
+        return false;
+    }
+    if (!dict_double(dict, "t0", q.t0) || !dict_double(dict, "t1", q.t1) ||
+        !dict_double(dict, "z0", q.z0) || !dict_double(dict, "z1", q.z1) ||
+        !dict_double(dict, "distance_km", q.distance_km)) {
+        return false;
+    }
+
+    if (q.kind == Kind::BBox) {
+        if (!dict_double(dict, "lat_lo", q.lat_lo) || !dict_double(dict, "lat_hi", q.lat_hi) ||
+            !dict_double(dict, "lon_lo", q.lon_lo) || !dict_double(dict, "lon_hi", q.lon_hi)) {
+            return false;
+        }
+        // A box across the date line has lon_hi < lon_lo
+        if (q.lon_hi < q.lon_lo) q.lon_hi += 360.0;
+        if (!(q.lat_hi >= q.lat_lo)) {
+            PyErr_SetString(PyExc_ValueError, "lat_hi must not be below lat_lo");
+            return false;
+        }
+        return true;
+    }
+    PyObject* lat_obj = PyDict_GetItemString(dict, "lat");
+    PyObject* lon_obj = PyDict_GetItemString(dict, "lon");
+    if (!lat_obj || !lon_obj) {
+        PyErr_SetString(PyExc_ValueError, "radius and corridor queries need 'lat' and 'lon'");
+        return false;
+    }
+    if (!path_lat.load(lat_obj, NPY_DOUBLE, "lat") || !path_lon.load(lon_obj, NPY_DOUBLE, "lon")) {
+        return false;
+    }
+    if (path_lat.size() < 1 || path_lon.size() != path_lat.size()) {
+        PyErr_SetString(PyExc_ValueError, "query lat and lon need the same, non-zero length");
+        return false;
+    }
+    if (!(q.distance_km >= 0.0)) {
+        PyErr_SetString(PyExc_ValueError, "distance_km must not be negative");
+        return false;
+    }
+    q.path_lat = path_lat.data<double>();
+    q.path_lon = path_lon.data<double>();
+    q.path_points = path_lat.size();
+    return true;
+}
+
+/**
+ * Trajectories matching a radius, bbox or corridor query.
+ *
+ * Returns a dict of arrays with one entry per matching trajectory:
+ * trajectory, point (segment start), fraction (along the segment),
+ * distance_km, lat, lon, time and height at the reported position.
+ */
+static PyObject* query_index(PyObject* self, PyObject* args) {
+    PyObject *lat_obj, *lon_obj, *height_obj, *time_obj, *offsets_obj;
+    PyObject *cell_obj, *entries_obj, *query_dict;
+    double resolution, max_duration;
+    if (!PyArg_ParseTuple(args, "OOOOOOOddO!", &lat_obj, &lon_obj, &height_obj, &time_obj,
+                          &offsets_obj, &cell_obj, &entries_obj, &resolution, &max_duration,
+                          &PyDict_Type, &query_dict)) {
+        return NULL;
+    }
+    ArchiveArgs archive;
+    Array1D cell_start, entries, path_lat, path_lon;
+    if (!archive.load(lat_obj, lon_obj, height_obj, time_obj, offsets_obj) ||
+        !cell_start.load(cell_obj, NPY_INT64, "cell_start") ||
+        !entries.load(entries_obj, NPY_UINT32, "entries")) {
+        return NULL;
+    }
+    const CellGrid grid(resolution);
+    if (!(resolution > 0.0) || cell_start.size() != grid.cells() + 1 ||
+        cell_start.data<int64_t>()[grid.cells()] != entries.size()) {
+        PyErr_SetString(PyExc_ValueError, "index arrays do not match the resolution");
+        return NULL;
+    }
+    Query q;
+    if (!parse_query(query_dict, q, path_lat, path_lon)) return NULL;
+
+    const Archive& a = archive.archive;
+    BestHits best(a);
+    std::vector<std::pair<int64_t, Hit>> hits;
+    Py_BEGIN_ALLOW_THREADS
+    run_query(a, grid, cell_start.data<int64_t>(), entries.data<uint32_t>(), max_duration, q, best);
+    hits = best.sorted();
+    Py_END_ALLOW_THREADS
+
+    const size_t n = hits.size();
+    std::vector<int64_t> traj(n), point(n);
+    std::vector<double> fraction(n), distance(n), lat(n), lon(n), time(n), height(n);
+    for (size_t i = 0; i < n; i++) {
+        const Hit& h = hits[i].second;
+        traj[i] = hits[i].first;
+        const int64_t p = h.segment;
+        point[i] = p;
+        fraction[i] = h.t;
+        distance[i] = h.distance;
+        position(a, p, h.t, lat[i], lon[i]);
+        lon[i] -= 360.0 * std::floor((lon[i] + 180.0) / 360.0);
+        time[i] = a.time[p] + (a.time[p + 1] - a.time[p]) * h.t;
+        height[i] = a.height[p] + (static_cast<double>(a.height[p + 1]) - a.height[p]) * h.t;
+    }
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    if (set_item(result, "trajectory", vector_array(traj, NPY_INT64)) < 0 ||
+        set_item(result, "point", vector_array(point, NPY_INT64)) < 0 ||
+        set_item(result, "fraction", vector_array(fraction, NPY_DOUBLE)) < 0 ||
+        set_item(result, "distance_km", vector_array(distance, NPY_DOUBLE)) < 0 ||
+        set_item(result, "lat", vector_array(lat, NPY_DOUBLE)) < 0 ||
+        set_item(result, "lon", vector_array(lon, NPY_DOUBLE)) < 0 ||
+        set_item(result, "time", vector_array(time, NPY_DOUBLE)) < 0 ||
+        set_item(result, "height", vector_array(height, NPY_DOUBLE)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Method definitions
+static PyMethodDef SpatialIndexMethods[] = {
+    {"build_index", build_index, METH_VARARGS,
+     "Build the segment index of a trajectory archive.\n\n"
+     "Args:\n"
+     "    lat, lon, height (numpy.ndarray): float32 points grouped by trajectory,\n"
+     "        in time order within each\n"
+     "    time (numpy.ndarray): float64 time of every point (e.g. hours)\n"
+     "    offsets (numpy.ndarray): Start of every trajectory, then the point count\n"
+     "    resolution (float): Cell size in degrees (default 1)\n\n"
+     "Returns:\n"
+     "    dict: cell_start, entries and max_duration"},
+
+    {"query_index", query_index, METH_VARARGS,
+     "Trajectories matching a radius, bbox or corridor query.\n\n"
+     "Args:\n"
+     "    lat, lon, height, time, offsets: Archive arrays as for build_index\n"
+     "    cell_start, entries (numpy.ndarray): Index from build_index\n"
+     "    resolution (float): Cell size the index was built with\n"
+     "    max_duration (float): Longest segment, from build_index\n"
+     "    query (dict): kind ('radius', 'corridor' or 'bbox'); lat, lon and\n"
+     "        distance_km (radius, corridor); lat_lo, lat_hi, lon_lo, lon_hi\n"
+     "        (bbox); optional t0 and t1 (time window), z0 and z1 (heights)\n\n"
+     "Returns:\n"
+     "    dict: trajectory, point, fraction, distance_km, lat, lon, time and\n"
+     "          height arrays, one entry per matching trajectory"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef spatialindexmodule = {
+    PyModuleDef_HEAD_INIT,
+    "_spatial_index",
+    "Spatial-temporal index over trajectory segments.",
+    -1,
+    SpatialIndexMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__spatial_index(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&spatialindexmodule);
+}
@@ -0,0 +1,690 @@
+/**
+ * Stand-in HYSPLIT executables for orchestration benchmarks.
+ *
+ * The package ships HYSPLIT binaries for macOS only, so the batch pipeline
+ * (config rendering, process spawn, output parsing, result transport)
+ * cannot be exercised on Linux CI machines. This program reads the CONTROL
+ * and SETUP.CFG files of the working directory like hyts_std / hycs_std,
+ * spends a configurable time, and writes outputs in the formats read by
+ * hysplit.io:
+ *   - hyts_std: a trajectory (tdump) file with hourly points of every
+ *     starting location and the diagnostic columns enabled by tm_* flags.
+ *   - hycs_std: a binary concentration (cdump) file on the CONTROL grid and
+ *     a text PARDUMP of particle positions (unless ndump = 0).
+ *
+ * Trajectories are a deterministic drift of the starting point; they are
+ * shaped like HYSPLIT output but carry no physical meaning.
+ *
+ * The mode is chosen from the executable name (a name containing "hycs"
+ * runs the dispersion stand-in). The time spent per run comes from the
+ * environment:
+ *   HYSPLIT_STANDIN_SLEEP  seconds to sleep (default 0)
+ *   HYSPLIT_STANDIN_CPU    seconds of busy CPU work (default 0)
+ *   HYSPLIT_STANDIN_FAIL   exit with this status after writing nothing
+ *   HYSPLIT_STANDIN_STALL  seconds of extra sleep of a straggling run
+ *   HYSPLIT_STANDIN_STALL_RATE  fraction of runs that straggle (default 0)
+ *
+ * Built into hysplit/bin/standin/ by: python setup.py build_ext --inplace
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Input files
+// ---------------------------------------------------------------------------
+
+struct Start {
+    double lat = 0.0, lon = 0.0, height = 0.0;
+    double rate = 1.0;
+};
+
+struct Grid {
+    double center_lat = 0.0, center_lon = 0.0;
+    double dlat = 0.1, dlon = 0.1;
+    double span_lat = 10.0, span_lon = 10.0;
+    std::string directory, file;
+    std::vector<double> levels;
+    int sample_start[5] = {0, 0, 0, 0, 0};
+    int sample_stop[5] = {0, 0, 0, 0, 0};
+    int interval_hours = 1;
+};
+
+struct Control {
+    int year = 0, month = 1, day = 1, hour = 0;  // 2-digit year
+    std::vector<Start> starts;
+    double run_hours = 24.0;
+    int vert_motion = 0;
+    std::vector<std::string> met_files;
+    std::string output_dir, output_file;  // trajectory output
+    std::string pollutant = "PART";
+    double release_hours = 1.0;
+    std::vector<Grid> grids;
+};
+
+// Non-empty, trimmed lines of a file
+static bool read_lines(const char* path, std::vector<std::string>& lines) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        const size_t last = line.find_last_not_of(" \t\r");
+        lines.push_back(line.substr(first, last - first + 1));
+    }
+    return true;
+}
+
+class LineReader {
+public:
+    explicit LineReader(const std::vector<std::string>& lines) : lines_(lines) {}
+
+    bool next(std::string& line) {
+        if (pos_ >= lines_.size()) return false;
+        line = lines_[pos_++];
+        return true;
+    }
+
+    // Whitespace separated numbers of the next line
+    bool numbers(std::vector<double>& values, size_t min_count) {
+        std::string line;
+        if (!next(line)) return false;
+        values.clear();
+        std::istringstream in(line);
+        double v;
+        while (in >> v) values.push_back(v);
+        return values.size() >= min_count;
+    }
+
+    bool number(double& value) {
+        std::vector<double> values;
+        if (!numbers(values, 1)) return false;
+        value = values[0];
+        return true;
+    }
+
+    // Directory line (with trailing slash) followed by a file name line
+    bool path(std::string& directory, std::string& file) {
+        if (!next(directory) || !next(file)) return false;
+        while (directory.size() > 1 && directory.back() == '/') directory.pop_back();
+        return true;
+    }
+
+private:
+    const std::vector<std::string>& lines_;
+    size_t pos_ = 0;
+};
+
+static bool parse_control(const std::vector<std::string>& lines, bool dispersion, Control& c) {
+    LineReader in(lines);
+    std::vector<double> v;
+    double value;
+
+    if (!in.numbers(v, 4)) return false;
+    c.year = static_cast<int>(v[0]);
+    c.month = static_cast<int>(v[1]);
+    c.day = static_cast<int>(v[2]);
+    c.hour = static_cast<int>(v[3]);
+
+    if (!in.number(value)) return false;
+    const int n_starts = static_cast<int>(value);
+    for (int i = 0; i < n_starts; i++) {
+        if (!in.numbers(v, 3)) return false;
+        Start s;
+        s.lat = v[0];
+        s.lon = v[1];
+        s.height = v[2];
+        if (v.size() > 3) s.rate = v[3];
+        c.starts.push_back(s);
+    }
+
+    if (!in.number(c.run_hours)) return false;
+    if (!in.number(value)) return false;
+    c.vert_motion = static_cast<int>(value);
+    if (!in.number(value)) return false;  // Model top
+    if (!in.number(value)) return false;
+    const int n_met = static_cast<int>(value);
+    for (int i = 0; i < n_met; i++) {
+        std::string directory, file;
+        if (!in.path(directory, file)) return false;
+        c.met_files.push_back(file);
+    }
+
+    if (!dispersion) return in.path(c.output_dir, c.output_file);
+
+    // Pollutants: count, then id, rate, hours, release start per pollutant
+    if (!in.number(value)) return false;
+    const int n_pollutants = static_cast<int>(value);
+    for (int i = 0; i < n_pollutants; i++) {
+        std::string id;
+        if (!in.next(id) || !in.number(value) || !in.number(c.release_hours) || !in.numbers(v, 1)) {
+            return false;
+        }
+        if (i == 0) c.pollutant = id;
+    }
+
+    // Concentration grids
+    if (!in.number(value)) return false;
+    const int n_grids = static_cast<int>(value);
+    for (int i = 0; i < n_grids; i++) {
+        Grid g;
+        if (!in.numbers(v, 2)) return false;
+        g.center_lat = v[0];
+        g.center_lon = v[1];
+        if (!in.numbers(v, 2)) return false;
+        g.dlat = v[0];
+        g.dlon = v[1];
+        if (!in.numbers(v, 2)) return false;
+        g.span_lat = v[0];
+        g.span_lon = v[1];
+        if (!in.path(g.directory, g.file) || !in.number(value)) return false;
+        const int n_levels = static_cast<int>(value);
+        for (int k = 0; k < n_levels; k++) {
+            if (!in.number(value)) return false;
+            g.levels.push_back(value);
+        }
+        if (!in.numbers(v, 5)) return false;
+        for (int k = 0; k < 5; k++) g.sample_start[k] = static_cast<int>(v[k]);
+        if (!in.numbers(v, 5)) return false;
+        for (int k = 0; k < 5; k++) g.sample_stop[k] = static_cast<int>(v[k]);
+        if (!in.numbers(v, 3)) return false;
+        g.interval_hours = static_cast<int>(v[1]);
+        c.grids.push_back(g);
+    }
+    // A grid center of 0 0 means the first source, as in HYSPLIT
+    for (Grid& g : c.grids) {
+        if (g.center_lat == 0.0 && g.center_lon == 0.0 && !c.starts.empty()) {
+            g.center_lat = c.starts[0].lat;
+            g.center_lon = c.starts[0].lon;
+        }
+    }
+    // Deposition records follow; the stand-in does not deposit
+    return !c.grids.empty();
+}
+
+// SETUP.CFG namelist as lower-case key -> unquoted value
+static std::map<std::string, std::string> parse_setup(const std::vector<std::string>& lines) {
+    std::map<std::string, std::string> setup;
+    for (const std::string& line : lines) {
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        for (char& ch : key) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        const size_t first = value.find_first_not_of(" \t'\"");
+        const size_t last = value.find_last_not_of(" \t,'\"");
+        setup[key] = first == std::string::npos || last < first ? "" : value.substr(first, last - first + 1);
+    }
+    return setup;
+}
+
+static int setup_int(const std::map<std::string, std::string>& setup, const char* key, int fallback) {
+    auto it = setup.find(key);
+    return it == setup.end() || it->second.empty() ? fallback : std::atoi(it->second.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Time
+// ---------------------------------------------------------------------------
+
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int& y, int& m, int& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    y = static_cast<int>(yoe + era * 400 + (m <= 2));
+}
+
+struct Stamp {
+    int year, month, day, hour, minute;  // 2-digit year
+};
+
+// Minutes since 1970-01-01 of a 2-digit-year stamp (HYSPLIT: < 40 is 20xx)
+static int64_t to_minutes(int yy, int month, int day, int hour, int minute) {
+    const int year = yy < 40 ? 2000 + yy : 1900 + yy;
+    return (days_from_civil(year, month, day) * 24 + hour) * 60 + minute;
+}
+
+static Stamp stamp_at(int64_t minutes) {
+    int64_t days = minutes / 1440;
+    int64_t rem = minutes % 1440;
+    if (rem < 0) {
+        rem += 1440;
+        days -= 1;
+    }
+    Stamp s;
+    civil_from_days(days, s.year, s.month, s.day);
+    s.year %= 100;
+    s.hour = static_cast<int>(rem / 60);
+    s.minute = static_cast<int>(rem % 60);
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Simulated work
+// ---------------------------------------------------------------------------
+
+static double env_seconds(const char* name) {
+    const char* value = std::getenv(name);
+    return value ? std::atof(value) : 0.0;
+}
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_seconds(double seconds) {
+    if (seconds <= 0.0) return;
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(seconds);
+    ts.tv_nsec = static_cast<long>((seconds - ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static void spend_time() {
+    sleep_seconds(env_seconds("HYSPLIT_STANDIN_SLEEP"));
+
+    // Stragglers are drawn independently per run
+    const double stall_rate = env_seconds("HYSPLIT_STANDIN_STALL_RATE");
+    if (stall_rate > 0.0) {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t x = (static_cast<uint64_t>(getpid()) << 32) ^ static_cast<uint64_t>(ts.tv_nsec)
+                     ^ static_cast<uint64_t>(ts.tv_sec) * 0x9E3779B97F4A7C15ull;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        if (static_cast<double>(x >> 11) * 0x1.0p-53 < stall_rate) {
+            sleep_seconds(env_seconds("HYSPLIT_STANDIN_STALL"));
+        }
+    }
+
+    const double cpu = env_seconds("HYSPLIT_STANDIN_CPU");
+    if (cpu > 0.0) {
+        const double deadline = now_seconds() + cpu;
+        volatile double sink = 1.0;
+        while (now_seconds() < deadline) {
+            for (int i = 0; i < 10000; i++) sink = sink * 1.0000001 + 1e-9;
+        }
+    }
+}
+
+// Deterministic drift of a trajectory point, in degrees per hour
+static void drift(const Start& s, double hours, double& lat, double& lon, double& height) {
+    const double phase = s.lat * 0.37 + s.lon * 0.11;
+    lat = s.lat + 0.08 * hours + 0.5 * (std::sin(phase + hours * 0.05) - std::sin(phase));
+    lon = s.lon + 0.25 * hours + 0.5 * (std::cos(phase + hours * 0.04) - std::cos(phase));
+    lat = std::fmax(-89.9, std::fmin(89.9, lat));
+    lon = std::fmod(lon + 540.0, 360.0) - 180.0;
+    height = std::fmax(0.0, s.height + 150.0 * std::sin(phase + hours * 0.1) * std::fmin(1.0, std::fabs(hours) / 12.0));
+}
+
+static double pressure_at(double height) {
+    return 1013.25 * std::pow(1.0 - 2.25577e-5 * std::fmin(height, 40000.0), 5.25588);
+}
+
+// ---------------------------------------------------------------------------
+// hyts_std: trajectory file
+// ---------------------------------------------------------------------------
+
+static const char* VERT_MOTION[] = {"OMEGA", "ISOBA", "ISENT", "DENSI", "SIGMA", "DIVERG", "ETA"};
+
+// tm_* flags in the order of the diagnostic columns HYSPLIT writes
+static const char* TM_FLAGS[][2] = {
+    {"tm_tpot", "THETA"}, {"tm_tamb", "AIR_TEMP"}, {"tm_rain", "RAINFALL"},
+    {"tm_mixd", "MIXDEPTH"}, {"tm_relh", "RELHUMID"}, {"tm_sphu", "SPCHUMID"},
+    {"tm_mixr", "H2OMIXRA"}, {"tm_terr", "TERR_MSL"}, {"tm_dswf", "SUN_FLUX"},
+};
+
+static double diagnostic(int column, double height, double pressure, double hours) {
+    const double t = 288.15 - 0.0065 * height;
+    switch (column) {
+        case 0: return t * std::pow(1000.0 / pressure, 0.286);     // THETA
+        case 1: return t;                                           // AIR_TEMP
+        case 2: return 0.0;                                         // RAINFALL
+        case 3: return 1000.0 + 400.0 * std::sin(hours * 0.26);     // MIXDEPTH
+        case 4: return 60.0;                                        // RELHUMID
+        case 5: return 6.0;                                         // SPCHUMID
+        case 6: return 6.0;                                         // H2OMIXRA
+        case 7: return 200.0;                                       // TERR_MSL
+        default: return std::fmax(0.0, 600.0 * std::sin(hours * 0.26));  // SUN_FLUX
+    }
+}
+
+static bool write_trajectory(const Control& c, const std::map<std::string, std::string>& setup) {
+    std::vector<int> columns;
+    for (int k = 0; k < 9; k++) {
+        if (setup_int(setup, TM_FLAGS[k][0], 0)) columns.push_back(k);
+    }
+
+    const std::string path = c.output_dir.empty() ? c.output_file : c.output_dir + "/" + c.output_file;
+    FILE* fp = std::fopen(path.c_str(), "w");
+    if (!fp) return false;
+
+    const int64_t t0 = to_minutes(c.year, c.month, c.day, c.hour, 0);
+    const Stamp s0 = stamp_at(t0);
+    const int n_met = c.met_files.empty() ? 1 : static_cast<int>(c.met_files.size());
+    std::fprintf(fp, "%6d%6d\n", n_met, 1);
+    for (int i = 0; i < n_met; i++) {
+        std::fprintf(fp, "%8s%6d%6d%6d%6d%6d\n", "STND", s0.year, s0.month, 1, 0, 0);
+    }
+    const int vm = c.vert_motion >= 0 && c.vert_motion < 7 ? c.vert_motion : 0;
+    std::fprintf(fp, "%6d %-8s %-8s\n", static_cast<int>(c.starts.size()),
+                 c.run_hours < 0 ? "BACKWARD" : "FORWARD", VERT_MOTION[vm]);
+    for (const Start& s : c.starts) {
+        std::fprintf(fp, "%6d%6d%6d%6d%9.3f%9.3f%9.1f\n",
+                     s0.year, s0.month, s0.day, s0.hour, s.lat, s.lon, s.height);
+    }
+    std::fprintf(fp, "%6d PRESSURE", static_cast<int>(columns.size()) + 1);
+    for (int k : columns) std::fprintf(fp, " %-8s", TM_FLAGS[k][1]);
+    std::fprintf(fp, "\n");
+
+    const int n_hours = static_cast<int>(std::fabs(c.run_hours));
+    const int sign = c.run_hours < 0 ? -1 : 1;
+    for (int h = 0; h <= n_hours; h++) {
+        const double age = sign * h;
+        const Stamp st = stamp_at(t0 + static_cast<int64_t>(age) * 60);
+        for (size_t i = 0; i < c.starts.size(); i++) {
+            double lat, lon, height;
+            drift(c.starts[i], age, lat, lon, height);
+            const double pressure = pressure_at(height);
+            std::fprintf(fp, "%6d%6d%6d%6d%6d%6d%6d%6d%8.1f%9.3f%9.3f%9.1f%9.1f",
+                         static_cast<int>(i + 1), 1, st.year, st.month, st.day, st.hour, 0, 0,
+                         age, lat, lon, height, pressure);
+            for (int k : columns) std::fprintf(fp, "%9.1f", diagnostic(k, height, pressure, age));
+            std::fprintf(fp, "\n");
+        }
+    }
+    return std::fclose(fp) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// hycs_std: cdump and PARDUMP
+// ---------------------------------------------------------------------------
+
+// Fortran sequential unformatted records: big-endian, 4-byte length markers
+class FortranWriter {
+public:
+    ~FortranWriter() { close(); }
+
+    bool open(const std::string& path) {
+        fp_ = std::fopen(path.c_str(), "wb");
+        return fp_ != nullptr;
+    }
+
+    bool close() {
+        bool ok = true;
+        if (fp_) ok = std::fclose(fp_) == 0;
+        fp_ = nullptr;
+        return ok;
+    }
+
+    void put_i32(int32_t value) { put_be(static_cast<uint32_t>(value), 4); }
+    void put_i16(int16_t value) { put_be(static_cast<uint16_t>(value), 2); }
+    void put_f32(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put_be(bits, 4);
+    }
+    void put_chars(const std::string& text, size_t width) {
+        for (size_t i = 0; i < width; i++) rec_.push_back(i < text.size() ? text[i] : ' ');
+    }
+    void put_stamp(const Stamp& s) {
+        put_i32(s.year); put_i32(s.month); put_i32(s.day); put_i32(s.hour);
+    }
+
+    bool end_record() {
+        const uint32_t n = static_cast<uint32_t>(rec_.size());
+        unsigned char marker[4] = {static_cast<unsigned char>(n >> 24),
+                                   static_cast<unsigned char>(n >> 16),
+                                   static_cast<unsigned char>(n >> 8),
+                                   static_cast<unsigned char>(n)};
+        bool ok = std::fwrite(marker, 1, 4, fp_) == 4;
+        ok = ok && std::fwrite(rec_.data(), 1, rec_.size(), fp_) == rec_.size();
+        ok = ok && std::fwrite(marker, 1, 4, fp_) == 4;
+        rec_.clear();
+        return ok;
+    }
+
+private:
+    void put_be(uint32_t value, int bytes) {
+        for (int b = bytes - 1; b >= 0; b--) rec_.push_back(static_cast<unsigned char>(value >> (8 * b)));
+    }
+
+    FILE* fp_ = nullptr;
+    std::vector<unsigned char> rec_;
+};
+
+// Splitmix64, for reproducible particle spread
+static double uniform(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return ((z ^ (z >> 31)) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+struct Particle {
+    double lat, lon, height, mass;
+};
+
+// Particles of all sources at an offset from the start; spread grows with age
+static std::vector<Particle> particles_at(const Control& c, int numpar, double hours) {
+    std::vector<Particle> out;
+    const double release = std::fmax(c.release_hours, 1e-6);
+    for (size_t s = 0; s < c.starts.size(); s++) {
+        uint64_t state = 0x5EED0000ULL + s;
+        for (int p = 0; p < numpar; p++) {
+            // Particles are released evenly over the emission period
+            const double released = release * (p + 0.5) / numpar;
+            const double age = hours - std::copysign(released, hours);
+            if (std::fabs(hours) < released) {
+                uniform(state); uniform(state); uniform(state);
+                continue;
+            }
+            Particle q;
+            drift(c.starts[s], age, q.lat, q.lon, q.height);
+            const double spread = 0.02 * std::sqrt(std::fabs(age) + 1.0);
+            q.lat += spread * (uniform(state) - 0.5) * 2.0;
+            q.lon += spread * (uniform(state) - 0.5) * 2.0;
+            q.height *= 0.5 + uniform(state);
+            q.mass = c.starts[s].rate * release / numpar;
+            out.push_back(q);
+        }
+    }
+    return out;
+}
+
+static bool write_cdump(const Control& c, const Grid& g, int numpar, bool packed) {
+    const std::string path = g.directory.empty() ? g.file : g.directory + "/" + g.file;
+    FortranWriter out;
+    if (!out.open(path)) return false;
+
+    const int nlat = std::max(1, static_cast<int>(std::lround(g.span_lat / g.dlat)) + 1);
+    const int nlon = std::max(1, static_cast<int>(std::lround(g.span_lon / g.dlon)) + 1);
+    const double ll_lat = g.center_lat - (nlat - 1) / 2.0 * g.dlat;
+    const double ll_lon = g.center_lon - (nlon - 1) / 2.0 * g.dlon;
+    const int64_t t0 = to_minutes(c.year, c.month, c.day, c.hour, 0);
+
+    out.put_chars("STND", 4);
+    out.put_stamp(stamp_at(t0));
+    out.put_i32(0);
+    out.put_i32(static_cast<int32_t>(c.starts.size()));
+    out.put_i32(packed ? 1 : 0);
+    bool ok = out.end_record();
+
+    for (const Start& s : c.starts) {
+        out.put_stamp(stamp_at(t0));
+        out.put_f32(static_cast<float>(s.lat));
+        out.put_f32(static_cast<float>(s.lon));
+        out.put_f32(static_cast<float>(s.height));
+        out.put_i32(0);
+        ok = ok && out.end_record();
+    }
+
+    out.put_i32(nlat); out.put_i32(nlon);
+    out.put_f32(static_cast<float>(g.dlat)); out.put_f32(static_cast<float>(g.dlon));
+    out.put_f32(static_cast<float>(ll_lat)); out.put_f32(static_cast<float>(ll_lon));
+    ok = ok && out.end_record();
+
+    out.put_i32(static_cast<int32_t>(g.levels.size()));
+    for (double level : g.levels) out.put_i32(static_cast<int32_t>(std::lround(level)));
+    ok = ok && out.end_record();
+
+    out.put_i32(1);
+    out.put_chars(c.pollutant, 4);
+    ok = ok && out.end_record();
+
+    // Sampling periods; a zero start means the run start, a zero stop the run end
+    const int64_t run_end = t0 + static_cast<int64_t>(std::lround(c.run_hours * 60.0));
+    int64_t start = g.sample_start[0] || g.sample_start[1]
+        ? to_minutes(g.sample_start[0], g.sample_start[1], g.sample_start[2], g.sample_start[3], g.sample_start[4])
+        : t0;
+    const int64_t stop = g.sample_stop[0] || g.sample_stop[1]
+        ? to_minutes(g.sample_stop[0], g.sample_stop[1], g.sample_stop[2], g.sample_stop[3], g.sample_stop[4])
+        : run_end;
+    const int64_t step = std::max(1, g.interval_hours) * 60;
+    const double volume_scale = 1.0 / (g.dlat * g.dlon * 1.2e10);
+
+    std::vector<double> plane(static_cast<size_t>(nlat) * nlon);
+    for (; start < stop && ok; start += step) {
+        const int64_t end = std::min(start + step, stop);
+        const Stamp a = stamp_at(start), b = stamp_at(end);
+        for (const Stamp& st : {a, b}) {
+            out.put_i32(st.year); out.put_i32(st.month); out.put_i32(st.day);
+            out.put_i32(st.hour); out.put_i32(st.minute); out.put_i32(0);
+            ok = ok && out.end_record();
+        }
+
+        const std::vector<Particle> particles = particles_at(c, numpar, (end - t0) / 60.0);
+        double bottom = 0.0;
+        for (double level : g.levels) {
+            std::fill(plane.begin(), plane.end(), 0.0);
+            const double depth = std::fmax(level - bottom, 1.0);
+            for (const Particle& q : particles) {
+                if (level > 0.0 && (q.height < bottom || q.height >= level)) continue;
+                const int j = static_cast<int>(std::lround((q.lat - ll_lat) / g.dlat));
+                const int i = static_cast<int>(std::lround((q.lon - ll_lon) / g.dlon));
+                if (j < 0 || j >= nlat || i < 0 || i >= nlon) continue;
+                plane[static_cast<size_t>(j) * nlon + i] += q.mass * volume_scale / (level > 0.0 ? depth : 1.0);
+            }
+            if (level > 0.0) bottom = level;
+
+            out.put_chars(c.pollutant, 4);
+            out.put_i32(static_cast<int32_t>(std::lround(level)));
+            if (packed) {
+                int32_t nonzero = 0;
+                for (double value : plane) nonzero += value > 0.0;
+                out.put_i32(nonzero);
+                for (int j = 0; j < nlat; j++) {
+                    for (int i = 0; i < nlon; i++) {
+                        const double value = plane[static_cast<size_t>(j) * nlon + i];
+                        if (value <= 0.0) continue;
+                        out.put_i16(static_cast<int16_t>(i + 1));
+                        out.put_i16(static_cast<int16_t>(j + 1));
+                        out.put_f32(static_cast<float>(value));
+                    }
+                }
+            } else {
+                for (double value : plane) out.put_f32(static_cast<float>(value));
+            }
+            ok = ok && out.end_record();
+        }
+    }
+    return out.close() && ok;
+}
+
+// Final particle positions as text rows: particle, lat, lon, height
+static bool write_pardump(const Control& c, const std::string& path, int numpar) {
+    FILE* fp = std::fopen(path.c_str(), "w");
+    if (!fp) return false;
+    const std::vector<Particle> particles = particles_at(c, numpar, c.run_hours);
+    for (size_t p = 0; p < particles.size(); p++) {
+        std::fprintf(fp, "%8zu %9.4f %10.4f %9.1f\n",
+                     p + 1, particles[p].lat, particles[p].lon, particles[p].height);
+    }
+    return std::fclose(fp) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    (void)argc;
+    const char* name = std::strrchr(argv[0], '/');
+    name = name ? name + 1 : argv[0];
+    const bool dispersion = std::strstr(name, "hycs") != nullptr;
+
+    std::vector<std::string> control_lines, setup_lines;
+    if (!read_lines("CONTROL", control_lines)) {
+        std::fprintf(stderr, "*ERROR* %s: cannot open CONTROL\n", name);
+        return 1;
+    }
+    read_lines("SETUP.CFG", setup_lines);  // Optional, as for HYSPLIT
+
+    Control control;
+    if (!parse_control(control_lines, dispersion, control)) {
+        std::fprintf(stderr, "*ERROR* %s: malformed CONTROL\n", name);
+        return 1;
+    }
+    const std::map<std::string, std::string> setup = parse_setup(setup_lines);
+
+    spend_time();
+
+    const char* fail = std::getenv("HYSPLIT_STANDIN_FAIL");
+    if (fail && std::atoi(fail) != 0) {
+        std::fprintf(stderr, "*ERROR* %s: failure requested by HYSPLIT_STANDIN_FAIL\n", name);
+        return std::atoi(fail);
+    }
+
+    bool ok = true;
+    if (dispersion) {
+        const int numpar = std::max(1, setup_int(setup, "numpar", 2500));
+        const bool packed = setup_int(setup, "cpack", 1) != 0;
+        for (const Grid& grid : control.grids) ok = ok && write_cdump(control, grid, numpar, packed);
+        if (setup_int(setup, "ndump", 1) > 0) {
+            auto it = setup.find("poutf");
+            const std::string poutf = it == setup.end() || it->second.empty() ? "PARDUMP" : it->second;
+            ok = ok && write_pardump(control, poutf, numpar);
+        }
+    } else {
+        ok = write_trajectory(control, setup);
+    }
+    if (!ok) {
+        std::fprintf(stderr, "*ERROR* %s: cannot write output: %s\n", name, std::strerror(errno));
+        return 1;
+    }
+    std::printf(" Complete Hysplit\n");
+    return 0;
+}
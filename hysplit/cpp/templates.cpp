@@ -0,0 +1,547 @@
+/**
+ * Native renderer for HYSPLIT input files (CONTROL, SETUP.CFG).
+ *
+ * A layout is compiled once from a subset of the Python format syntax into
+ * literal and field segments. Rendering formats numbers with std::to_chars
+ * into a thread-local buffer that is reused between calls, and the result
+ * is returned as bytes or written to a file (or memfd) with a single write.
+ * Output matches Python's str() and format() for the supported specs:
+ *
+ *   {}      str() of the value (floats as repr, strings unquoted)
+ *   {:q}    SETUP.CFG namelist value: None as '', strings quoted
+ *   {:.Nf}  fixed point with N decimals
+ *   {:g}    general format with 6 significant digits
+ *   {:d}    integer, {:0Nd} zero padded to N characters
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#endif
+
+enum class FieldKind { Literal, Str, Namelist, Fixed, General, Integer };
+
+struct Segment {
+    FieldKind kind;
+    std::string literal;  // Literal segments only
+    int precision = 0;    // Fixed: decimals, Integer: zero-padded width
+};
+
+struct Layout {
+    std::vector<Segment> segments;
+    int n_fields = 0;
+};
+
+static const char* kCapsuleName = "hysplit.template";
+
+static thread_local std::string buffer;
+
+// ---------------------------------------------------------------------------
+// Number formatting
+// ---------------------------------------------------------------------------
+
+// Non-finite test on the bit pattern, since -ffast-math folds std::isnan
+static bool is_finite(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return ((bits >> 52) & 0x7ff) != 0x7ff;
+}
+
+// Python repr() of a float: shortest round-trip digits, fixed notation for
+// decimal exponents in [-4, 16), scientific otherwise.
+static void append_repr(std::string& out, double value) {
+    if (!is_finite(value)) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (bits & ((uint64_t(1) << 52) - 1)) {
+            out += "nan";
+        } else {
+            out += (bits >> 63) ? "-inf" : "inf";
+        }
+        return;
+    }
+    char sci[32];
+    const auto res = std::to_chars(sci, sci + sizeof(sci), value, std::chars_format::scientific);
+    const char* end = res.ptr;
+    const char* e = static_cast<const char*>(std::memchr(sci, 'e', end - sci));
+    const char* p = sci;
+    if (*p == '-') {
+        out += '-';
+        p++;
+    }
+    std::string digits;
+    for (const char* c = p; c < e; c++) {
+        if (*c != '.') digits += *c;
+    }
+    int exponent = 0;
+    std::from_chars(e[1] == '+' ? e + 2 : e + 1, end, exponent);
+
+    if (exponent >= -4 && exponent < 16) {
+        const int n = static_cast<int>(digits.size());
+        if (exponent < 0) {
+            out += "0.";
+            out.append(static_cast<size_t>(-exponent - 1), '0');
+            out += digits;
+        } else if (exponent + 1 >= n) {
+            out += digits;
+            out.append(static_cast<size_t>(exponent + 1 - n), '0');
+            out += ".0";
+        } else {
+            out.append(digits, 0, exponent + 1);
+            out += '.';
+            out.append(digits, exponent + 1, std::string::npos);
+        }
+    } else {
+        out += digits[0];
+        if (digits.size() > 1) {
+            out += '.';
+            out.append(digits, 1, std::string::npos);
+        }
+        // Exponent as repr writes it: a sign and at least two digits
+        const int magnitude = exponent < 0 ? -exponent : exponent;
+        out += exponent < 0 ? "e-" : "e+";
+        if (magnitude < 10) out += '0';
+        char exp_buf[16];
+        out.append(exp_buf, std::to_chars(exp_buf, exp_buf + sizeof(exp_buf), magnitude).ptr);
+    }
+}
+
+static void append_chars(std::string& out, double value, std::chars_format fmt, int precision) {
+    if (!is_finite(value)) {
+        append_repr(out, value);
+        return;
+    }
+    char buf[384];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), value, fmt, precision);
+    out.append(buf, res.ptr);
+}
+
+// Appends str(obj); Python strings are copied as UTF-8
+static bool append_str(std::string& out, PyObject* obj) {
+    if (PyUnicode_Check(obj)) {
+        Py_ssize_t size;
+        const char* data = PyUnicode_AsUTF8AndSize(obj, &size);
+        if (!data) return false;
+        out.append(data, static_cast<size_t>(size));
+        return true;
+    }
+    if (PyFloat_Check(obj)) {
+        append_repr(out, PyFloat_AS_DOUBLE(obj));
+        return true;
+    }
+    if (PyLong_CheckExact(obj)) {
+        int overflow = 0;
+        const long long value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+        if (!overflow) {
+            char buf[24];
+            const auto res = std::to_chars(buf, buf + sizeof(buf), value);
+            out.append(buf, res.ptr);
+            return true;
+        }
+    }
+    PyObject* text = PyObject_Str(obj);
+    if (!text) return false;
+    const bool ok = append_str(out, text);
+    Py_DECREF(text);
+    return ok;
+}
+
+static bool append_field(std::string& out, const Segment& seg, PyObject* obj) {
+    switch (seg.kind) {
+        case FieldKind::Str:
+            return append_str(out, obj);
+
+        case FieldKind::Namelist:
+            if (obj == Py_None) {
+                out += "''";
+                return true;
+            }
+            if (PyUnicode_Check(obj)) {
+                out += '\'';
+                if (!append_str(out, obj)) return false;
+                out += '\'';
+                return true;
+            }
+            return append_str(out, obj);
+
+        case FieldKind::Fixed:
+        case FieldKind::General: {
+            const double value = PyFloat_AsDouble(obj);
+            if (value == -1.0 && PyErr_Occurred()) return false;
+            if (seg.kind == FieldKind::Fixed) {
+                append_chars(out, value, std::chars_format::fixed, seg.precision);
+            } else {
+                append_chars(out, value, std::chars_format::general, 6);
+            }
+            return true;
+        }
+
+        case FieldKind::Integer: {
+            PyObject* index = PyNumber_Index(obj);
+            if (!index) return false;
+            const long long value = PyLong_AsLongLong(index);
+            Py_DECREF(index);
+            if (value == -1 && PyErr_Occurred()) return false;
+            char buf[24];
+            const auto res = std::to_chars(buf, buf + sizeof(buf), value);
+            const int length = static_cast<int>(res.ptr - buf);
+            if (value < 0) out += '-';
+            if (length < seg.precision) {
+                out.append(static_cast<size_t>(seg.precision - length), '0');
+            }
+            out.append(value < 0 ? buf + 1 : buf, res.ptr);
+            return true;
+        }
+
+        case FieldKind::Literal:
+            break;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Layout compilation and rendering
+// ---------------------------------------------------------------------------
+
+static bool parse_spec(const std::string& spec, Segment& seg) {
+    if (spec.empty()) {
+        seg.kind = FieldKind::Str;
+    } else if (spec == "q") {
+        seg.kind = FieldKind::Namelist;
+    } else if (spec == "g") {
+        seg.kind = FieldKind::General;
+    } else if (spec.size() >= 3 && spec[0] == '.' && spec.back() == 'f') {
+        seg.kind = FieldKind::Fixed;
+        const auto res = std::from_chars(spec.data() + 1, spec.data() + spec.size() - 1, seg.precision);
+        return res.ptr == spec.data() + spec.size() - 1;
+    } else if (spec.back() == 'd') {
+        seg.kind = FieldKind::Integer;
+        if (spec.size() == 1) return true;
+        if (spec[0] != '0') return false;
+        const auto res = std::from_chars(spec.data() + 1, spec.data() + spec.size() - 1, seg.precision);
+        return res.ptr == spec.data() + spec.size() - 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool compile_layout(const std::string& fmt, Layout& layout, std::string& error) {
+    std::string literal;
+    for (size_t i = 0; i < fmt.size(); i++) {
+        const char c = fmt[i];
+        if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c) {
+            literal += c;
+            i++;
+            continue;
+        }
+        if (c == '}') {
+            error = "single '}' in template";
+            return false;
+        }
+        if (c != '{') {
+            literal += c;
+            continue;
+        }
+        const size_t close = fmt.find('}', i);
+        if (close == std::string::npos) {
+            error = "unterminated '{' in template";
+            return false;
+        }
+        std::string field = fmt.substr(i + 1, close - i - 1);
+        if (!field.empty() && field[0] != ':') {
+            error = "template fields must be positional: '{" + field + "}'";
+            return false;
+        }
+        Segment seg;
+        if (!parse_spec(field.empty() ? field : field.substr(1), seg)) {
+            error = "unsupported format spec: '{" + field + "}'";
+            return false;
+        }
+        if (!literal.empty()) {
+            layout.segments.push_back({FieldKind::Literal, literal, 0});
+            literal.clear();
+        }
+        layout.segments.push_back(seg);
+        layout.n_fields++;
+        i = close;
+    }
+    if (!literal.empty()) layout.segments.push_back({FieldKind::Literal, literal, 0});
+    return true;
+}
+
+static bool render_values(const Layout& layout, PyObject* values, std::string& out) {
+    PyObject* seq = PySequence_Fast(values, "template values must be a sequence");
+    if (!seq) return false;
+    if (PySequence_Fast_GET_SIZE(seq) != layout.n_fields) {
+        PyErr_Format(PyExc_ValueError, "template has %d fields, got %zd values",
+                     layout.n_fields, PySequence_Fast_GET_SIZE(seq));
+        Py_DECREF(seq);
+        return false;
+    }
+    PyObject** items = PySequence_Fast_ITEMS(seq);
+    int field = 0;
+    for (const auto& seg : layout.segments) {
+        if (seg.kind == FieldKind::Literal) {
+            out += seg.literal;
+        } else if (!append_field(out, seg, items[field++])) {
+            Py_DECREF(seq);
+            return false;
+        }
+    }
+    Py_DECREF(seq);
+    return true;
+}
+
+// Rows of a 2-D float array, without creating Python floats
+static bool render_array(const Layout& layout, PyArrayObject* array, std::string& out) {
+    if (PyArray_NDIM(array) != 2 || PyArray_DIM(array, 1) != layout.n_fields) {
+        PyErr_Format(PyExc_ValueError, "template rows need shape (n, %d)", layout.n_fields);
+        return false;
+    }
+    for (const auto& seg : layout.segments) {
+        if (seg.kind != FieldKind::Literal && seg.kind != FieldKind::Fixed &&
+            seg.kind != FieldKind::General) {
+            PyErr_SetString(PyExc_TypeError, "array rows only support {:.Nf} and {:g} fields");
+            return false;
+        }
+    }
+    PyArrayObject* data = reinterpret_cast<PyArrayObject*>(
+        PyArray_FROMANY(reinterpret_cast<PyObject*>(array), NPY_DOUBLE, 2, 2, NPY_ARRAY_IN_ARRAY));
+    if (!data) return false;
+    const npy_intp rows = PyArray_DIM(data, 0);
+    const double* values = static_cast<const double*>(PyArray_DATA(data));
+    for (npy_intp r = 0; r < rows; r++) {
+        const double* row = values + r * layout.n_fields;
+        int field = 0;
+        for (const auto& seg : layout.segments) {
+            if (seg.kind == FieldKind::Literal) {
+                out += seg.literal;
+            } else if (seg.kind == FieldKind::Fixed) {
+                append_chars(out, row[field++], std::chars_format::fixed, seg.precision);
+            } else {
+                append_chars(out, row[field++], std::chars_format::general, 6);
+            }
+        }
+    }
+    Py_DECREF(data);
+    return true;
+}
+
+// Renders a document: a sequence of (layout, values) parts. values is a
+// tuple for one rendering, or a list of tuples / 2-D array for one per row.
+static bool render_parts(PyObject* parts, std::string& out) {
+    PyObject* seq = PySequence_Fast(parts, "parts must be a sequence of (template, values)");
+    if (!seq) return false;
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    PyObject** items = PySequence_Fast_ITEMS(seq);
+    bool ok = true;
+    for (Py_ssize_t i = 0; ok && i < n; i++) {
+        PyObject *capsule, *values;
+        if (!PyArg_ParseTuple(items[i], "OO", &capsule, &values)) {
+            ok = false;
+            break;
+        }
+        const Layout* layout = static_cast<const Layout*>(PyCapsule_GetPointer(capsule, kCapsuleName));
+        if (!layout) {
+            ok = false;
+        } else if (PyTuple_Check(values)) {
+            ok = render_values(*layout, values, out);
+        } else if (PyArray_Check(values)) {
+            ok = render_array(*layout, reinterpret_cast<PyArrayObject*>(values), out);
+        } else {
+            PyObject* rows = PySequence_Fast(values, "template rows must be a sequence");
+            ok = rows != nullptr;
+            for (Py_ssize_t r = 0; ok && r < PySequence_Fast_GET_SIZE(rows); r++) {
+                ok = render_values(*layout, PySequence_Fast_GET_ITEM(rows, r), out);
+            }
+            Py_XDECREF(rows);
+        }
+    }
+    Py_DECREF(seq);
+    return ok;
+}
+
+#ifndef _WIN32
+static bool write_all(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Python interface
+// ---------------------------------------------------------------------------
+
+static void free_layout(PyObject* capsule) {
+    delete static_cast<Layout*>(PyCapsule_GetPointer(capsule, kCapsuleName));
+}
+
+/**
+ * Compile a template string.
+ */
+static PyObject* compile(PyObject* self, PyObject* args) {
+    const char* fmt;
+    Py_ssize_t size;
+    if (!PyArg_ParseTuple(args, "s#", &fmt, &size)) return NULL;
+
+    auto* layout = new Layout();
+    std::string error;
+    if (!compile_layout(std::string(fmt, static_cast<size_t>(size)), *layout, error)) {
+        delete layout;
+        PyErr_SetString(PyExc_ValueError, error.c_str());
+        return NULL;
+    }
+    PyObject* capsule = PyCapsule_New(layout, kCapsuleName, free_layout);
+    if (!capsule) delete layout;
+    return capsule;
+}
+
+/**
+ * Render parts into bytes.
+ */
+static PyObject* render(PyObject* self, PyObject* args) {
+    PyObject* parts;
+    if (!PyArg_ParseTuple(args, "O", &parts)) return NULL;
+    buffer.clear();
+    if (!render_parts(parts, buffer)) return NULL;
+    return PyBytes_FromStringAndSize(buffer.data(), static_cast<Py_ssize_t>(buffer.size()));
+}
+
+/**
+ * Render parts and write them to a file with one write call.
+ */
+static PyObject* write_file(PyObject* self, PyObject* args) {
+    PyObject* path_obj;
+    PyObject* parts;
+    if (!PyArg_ParseTuple(args, "O&O", PyUnicode_FSConverter, &path_obj, &parts)) return NULL;
+    buffer.clear();
+    if (!render_parts(parts, buffer)) {
+        Py_DECREF(path_obj);
+        return NULL;
+    }
+
+#ifdef _WIN32
+    FILE* f = std::fopen(PyBytes_AS_STRING(path_obj), "wb");
+    const bool ok = f && std::fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+    if (f) std::fclose(f);
+#else
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    const int fd = open(PyBytes_AS_STRING(path_obj), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ok = fd >= 0 && write_all(fd, buffer);
+    const int err = errno;
+    if (fd >= 0) close(fd);
+    errno = err;
+    Py_END_ALLOW_THREADS
+#endif
+    if (!ok) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path_obj));
+        Py_DECREF(path_obj);
+        return NULL;
+    }
+    Py_DECREF(path_obj);
+    return PyLong_FromSize_t(buffer.size());
+}
+
+/**
+ * Render parts into an anonymous in-memory file (Linux memfd).
+ */
+static PyObject* write_memfd(PyObject* self, PyObject* args) {
+    const char* name;
+    PyObject* parts;
+    if (!PyArg_ParseTuple(args, "sO", &name, &parts)) return NULL;
+#ifdef __linux__
+    buffer.clear();
+    if (!render_parts(parts, buffer)) return NULL;
+    const int fd = memfd_create(name, 0);
+    if (fd < 0 || !write_all(fd, buffer) || lseek(fd, 0, SEEK_SET) < 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    return PyLong_FromLong(fd);
+#else
+    PyErr_SetString(PyExc_NotImplementedError, "memfd is only available on Linux");
+    return NULL;
+#endif
+}
+
+// Method definitions
+static PyMethodDef TemplatesMethods[] = {
+    {"compile", compile, METH_VARARGS,
+     "Compile a template string.\n\n"
+     "Args:\n"
+     "    fmt (str): Literal text with {}, {:q}, {:.Nf}, {:g}, {:d} or {:0Nd} fields\n\n"
+     "Returns:\n"
+     "    Compiled template (opaque)"},
+
+    {"render", render, METH_VARARGS,
+     "Render a document into bytes.\n\n"
+     "Args:\n"
+     "    parts (list): (template, values) pairs; values is a tuple for one\n"
+     "        rendering, or a list of tuples or a 2-D float array for one\n"
+     "        rendering per row\n\n"
+     "Returns:\n"
+     "    bytes: Rendered document"},
+
+    {"write", write_file, METH_VARARGS,
+     "Render a document and write it to a file with a single write.\n\n"
+     "Args:\n"
+     "    path (str): Output file, truncated if it exists\n"
+     "    parts (list): (template, values) pairs as for render()\n\n"
+     "Returns:\n"
+     "    int: Bytes written"},
+
+    {"write_memfd", write_memfd, METH_VARARGS,
+     "Render a document into a new memfd (Linux only).\n\n"
+     "Args:\n"
+     "    name (str): Name of the memfd (for /proc)\n"
+     "    parts (list): (template, values) pairs as for render()\n\n"
+     "Returns:\n"
+     "    int: File descriptor positioned at the start; the caller closes it"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef templatesmodule = {
+    PyModuleDef_HEAD_INIT,
+    "_templates",
+    "Native renderer for HYSPLIT CONTROL and SETUP.CFG files.",
+    -1,
+    TemplatesMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__templates(void) {
+    import_array();
+    return PyModule_Create(&templatesmodule);
+}
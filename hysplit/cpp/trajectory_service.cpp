@@ -0,0 +1,517 @@
+/**
+ * Native trajectory service.
+ *
+ * Computes HYSPLIT-style trajectories (predictor-corrector advection on the
+ * mean wind) on an in-memory met field, either directly or from a
+ * long-running server that keeps the met field resident and answers
+ * batched requests over a Unix domain socket.
+ *
+ * Wire protocol (little-endian). Every message is a 16-byte header
+ *
+ *     uint32 magic 'HYTS', uint16 version, uint16 type, uint32 count, uint32 size
+ *
+ * followed by size bytes of body. Requests:
+ *
+ *     PING (1)          no body
+ *     TRAJECTORIES (2)  count records of 48 bytes: float64 lat, lon, height,
+ *                       start (minutes since 1970-01-01), duration (hours),
+ *                       int32 direction (1 forward, -1 backward), int32 reserved
+ *     SHUTDOWN (3)      no body; the server stops after replying
+ *
+ * Replies use type 0 (OK) or 1 (ERROR, body is the message). A TRAJECTORIES
+ * reply carries count trajectories in columnar form: int64 offsets[count+1]
+ * followed by float64 hour_along, lat, lon and height columns of
+ * offsets[count] hourly points each.
+ *
+ * Build with: python setup.py build_ext --inplace
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "met_field.h"
+
+constexpr uint32_t PROTOCOL_MAGIC = 0x53545948;  // "HYTS"
+constexpr uint16_t PROTOCOL_VERSION = 1;
+
+enum MessageType : uint16_t {
+    MSG_PING = 1,
+    MSG_TRAJECTORIES = 2,
+    MSG_SHUTDOWN = 3,
+};
+
+enum ReplyStatus : uint16_t {
+    REPLY_OK = 0,
+    REPLY_ERROR = 1,
+};
+
+// Largest accepted request body, to reject garbage headers early
+constexpr uint32_t MAX_REQUEST_BYTES = 64u << 20;
+
+// Poll timeout between checks for Python signals (ms)
+constexpr int POLL_INTERVAL_MS = 200;
+
+#pragma pack(push, 1)
+struct MessageHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t count;
+    uint32_t size;
+};
+
+struct TrajectoryRequest {
+    double lat, lon, height;
+    double start;     // minutes since 1970-01-01
+    double duration;  // hours
+    int32_t direction;
+    int32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(MessageHeader) == 16, "unexpected header layout");
+static_assert(sizeof(TrajectoryRequest) == 48, "unexpected request layout");
+
+// ---------------------------------------------------------------------------
+// Trajectory kernel
+// ---------------------------------------------------------------------------
+
+struct ServiceOptions {
+    double tratio = 0.75;
+    double time_step = 0.0;       // minutes, 0 selects from tratio
+    double model_top = 20000.0;   // m AGL
+    double met_start = 0.0;       // minutes since 1970 of met time 0
+};
+
+// Hourly trajectory points in columnar form, one offsets entry per trajectory
+struct TrajectoryColumns {
+    std::vector<int64_t> offsets{0};
+    std::vector<double> hour, lat, lon, height;
+};
+
+// One predictor-corrector step on the mean wind; false when the point leaves the domain
+static bool advect(const MetField& m, double t0, double sdt, double model_top, double& lat,
+                   double& lon, double& z) {
+    const double t1 = t0 + sdt / 3600.0;
+    lon = m.wrap_lon(lon);
+    Wind w0, w1;
+    if (!sample_wind(m, t0, lat, lon, z, w0)) return false;
+
+    const double plat = lat + w0.v * sdt / METERS_PER_DEGREE;
+    const double plon = m.wrap_lon(
+        lon + w0.u * sdt / (METERS_PER_DEGREE * std::max(std::cos(lat * DEG_TO_RAD), 1e-6)));
+    const double pz = std::min(std::max(z + w0.w * sdt, 0.0), model_top);
+    if (!sample_wind(m, t1, plat, plon, pz, w1)) return false;
+
+    lat += 0.5 * (w0.v + w1.v) * sdt / METERS_PER_DEGREE;
+    lon += 0.5 * (w0.u + w1.u) * sdt / (METERS_PER_DEGREE * std::max(std::cos(lat * DEG_TO_RAD), 1e-6));
+    z = std::min(std::max(z + 0.5 * (w0.w + w1.w) * sdt, 0.0), model_top);
+
+    if (lat > 90.0 || lat < -90.0) return false;
+    lon = m.wrap_lon(lon);
+    return lat >= m.lats[0] && lat <= m.lats[m.ny - 1] && lon >= m.lons[0] &&
+           lon <= m.lons[m.nx - 1];
+}
+
+// Integrate one trajectory and append its hourly points (hour 0 first)
+static void integrate(const MetField& m, const ServiceOptions& opt, double dt_min,
+                      const TrajectoryRequest& req, std::vector<double>& hour,
+                      std::vector<double>& lat, std::vector<double>& lon, std::vector<double>& z) {
+    const int direction = req.direction < 0 ? -1 : 1;
+    const double dt_s = dt_min * 60.0;
+    const long steps_per_hour = std::max(1L, std::lround(60.0 / dt_min));
+    const long hours = static_cast<long>(std::floor(std::fabs(req.duration) + 1e-9));
+
+    double t = (req.start - opt.met_start) / 60.0;
+    double plat = req.lat, plon = req.lon, pz = req.height;
+    hour.push_back(0.0); lat.push_back(plat); lon.push_back(plon); z.push_back(pz);
+
+    for (long h = 1; h <= hours; h++) {
+        for (long s = 0; s < steps_per_hour; s++) {
+            if (!advect(m, t, direction * dt_s, opt.model_top, plat, plon, pz)) return;
+            t += direction * dt_min / 60.0;
+        }
+        hour.push_back(static_cast<double>(direction * h));
+        lat.push_back(plat); lon.push_back(plon); z.push_back(pz);
+    }
+}
+
+// Run a batch of trajectories in parallel and concatenate them in request order
+static void run_batch(const MetField& m, const ServiceOptions& opt, double dt_min,
+                      const TrajectoryRequest* requests, long n, TrajectoryColumns& out) {
+    std::vector<TrajectoryColumns> parts(n);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 4)
+#endif
+    for (long r = 0; r < n; r++) {
+        TrajectoryColumns& p = parts[r];
+        integrate(m, opt, dt_min, requests[r], p.hour, p.lat, p.lon, p.height);
+    }
+
+    size_t total = out.hour.size();
+    for (const auto& p : parts) total += p.hour.size();
+    out.hour.reserve(total); out.lat.reserve(total); out.lon.reserve(total); out.height.reserve(total);
+    for (const auto& p : parts) {
+        out.hour.insert(out.hour.end(), p.hour.begin(), p.hour.end());
+        out.lat.insert(out.lat.end(), p.lat.begin(), p.lat.end());
+        out.lon.insert(out.lon.end(), p.lon.begin(), p.lon.end());
+        out.height.insert(out.height.end(), p.height.begin(), p.height.end());
+        out.offsets.push_back(static_cast<int64_t>(out.hour.size()));
+    }
+}
+
+static double time_step_minutes(const MetField& met, const ServiceOptions& opt) {
+    if (opt.time_step > 0.0) return opt.time_step;
+    return select_time_step(met, opt.tratio);
+}
+
+// ---------------------------------------------------------------------------
+// Server
+// ---------------------------------------------------------------------------
+
+#ifndef _WIN32
+
+static bool read_full(int fd, void* buffer, size_t n) {
+    char* p = static_cast<char*>(buffer);
+    while (n > 0) {
+        const ssize_t got = recv(fd, p, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void* buffer, size_t n) {
+    const char* p = static_cast<const char*>(buffer);
+    while (n > 0) {
+        const ssize_t sent = send(fd, p, n, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        p += sent;
+        n -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool send_reply(int fd, uint16_t type, uint32_t count, const std::string& body) {
+    const MessageHeader header{PROTOCOL_MAGIC, PROTOCOL_VERSION, type, count,
+                               static_cast<uint32_t>(body.size())};
+    std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+    message += body;
+    return write_full(fd, message.data(), message.size());
+}
+
+// Serialize columns as offsets followed by the four float64 columns
+static std::string encode_columns(const TrajectoryColumns& c) {
+    const size_t n_points = c.hour.size();
+    std::string body;
+    body.resize(c.offsets.size() * sizeof(int64_t) + 4 * n_points * sizeof(double));
+    char* p = &body[0];
+    std::memcpy(p, c.offsets.data(), c.offsets.size() * sizeof(int64_t));
+    p += c.offsets.size() * sizeof(int64_t);
+    for (const std::vector<double>* column : {&c.hour, &c.lat, &c.lon, &c.height}) {
+        if (n_points) std::memcpy(p, column->data(), n_points * sizeof(double));
+        p += n_points * sizeof(double);
+    }
+    return body;
+}
+
+struct ServerStats {
+    long connections = 0;
+    long requests = 0;
+    long trajectories = 0;
+};
+
+// Handle one message on a client socket; false closes the connection
+static bool handle_message(int fd, const MetField& met, const ServiceOptions& opt, double dt_min,
+                           ServerStats& stats, bool& shutdown) {
+    MessageHeader header;
+    if (!read_full(fd, &header, sizeof(header))) return false;
+    if (header.magic != PROTOCOL_MAGIC || header.version != PROTOCOL_VERSION ||
+        header.size > MAX_REQUEST_BYTES) {
+        send_reply(fd, REPLY_ERROR, 0, "bad message header");
+        return false;
+    }
+    std::vector<char> body(header.size);
+    if (header.size && !read_full(fd, body.data(), body.size())) return false;
+    stats.requests++;
+
+    switch (header.type) {
+        case MSG_PING:
+            return send_reply(fd, REPLY_OK, 0, "");
+        case MSG_SHUTDOWN:
+            shutdown = true;
+            send_reply(fd, REPLY_OK, 0, "");
+            return false;
+        case MSG_TRAJECTORIES: {
+            if (static_cast<uint64_t>(header.count) * sizeof(TrajectoryRequest) != header.size) {
+                return send_reply(fd, REPLY_ERROR, 0, "body size does not match the request count");
+            }
+            std::vector<TrajectoryRequest> requests(header.count);
+            if (header.count) std::memcpy(requests.data(), body.data(), body.size());
+            TrajectoryColumns columns;
+            run_batch(met, opt, dt_min, requests.data(), header.count, columns);
+            stats.trajectories += header.count;
+            return send_reply(fd, REPLY_OK, header.count, encode_columns(columns));
+        }
+        default:
+            return send_reply(fd, REPLY_ERROR, 0, "unknown message type");
+    }
+}
+
+static int open_listener(const std::string& path, std::string& error) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "socket path is too long";
+        return -1;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        error = std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    chmod(path.c_str(), 0600);
+    return fd;
+}
+
+#endif  // _WIN32
+
+// ---------------------------------------------------------------------------
+// Python interface
+// ---------------------------------------------------------------------------
+
+static bool load_options(PyObject* opt_dict, ServiceOptions& opt) {
+    return dict_double(opt_dict, "tratio", opt.tratio) &&
+           dict_double(opt_dict, "time_step", opt.time_step) &&
+           dict_double(opt_dict, "model_top", opt.model_top) &&
+           dict_double(opt_dict, "met_start", opt.met_start);
+}
+
+static PyObject* vector_to_array(const void* values, size_t n, int type_num, size_t item) {
+    npy_intp dims[1] = {static_cast<npy_intp>(n)};
+    PyObject* array = PyArray_SimpleNew(1, dims, type_num);
+    if (!array) return NULL;
+    if (n) std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), values, n * item);
+    return array;
+}
+
+/**
+ * Compute trajectories in-process.
+ *
+ * requests is an (n, 6) float64 array of lat, lon, height, start minutes,
+ * duration hours and direction.
+ */
+static PyObject* run_trajectories(PyObject* self, PyObject* args) {
+    PyObject *met_dict, *req_obj, *opt_dict;
+    if (!PyArg_ParseTuple(args, "O!OO!", &PyDict_Type, &met_dict, &req_obj, &PyDict_Type,
+                          &opt_dict)) {
+        return NULL;
+    }
+
+    MetField met;
+    MetArrays met_arrays;
+    ServiceOptions opt;
+    DoubleArray req;
+    if (!met_arrays.load(met_dict, met) || !load_options(opt_dict, opt) ||
+        !req.load(req_obj, 2, "requests")) {
+        return NULL;
+    }
+    if (req.dim(1) != 6) {
+        PyErr_SetString(PyExc_ValueError, "requests must have shape (n, 6)");
+        return NULL;
+    }
+
+    const long n = static_cast<long>(req.dim(0));
+    std::vector<TrajectoryRequest> requests(n);
+    for (long r = 0; r < n; r++) {
+        const double* row = req.data() + r * 6;
+        requests[r] = {row[0], row[1], row[2], row[3], row[4], row[5] < 0 ? -1 : 1, 0};
+    }
+
+    TrajectoryColumns columns;
+    Py_BEGIN_ALLOW_THREADS
+    run_batch(met, opt, time_step_minutes(met, opt), requests.data(), n, columns);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    const size_t n_points = columns.hour.size();
+    if (set_item(result, "offsets", vector_to_array(columns.offsets.data(), columns.offsets.size(), NPY_INT64, sizeof(int64_t))) < 0 ||
+        set_item(result, "hour_along", vector_to_array(columns.hour.data(), n_points, NPY_DOUBLE, sizeof(double))) < 0 ||
+        set_item(result, "lat", vector_to_array(columns.lat.data(), n_points, NPY_DOUBLE, sizeof(double))) < 0 ||
+        set_item(result, "lon", vector_to_array(columns.lon.data(), n_points, NPY_DOUBLE, sizeof(double))) < 0 ||
+        set_item(result, "height", vector_to_array(columns.height.data(), n_points, NPY_DOUBLE, sizeof(double))) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * Serve trajectory requests on a Unix domain socket until SHUTDOWN.
+ *
+ * The met field stays resident for the lifetime of the call. Connections
+ * are persistent and multiplexed with poll(); each request batch runs in
+ * parallel over its trajectories. Python signals (e.g. Ctrl-C) are checked
+ * between polls when serving from the main thread.
+ */
+static PyObject* serve(PyObject* self, PyObject* args) {
+    PyObject *met_dict, *opt_dict;
+    const char* socket_path;
+    if (!PyArg_ParseTuple(args, "O!sO!", &PyDict_Type, &met_dict, &socket_path, &PyDict_Type,
+                          &opt_dict)) {
+        return NULL;
+    }
+
+#ifdef _WIN32
+    PyErr_SetString(PyExc_NotImplementedError, "the trajectory service needs Unix domain sockets");
+    return NULL;
+#else
+    MetField met;
+    MetArrays met_arrays;
+    ServiceOptions opt;
+    if (!met_arrays.load(met_dict, met) || !load_options(opt_dict, opt)) {
+        return NULL;
+    }
+    const double dt_min = time_step_minutes(met, opt);
+
+    std::string error;
+    const int listener = open_listener(socket_path, error);
+    if (listener < 0) {
+        PyErr_Format(PyExc_OSError, "Cannot listen on '%s': %s", socket_path, error.c_str());
+        return NULL;
+    }
+
+    ServerStats stats;
+    bool shutdown = false, interrupted = false;
+    std::vector<pollfd> fds{{listener, POLLIN, 0}};
+
+    Py_BEGIN_ALLOW_THREADS
+    while (!shutdown) {
+        const int ready = poll(fds.data(), fds.size(), POLL_INTERVAL_MS);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) {
+            Py_BLOCK_THREADS
+            interrupted = PyErr_CheckSignals() < 0;
+            Py_UNBLOCK_THREADS
+            if (interrupted) break;
+            continue;
+        }
+
+        for (size_t i = 1; i < fds.size() && !shutdown; i++) {
+            if (!fds[i].revents) continue;
+            bool keep = false;
+            if (fds[i].revents & POLLIN) {
+                keep = handle_message(fds[i].fd, met, opt, dt_min, stats, shutdown);
+            }
+            if (!keep) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+            }
+        }
+        fds.erase(std::remove_if(fds.begin() + 1, fds.end(), [](const pollfd& p) { return p.fd < 0; }),
+                  fds.end());
+
+        if (fds[0].revents & POLLIN) {
+            const int client = accept(listener, nullptr, nullptr);
+            if (client >= 0) {
+                // A stalled client must not block the other connections forever
+                timeval timeout{5, 0};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                fds.push_back({client, POLLIN, 0});
+                stats.connections++;
+            }
+        }
+        for (auto& p : fds) p.revents = 0;
+    }
+    for (const auto& p : fds) close(p.fd);
+    unlink(socket_path);
+    Py_END_ALLOW_THREADS
+
+    if (interrupted) return NULL;
+
+    PyObject* result = PyDict_New();
+    if (!result) return NULL;
+    if (set_item(result, "connections", PyLong_FromLong(stats.connections)) < 0 ||
+        set_item(result, "requests", PyLong_FromLong(stats.requests)) < 0 ||
+        set_item(result, "trajectories", PyLong_FromLong(stats.trajectories)) < 0 ||
+        set_item(result, "time_step", PyFloat_FromDouble(dt_min)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+#endif
+}
+
+// Method definitions
+static PyMethodDef ServiceMethods[] = {
+    {"run_trajectories", run_trajectories, METH_VARARGS,
+     "Compute trajectories on an in-memory met field.\n\n"
+     "Args:\n"
+     "    met (dict): Met field arrays (times, lats, lons, heights, u, v, w)\n"
+     "    requests (numpy.ndarray): (n, 6) lat, lon, height, start minutes since 1970,\n"
+     "        duration hours, direction\n"
+     "    options (dict): tratio, time_step, model_top, met_start\n\n"
+     "Returns:\n"
+     "    dict: offsets, hour_along, lat, lon, height columns"},
+
+    {"serve", serve, METH_VARARGS,
+     "Serve trajectory requests on a Unix domain socket until a SHUTDOWN message.\n\n"
+     "Args:\n"
+     "    met (dict): Met field arrays, kept resident while serving\n"
+     "    socket_path (str): Path of the Unix domain socket\n"
+     "    options (dict): tratio, time_step, model_top, met_start\n\n"
+     "Returns:\n"
+     "    dict: Connection, request and trajectory counts"},
+
+    {NULL, NULL, 0, NULL}
+};
+
+// Module definition
+static struct PyModuleDef servicemodule = {
+    PyModuleDef_HEAD_INIT,
+    "_trajectory_service",
+    "Native trajectory kernel and Unix socket trajectory service.",
+    -1,
+    ServiceMethods
+};
+
+// Module initialization
+PyMODINIT_FUNC PyInit__trajectory_service(void) {
+    import_array();  // Initialize NumPy
+    return PyModule_Create(&servicemodule);
+}
@@ -1,5 +1,10 @@
 """Input/Output utilities for HYSPLIT data files."""
 
-from hysplit.io.readers import trajectory_read, dispersion_read
+from hysplit.io.readers import (
+    trajectory_read, dispersion_read, concentration_read, emitimes_read, split_trajectory_file
+)
 
-__all__ = ["trajectory_read", "dispersion_read"]
+__all__ = [
+    "trajectory_read", "dispersion_read", "concentration_read", "emitimes_read",
+    "split_trajectory_file",
+]
@@ -246,6 +246,69 @@ def trajectory_read(
         raise FileNotFoundError(f"Path does not exist: {output_path}")
 
 
+def split_trajectory_file(
+    filepath: Union[str, Path],
+    output_paths: List[Union[str, Path]]
+) -> List[Path]:
+    """Split a multi-start trajectory file into one file per trajectory.
+
+    HYSPLIT numbers the trajectories of a CONTROL file with several
+    starting locations 1..N in a single output file. Trajectory k is
+    written to ``output_paths[k - 1]`` as the file a single-start run from
+    that location would have produced: the header keeps only its starting
+    location and its points are renumbered as trajectory 1.
+
+    Args:
+        filepath: Combined trajectory output file
+        output_paths: Output path for each trajectory, in start order
+
+    Returns:
+        Paths of the files written (trajectories without any points are skipped)
+    """
+    with open(filepath, 'r', encoding='utf-8', errors='ignore') as f:
+        lines = f.readlines()
+
+    diag_idx = next((i for i, line in enumerate(lines) if "PRESSURE" in line), None)
+    if diag_idx is None:
+        return []
+
+    def renumber(line: str, value: int = 1) -> str:
+        match = re.match(r"\s*\d+", line)
+        return str(value).rjust(match.end()) + line[match.end():]
+
+    # Header: grid count, grid lines, trajectory count, one line per start
+    header, starts = lines[:diag_idx], None
+    traj_idx = 1 + int(lines[0].split()[0])
+    if traj_idx < diag_idx:
+        n_traj = int(header[traj_idx].split()[0])
+        if traj_idx + 1 + n_traj == diag_idx:
+            starts = header[traj_idx + 1:diag_idx]
+            header = header[:traj_idx] + [renumber(header[traj_idx])]
+
+    points: List[List[str]] = [[] for _ in output_paths]
+    for line in lines[diag_idx + 1:]:
+        match = re.match(r"\s*(\d+)", line)
+        if not match:
+            continue
+        k = int(match.group(1)) - 1
+        if 0 <= k < len(points):
+            points[k].append(renumber(line))
+
+    written = []
+    for k, path in enumerate(output_paths):
+        if not points[k]:
+            continue
+        path = Path(path)
+        with open(path, 'w') as f:
+            f.writelines(header)
+            if starts is not None:
+                f.write(starts[k])
+            f.write(lines[diag_idx])
+            f.writelines(points[k])
+        written.append(path)
+    return written
+
+
 def _parse_dispersion_pardump_python(filepath: Path) -> pd.DataFrame:
     """Parse PARDUMP file (particle dump) from dispersion model.
 
@@ -353,6 +416,213 @@ def dispersion_read(
         raise FileNotFoundError(f"Path does not exist: {output_path}")
 
 
+def _read_fortran_records(filepath: Path) -> List[bytes]:
+    """Split a big-endian Fortran sequential unformatted file into records."""
+    data = filepath.read_bytes()
+    records = []
+    pos = 0
+    while pos + 4 <= len(data):
+        length = int.from_bytes(data[pos:pos + 4], "big")
+        records.append(data[pos + 4:pos + 4 + length])
+        pos += length + 8
+    return records
+
+
+def concentration_read(output_path: Union[str, Path]) -> pd.DataFrame:
+    """Read a HYSPLIT binary concentration (cdump) file into a DataFrame.
+
+    Handles both packed and unpacked concentration records.
+
+    Args:
+        output_path: Path to the cdump file
+
+    Returns:
+        DataFrame with one row per non-zero grid cell:
+        - sample_start, sample_stop: Sampling period
+        - pollutant: Pollutant identifier
+        - level: Top of the concentration layer (meters AGL, 0 = deposition)
+        - lat, lon: Grid node position
+        - conc: Concentration (mass/m^3) or deposition (mass/m^2)
+    """
+    output_path = Path(output_path)
+    if not output_path.is_file():
+        raise FileNotFoundError(f"File not found: {output_path}")
+
+    columns = ["sample_start", "sample_stop", "pollutant", "level", "lat", "lon", "conc"]
+    records = _read_fortran_records(output_path)
+    if len(records) < 5:
+        return pd.DataFrame(columns=columns)
+
+    n_locations, packed = np.frombuffer(records[0], dtype=">i4", offset=24, count=2)
+    idx = 1 + int(n_locations)
+    nlat, nlon = np.frombuffer(records[idx], dtype=">i4", count=2)
+    dlat, dlon, ll_lat, ll_lon = np.frombuffer(records[idx], dtype=">f4", offset=8, count=4)
+    n_levels = int(np.frombuffer(records[idx + 1], dtype=">i4", count=1)[0])
+    n_pollutants = int(np.frombuffer(records[idx + 2], dtype=">i4", count=1)[0])
+    idx += 3
+
+    def _stamp(record: bytes) -> datetime:
+        year, month, day, hour, minute = np.frombuffer(record, dtype=">i4", count=5)
+        year = year + 2000 if year < 50 else year + 1900
+        return datetime(int(year), int(month), int(day), int(hour), int(minute))
+
+    frames = []
+    while idx + 2 <= len(records):
+        sample_start = _stamp(records[idx])
+        sample_stop = _stamp(records[idx + 1])
+        idx += 2
+        for _ in range(n_pollutants * n_levels):
+            record = records[idx]
+            idx += 1
+            pollutant = record[:4].decode("ascii", errors="ignore").strip()
+            level = int(np.frombuffer(record, dtype=">i4", offset=4, count=1)[0])
+            if packed:
+                n_cells = int(np.frombuffer(record, dtype=">i4", offset=8, count=1)[0])
+                cells = np.frombuffer(
+                    record, dtype=[("i", ">i2"), ("j", ">i2"), ("conc", ">f4")],
+                    offset=12, count=n_cells
+                )
+                i = cells["i"].astype(np.int64) - 1
+                j = cells["j"].astype(np.int64) - 1
+                conc = cells["conc"].astype(np.float64)
+            else:
+                grid = np.frombuffer(record, dtype=">f4", offset=8, count=int(nlat * nlon))
+                j, i = np.nonzero(grid.reshape(int(nlat), int(nlon)))
+                conc = grid.reshape(int(nlat), int(nlon))[j, i].astype(np.float64)
+            frames.append(pd.DataFrame({
+                "sample_start": sample_start,
+                "sample_stop": sample_stop,
+                "pollutant": pollutant,
+                "level": level,
+                "lat": ll_lat + j * dlat,
+                "lon": ll_lon + i * dlon,
+                "conc": conc,
+            }))
+
+    if not frames:
+        return pd.DataFrame(columns=columns)
+    return pd.concat(frames, ignore_index=True)[columns]
+
+
+EMITIMES_COLS = [
+    "source", "start_minutes", "duration_hours",
+    "lat", "lon", "height", "rate", "area", "heat"
+]
+
+
+def _parse_emitimes_file_python(filepath: Path) -> np.ndarray:
+    """Parse an EMITIMES file using pure Python (same rows as the C++ parser)."""
+    rows = []
+    source_ids = {}
+    pending = 0
+    cycle_line = 0
+
+    with open(filepath, 'r', encoding='utf-8', errors='ignore') as f:
+        for line_number, line in enumerate(f, start=1):
+            values = []
+            for token in line.split():
+                try:
+                    values.append(float(token))
+                except ValueError:
+                    break
+            if not values:
+                if pending > 0 and line.strip():
+                    raise ValueError(f"EMITIMES line {line_number}: expected an emission record")
+                continue
+
+            if pending == 0:
+                if len(values) != 6 or values[5] < 0 or values[5] != int(values[5]):
+                    raise ValueError(
+                        f"EMITIMES line {line_number}: expected a cycle header with 6 fields"
+                    )
+                pending = int(values[5])
+                cycle_line = line_number
+                continue
+
+            if len(values) < 10:
+                raise ValueError(
+                    f"EMITIMES line {line_number}: emission record needs at least 10 fields"
+                )
+            year, month, day, hour, minute = (int(v) for v in values[:5])
+            year = year + 2000 if year < 50 else (year + 1900 if year < 100 else year)
+            try:
+                start = datetime(year, month, day, hour, minute)
+            except ValueError:
+                raise ValueError(f"EMITIMES line {line_number}: invalid date") from None
+            hhmm = int(values[5])
+            if values[5] < 0 or hhmm % 100 > 59:
+                raise ValueError(f"EMITIMES line {line_number}: invalid duration")
+            lat, lon, height, rate = values[6:10]
+            if rate < 0:
+                raise ValueError(f"EMITIMES line {line_number}: negative emission rate")
+            if not (-90.0 <= lat <= 90.0 and -180.0 <= lon <= 360.0):
+                raise ValueError(f"EMITIMES line {line_number}: location out of range")
+
+            source = source_ids.setdefault((lat, lon, height), len(source_ids))
+            minutes = (start - datetime(1970, 1, 1)).total_seconds() // 60
+            rows.append([
+                source, minutes, hhmm // 100 + (hhmm % 100) / 60.0, lat, lon, height, rate,
+                values[10] if len(values) > 10 else 0.0,
+                values[11] if len(values) > 11 else 0.0,
+            ])
+            pending -= 1
+
+    if pending > 0:
+        raise ValueError(f"EMITIMES line {cycle_line}: file ends before all records of the cycle")
+
+    rows = np.asarray(rows, dtype=np.float64).reshape(-1, len(EMITIMES_COLS))
+    return rows[np.lexsort((rows[:, 1], rows[:, 0]))]
+
+
+def emitimes_read(
+    filepath: Union[str, Path],
+    use_cpp: Optional[bool] = None
+) -> pd.DataFrame:
+    """Read and validate a HYSPLIT EMITIMES temporal emissions file.
+
+    Each distinct (lat, lon, height) is one source. Rows are sorted by
+    source and start time, so every source's records form a contiguous,
+    time-ordered block.
+
+    Args:
+        filepath: Path to the EMITIMES file (``HysplitConfig.efile``)
+        use_cpp: Force use of C++ parser (True), Python parser (False),
+                 or auto-detect (None, default)
+
+    Returns:
+        DataFrame with columns:
+        - source: Source index, in order of first appearance
+        - start_time: Start of the emission record
+        - duration_hours: Emission duration
+        - lat, lon, height: Source position (height in meters)
+        - rate: Emission rate (mass per hour)
+        - area, heat: Source area (m^2) and heat release (W)
+
+    Raises:
+        ValueError: If the file is malformed
+    """
+    filepath = Path(filepath)
+    if not filepath.is_file():
+        raise FileNotFoundError(f"File not found: {filepath}")
+
+    if use_cpp is None:
+        use_cpp = HAS_CPP_EXTENSION
+    elif use_cpp and not HAS_CPP_EXTENSION:
+        import warnings
+        warnings.warn("C++ extension not available, falling back to Python parser")
+        use_cpp = False
+
+    if use_cpp:
+        result = cpp_parsers.parse_emitimes_file(str(filepath))
+    else:
+        result = _parse_emitimes_file_python(filepath)
+
+    df = pd.DataFrame(result, columns=EMITIMES_COLS)
+    df["source"] = df["source"].astype(np.int64)
+    df.insert(1, "start_time", pd.to_datetime(df.pop("start_minutes").astype(np.int64), unit="m"))
+    return df
+
+
 # Optimized NumPy-based parser for large files
 def trajectory_read_fast(
     output_path: Union[str, Path],
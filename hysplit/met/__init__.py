@@ -2,6 +2,7 @@
 
 from hysplit.met.downloaders import (
     download_met_files,
+    met_file_names,
     get_met_gdas1,
     get_met_gdas0p5,
     get_met_gfs0p25,
@@ -11,9 +12,11 @@ from hysplit.met.downloaders import (
     get_met_era5,
     get_met_hrrr,
 )
+from hysplit.met.field import MetField, uniform_met_field
 
 __all__ = [
     "download_met_files",
+    "met_file_names",
     "get_met_gdas1",
     "get_met_gdas0p5",
     "get_met_gfs0p25",
@@ -22,4 +25,6 @@ __all__ = [
     "get_met_nam12",
     "get_met_era5",
     "get_met_hrrr",
+    "MetField",
+    "uniform_met_field",
 ]
@@ -4,6 +4,7 @@ from __future__ import annotations
 
 import math
 import os
+import threading
 import urllib.request
 from concurrent.futures import ThreadPoolExecutor, as_completed
 from datetime import datetime, timedelta
@@ -49,8 +50,15 @@ def _download_file(url: str, filepath: Path, timeout: int = 300) -> bool:
             logger.info(f"File already exists: {filepath}")
             return True
 
+        # Through a temporary name, so concurrent runs sharing the directory
+        # never read a partial file
         logger.info(f"Downloading: {url}")
-        urllib.request.urlretrieve(url, filepath)
+        partial = filepath.with_name(f".{filepath.name}.{os.getpid()}.{threading.get_ident()}")
+        try:
+            urllib.request.urlretrieve(url, partial)
+            os.replace(partial, filepath)
+        finally:
+            partial.unlink(missing_ok=True)
         logger.info(f"Downloaded: {filepath}")
         return True
 
@@ -517,6 +525,52 @@ def get_met_hrrr(
     return sorted(downloaded_files)
 
 
+# File name of the met file covering a date, as fetched by the get_met_* functions
+MET_FILE_NAMES = {
+    "gdas1": lambda d: f"gdas1.{MONTH_ABBR[d.month - 1]}{d.strftime('%y')}.w{math.ceil(d.day / 7)}",
+    "gdas0.5": lambda d: f"gdas0p5.{d.strftime('%Y%m')}.w{math.ceil(d.day / 7)}",
+    "gfs0.25": lambda d: f"gfs0p25.{d.strftime('%Y%m%d')}",
+    "reanalysis": lambda d: f"RP{d.strftime('%Y%m')}.gbl",
+    "narr": lambda d: f"narr{d.strftime('%Y%m')}",
+    "nam12": lambda d: f"nam12_{d.strftime('%Y%m%d')}",
+    "era5": lambda d: f"ERA5_{d.strftime('%Y%m')}.ARL",
+    "hrrr": lambda d: f"hrrr.{d.strftime('%Y%m%d')}.nathrrr",
+}
+
+
+def met_file_names(
+    met_type: str,
+    days: List[datetime],
+    duration: int,
+    direction: str
+) -> List[str]:
+    """Names of the met files a set of runs needs, without downloading.
+
+    Args:
+        met_type: Type of meteorological data
+        days: List of run start dates
+        duration: Model run duration in hours
+        direction: "forward" or "backward"
+
+    Returns:
+        Sorted list of file names
+    """
+    if met_type not in MET_FILE_NAMES:
+        valid_types = ", ".join(sorted(MET_FILE_NAMES.keys()))
+        raise ValueError(
+            f"Unknown met_type: '{met_type}'. Valid types are: {valid_types}"
+        )
+
+    name = MET_FILE_NAMES[met_type]
+    min_date, max_date = _get_date_range(days, duration, direction)
+    files_needed = set()
+    current = min_date
+    while current <= max_date:
+        files_needed.add(name(current))
+        current += timedelta(days=1)
+    return sorted(files_needed)
+
+
 def download_met_files(
     met_type: str,
     days: List[datetime],
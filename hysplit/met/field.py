@@ -0,0 +1,156 @@
+"""In-memory gridded meteorology for the native engines."""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+from datetime import datetime
+from typing import Optional, Sequence
+
+import numpy as np
+
+
+@dataclass
+class MetField:
+    """Gridded meteorology held in memory.
+
+    Wind components are (time, height, lat, lon) arrays in m/s; surface
+    fields are (time, lat, lon). Axes must be strictly increasing, heights
+    are meters above ground level and times are hours after ``start_time``.
+    """
+
+    start_time: datetime
+    times: np.ndarray
+    lats: np.ndarray
+    lons: np.ndarray
+    heights: np.ndarray
+    u: np.ndarray = field(repr=False)
+    v: np.ndarray = field(repr=False)
+    w: np.ndarray = field(repr=False)
+    mixing_depth: Optional[np.ndarray] = field(default=None, repr=False)
+    precipitation: Optional[np.ndarray] = field(default=None, repr=False)
+
+    def __post_init__(self):
+        """Convert inputs to contiguous float64 arrays and check shapes."""
+        for name in ("times", "lats", "lons", "heights", "u", "v", "w"):
+            setattr(self, name, np.ascontiguousarray(getattr(self, name), dtype=np.float64))
+
+        shape = (len(self.times), len(self.heights), len(self.lats), len(self.lons))
+        for name in ("u", "v", "w"):
+            if getattr(self, name).shape != shape:
+                raise ValueError(f"MetField.{name} must have shape {shape}")
+
+        surface_shape = (shape[0],) + shape[2:]
+        for name in ("mixing_depth", "precipitation"):
+            value = getattr(self, name)
+            if value is None:
+                continue
+            value = np.ascontiguousarray(value, dtype=np.float64)
+            if value.shape != surface_shape:
+                raise ValueError(f"MetField.{name} must have shape {surface_shape}")
+            setattr(self, name, value)
+
+    def to_arrays(self, start_time: datetime) -> dict:
+        """Arrays for the native engines with times relative to start_time."""
+        offset = (self.start_time - start_time).total_seconds() / 3600.0
+        return {
+            "times": self.times + offset,
+            "lats": self.lats,
+            "lons": self.lons,
+            "heights": self.heights,
+            "u": self.u,
+            "v": self.v,
+            "w": self.w,
+            "mixing_depth": self.mixing_depth,
+            "precipitation": self.precipitation,
+        }
+
+    def save(self, path: str) -> str:
+        """Write the field to an uncompressed .npz file.
+
+        Args:
+            path: Output file path
+
+        Returns:
+            Path of the written file
+        """
+        arrays = {
+            name: getattr(self, name)
+            for name in ("times", "lats", "lons", "heights", "u", "v", "w",
+                         "mixing_depth", "precipitation")
+            if getattr(self, name) is not None
+        }
+        with open(path, "wb") as f:
+            np.savez(f, start_time=np.array(self.start_time.isoformat()), **arrays)
+        return path
+
+    @classmethod
+    def load(cls, path: str) -> "MetField":
+        """Read a field written by ``save()``.
+
+        Args:
+            path: Path of the .npz file
+
+        Returns:
+            MetField object
+        """
+        with np.load(path) as data:
+            arrays = {name: data[name] for name in data.files if name != "start_time"}
+            start_time = datetime.fromisoformat(str(data["start_time"]))
+        return cls(start_time=start_time, **arrays)
+
+
+def uniform_met_field(
+    start_time: datetime,
+    hours: int,
+    lat_range: tuple[float, float] = (-90.0, 90.0),
+    lon_range: tuple[float, float] = (-180.0, 180.0),
+    spacing: float = 1.0,
+    heights: Sequence[float] = (0.0, 1000.0, 5000.0, 20000.0),
+    u: float = 5.0,
+    v: float = 0.0,
+    w: float = 0.0,
+    mixing_depth: Optional[float] = None,
+    precipitation: Optional[float] = None,
+) -> MetField:
+    """Create a MetField with a spatially and temporally constant wind.
+
+    Useful for idealized experiments and for exercising the native engines
+    without decoded meteorology.
+
+    Args:
+        start_time: Time of the first met record
+        hours: Number of hourly records after the first
+        lat_range: Latitude extent (south, north)
+        lon_range: Longitude extent (west, east)
+        spacing: Grid spacing in degrees
+        heights: Vertical levels (meters AGL)
+        u, v, w: Wind components (m/s)
+        mixing_depth: Optional constant mixing depth (meters)
+        precipitation: Optional constant precipitation rate (mm/h)
+
+    Returns:
+        MetField object
+    """
+    times = np.arange(hours + 1, dtype=np.float64)
+    lats = np.arange(lat_range[0], lat_range[1] + spacing / 2, spacing)
+    lons = np.arange(lon_range[0], lon_range[1] + spacing / 2, spacing)
+    heights = np.asarray(heights, dtype=np.float64)
+    shape = (len(times), len(heights), len(lats), len(lons))
+    surface_shape = (shape[0],) + shape[2:]
+
+    return MetField(
+        start_time=start_time,
+        times=times,
+        lats=lats,
+        lons=lons,
+        heights=heights,
+        u=np.full(shape, u),
+        v=np.full(shape, v),
+        w=np.full(shape, w),
+        mixing_depth=(
+            np.full(surface_shape, mixing_depth) if mixing_depth is not None else None
+        ),
+        precipitation=(
+            np.full(surface_shape, precipitation) if precipitation is not None else None
+        ),
+    )
@@ -23,6 +23,7 @@ from hysplit.workflows.batch import (
     run_batch_trajectories,
     run_batch_dispersion,
 )
+from hysplit.workflows.journal import RunJournal
 
 __all__ = [
     # Download phase
@@ -37,4 +38,5 @@ __all__ = [
     "create_batch_config",
     "run_batch_trajectories",
     "run_batch_dispersion",
+    "RunJournal",
 ]
@@ -0,0 +1,230 @@
+"""
+Shared-memory transport of batch results.
+
+Returning parsed trajectories from ``ProcessPoolExecutor`` workers pickles
+every DataFrame through a pipe and unpickles it in the parent. A
+``ResultArena`` is instead a file on a memory filesystem (``/dev/shm`` on
+Linux) that holds one column region per output column, each with room for
+``capacity`` rows. A worker reserves rows for its run by bumping a counter
+in the arena header under an ``flock``, copies its columns into the
+reserved rows and returns only the (offset, rows) extent. The parent maps
+the same file, and since every run occupies the same rows in all columns,
+the rows filled by the batch already form contiguous columns: the final
+DataFrame is built from views of the mapping without copying.
+
+Pages of the arena are only allocated when written, so the capacity can be
+generous. A run that does not fit is returned through the pipe instead.
+
+Usage:
+    arena = ResultArena.create({"run_index": "int64", "lat": "float64"}, capacity=1 << 24)
+    # Worker process
+    extent = arena_write(arena.handle, frame, run_index=7)
+    # Parent, after collecting extents
+    df = arena.to_dataframe(extents)
+"""
+
+from __future__ import annotations
+
+import mmap
+import os
+import struct
+import tempfile
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+import pandas as pd
+
+try:
+    import fcntl
+    HAS_SHARED_ARENA = True
+except ImportError:
+    HAS_SHARED_ARENA = False
+
+MAGIC = 0x4152454E41535948  # "HYSARENA"
+HEADER = struct.Struct("<QQQ")  # magic, capacity, rows reserved
+HEADER_SIZE = 4096
+
+
+@dataclass(frozen=True)
+class ArenaHandle:
+    """Picklable description of an arena, passed to workers."""
+
+    path: str
+    capacity: int
+    columns: Tuple[Tuple[str, str], ...]  # (name, numpy dtype)
+
+    def offsets(self) -> Dict[str, int]:
+        """Byte offset of each column region, page aligned."""
+        offsets = {}
+        position = HEADER_SIZE
+        for name, dtype in self.columns:
+            offsets[name] = position
+            size = self.capacity * np.dtype(dtype).itemsize
+            position += (size + mmap.PAGESIZE - 1) // mmap.PAGESIZE * mmap.PAGESIZE
+        return offsets
+
+    @property
+    def size(self) -> int:
+        """Total size of the arena file in bytes."""
+        name, dtype = self.columns[-1]
+        return self.offsets()[name] + self.capacity * np.dtype(dtype).itemsize
+
+
+def _column_views(mapped: mmap.mmap, handle: ArenaHandle) -> Dict[str, np.ndarray]:
+    offsets = handle.offsets()
+    return {
+        name: np.frombuffer(mapped, dtype=dtype, count=handle.capacity, offset=offsets[name])
+        for name, dtype in handle.columns
+    }
+
+
+class ResultArena:
+    """Parent side of a shared-memory result arena."""
+
+    def __init__(self, handle: ArenaHandle, mapped: mmap.mmap):
+        self.handle = handle
+        self._mapped = mapped
+        self.columns = _column_views(mapped, handle)
+
+    @classmethod
+    def create(
+        cls,
+        columns: Dict[str, str],
+        capacity: int,
+        directory: Optional[str] = None,
+    ) -> "ResultArena":
+        """Create an empty arena.
+
+        Args:
+            columns: Column names and numpy dtypes, in output order
+            capacity: Maximum number of rows
+            directory: Directory of the arena file (default: /dev/shm when
+                       present, else the system temporary directory)
+
+        Returns:
+            ResultArena
+        """
+        if directory is None and os.path.isdir("/dev/shm"):
+            directory = "/dev/shm"
+        fd, path = tempfile.mkstemp(prefix="hysplit_arena_", dir=directory)
+        handle = ArenaHandle(path, int(capacity), tuple((k, str(np.dtype(v))) for k, v in columns.items()))
+        try:
+            os.ftruncate(fd, handle.size)
+            os.pwrite(fd, HEADER.pack(MAGIC, handle.capacity, 0), 0)
+            mapped = mmap.mmap(fd, handle.size)
+        finally:
+            os.close(fd)
+        return cls(handle, mapped)
+
+    @property
+    def rows_reserved(self) -> int:
+        """Rows reserved by workers so far."""
+        return HEADER.unpack_from(self._mapped, 0)[2]
+
+    def to_dataframe(self, extents: Sequence[Tuple[int, int]]) -> pd.DataFrame:
+        """Columns of the given (offset, rows) extents as a DataFrame.
+
+        When the extents cover the reserved rows without gaps (every run
+        that reserved rows also reported them), the columns are views of
+        the arena. Otherwise the extents are gathered into new arrays.
+        """
+        extents = sorted(extents)
+        used = 0
+        contiguous = True
+        for offset, rows in extents:
+            contiguous = contiguous and offset == used
+            used += rows
+        if contiguous and used == self.rows_reserved:
+            data = {name: view[:used] for name, view in self.columns.items()}
+        else:
+            data = {
+                name: np.concatenate([view[o:o + n] for o, n in extents]) if extents else view[:0]
+                for name, view in self.columns.items()
+            }
+        return pd.DataFrame(data, copy=False)
+
+    def unlink(self):
+        """Remove the arena file; existing views stay valid."""
+        try:
+            os.unlink(self.handle.path)
+        except FileNotFoundError:
+            pass
+
+
+_worker_maps: Dict[str, Tuple[int, Dict[str, np.ndarray]]] = {}
+
+
+def _attach(handle: ArenaHandle) -> Tuple[int, Dict[str, np.ndarray]]:
+    """Map an arena in a worker, once per process."""
+    cached = _worker_maps.get(handle.path)
+    if cached is None:
+        fd = os.open(handle.path, os.O_RDWR)
+        mapped = mmap.mmap(fd, handle.size)
+        cached = (fd, _column_views(mapped, handle))
+        _worker_maps[handle.path] = cached
+    return cached
+
+
+def _reserve(fd: int, rows: int, capacity: int) -> Optional[int]:
+    """Reserve rows under the arena lock; None if the arena is full."""
+    fcntl.flock(fd, fcntl.LOCK_EX)
+    try:
+        magic, _, reserved = HEADER.unpack(os.pread(fd, HEADER.size, 0))
+        if magic != MAGIC or reserved + rows > capacity:
+            return None
+        os.pwrite(fd, HEADER.pack(magic, capacity, reserved + rows), 0)
+        return reserved
+    finally:
+        fcntl.flock(fd, fcntl.LOCK_UN)
+
+
+def arena_write(handle: ArenaHandle, frame: pd.DataFrame, **constants) -> Optional[Tuple[int, int]]:
+    """Copy a worker's result into the arena.
+
+    Columns of the arena missing from ``frame`` are taken from
+    ``constants`` (e.g. ``run_index=7``) or filled with NaN, NaT or 0.
+
+    Args:
+        handle: Arena handle from the parent
+        frame: Result rows
+        **constants: Values for columns that are constant over the rows
+
+    Returns:
+        (offset, rows) extent, or None if the arena is full (or shared
+        arenas are unsupported on this platform)
+    """
+    if not HAS_SHARED_ARENA:
+        return None
+    rows = len(frame)
+    fd, views = _attach(handle)
+    offset = _reserve(fd, rows, handle.capacity)
+    if offset is None:
+        return None
+
+    for name, view in views.items():
+        target = view[offset:offset + rows]
+        if name in constants:
+            target[:] = constants[name]
+        elif name in frame.columns:
+            np.copyto(target, frame[name].to_numpy(), casting="unsafe")
+        elif view.dtype.kind == "M":
+            target[:] = np.datetime64("NaT")
+        elif view.dtype.kind == "f":
+            target[:] = np.nan
+        else:
+            target[:] = 0
+    return offset, rows
+
+
+def gather_results(
+    arena: ResultArena,
+    extents: Sequence[Tuple[int, int]],
+    frames: List[pd.DataFrame],
+) -> pd.DataFrame:
+    """Combine arena extents with results that came through the pipe."""
+    df = arena.to_dataframe(extents)
+    if not frames:
+        return df
+    columns = list(arena.columns)
+    return pd.concat([df] + [f.reindex(columns=columns) for f in frames], ignore_index=True)
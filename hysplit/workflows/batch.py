@@ -31,15 +31,21 @@ from __future__ import annotations
 
 import json
 import multiprocessing as mp
-from concurrent.futures import ProcessPoolExecutor, as_completed
+import os
+import time
 from dataclasses import dataclass, field, asdict
 from datetime import datetime, timedelta
 from pathlib import Path
-from typing import List, Optional, Union, Dict, Any, Callable
+from typing import TYPE_CHECKING, List, Optional, Union, Dict, Any, Callable, Tuple
 import itertools
 
 import pandas as pd
 
+if TYPE_CHECKING:
+    from hysplit.core.cache import RunCache
+    from hysplit.core.telemetry import BatchTelemetry
+    from hysplit.core.trajectory import TrajectoryModel
+
 
 @dataclass
 class BatchConfig:
@@ -101,6 +107,8 @@ class BatchConfig:
             "model_height": self.model_height,
             "extended_met": self.extended_met,
             "met_dir": self.met_dir,
+            "output_dir": self.output_dir,
+            "batch_name": self.batch_name,
             "binary_path": self.binary_path,
         }
 
@@ -123,9 +131,25 @@ class BatchConfig:
             data = json.load(f)
         return cls(**data)
 
-    def to_slurm_array(self, script_path: Union[str, Path], python_script: str) -> str:
-        """Generate a SLURM job array script."""
+    def fingerprint(self) -> str:
+        """Hash of the configuration identifying its journal."""
+        from hysplit.workflows.journal import config_fingerprint
+        return config_fingerprint(asdict(self))
+
+    def to_slurm_array(
+        self,
+        script_path: Union[str, Path],
+        python_script: str,
+        journal: Optional[Union[str, Path]] = None
+    ) -> str:
+        """Generate a SLURM job array script.
+
+        With ``journal``, every task records its completed run in the journal
+        and skips runs it already lists, so resubmitting the array after a
+        failure only re-runs what did not finish.
+        """
         total = self.total_runs()
+        journal_arg = f" --journal {journal}" if journal else ""
         script = f"""#!/bin/bash
 #SBATCH --job-name={self.batch_name}
 #SBATCH --array=0-{total - 1}
@@ -139,7 +163,7 @@ class BatchConfig:
 # module load python/3.9
 
 # Run the Python script with the array task ID
-python {python_script} --config {script_path} --run-index $SLURM_ARRAY_TASK_ID
+python {python_script} --config {script_path} --run-index $SLURM_ARRAY_TASK_ID{journal_arg}
 """
         return script
 
@@ -205,36 +229,162 @@ def create_batch_config(
     )
 
 
+def trajectory_columns(extended_met: bool = False) -> Dict[str, str]:
+    """Columns and dtypes of batch trajectories returned by the workers."""
+    from hysplit.io.readers import EXTENDED_COLS, STANDARD_COLS
+
+    columns = {"run_index": "int64"}
+    for name in EXTENDED_COLS if extended_met else STANDARD_COLS:
+        columns[name] = "int64" if name in ("year", "month", "day", "hour", "hour_along") else "float64"
+    columns["traj_dt"] = "datetime64[ns]"
+    return columns
+
+
+def _trajectory_model(params: Dict[str, Any]) -> "TrajectoryModel":
+    """TrajectoryModel of a batch run."""
+    from hysplit.core.trajectory import TrajectoryModel
+
+    date = datetime.strptime(params["date"], "%Y-%m-%d")
+    date = date.replace(hour=params["hour"])
+    model = TrajectoryModel(
+        lat=params["lat"],
+        lon=params["lon"],
+        height=params["height"],
+        duration=params["duration"],
+        days=[date],
+        daily_hours=[params["hour"]],
+        direction=params["direction"],
+        met_type=params["met_type"],
+        vert_motion=params["vert_motion"],
+        model_height=params["model_height"],
+        extended_met=params["extended_met"],
+        met_dir=params["met_dir"],
+        binary_path=params["binary_path"],
+        clean_up=True
+    )
+    if model.extended_met:
+        model.config.enable_extended_met()
+    return model
+
+
+def _run_cache_key(params: Dict[str, Any]) -> Optional[str]:
+    """Run cache key of a batch run, or None if it cannot be computed up front.
+
+    Needs ``met_dir`` (the met files are identified by their stat) and the
+    hyts_std binary.
+    """
+    from hysplit.core.cache import trajectory_run_key
+    from hysplit.core.trajectory import get_binary_path
+    from hysplit.workflows.scheduler import met_files_for_run, run_start
+
+    if not params["met_dir"]:
+        return None
+    try:
+        binary_path = params["binary_path"] or get_binary_path("hyts_std")
+    except FileNotFoundError:
+        return None
+    return trajectory_run_key(
+        _trajectory_model(params),
+        run_start(params),
+        (float(params["lat"]), float(params["lon"]), float(params["height"])),
+        params["met_dir"],
+        met_files_for_run(params),
+        binary_path,
+    )
+
+
+def _write_output(params: Dict[str, Any], result: Optional[pd.DataFrame]) -> Tuple[str, str]:
+    """Write a run's trajectory for ``output_dir``.
+
+    With an output spool (``spool_dir``) the file is only staged there and
+    reaches ``output_dir`` when the parent flushes the spool.
+
+    Returns:
+        Tuple of (file in ``output_dir`` or "", staged file or "")
+    """
+    if not params.get("output_dir") or result is None:
+        return "", ""
+    output_path = Path(params["output_dir"]) / (
+        f"{params.get('batch_name', 'batch')}_{params['run_index']:06d}.csv"
+    )
+    # The pid keeps duplicate attempts of a run from sharing a file
+    if params.get("spool_dir"):
+        staged = Path(params["spool_dir"]) / f"{output_path.name}.{os.getpid()}"
+        result.to_csv(staged, index=False)
+        return str(output_path.absolute()), str(staged)
+    # Write to a temporary name first so a crash never leaves a partial file
+    output_path.parent.mkdir(parents=True, exist_ok=True)
+    tmp_path = output_path.with_name(f"{output_path.name}.{os.getpid()}.tmp")
+    result.to_csv(tmp_path, index=False)
+    os.replace(tmp_path, output_path)
+    return str(output_path.absolute()), ""
+
+
+def _scratch_roots(scratch: Optional[Union[str, Path]]) -> Tuple[Optional[str], Optional[str]]:
+    """Scratch roots of a batch's working directories and of its output spool.
+
+    "auto" is ``HYSPLIT_SCRATCH`` or, failing that, /dev/shm. Met files are
+    never downloaded into the working directories (see
+    ``hysplit.core.launcher.worker_met_dir``).
+    """
+    from hysplit.core.scratch import SCRATCH_ENV, tmpfs_root
+
+    if scratch == "auto":
+        root = os.environ.get(SCRATCH_ENV)
+        if root:
+            scratch = None if root.lower() == "off" else root
+        else:
+            tmpfs = tmpfs_root()
+            if tmpfs is None:
+                return None, None
+            return str(tmpfs), str(tmpfs)
+    root = str(scratch) if scratch is not None else None
+    return root, root
+
+
 def _run_single_trajectory(params: Dict[str, Any]) -> Dict[str, Any]:
     """Worker function to run a single trajectory."""
-    from hysplit.core.trajectory import hysplit_trajectory
+    from hysplit.core import scratch, telemetry
+    from hysplit.core.cache import RunCache
+    from hysplit.core.launcher import RunCancelledError, RunTimeoutError, launch_limits
+    from hysplit.workflows.arena import arena_write
 
+    start = time.monotonic_ns()
+    timers = []
     try:
-        date = datetime.strptime(params["date"], "%Y-%m-%d")
-        date = date.replace(hour=params["hour"])
-
-        result = hysplit_trajectory(
-            lat=params["lat"],
-            lon=params["lon"],
-            height=params["height"],
-            duration=params["duration"],
-            days=[date],
-            daily_hours=[params["hour"]],
-            direction=params["direction"],
-            met_type=params["met_type"],
-            vert_motion=params["vert_motion"],
-            model_height=params["model_height"],
-            extended_met=params["extended_met"],
-            met_dir=params["met_dir"],
-            binary_path=params["binary_path"],
-            clean_up=True
-        )
-
+        if "scratch" in params:
+            scratch.configure(*params["scratch"])
+        model = _trajectory_model(params)
+        if params.get("cache"):
+            model.cache = RunCache(params["cache"])
+
+        with telemetry.collect() as timers, launch_limits(params.get("timeout"), params.get("cancel")):
+            result = model.run().get_output()
+
+        output, staged = _write_output(params, result)
+
+        # Hand the trajectory to the parent through the shared arena if it fits
+        extent, frame = None, None
+        if params.get("collect") and result is not None and len(result):
+            if params.get("result_arena") is not None:
+                extent = arena_write(params["result_arena"], result, run_index=params["run_index"])
+            if extent is None:
+                frame = result.assign(run_index=params["run_index"])
+
+        spans = [span for timer in timers for span in timer.spans]
+        spans.append(("total", start, time.monotonic_ns() - start))
         return {
             "run_index": params["run_index"],
             "success": True,
             "n_points": len(result) if result is not None else 0,
-            "error": None
+            "error": None,
+            "output": output,
+            "staged": staged,
+            "extent": extent,
+            "frame": frame,
+            "cached": model.cache is not None and model.cache.hits > 0,
+            "timings": spans,
+            "pid": os.getpid()
         }
 
     except Exception as e:
@@ -242,15 +392,32 @@ def _run_single_trajectory(params: Dict[str, Any]) -> Dict[str, Any]:
             "run_index": params["run_index"],
             "success": False,
             "n_points": 0,
-            "error": str(e)
+            "error": str(e),
+            "output": "",
+            "timed_out": isinstance(e, RunTimeoutError),
+            "cancelled": isinstance(e, RunCancelledError),
+            "timings": [span for timer in timers for span in timer.spans]
+                       + [("total", start, time.monotonic_ns() - start)],
+            "pid": os.getpid()
         }
 
 
 def run_batch_trajectories(
     config: BatchConfig,
     n_workers: int = 4,
-    progress_callback: Optional[Callable] = None
-) -> pd.DataFrame:
+    progress_callback: Optional[Callable] = None,
+    schedule: str = "locality",
+    measure_cache: bool = False,
+    journal: Optional[Union[str, Path]] = None,
+    return_trajectories: bool = False,
+    telemetry: Optional["BatchTelemetry"] = None,
+    cache: Optional[Union[str, Path, "RunCache"]] = None,
+    timeout: Optional[float] = None,
+    speculate: bool = False,
+    placement: Optional[str] = None,
+    scratch: Optional[Union[str, Path]] = "auto",
+    scratch_budget: Optional[Union[int, str]] = None
+) -> Union[pd.DataFrame, Tuple[pd.DataFrame, pd.DataFrame]]:
     """
     Run batch trajectories using multiprocessing.
 
@@ -258,36 +425,243 @@ def run_batch_trajectories(
         config: BatchConfig object
         n_workers: Number of parallel workers
         progress_callback: Optional callback function(completed, total)
+        schedule: "locality" groups runs by the met files they read and
+                  keeps each file hot (see hysplit.workflows.scheduler);
+                  "naive" runs them in ``iter_runs()`` order
+        measure_cache: Sample the page-cache residency of each run's met
+                       files (requires ``config.met_dir``)
+        journal: Path of a run journal (see hysplit.workflows.journal).
+                 Successful runs are recorded as they complete, and runs
+                 already in the journal are skipped, so calling again after
+                 a crash resumes the batch
+        return_trajectories: Also return the trajectory points of the runs
+                             executed by this call. Workers write them into a
+                             shared-memory arena (hysplit.workflows.arena)
+                             instead of pickling DataFrames back
+        telemetry: BatchTelemetry that receives the per-phase timings of
+                   every run (see hysplit.core.telemetry)
+        cache: Run cache directory or RunCache (see hysplit.core.cache).
+               With ``config.met_dir`` set, runs found in the cache are
+               answered by the parent without being scheduled; workers look
+               up the rest again and store what they compute
+        timeout: Seconds before the hyts_std of a run is killed; the run
+                 fails with a RunTimeoutError instead of stalling its worker
+        speculate: Launch a duplicate of runs that have been running longer
+                   than the p99 of the batch so far; the first attempt to
+                   finish wins and the other is killed
+        placement: Pin workers to "cores" or to "nodes" (the CPUs of their
+                   NUMA node) and give each NUMA node its own share of the
+                   met groups (see hysplit.workflows.placement); None lets
+                   the kernel move workers freely
+        scratch: Directory on a tmpfs for the workers' working directories
+                 and for staging output files (see hysplit.core.scratch).
+                 "auto" uses ``HYSPLIT_SCRATCH`` or /dev/shm; met files are
+                 never downloaded there. Outputs are
+                 staged there and copied to ``output_dir`` in batches; a run
+                 is only journaled once its output is in ``output_dir``, so
+                 outputs lost in a crash are rerun on resume. None keeps
+                 everything under the system temporary directory
+        scratch_budget: Bytes (or e.g. "2G") the scratch may use; default
+                        ``HYSPLIT_SCRATCH_BUDGET`` or 1 GiB
 
     Returns:
-        DataFrame with combined results from all runs
+        DataFrame with combined results from all runs; the schedule report
+        is stored in ``df.attrs["schedule"]`` and, with a cache, the hit
+        counts of the runs looked up in it (not those replayed from the
+        journal) in ``df.attrs["cache"]`` and, with a scratch, its use in
+        ``df.attrs["scratch"]``. With ``return_trajectories``,
+        a tuple of that DataFrame and the trajectories (one row per point,
+        with a ``run_index`` column)
     """
-    total_runs = config.total_runs()
-    print(f"Running {total_runs} trajectories with {n_workers} workers")
-
-    all_params = list(config.iter_runs())
-    results = []
+    from hysplit.core.cache import open_cache
+    from hysplit.core.scratch import OutputSpool, ScratchSpace, parse_size
+    from hysplit.workflows.journal import RunJournal
+    from hysplit.workflows.scheduler import run_scheduled
 
-    with ProcessPoolExecutor(max_workers=n_workers) as executor:
-        futures = {executor.submit(_run_single_trajectory, p): p for p in all_params}
-
-        completed = 0
-        for future in as_completed(futures):
-            result = future.result()
-            results.append(result)
-            completed += 1
+    total_runs = config.total_runs()
+    all_params = config.iter_runs()
+    run_journal = None
+    if journal is not None:
+        run_journal = RunJournal(journal, total_runs, fingerprint=config.fingerprint())
+        all_params = run_journal.remaining(all_params)
+        if run_journal.n_done:
+            print(f"Resuming from {journal}: {run_journal.n_done} runs already completed")
+    all_params = list(all_params)
+
+    # Working directories and staged outputs on the scratch (tmpfs)
+    exec_root, spool_root = _scratch_roots(scratch)
+    spool = None
+    if spool_root is not None and config.output_dir:
+        try:
+            spool = OutputSpool(ScratchSpace(spool_root, scratch_budget))
+        except OSError as e:
+            print(f"Warning: no output spool under {spool_root} ({e}); writing outputs directly")
+    for params in all_params:
+        params["scratch"] = (exec_root, scratch_budget)
+        if spool is not None:
+            params["spool_dir"] = str(spool.directory)
+
+    def persist(results):
+        if run_journal is not None:
+            for result in results:
+                run_journal.record(result["run_index"], result["n_points"], result["output"])
+
+    def keep(result):
+        """Journal a successful run once its output is in ``output_dir``."""
+        if not result["success"]:
+            return
+        if spool is not None and result.get("staged"):
+            spool.add(result["staged"], result["output"], result)
+            if spool.due():
+                persist(spool.flush())
+        else:
+            persist([result])
+
+    def discard(result):
+        """Remove the staged output of an attempt that lost its run."""
+        if result.get("staged"):
+            Path(result["staged"]).unlink(missing_ok=True)
+
+    # Runs already in the run cache never reach a worker
+    run_cache = open_cache(cache)
+    cached_results = []
+    if run_cache is not None:
+        misses = []
+        for params in all_params:
+            key = _run_cache_key(params)
+            df = run_cache.get(key) if key is not None else None
+            if df is None:
+                params["cache"] = str(run_cache.directory)
+                misses.append(params)
+                continue
+            df = df.assign(run=1)
+            output, staged = _write_output(params, df)
+            cached_results.append({
+                "run_index": params["run_index"], "success": True, "n_points": len(df),
+                "error": None, "output": output, "staged": staged, "cached": True,
+                "frame": df.assign(run_index=params["run_index"]) if return_trajectories else None,
+            })
+            keep(cached_results[-1])
+        all_params = misses
+        print(f"Run cache: {len(cached_results)} of {len(cached_results) + len(misses)} runs cached")
+    print(f"Running {len(all_params)} trajectories with {n_workers} workers")
+
+    arena = None
+    if return_trajectories:
+        from hysplit.workflows.arena import HAS_SHARED_ARENA, ResultArena, gather_results
+        if HAS_SHARED_ARENA:
+            # One point per hour and run; pages are only allocated when written
+            capacity = max(1, len(all_params) * (abs(config.duration) + 1))
+            arena = ResultArena.create(trajectory_columns(config.extended_met), capacity)
+        for params in all_params:
+            params["collect"] = True
+            params["result_arena"] = arena.handle if arena is not None else None
+
+    def report_progress(completed, total):
+        if progress_callback:
+            progress_callback(completed, total)
+        elif completed % 10 == 0:
+            print(f"Progress: {completed}/{total}")
+
+    def record(result):
+        if telemetry is not None:
+            telemetry.add_run(result["run_index"], result["timings"], result["pid"])
+        keep(result)
 
-            if progress_callback:
-                progress_callback(completed, total_runs)
-            else:
-                if completed % 10 == 0:
-                    print(f"Progress: {completed}/{total_runs}")
+    try:
+        results, report = run_scheduled(
+            _run_single_trajectory,
+            all_params,
+            n_workers=n_workers,
+            schedule=schedule,
+            met_dir=config.met_dir,
+            measure_cache=measure_cache,
+            progress_callback=report_progress,
+            result_callback=record,
+            discard_callback=discard,
+            timeout=timeout,
+            speculate=speculate,
+            succeeded=lambda result: result["success"],
+            placement=placement,
+        )
+    finally:
+        if spool is not None:
+            try:
+                persist(spool.flush())
+            finally:
+                spool.space.close()
+        if run_journal is not None:
+            run_journal.close()
+        if arena is not None:
+            arena.unlink()
+
+    results = cached_results + results
+    # Only these were looked up in the run cache
+    looked_up = len(results)
+
+    trajectories = None
+    if return_trajectories:
+        extents = [r["extent"] for r in results if r.get("extent") is not None]
+        frames = [r["frame"] for r in results if r.get("frame") is not None]
+        if arena is not None:
+            trajectories = gather_results(arena, extents, frames)
+        else:
+            columns = list(trajectory_columns(config.extended_met))
+            trajectories = (pd.concat(frames, ignore_index=True) if frames else pd.DataFrame()).reindex(columns=columns)
+
+    # Runs completed before a resume come from the journal
+    if run_journal is not None:
+        completed = {r["run_index"] for r in results}
+        results = [
+            {"run_index": e.run_index, "success": True, "n_points": e.n_points,
+             "error": None, "output": e.output}
+            for e in run_journal.entries.values() if e.run_index not in completed
+        ] + results
 
     # Summarize results
-    df = pd.DataFrame(results)
-    success_rate = df["success"].sum() / len(df) * 100
+    df = pd.DataFrame(results, columns=["run_index", "success", "n_points", "error", "output"])
+    success_rate = df["success"].sum() / len(df) * 100 if len(df) else 0.0
     print(f"Completed: {len(df)} runs, {success_rate:.1f}% success rate")
+    print(report.summary())
+    df.attrs["schedule"] = {
+        "schedule": report.schedule,
+        "runs": report.runs,
+        "groups": report.groups,
+        "steals": report.steals,
+        "elapsed": report.elapsed,
+        "throughput": report.throughput,
+        "cache_hit_ratio": report.cache_hit_ratio,
+        "speculated": report.speculated,
+        "speculative_wins": report.speculative_wins,
+        "cancelled": report.cancelled,
+        "placement": report.placement,
+        "numa_nodes": report.numa_nodes,
+        "remote_groups": report.remote_groups,
+        "timed_out": sum(1 for r in results if r.get("timed_out")),
+    }
+    if df.attrs["schedule"]["timed_out"]:
+        print(f"Timed out: {df.attrs['schedule']['timed_out']} runs (limit {timeout}s)")
+    if exec_root is not None or spool is not None:
+        df.attrs["scratch"] = {
+            "root": exec_root or spool_root,
+            "exec_dirs": exec_root is not None,
+            "flushes": spool.flushes if spool is not None else 0,
+            "files_flushed": spool.files_flushed if spool is not None else 0,
+            "bytes_flushed": spool.bytes_flushed if spool is not None else 0,
+        }
+    if run_cache is not None:
+        hits = sum(1 for r in results if r.get("cached"))
+        df.attrs["cache"] = {
+            "hits": hits,
+            "misses": looked_up - hits,
+            "hit_rate": hits / looked_up if looked_up else 0.0,
+            "parent_hits": len(cached_results),
+            "journaled": len(results) - looked_up,
+        }
+        print(f"Run cache hit rate: {df.attrs['cache']['hit_rate'] * 100:.1f}% ({hits}/{looked_up})")
 
+    if return_trajectories:
+        return df, trajectories
     return df
 
 
@@ -321,17 +695,44 @@ def main():
     parser.add_argument("--config", required=True, help="Path to batch config JSON")
     parser.add_argument("--run-index", type=int, required=True, help="Index of run to execute")
     parser.add_argument("--output-dir", help="Override output directory")
+    parser.add_argument("--journal", help="Run journal shared by all tasks of the batch")
+    parser.add_argument("--cache", help="Run cache directory shared by all tasks of the batch")
+    parser.add_argument("--timeout", type=float, help="Seconds before a hung hyts_std is killed")
+    parser.add_argument("--scratch", help="tmpfs directory (e.g. /dev/shm) for the run's working directory")
 
     args = parser.parse_args()
 
     # Load config
     config = BatchConfig.from_json(args.config)
 
+    run_journal = None
+    if args.journal:
+        from hysplit.workflows.journal import RunJournal
+        # Other array tasks append concurrently, so never truncate the tail
+        run_journal = RunJournal(
+            args.journal, config.total_runs(), fingerprint=config.fingerprint(), repair=False
+        )
+        if run_journal.is_done(args.run_index):
+            print(f"Run {args.run_index}: already completed")
+            run_journal.close()
+            return
+
+    if args.output_dir:
+        config.output_dir = args.output_dir
+
     # Get params for this run
     params = config.get_run_params(args.run_index)
+    params["cache"] = args.cache
+    params["timeout"] = args.timeout
+    if args.scratch:
+        params["scratch"] = (args.scratch, None)
 
     # Run single trajectory
     result = _run_single_trajectory(params)
+    if run_journal is not None:
+        if result["success"]:
+            run_journal.record(args.run_index, result["n_points"], result["output"])
+        run_journal.close()
 
     print(f"Run {args.run_index}: {'SUCCESS' if result['success'] else 'FAILED'}")
     if result["error"]:
@@ -0,0 +1,240 @@
+"""
+Crash-safe journal of completed batch runs.
+
+Batch results otherwise live only in the memory of the parent process, so
+a batch that dies part way must start over. The journal is an append-only
+text file with one record per completed run (run index, number of
+trajectory points and output file), each protected by a CRC32. Records are
+written with a single ``write()`` on an ``O_APPEND`` descriptor and synced
+to disk in batches (every ``sync_every`` records or ``sync_interval``
+seconds), so journaling costs one fsync per batch rather than per run.
+
+On open, the journal is replayed into a bitmap of completed run indices;
+resuming a batch tests one bit per run. Records that are torn, corrupt or
+point to a missing output file are ignored, so the worst outcome of a
+crash is re-running a few runs, never skipping one that did not finish.
+
+File format::
+
+    hysplit-journal 1\t<total_runs>\t<fingerprint>
+    <run_index>\t<n_points>\t<output>\t<crc32 hex>
+    ...
+
+Usage:
+    from hysplit.workflows.journal import RunJournal
+
+    with RunJournal("batch.journal", total_runs=config.total_runs()) as journal:
+        for params in config.iter_runs():
+            if journal.is_done(params["run_index"]):
+                continue
+            ...
+            journal.record(params["run_index"], n_points, output)
+"""
+
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import tempfile
+import time
+import zlib
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Any, Dict, Iterable, Iterator, Optional, Union
+
+MAGIC = "hysplit-journal 1"
+
+
+def config_fingerprint(config: Dict[str, Any]) -> str:
+    """Short hash of a batch configuration, excluding its creation time.
+
+    Args:
+        config: Configuration dictionary (e.g. ``asdict(BatchConfig)``)
+
+    Returns:
+        16-character hex digest
+    """
+    data = {k: v for k, v in config.items() if k != "created_at"}
+    encoded = json.dumps(data, sort_keys=True, default=str).encode()
+    return hashlib.blake2b(encoded, digest_size=8).hexdigest()
+
+
+@dataclass
+class JournalEntry:
+    """A completed run as recorded in the journal."""
+
+    run_index: int
+    n_points: int
+    output: str  # Output file, empty if the run kept no output
+
+
+def _encode(run_index: int, n_points: int, output: str) -> bytes:
+    body = f"{run_index}\t{n_points}\t{output}".encode()
+    return body + b"\t%08x\n" % zlib.crc32(body)
+
+
+def _decode(line: bytes) -> Optional[JournalEntry]:
+    body, sep, crc = line.rpartition(b"\t")
+    if not sep or len(crc) != 8:
+        return None
+    try:
+        if int(crc, 16) != zlib.crc32(body):
+            return None
+        index, n_points, output = body.split(b"\t", 2)
+        return JournalEntry(int(index), int(n_points), output.decode())
+    except ValueError:
+        return None
+
+
+class RunJournal:
+    """Append-only journal of completed runs with a completion bitmap.
+
+    Several processes (e.g. SLURM array tasks) may append to the same
+    journal on a local filesystem, since every record is one ``O_APPEND``
+    write. Only a single writer should use ``repair=True``.
+
+    Args:
+        path: Journal file, created if missing
+        total_runs: Number of runs in the batch
+        fingerprint: Configuration fingerprint; opening a journal written for
+                     a different configuration raises ValueError
+        sync_every: Records between fsyncs
+        sync_interval: Maximum seconds between fsyncs while recording
+        verify_outputs: Treat runs whose output file is missing as not done
+        repair: Truncate a torn record at the end of the file before appending
+    """
+
+    def __init__(
+        self,
+        path: Union[str, Path],
+        total_runs: int,
+        fingerprint: str = "",
+        sync_every: int = 256,
+        sync_interval: float = 1.0,
+        verify_outputs: bool = True,
+        repair: bool = True,
+    ):
+        self.path = Path(path)
+        self.total_runs = total_runs
+        self.fingerprint = fingerprint
+        self.sync_every = max(1, sync_every)
+        self.sync_interval = sync_interval
+        self.entries: Dict[int, JournalEntry] = {}
+        self._bitmap = bytearray((total_runs + 7) // 8)
+        self._pending = 0
+        self._last_sync = time.monotonic()
+
+        self._create()
+        valid_end = self._load(verify_outputs)
+        self._fd = os.open(self.path, os.O_WRONLY | os.O_APPEND)
+        if repair and valid_end < self.path.stat().st_size:
+            os.ftruncate(self._fd, valid_end)
+            os.fsync(self._fd)
+
+    def _create(self):
+        """Create the journal with its header atomically if it does not exist."""
+        if self.path.exists():
+            return
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        fd, tmp = tempfile.mkstemp(dir=self.path.parent, prefix=f".{self.path.name}.")
+        try:
+            os.write(fd, f"{MAGIC}\t{self.total_runs}\t{self.fingerprint}\n".encode())
+            os.fsync(fd)
+            os.close(fd)
+            try:
+                os.link(tmp, self.path)
+            except FileExistsError:
+                pass  # Created concurrently by another process
+        finally:
+            os.unlink(tmp)
+
+        dir_fd = os.open(self.path.parent, os.O_RDONLY)
+        try:
+            os.fsync(dir_fd)
+        finally:
+            os.close(dir_fd)
+
+    def _load(self, verify_outputs: bool) -> int:
+        """Replay the journal into the bitmap; returns the end of the last whole line."""
+        data = self.path.read_bytes()
+        header, _, records = data.partition(b"\n")
+        fields = header.decode(errors="replace").split("\t")
+        if len(fields) != 3 or fields[0] != MAGIC:
+            raise ValueError(f"Not a batch journal: {self.path}")
+        if int(fields[1]) != self.total_runs or fields[2] != self.fingerprint:
+            raise ValueError(
+                f"Journal {self.path} belongs to a different batch configuration"
+            )
+
+        for line in records.split(b"\n")[:-1]:
+            entry = _decode(line)
+            if entry is None or not 0 <= entry.run_index < self.total_runs:
+                continue
+            if verify_outputs and entry.output and not os.path.exists(entry.output):
+                continue
+            self._set(entry.run_index)
+            self.entries[entry.run_index] = entry
+        return data.rfind(b"\n") + 1
+
+    def _set(self, run_index: int):
+        self._bitmap[run_index >> 3] |= 1 << (run_index & 7)
+
+    def is_done(self, run_index: int) -> bool:
+        """Whether a run has completed (one bitmap test)."""
+        return bool(self._bitmap[run_index >> 3] & (1 << (run_index & 7)))
+
+    @property
+    def n_done(self) -> int:
+        """Number of completed runs."""
+        return len(self.entries)
+
+    def remaining(self, runs: Iterable[Dict[str, Any]]) -> Iterator[Dict[str, Any]]:
+        """Filter run parameter dicts down to the runs not yet completed."""
+        return (params for params in runs if not self.is_done(params["run_index"]))
+
+    def record(self, run_index: int, n_points: int = 0, output: Union[str, Path] = ""):
+        """Append a completed run; synced to disk with the next batch.
+
+        Args:
+            run_index: Index of the run in the batch
+            n_points: Number of trajectory points
+            output: File holding the run's output, if any
+        """
+        output = str(output)
+        if "\n" in output:
+            raise ValueError("Journal output paths cannot contain newlines")
+        os.write(self._fd, _encode(run_index, n_points, output))
+        self._set(run_index)
+        self.entries[run_index] = JournalEntry(run_index, n_points, output)
+
+        self._pending += 1
+        if (self._pending >= self.sync_every
+                or time.monotonic() - self._last_sync >= self.sync_interval):
+            self.sync()
+
+    def sync(self):
+        """Flush pending records to disk."""
+        if self._pending:
+            os.fsync(self._fd)
+            self._pending = 0
+        self._last_sync = time.monotonic()
+
+    def close(self):
+        """Sync and close the journal."""
+        if self._fd >= 0:
+            self.sync()
+            os.close(self._fd)
+            self._fd = -1
+
+    def __enter__(self) -> "RunJournal":
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        try:
+            self.close()
+        except (OSError, AttributeError):
+            pass
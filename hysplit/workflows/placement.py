@@ -0,0 +1,135 @@
+"""
+CPU and NUMA placement of batch worker processes.
+
+On multi-socket machines the kernel moves unpinned workers between
+sockets, so a met file read into the page cache by one worker (and
+therefore allocated on that worker's NUMA node) is later read remotely by
+others. With a placement, the scheduler runs one process pool per NUMA
+node whose workers are pinned, either each to one core ("cores") or to the
+CPUs of their node ("nodes"). HYSPLIT binaries inherit the affinity of
+their worker. Pages are allocated on the node that first touches them, so
+met data a node's workers read stays local to that node.
+
+The topology comes from /sys/devices/system/node (Linux), restricted to the
+CPUs this process may run on; elsewhere all CPUs form a single node and
+pinning is skipped.
+
+Usage:
+    from hysplit.workflows.placement import numa_nodes, plan_placement
+
+    for worker in plan_placement(n_workers=8, mode="cores"):
+        print(worker.node, sorted(worker.cpus))
+"""
+
+from __future__ import annotations
+
+import os
+from dataclasses import dataclass
+from pathlib import Path
+from typing import FrozenSet, List, Optional, Sequence
+
+NODE_ROOT = Path("/sys/devices/system/node")
+PLACEMENTS = ("nodes", "cores")
+
+
+@dataclass(frozen=True)
+class NumaNode:
+    """A NUMA node and the CPUs of it this process may use."""
+
+    node: int
+    cpus: FrozenSet[int]
+
+
+@dataclass(frozen=True)
+class WorkerPlacement:
+    """CPUs a worker process is pinned to."""
+
+    worker: int
+    node: int
+    cpus: FrozenSet[int]
+
+
+def parse_cpulist(text: str) -> FrozenSet[int]:
+    """CPUs of a sysfs cpulist such as ``0-3,8-11``."""
+    cpus = set()
+    for part in text.strip().split(","):
+        if not part:
+            continue
+        first, _, last = part.partition("-")
+        cpus.update(range(int(first), int(last or first) + 1))
+    return frozenset(cpus)
+
+
+def available_cpus() -> FrozenSet[int]:
+    """CPUs this process may run on."""
+    if hasattr(os, "sched_getaffinity"):
+        return frozenset(os.sched_getaffinity(0))
+    return frozenset(range(os.cpu_count() or 1))
+
+
+def numa_nodes(root: Path = NODE_ROOT) -> List[NumaNode]:
+    """NUMA nodes with at least one usable CPU, by node number."""
+    usable = available_cpus()
+    nodes = []
+    for path in sorted(root.glob("node[0-9]*"), key=lambda p: int(p.name[4:])):
+        try:
+            cpus = parse_cpulist((path / "cpulist").read_text()) & usable
+        except (OSError, ValueError):
+            continue
+        if cpus:
+            nodes.append(NumaNode(int(path.name[4:]), cpus))
+    return nodes or [NumaNode(0, usable)]
+
+
+def split_workers(n_workers: int, nodes: Sequence[NumaNode]) -> List[int]:
+    """Workers per node, proportional to the nodes' CPU counts (largest remainder)."""
+    total = sum(len(node.cpus) for node in nodes)
+    shares = [n_workers * len(node.cpus) / total for node in nodes]
+    counts = [int(share) for share in shares]
+    by_remainder = sorted(range(len(nodes)), key=lambda i: counts[i] - shares[i])
+    for i in by_remainder[:n_workers - sum(counts)]:
+        counts[i] += 1
+    return counts
+
+
+def plan_placement(
+    n_workers: int,
+    mode: str = "cores",
+    nodes: Optional[Sequence[NumaNode]] = None,
+) -> List[WorkerPlacement]:
+    """Pinning of each worker, grouped by node.
+
+    Args:
+        n_workers: Number of worker processes
+        mode: "cores" pins every worker to one core of its node (cores are
+              shared round-robin when a node has more workers than cores);
+              "nodes" pins workers to all CPUs of their node
+        nodes: Topology; defaults to ``numa_nodes()``
+
+    Returns:
+        One WorkerPlacement per worker, workers of a node numbered together
+    """
+    if mode not in PLACEMENTS:
+        raise ValueError(f"Unknown placement: '{mode}'. Use 'nodes' or 'cores'")
+    nodes = list(nodes) if nodes is not None else numa_nodes()
+    placements = []
+    for node, count in zip(nodes, split_workers(n_workers, nodes)):
+        cores = sorted(node.cpus)
+        for i in range(count):
+            cpus = frozenset([cores[i % len(cores)]]) if mode == "cores" else node.cpus
+            placements.append(WorkerPlacement(len(placements), node.node, cpus))
+    return placements
+
+
+def pin_worker(cpu_sets: Sequence[FrozenSet[int]], claimed) -> None:
+    """Process pool initializer: pin this process to the next unclaimed CPU set.
+
+    Args:
+        cpu_sets: CPU sets of the pool's processes
+        claimed: multiprocessing.Value counting the sets already taken
+    """
+    with claimed.get_lock():
+        index = claimed.value
+        claimed.value += 1
+    if index < len(cpu_sets) and hasattr(os, "sched_setaffinity"):
+        os.sched_setaffinity(0, cpu_sets[index])
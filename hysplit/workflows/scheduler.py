@@ -0,0 +1,469 @@
+"""
+Met-locality-aware scheduling of batch runs.
+
+Submitting batch runs in ``BatchConfig.iter_runs()`` order (location-major)
+makes the workers jump between met files, so on a met set larger than
+memory every run reads its files from disk again. This scheduler groups
+runs by the met files they need and works through the groups in
+chronological order, so neighbouring groups share files. Workers split a
+group between them by work stealing: an idle worker takes the back half of
+the busiest worker's remaining runs, which read the same met files and
+are therefore already in the page cache.
+
+Runs can be bounded by a timeout, and stragglers re-executed
+speculatively: once enough runs have completed, a worker that frees up
+launches a duplicate of the oldest in-flight run that has been running
+longer than the p99 of the completed ones. The first attempt to succeed
+wins; the other is killed through its cancel flag (see
+hysplit.core.launcher) and its result is discarded, or handed to a
+discard callback that removes what it wrote.
+
+With a placement (see hysplit.workflows.placement), workers are pinned and
+run in one process pool per NUMA node. The met groups are split into
+contiguous chronological chunks, one per node, so the files a node's
+workers read stay in that node's memory; workers steal within their node,
+and a node that runs out of work takes the last pending group of another.
+
+Usage:
+    from hysplit.workflows.scheduler import run_scheduled
+
+    results, report = run_scheduled(func, all_params, n_workers=8, met_dir="met")
+    print(report.throughput, report.cache_hit_ratio)
+"""
+
+from __future__ import annotations
+
+import contextlib
+import ctypes
+import ctypes.util
+import mmap
+import multiprocessing as mp
+import os
+import time
+from collections import deque
+from concurrent.futures import FIRST_COMPLETED, Future, ProcessPoolExecutor, wait
+from dataclasses import dataclass, field
+from datetime import datetime, timedelta
+from pathlib import Path
+from typing import Any, Callable, Deque, Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+from hysplit.core.launcher import CancelFlags
+from hysplit.core.telemetry import HdrHistogram
+from hysplit.met.downloaders import met_file_names
+from hysplit.workflows.placement import pin_worker, plan_placement
+
+# Attempts per run, counting the original
+MAX_ATTEMPTS = 2
+# Seconds between straggler checks while workers are idle
+SPECULATION_TICK = 0.05
+
+
+def run_start(params: Dict[str, Any]) -> datetime:
+    """Start time of a batch run from its ``date`` and ``hour`` parameters."""
+    return datetime.strptime(params["date"], "%Y-%m-%d") + timedelta(hours=params["hour"])
+
+
+def met_files_for_run(params: Dict[str, Any]) -> Tuple[str, ...]:
+    """Met files a batch run reads."""
+    return tuple(met_file_names(
+        met_type=params["met_type"],
+        days=[run_start(params)],
+        duration=params["duration"],
+        direction=params["direction"],
+    ))
+
+
+@dataclass
+class RunGroup:
+    """Runs that read the same met files."""
+
+    met_files: Tuple[str, ...]
+    runs: Deque[Dict[str, Any]] = field(default_factory=deque)
+
+
+def group_by_met(
+    runs: Sequence[Dict[str, Any]],
+    met_files: Callable[[Dict[str, Any]], Tuple[str, ...]] = met_files_for_run,
+) -> List[RunGroup]:
+    """Group runs by the met files they need, in chronological order.
+
+    Groups are ordered by the earliest start time of their runs, and runs
+    inside a group by start time, so consecutive groups share most files.
+    """
+    groups: Dict[Tuple[str, ...], RunGroup] = {}
+    for params in sorted(runs, key=run_start):
+        files = met_files(params)
+        if files not in groups:
+            groups[files] = RunGroup(files)
+        groups[files].runs.append(params)
+    return list(groups.values())
+
+
+class WorkStealingQueues:
+    """Per-worker run queues with stealing within a group.
+
+    Groups are started in chronological order. A worker that starts a group
+    takes all of its runs; an idle worker steals the back half of the
+    longest queue, which holds runs of a group already in progress, and
+    only starts the next group when there is nothing left to steal. All
+    workers therefore stay on the same or adjacent groups, and the met
+    working set is about two groups' files at any time.
+    """
+
+    def __init__(self, groups: Sequence[RunGroup], n_workers: int):
+        self.pending: Deque[RunGroup] = deque(groups)
+        self.queues: List[Deque[Dict[str, Any]]] = [deque() for _ in range(n_workers)]
+        self.steals = 0
+
+    def next_run(self, worker: int) -> Optional[Dict[str, Any]]:
+        """Next run for a worker: own queue, then steal, then the next group."""
+        own = self.queues[worker]
+        if not own and not self._steal(worker) and self.pending:
+            own.extend(self.pending.popleft().runs)
+        return own.popleft() if own else None
+
+    def _steal(self, thief: int) -> bool:
+        victim = max(self.queues, key=len)
+        if len(victim) < 2:
+            return False
+        stolen = [victim.pop() for _ in range(len(victim) // 2)]
+        self.queues[thief].extend(reversed(stolen))
+        self.steals += 1
+        return True
+
+
+class NodeQueues:
+    """Work-stealing queues per NUMA node.
+
+    Groups are split between nodes in chronological chunks sized by their
+    share of workers. Worker numbers are global, with the workers of a
+    node numbered together (as in ``plan_placement``).
+    """
+
+    def __init__(self, groups: Sequence[RunGroup], workers_per_node: Sequence[int]):
+        total_runs = sum(len(group.runs) for group in groups)
+        total_workers = sum(workers_per_node)
+        chunks: List[List[RunGroup]] = [[] for _ in workers_per_node]
+        node, assigned, bound = 0, 0, 0.0
+        for group in groups:
+            while node < len(workers_per_node) - 1 and (
+                workers_per_node[node] == 0
+                or assigned >= bound + total_runs * workers_per_node[node] / total_workers
+            ):
+                bound += total_runs * workers_per_node[node] / total_workers
+                node += 1
+            chunks[node].append(group)
+            assigned += len(group.runs)
+        self.nodes = [WorkStealingQueues(chunk, n) for chunk, n in zip(chunks, workers_per_node)]
+        self.owners = [(node, local) for node, n in enumerate(workers_per_node) for local in range(n)]
+        self.remote_groups = 0
+
+    def next_run(self, worker: int) -> Optional[Dict[str, Any]]:
+        """Next run on the worker's node; once the node is out of work, a
+        group from the node with the most pending groups."""
+        node, local = self.owners[worker]
+        queues = self.nodes[node]
+        params = queues.next_run(local)
+        if params is None:
+            donor = max(self.nodes, key=lambda other: len(other.pending))
+            if donor.pending:
+                queues.pending.append(donor.pending.pop())
+                self.remote_groups += 1
+                params = queues.next_run(local)
+        return params
+
+    @property
+    def steals(self) -> int:
+        return sum(queues.steals for queues in self.nodes)
+
+
+class FifoQueue:
+    """Runs in submission order, shared by all workers."""
+
+    def __init__(self, runs: Sequence[Dict[str, Any]]):
+        self.runs = deque(runs)
+        self.steals = 0
+
+    def next_run(self, worker: int) -> Optional[Dict[str, Any]]:
+        return self.runs.popleft() if self.runs else None
+
+
+_libc = None
+
+
+def page_cache_residency(path: Path) -> Tuple[int, int]:
+    """Resident and total pages of a file in the page cache (Linux/macOS).
+
+    Returns (0, 0) when the file is missing, empty or mincore is unavailable.
+    """
+    global _libc
+    try:
+        size = os.path.getsize(path)
+    except OSError:
+        return 0, 0
+    if size == 0:
+        return 0, 0
+    if _libc is None:
+        _libc = ctypes.CDLL(ctypes.util.find_library("c"), use_errno=True)
+
+    page = mmap.PAGESIZE
+    n_pages = (size + page - 1) // page
+    with open(path, "rb") as f:
+        mapped = mmap.mmap(f.fileno(), size, access=mmap.ACCESS_COPY)
+    buffer = ctypes.c_char.from_buffer(mapped)
+    try:
+        vec = (ctypes.c_ubyte * n_pages)()
+        if _libc.mincore(ctypes.c_void_p(ctypes.addressof(buffer)), ctypes.c_size_t(size), vec) != 0:
+            return 0, 0
+        resident = int((np.frombuffer(vec, dtype=np.uint8) & 1).sum())
+    finally:
+        del buffer
+        mapped.close()
+    return resident, n_pages
+
+
+@dataclass
+class ScheduleReport:
+    """Throughput and page-cache locality of a scheduled batch."""
+
+    schedule: str
+    runs: int = 0
+    groups: int = 0
+    steals: int = 0
+    elapsed: float = 0.0
+    resident_pages: int = 0
+    total_pages: int = 0
+    placement: Optional[str] = None  # "nodes" or "cores" when workers are pinned
+    numa_nodes: int = 1
+    remote_groups: int = 0      # met groups taken over from another node
+    speculated: int = 0         # duplicate attempts launched for stragglers
+    speculative_wins: int = 0   # runs won by their duplicate
+    cancelled: int = 0          # losing attempts killed through their cancel flag
+
+    @property
+    def throughput(self) -> float:
+        """Runs per second."""
+        return self.runs / self.elapsed if self.elapsed > 0 else 0.0
+
+    @property
+    def cache_hit_ratio(self) -> Optional[float]:
+        """Fraction of met file pages already cached when runs started."""
+        return self.resident_pages / self.total_pages if self.total_pages else None
+
+    def summary(self) -> str:
+        hit = self.cache_hit_ratio
+        return (
+            f"{self.schedule}: {self.runs} runs in {self.elapsed:.2f}s "
+            f"({self.throughput:.1f} runs/s), {self.groups} met groups, {self.steals} steals"
+            + (f", page-cache hit ratio {hit:.1%}" if hit is not None else "")
+            + (f", pinned to {self.placement} on {self.numa_nodes} NUMA node(s) "
+               f"({self.remote_groups} groups moved between nodes)" if self.placement else "")
+            + (f", {self.speculated} speculative attempts ({self.speculative_wins} won, "
+               f"{self.cancelled} cancelled)" if self.speculated else "")
+        )
+
+
+@dataclass
+class _RunState:
+    """A run with attempts in flight."""
+
+    params: Dict[str, Any]
+    started: int        # monotonic ns of the first attempt
+    attempts: int = 0   # attempts launched
+    live: int = 0       # attempts still in flight
+
+
+def run_scheduled(
+    func: Callable[[Dict[str, Any]], Any],
+    runs: Sequence[Dict[str, Any]],
+    n_workers: int = 4,
+    schedule: str = "locality",
+    met_dir: Optional[str] = None,
+    measure_cache: bool = False,
+    met_files: Callable[[Dict[str, Any]], Tuple[str, ...]] = met_files_for_run,
+    progress_callback: Optional[Callable] = None,
+    result_callback: Optional[Callable[[Any], None]] = None,
+    discard_callback: Optional[Callable[[Any], None]] = None,
+    timeout: Optional[float] = None,
+    speculate: bool = False,
+    speculate_after: int = 20,
+    speculate_quantile: float = 99.0,
+    succeeded: Callable[[Any], bool] = lambda result: True,
+    placement: Optional[str] = None,
+) -> Tuple[List[Any], ScheduleReport]:
+    """Run ``func`` over batch run parameters with a process pool.
+
+    Every worker has one run in flight; when it finishes, the scheduler
+    picks that worker's next run (or a duplicate of a straggler).
+
+    With a timeout or speculation, ``func`` receives a copy of the params
+    with a ``timeout`` (seconds) and a ``cancel`` key (a CancelFlag) and is
+    expected to pass them to ``hysplit.core.launcher.launch_limits``.
+
+    Args:
+        func: Picklable function taking a run parameter dict
+        runs: Run parameter dicts, e.g. from ``BatchConfig.iter_runs()``
+        n_workers: Number of worker processes
+        schedule: "locality" (met-grouped with work stealing) or "naive"
+                  (submission order)
+        met_dir: Directory of the met files, needed for ``measure_cache``
+        measure_cache: Sample page-cache residency of each run's met files
+                       when it starts
+        met_files: Function returning the met files of a run
+        progress_callback: Optional callback function(completed, total)
+        result_callback: Optional callback function(result), called in this
+                         process as each run completes
+        discard_callback: Optional callback function(result), called in this
+                          process with the result of an attempt that does
+                          not complete its run, e.g. to remove its outputs
+        timeout: Seconds before the binary of an attempt is killed
+        speculate: Launch a duplicate of runs in flight longer than the
+                   ``speculate_quantile`` of completed runs
+        speculate_after: Completed runs needed before speculating
+        speculate_quantile: Percentile (0-100) of completed run times that
+                            marks a straggler
+        succeeded: Whether a result is a success; a failed attempt only
+                   completes its run when no other attempt is in flight
+        placement: Pin workers to "cores" or to "nodes" (their NUMA node's
+                   CPUs), with one process pool and share of the met groups
+                   per node (locality schedule only); None lets the kernel
+                   place them
+
+    Returns:
+        Tuple of (results in completion order, ScheduleReport)
+    """
+    if placement is not None:
+        if schedule != "locality":
+            raise ValueError("placement needs the 'locality' schedule")
+        pinning = plan_placement(n_workers, placement)
+        node_ids = sorted({worker.node for worker in pinning})
+        worker_pool = [node_ids.index(worker.node) for worker in pinning]
+        workers_per_node = [worker_pool.count(i) for i in range(len(node_ids))]
+    else:
+        pinning, worker_pool, workers_per_node = None, [0] * n_workers, [n_workers]
+
+    if schedule == "locality":
+        groups = group_by_met(runs, met_files)
+        if placement is not None:
+            queues = NodeQueues(groups, workers_per_node)
+        else:
+            queues = WorkStealingQueues(groups, n_workers)
+        report = ScheduleReport(schedule, groups=len(groups), placement=placement,
+                                numa_nodes=len(workers_per_node))
+    elif schedule == "naive":
+        queues = FifoQueue(runs)
+        report = ScheduleReport(schedule, groups=len({met_files(p) for p in runs}))
+    else:
+        raise ValueError(f"Unknown schedule: '{schedule}'. Use 'locality' or 'naive'")
+
+    total = len(runs)
+    results = []
+    flags = CancelFlags(total) if speculate else None
+    durations = HdrHistogram()  # ns per winning attempt
+    running: Dict[int, _RunState] = {}  # by run position
+    idle = set()
+    t0 = time.perf_counter()
+    try:
+        with contextlib.ExitStack() as stack:
+            # One pool per node; each process pins itself to a CPU set of its node
+            pools = []
+            for node, count in enumerate(workers_per_node):
+                kwargs = {}
+                if pinning is not None:
+                    cpu_sets = [worker.cpus for worker, pool in zip(pinning, worker_pool) if pool == node]
+                    kwargs = {"initializer": pin_worker, "initargs": (cpu_sets, mp.Value("i", 0))}
+                pools.append(stack.enter_context(ProcessPoolExecutor(max_workers=count, **kwargs)))
+
+            # future -> (worker, run position, attempt number, start ns)
+            in_flight: Dict[Future, Tuple[int, int, int, int]] = {}
+
+            def launch(worker: int, position: int):
+                state = running[position]
+                params = state.params
+                if timeout is not None or flags is not None:
+                    params = dict(params, timeout=timeout,
+                                  cancel=flags.flag(position) if flags is not None else None)
+                future = pools[worker_pool[worker]].submit(func, params)
+                in_flight[future] = (worker, position, state.attempts, time.monotonic_ns())
+                state.attempts += 1
+                state.live += 1
+
+            def straggler() -> Optional[int]:
+                """Oldest single-attempt run slower than the quantile, if any."""
+                if not speculate or durations.count < speculate_after:
+                    return None
+                cutoff = time.monotonic_ns() - durations.percentile(speculate_quantile)
+                late = [(state.started, position) for position, state in running.items()
+                        if state.attempts < MAX_ATTEMPTS and state.started < cutoff]
+                return min(late)[1] if late else None
+
+            def submit(worker: int):
+                position = straggler()
+                if position is not None:
+                    report.speculated += 1
+                    launch(worker, position)
+                    return
+                params = queues.next_run(worker)
+                if params is None:
+                    idle.add(worker)
+                    return
+                if measure_cache and met_dir is not None:
+                    for name in met_files(params):
+                        resident, pages = page_cache_residency(Path(met_dir) / name)
+                        report.resident_pages += resident
+                        report.total_pages += pages
+                position = report.runs
+                report.runs += 1
+                running[position] = _RunState(params, time.monotonic_ns())
+                launch(worker, position)
+
+            for worker in range(n_workers):
+                submit(worker)
+
+            while in_flight:
+                # Idle workers wake up periodically to pick up stragglers
+                tick = SPECULATION_TICK if speculate and idle else None
+                done, _ = wait(in_flight, timeout=tick, return_when=FIRST_COMPLETED)
+                for future in done:
+                    worker, position, attempt, started = in_flight.pop(future)
+                    result = future.result()
+                    state = running.get(position)
+                    if state is not None:
+                        state.live -= 1
+                        # A failure is final only when no other attempt can still succeed
+                        if succeeded(result) or state.live == 0:
+                            del running[position]
+                            if state.live:
+                                flags.flag(position).set()
+                                report.cancelled += state.live
+                            if attempt > 0:
+                                report.speculative_wins += 1
+                            if succeeded(result):
+                                durations.record(time.monotonic_ns() - started)
+                            results.append(result)
+                            if result_callback:
+                                result_callback(result)
+                            if progress_callback:
+                                progress_callback(len(results), total)
+                        elif discard_callback:
+                            discard_callback(result)
+                    elif discard_callback:
+                        # An attempt that lost to one completing the run first
+                        discard_callback(result)
+                    submit(worker)
+                if speculate:
+                    for worker in list(idle):
+                        if straggler() is None:
+                            break
+                        idle.discard(worker)
+                        submit(worker)
+    finally:
+        if flags is not None:
+            flags.unlink()
+
+    report.steals = queues.steals
+    report.remote_groups = getattr(queues, "remote_groups", 0)
+    report.elapsed = time.perf_counter() - t0
+    return results, report
@@ -33,6 +33,33 @@ class BuildExtWithFallback(build_ext):
             print("The package will still work using Python fallback.")
             print(f"{'='*60}\n")
 
+    def run(self):
+        super().run()
+        self.build_standin()
+
+    def build_standin(self):
+        """Build the stand-in hyts_std / hycs_std into hysplit/bin/standin.
+
+        These mimic the HYSPLIT executables' inputs and outputs for
+        orchestration benchmarks on platforms without bundled binaries.
+        """
+        if sys.platform == "win32":
+            return
+        base = Path("hysplit") if self.inplace else Path(self.build_lib) / "hysplit"
+        output_dir = base / "bin" / "standin"
+        try:
+            objects = self.compiler.compile(
+                ["hysplit/cpp/standin.cpp"],
+                output_dir=self.build_temp,
+                extra_postargs=["-std=c++17", "-O2"],
+            )
+            for name in ("hyts_std", "hycs_std"):
+                self.compiler.link_executable(
+                    objects, name, output_dir=str(output_dir), target_lang="c++"
+                )
+        except Exception as e:
+            print(f"WARNING: Failed to build the stand-in HYSPLIT binaries: {e}")
+
 
 def get_cpp_extensions():
     """Get C++ extension modules."""
@@ -76,6 +103,84 @@ def get_cpp_extensions():
             extra_link_args=extra_link_args,
             language="c++",
         ),
+        Extension(
+            "hysplit.cpp._particles",
+            sources=["hysplit/cpp/particles.cpp"],
+            depends=["hysplit/cpp/earth.h", "hysplit/cpp/met_field.h", "hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._trajectory_service",
+            sources=["hysplit/cpp/trajectory_service.cpp"],
+            depends=["hysplit/cpp/earth.h", "hysplit/cpp/met_field.h", "hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._launcher",
+            sources=["hysplit/cpp/launcher.cpp"],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._inverse",
+            sources=["hysplit/cpp/inverse.cpp"],
+            depends=["hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._cluster",
+            sources=["hysplit/cpp/cluster.cpp"],
+            depends=["hysplit/cpp/earth.h", "hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._gridding",
+            sources=["hysplit/cpp/gridding.cpp"],
+            depends=["hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._geodesy",
+            sources=["hysplit/cpp/geodesy.cpp"],
+            depends=["hysplit/cpp/earth.h", "hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._spatial_index",
+            sources=["hysplit/cpp/spatial_index.cpp"],
+            depends=["hysplit/cpp/earth.h", "hysplit/cpp/py_args.h"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
+        Extension(
+            "hysplit.cpp._templates",
+            sources=["hysplit/cpp/templates.cpp"],
+            include_dirs=[numpy_include],
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language="c++",
+        ),
     ]
 
     return extensions
@@ -0,0 +1,85 @@
+"""
+Shared fixtures of the benchmark scripts in this directory.
+
+    STANDIN                  stand-in hyts_std built by setup.py
+    require_standin()        exit with a hint when it has not been built
+    synthetic_trajectories() random-walk back trajectories in the layout of
+                             run_batch_trajectories(..., return_trajectories=True)
+"""
+
+import sys
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+REPO = Path(__file__).resolve().parents[2]
+STANDIN = REPO / "hysplit" / "bin" / "standin" / "hyts_std"
+
+# Receptor of the single-site fixtures
+ORIGIN = (42.8, -80.3)
+
+
+def require_standin():
+    """Exit unless the stand-in binary has been built."""
+    if not STANDIN.exists():
+        sys.exit(f"Stand-in binary not found at {STANDIN}; run: python setup.py build_ext --inplace")
+
+
+def synthetic_trajectories(
+    n,
+    hours,
+    drift=(0.05, -0.4),
+    spread=0.4,
+    seed=0,
+    regimes=0,
+    origins=None,
+    climb=None,
+    start_times=False,
+):
+    """Endpoint DataFrame of n random-walk back trajectories.
+
+    Args:
+        n: Number of trajectories
+        hours: Hours per trajectory (hours + 1 endpoints)
+        drift: Mean (lat, lon) step per hour in degrees
+        spread: Standard deviation of a step
+        seed: Random seed
+        regimes: When > 0, each trajectory drifts with one of this many
+                 random flow regimes instead of ``drift`` (for clustering)
+        origins: ((lat_min, lat_max), (lon_min, lon_max)) to start each
+                 trajectory at a random point; default ORIGIN for all
+        climb: Standard deviation of the hourly height change in m; adds a
+               ``height`` column starting at random heights up to 2000 m
+        start_times: Add ``traj_dt`` with start times at random hours of 2015
+
+    Returns:
+        DataFrame with run_index, hour_along, lat, lon (and height, traj_dt)
+        columns, trajectory by trajectory from hour 0 backwards
+    """
+    rng = np.random.default_rng(seed)
+    if regimes > 0:
+        flows = rng.normal(0, 0.6, (regimes, 2))
+        drift = flows[rng.integers(0, regimes, n)][:, None, :]
+    steps = rng.normal(0.0, spread, (n, hours, 2)) + drift
+    path = np.concatenate([np.zeros((n, 1, 2)), np.cumsum(steps, axis=1)], axis=1)
+    if origins is None:
+        origin = np.array(ORIGIN)
+    else:
+        origin = np.column_stack([rng.uniform(*origins[0], n), rng.uniform(*origins[1], n)])[:, None, :]
+    path = path + origin
+
+    hour_along = -np.arange(hours + 1)
+    trajectories = pd.DataFrame({
+        "run_index": np.repeat(np.arange(n), hours + 1),
+        "hour_along": np.tile(hour_along, n),
+        "lat": path[..., 0].ravel(),
+        "lon": path[..., 1].ravel(),
+    })
+    if climb is not None:
+        change = np.concatenate([np.zeros((n, 1)), rng.normal(0.0, climb, (n, hours))], axis=1)
+        trajectories["height"] = np.abs(rng.uniform(10.0, 2000.0, (n, 1)) + np.cumsum(change, axis=1)).ravel()
+    if start_times:
+        start = np.datetime64("2015-01-01T00", "h") + rng.integers(0, 365 * 24, n).astype("timedelta64[h]")
+        trajectories["traj_dt"] = (start[:, None] + hour_along.astype("timedelta64[h]")).ravel()
+    return trajectories
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Benchmark for concurrent model runs from asyncio.
+
+Runs N trajectory models at once against the stand-in hyts_std
+(hysplit/bin/standin, built by ``python setup.py build_ext --inplace``),
+first by wrapping the blocking ``run()`` in a thread pool with one thread
+per run, as a service had to before, then with ``await run_async()`` on
+the native reactor. Reports the wall time, the peak thread count of the
+process and the event-loop lag (how late a 10 ms timer fires while runs are
+in flight). Met downloads are stubbed out.
+
+Usage:
+    python benchmark_async.py [--runs 200] [--sleep 0.5]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import asyncio
+import os
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from datetime import datetime
+from unittest import mock
+
+from hysplit.core.aio import HAS_REACTOR, AsyncLauncher
+from hysplit.core.trajectory import TrajectoryModel
+
+from bench_common import STANDIN, require_standin
+
+MET_FILES = ["gdas1.mar12.w2"]
+
+
+def make_models(n):
+    return [TrajectoryModel(lat=30.0 + i * 0.01, lon=-100.0, height=50, duration=24,
+                            days=[datetime(2012, 3, 10)], direction="backward",
+                            met_type="gdas1", binary_path=str(STANDIN))
+            for i in range(n)]
+
+
+async def measure(runs):
+    """Wall time, peak threads and max loop lag (s) while ``runs`` complete."""
+    peak = threading.active_count()
+    lag = 0.0
+    done = asyncio.ensure_future(runs)
+    t0 = time.perf_counter()
+    while not done.done():
+        tick = time.perf_counter()
+        await asyncio.sleep(0.01)
+        lag = max(lag, time.perf_counter() - tick - 0.01)
+        peak = max(peak, threading.active_count())
+    await done
+    return time.perf_counter() - t0, peak, lag
+
+
+async def with_threads(n):
+    loop = asyncio.get_running_loop()
+    models = make_models(n)
+    with ThreadPoolExecutor(max_workers=n) as pool:
+        return await measure(asyncio.gather(*(loop.run_in_executor(pool, m.run) for m in models)))
+
+
+async def with_reactor(n):
+    models = make_models(n)
+    async with AsyncLauncher(max_concurrent=n) as launcher:
+        return await measure(asyncio.gather(*(m.run_async(launcher) for m in models)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, default=200, help="Concurrent runs")
+    parser.add_argument("--sleep", type=float, default=0.5, help="Seconds per stand-in run")
+    args = parser.parse_args()
+
+    require_standin()
+    os.environ["HYSPLIT_STANDIN_SLEEP"] = str(args.sleep)
+
+    print("=" * 70)
+    print("ASYNC RUN API BENCHMARK")
+    print("=" * 70)
+    print(f"{args.runs} concurrent runs of {args.sleep * 1e3:.0f} ms, "
+          f"native reactor: {'yes' if HAS_REACTOR else 'no (asyncio subprocesses)'}")
+    print()
+
+    rows = []
+    with mock.patch("hysplit.met.download_met_files", return_value=MET_FILES):
+        for name, runner in [("thread per run", with_threads), ("run_async", with_reactor)]:
+            rows.append((name, *asyncio.run(runner(args.runs))))
+
+    print(f"{'Mode':>16} {'Wall':>9} {'Peak threads':>13} {'Max loop lag':>13}")
+    print("-" * 54)
+    for name, wall, peak, lag in rows:
+        print(f"{name:>16} {wall:>8.2f}s {peak:>13} {lag * 1e3:>11.1f}ms")
+
+
+if __name__ == "__main__":
+    main()
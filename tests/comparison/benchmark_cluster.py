@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""
+Benchmark for trajectory cluster analysis.
+
+Generates synthetic 72-hour back trajectories (four a day) drawn from a
+few flow regimes and clusters them with the native TSV engine
+(hysplit.core.cluster), reporting time and peak matrix memory per size. For
+the smallest size it also runs a NumPy baseline that keeps the full
+pairwise matrix and scans it for the cheapest merge at every step (and
+scipy's Ward linkage when scipy is installed), and checks that the TSV
+curves agree.
+
+Usage:
+    python benchmark_cluster.py [--years 1 2 4] [--hours 72] [--no-baseline]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import time
+
+import numpy as np
+
+from hysplit.core.cluster import HAS_CLUSTER_ENGINE, _to_xyz, cluster_trajectories
+
+from bench_common import synthetic_trajectories
+
+
+def numpy_baseline(lat, lon):
+    """TSV curve by scanning a dense cost matrix for every merge."""
+    x = _to_xyz(lat, lon).transpose(0, 2, 1).reshape(len(lat), -1)
+    sq = (x * x).sum(axis=1)
+    cost = 0.5 * np.maximum(sq[:, None] + sq[None, :] - 2.0 * x @ x.T, 0.0)
+    n = len(lat)
+    np.fill_diagonal(cost, np.inf)
+    size = np.ones(n)
+    tsv = [0.0]
+    for _ in range(n - 1):
+        a, b = np.unravel_index(np.argmin(cost), cost.shape)
+        ab = cost[a, b]
+        tsv.append(tsv[-1] + ab)
+        row = ((size + size[a]) * cost[a] + (size + size[b]) * cost[b] - size * ab) / (size + size[a] + size[b])
+        cost[b], cost[:, b] = row, row
+        cost[b, b] = np.inf
+        cost[a], cost[:, a] = np.inf, np.inf
+        size[b] += size[a]
+    return np.array(tsv[::-1])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--years", type=float, nargs="+", default=[1, 2, 4])
+    parser.add_argument("--hours", type=int, default=72)
+    parser.add_argument("--no-baseline", action="store_true")
+    args = parser.parse_args()
+
+    if not HAS_CLUSTER_ENGINE:
+        sys.exit("Native cluster engine not found; run: python setup.py build_ext --inplace")
+
+    print("=" * 70)
+    print("TRAJECTORY CLUSTER BENCHMARK")
+    print("=" * 70)
+    print(f"{args.hours}-hour trajectories, 4 per day")
+    print()
+    print(f"{'Years':>6} {'Trajectories':>13} {'Engine':>10} {'Time':>10} {'Matrix':>10}")
+    print("-" * 54)
+
+    for i, years in enumerate(args.years):
+        n = int(years * 365 * 4)
+        trajectories = synthetic_trajectories(n, args.hours, spread=0.25, regimes=6)
+        lat = trajectories["lat"].to_numpy().reshape(n, -1)
+        lon = trajectories["lon"].to_numpy().reshape(n, -1)
+        matrix_mb = n * (n - 1) / 2 * 8 / 1e6
+        t0 = time.perf_counter()
+        result = cluster_trajectories((lat, lon), n_clusters=range(2, 11))
+        elapsed = time.perf_counter() - t0
+        print(f"{years:>6g} {n:>13} {'native':>10} {elapsed:>9.2f}s {matrix_mb:>8.0f}MB")
+
+        if i == 0 and not args.no_baseline:
+            t0 = time.perf_counter()
+            tsv = numpy_baseline(lat, lon)
+            elapsed = time.perf_counter() - t0
+            error = np.max(np.abs(tsv - result.tsv) / np.maximum(result.tsv, 1.0))
+            print(f"{'':>6} {'':>13} {'numpy':>10} {elapsed:>9.2f}s {n * n * 8 / 1e6:>8.0f}MB"
+                  f"  (TSV max rel. difference {error:.1e})")
+            try:
+                from scipy.cluster.hierarchy import linkage
+            except ImportError:
+                continue
+            x = _to_xyz(lat, lon).transpose(0, 2, 1).reshape(n, -1)
+            t0 = time.perf_counter()
+            linkage(x, method="ward")
+            elapsed = time.perf_counter() - t0
+            print(f"{'':>6} {'':>13} {'scipy':>10} {elapsed:>9.2f}s {matrix_mb:>8.0f}MB")
+
+    print()
+    print("TSV curve of the last size (percent change; pick the count before a jump):")
+    print(result.tsv_curve(max_clusters=10).to_string(index=False))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Benchmark for geodesic trajectory metrics.
+
+Generates synthetic 72-hour back trajectories in the layout of
+run_batch_trajectories(..., return_trajectories=True) and computes per-point
+segment length, bearing, speed and distance from origin plus per-run
+aggregates with the native kernels (hysplit.core.geodesy), against a
+pandas groupby().apply() of NumPy haversine per run. Checks that path
+lengths agree.
+
+Usage:
+    python benchmark_geodesy.py [--runs 1000 10000 50000] [--hours 72]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import time
+
+import numpy as np
+import pandas as pd
+
+from hysplit.core.cluster import EARTH_RADIUS_KM
+from hysplit.core.geodesy import HAS_GEODESY_ENGINE, trajectory_metrics
+
+from bench_common import synthetic_trajectories
+
+
+def haversine(lat1, lon1, lat2, lon2):
+    phi1, phi2 = np.radians(lat1), np.radians(lat2)
+    h = (np.sin((phi2 - phi1) / 2) ** 2
+         + np.cos(phi1) * np.cos(phi2) * np.sin(np.radians(lon2 - lon1) / 2) ** 2)
+    return 2 * EARTH_RADIUS_KM * np.arcsin(np.sqrt(h))
+
+
+def run_summary(group):
+    """Per-run metrics the way they are usually written with pandas."""
+    lat, lon = group["lat"].to_numpy(), group["lon"].to_numpy()
+    step = haversine(lat[:-1], lon[:-1], lat[1:], lon[1:])
+    origin = haversine(lat[0], lon[0], lat, lon)
+    hours = np.abs(np.diff(group["hour_along"].to_numpy()))
+    return pd.Series({
+        "path_km": step.sum(),
+        "origin_km": origin[-1],
+        "max_origin_km": origin.max(),
+        "max_speed_kmh": (step / hours).max(),
+    })
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, nargs="+", default=[1000, 10000, 50000])
+    parser.add_argument("--hours", type=int, default=72)
+    args = parser.parse_args()
+
+    if not HAS_GEODESY_ENGINE:
+        sys.exit("Native geodesy engine not found; run: python setup.py build_ext --inplace")
+
+    print("=" * 70)
+    print("GEODESIC TRAJECTORY METRICS BENCHMARK")
+    print("=" * 70)
+    print(f"{args.hours}-hour trajectories")
+    print()
+    print(f"{'Runs':>8} {'Points':>10} {'Haversine':>10} {'Vincenty':>10} {'groupby':>10} {'Speedup':>8}")
+    print("-" * 61)
+
+    for n in args.runs:
+        trajectories = synthetic_trajectories(n, args.hours)
+        t0 = time.perf_counter()
+        metrics = trajectory_metrics(trajectories)
+        native = time.perf_counter() - t0
+
+        t0 = time.perf_counter()
+        trajectory_metrics(trajectories, method="vincenty")
+        vincenty = time.perf_counter() - t0
+
+        t0 = time.perf_counter()
+        baseline = trajectories.groupby("run_index")[["hour_along", "lat", "lon"]].apply(run_summary)
+        reference = time.perf_counter() - t0
+
+        assert np.allclose(baseline["path_km"], metrics.runs["path_km"]), "path lengths differ"
+        print(f"{n:>8} {len(trajectories):>10} {native:>9.3f}s {vincenty:>9.3f}s {reference:>9.3f}s "
+              f"{reference / native:>7.0f}x")
+
+    print()
+    print(metrics.runs.describe().loc[["mean", "max"]].to_string())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Benchmark for the per-run orchestration overhead of batch trajectories.
+
+Runs run_batch_trajectories end to end against the stand-in hyts_std
+(hysplit/bin/standin, built by ``python setup.py build_ext --inplace``),
+which parses CONTROL and SETUP.CFG and writes a format-correct tdump, so
+the whole pipeline (scheduling, config rendering, spawn, parsing, result
+collection) runs as in production while the "model" costs almost nothing.
+Met downloads are stubbed out. The stand-in's own cost is measured by
+launching it directly in a prepared directory; the rest of the per-run
+time is orchestration overhead. Phase percentiles come from BatchTelemetry.
+
+Set HYSPLIT_STANDIN_SLEEP or HYSPLIT_STANDIN_CPU (seconds) to give every
+run a model time.
+
+Usage:
+    python benchmark_orchestration.py [--runs 1000,10000,100000] [--workers N] [--duration H]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import math
+import os
+import tempfile
+import time
+from datetime import datetime, timedelta
+from unittest import mock
+
+from hysplit.core.launcher import ExecDir, launch
+from hysplit.core.telemetry import BatchTelemetry
+from hysplit.core.trajectory import TrajectoryModel
+from hysplit.workflows.batch import create_batch_config, run_batch_trajectories
+
+from bench_common import STANDIN, require_standin
+
+MET_FILES = ["gdas1.mar12.w2"]
+HOURS = [0, 6, 12, 18]
+
+
+def bare_run_cost(duration, samples=200):
+    """Seconds per direct launch of the stand-in on a prepared directory."""
+    with tempfile.TemporaryDirectory() as tmp:
+        model = TrajectoryModel(lat=42.8, lon=-80.3, height=50, duration=duration,
+                                direction="backward", met_dir=tmp)
+        workdir = ExecDir(tmp)
+        workdir.write_configs(model.config, model.ascdata)
+        workdir.write("CONTROL", model._control_text(
+            Path(tmp), datetime(2012, 3, 10), [(42.8, -80.3, 50.0)], MET_FILES, "tdump"
+        ))
+        t0 = time.perf_counter()
+        for _ in range(samples):
+            launch([str(STANDIN)], cwd=tmp)
+        return (time.perf_counter() - t0) / samples
+
+
+def run_batch(n_runs, n_workers, duration):
+    """Elapsed seconds, runs, successes and telemetry of a stand-in batch.
+
+    Runs are locations x 25 days x 4 hours, rounded up to whole locations.
+    """
+    n_days = 25
+    n_locations = math.ceil(n_runs / (n_days * len(HOURS)))
+    config = create_batch_config(
+        locations=[{"lat": 30.0 + (i % 200) * 0.1, "lon": -100.0 + i // 200, "height": 50}
+                   for i in range(n_locations)],
+        dates=[datetime(2012, 3, 1) + timedelta(days=d) for d in range(n_days)],
+        daily_hours=HOURS,
+        duration=duration,
+        direction="backward",
+        met_type="gdas1",
+        binary_path=str(STANDIN),
+    )
+    telemetry = BatchTelemetry(keep_spans=False)
+
+    with mock.patch("hysplit.met.download_met_files", return_value=MET_FILES):
+        t0 = time.perf_counter()
+        df = run_batch_trajectories(config, n_workers=n_workers, telemetry=telemetry,
+                                    progress_callback=lambda done, total: None)
+        elapsed = time.perf_counter() - t0
+    return elapsed, config.total_runs(), int(df["success"].sum()), telemetry
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", default="1000,10000,100000",
+                        help="Comma-separated batch sizes")
+    parser.add_argument("--workers", type=int, default=2)
+    parser.add_argument("--duration", type=int, default=24)
+    args = parser.parse_args()
+
+    require_standin()
+
+    print("=" * 70)
+    print("BATCH ORCHESTRATION OVERHEAD BENCHMARK")
+    print("=" * 70)
+    print()
+    bare = bare_run_cost(args.duration)
+    print(f"Stand-in: {STANDIN}")
+    print(f"Workers: {args.workers}, duration: {args.duration} h")
+    print(f"Bare stand-in launch: {bare * 1e3:.2f} ms/run")
+    print()
+
+    # Workers beyond the CPU count only share the same cores
+    parallel = min(args.workers, os.cpu_count() or 1)
+    rows = []
+    for n_runs in [int(n) for n in args.runs.split(",")]:
+        elapsed, n_runs, ok, telemetry = run_batch(n_runs, args.workers, args.duration)
+        per_run = elapsed * parallel / n_runs
+        rows.append((n_runs, ok, elapsed, n_runs / elapsed, per_run, per_run - bare))
+        print()
+        print(f"Phases of {n_runs} runs:")
+        print(telemetry.summary())
+        print()
+
+    print(f"{'Runs':>8} {'OK':>8} {'Elapsed':>10} {'Runs/s':>10} {'Per run':>10} {'Overhead':>10}")
+    print("-" * 61)
+    for n_runs, ok, elapsed, rate, per_run, overhead in rows:
+        print(f"{n_runs:>8} {ok:>8} {elapsed:>9.1f}s {rate:>10.1f} "
+              f"{per_run * 1e3:>8.2f}ms {overhead * 1e3:>8.2f}ms")
+    print()
+    print("Per run = elapsed x min(workers, CPUs) / runs; overhead = per run - bare stand-in launch.")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""
+Benchmark for pinned (CPU and NUMA-aware) against unpinned batch workers.
+
+Creates synthetic met files and runs a batch whose worker maps the met
+files of each run and sums them, a memory-bandwidth-bound stand-in for
+hyts_std reading its met data, with the locality schedule: unpinned, with
+workers pinned to their NUMA node ("nodes") and pinned to one core each
+("cores"). Reports throughput and the CPU migrations of the workers (from
+/proc/self/sched). Remote-node reads only exist on multi-socket machines;
+on a single node the difference is the migrations alone.
+
+Usage:
+    python benchmark_placement.py [--locations N] [--days N] [--file-mb N] [--workers N] [--repeat N]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import mmap
+import os
+import tempfile
+import time
+from datetime import datetime, timedelta
+
+import numpy as np
+
+from hysplit.workflows.batch import create_batch_config
+from hysplit.workflows.placement import numa_nodes
+from hysplit.workflows.scheduler import met_files_for_run, run_scheduled
+
+
+def migrations() -> int:
+    """CPU migrations of the calling process so far (Linux)."""
+    try:
+        with open("/proc/self/sched") as f:
+            for line in f:
+                if line.startswith("se.nr_migrations"):
+                    return int(line.split(":")[1])
+    except OSError:
+        pass
+    return 0
+
+
+def sum_met(params):
+    """Worker: map the run's met files and sum them --repeat times."""
+    before = migrations()
+    met_dir = Path(params["met_dir"])
+    total = 0
+    for name in met_files_for_run(params):
+        with open(met_dir / name, "rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as m:
+            data = np.frombuffer(m, dtype=np.uint64)
+            for _ in range(int(os.environ["REPEAT"])):
+                total += int(data.sum())
+            del data
+    return os.getpid(), migrations() - before
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--locations", type=int, default=8)
+    parser.add_argument("--days", type=int, default=28)
+    parser.add_argument("--file-mb", type=int, default=16)
+    parser.add_argument("--workers", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--repeat", type=int, default=4, help="Passes over the met data per run")
+    args = parser.parse_args()
+    os.environ["REPEAT"] = str(args.repeat)
+
+    nodes = numa_nodes()
+    print("=" * 70)
+    print("BATCH WORKER PLACEMENT BENCHMARK")
+    print("=" * 70)
+    print(f"NUMA nodes: {len(nodes)} ({', '.join(f'node {n.node}: {len(n.cpus)} CPUs' for n in nodes)})")
+
+    with tempfile.TemporaryDirectory() as met_dir:
+        config = create_batch_config(
+            locations=[{"lat": 40.0 + i, "lon": -100.0, "height": 50} for i in range(args.locations)],
+            dates=[datetime(2012, 3, 1) + timedelta(days=d) for d in range(args.days)],
+            daily_hours=[0, 6, 12, 18],
+            duration=48,
+            direction="backward",
+            met_type="gdas1",
+            met_dir=met_dir,
+        )
+        runs = list(config.iter_runs())
+        names = sorted({name for params in runs for name in met_files_for_run(params)})
+        block = np.random.default_rng(0).integers(0, 2**63, args.file_mb << 17, dtype=np.uint64)
+        for name in names:
+            block.tofile(Path(met_dir) / name)
+        print(f"Runs: {len(runs)}, met files: {len(names)} x {args.file_mb} MB, workers: {args.workers}")
+        print()
+
+        rows = []
+        for placement in (None, "nodes", "cores"):
+            t0 = time.perf_counter()
+            results, report = run_scheduled(sum_met, runs, n_workers=args.workers,
+                                            placement=placement, met_dir=met_dir)
+            elapsed = time.perf_counter() - t0
+            moved = sum(m for _, m in results)
+            rows.append((placement or "unpinned", len(runs) / elapsed, elapsed, moved,
+                         report.remote_groups))
+            print(report.summary())
+
+    print()
+    print(f"{'Placement':>10} {'Runs/s':>10} {'Elapsed':>10} {'Migrations':>11} {'Groups moved':>13}")
+    print("-" * 58)
+    for name, rate, elapsed, moved, remote in rows:
+        print(f"{name:>10} {rate:>10.1f} {elapsed:>9.2f}s {moved:>11} {remote:>13}")
+
+
+if __name__ == "__main__":
+    main()
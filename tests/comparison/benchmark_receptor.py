@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""
+Benchmark for PSCF/CWT receptor gridding.
+
+Generates synthetic 72-hour back trajectories (one row per endpoint, as
+returned by run_batch_trajectories(..., return_trajectories=True)) with a
+lognormal concentration per run, and grids them with the native engine
+(hysplit.core.gridding). For every size it also runs a pandas baseline
+(join, bin and groupby) and checks that the n, m and CWT grids agree.
+
+Usage:
+    python benchmark_receptor.py [--runs 10000 50000] [--hours 72] [--resolution 0.5]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import time
+
+import numpy as np
+import pandas as pd
+
+from hysplit.core.gridding import HAS_GRIDDING_ENGINE, receptor_grid
+
+from bench_common import synthetic_trajectories
+
+
+def pandas_baseline(trajectories, concentrations, grid, threshold):
+    """n, m and CWT grids with a join and a groupby over cells."""
+    points = trajectories[trajectories["hour_along"] != 0]
+    points = points.join(concentrations.rename("c"), on="run_index")
+    iy = np.floor((points["lat"] - grid.lat_min) / grid.resolution).astype(int)
+    ix = np.floor((points["lon"] - grid.lon_min) / grid.resolution).astype(int)
+    cells = points.assign(cell=iy * grid.nlon + ix, above=points["c"] > threshold)
+    sums = cells.groupby("cell").agg(n=("c", "size"), m=("above", "sum"), total=("c", "sum"))
+    out = {}
+    for name in ("n", "m", "total"):
+        flat = np.zeros(grid.nlat * grid.nlon)
+        flat[sums.index.to_numpy()] = sums[name].to_numpy()
+        out[name] = flat.reshape(grid.nlat, grid.nlon)
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, nargs="+", default=[10000, 50000])
+    parser.add_argument("--hours", type=int, default=72)
+    parser.add_argument("--resolution", type=float, default=0.5)
+    args = parser.parse_args()
+
+    if not HAS_GRIDDING_ENGINE:
+        sys.exit("Native gridding engine not found; run: python setup.py build_ext --inplace")
+
+    print("=" * 70)
+    print("RECEPTOR GRIDDING BENCHMARK (PSCF / CWT)")
+    print("=" * 70)
+    print(f"{args.hours}-hour trajectories, {args.resolution} degree cells")
+    print()
+    print(f"{'Runs':>8} {'Endpoints':>11} {'Cells':>8} {'Native':>9} {'Pandas':>9} {'Speedup':>8}")
+    print("-" * 58)
+
+    for n in args.runs:
+        trajectories = synthetic_trajectories(n, args.hours, drift=(0.05, -0.15), spread=0.3)
+        concentrations = pd.Series(np.random.default_rng(1).lognormal(2.0, 0.8, n), index=np.arange(n))
+        t0 = time.perf_counter()
+        result = receptor_grid(trajectories, concentrations, resolution=args.resolution)
+        native = time.perf_counter() - t0
+
+        t0 = time.perf_counter()
+        baseline = pandas_baseline(trajectories, concentrations, result.grid, result.threshold)
+        reference = time.perf_counter() - t0
+
+        assert np.array_equal(baseline["n"], result.n), "n grids differ"
+        assert np.array_equal(baseline["m"], result.m), "m grids differ"
+        assert np.allclose(baseline["total"], result.sum), "CWT sums differ"
+        print(f"{n:>8} {result.n_points:>11} {result.n.size:>8} {native:>8.3f}s {reference:>8.3f}s "
+              f"{reference / native:>7.1f}x")
+
+    print()
+    print("Cells with the highest WPSCF (last size, at least 20 endpoints):")
+    cells = result.to_dataframe(min_endpoints=20)
+    print(cells.nlargest(5, "wpscf")[["lat", "lon", "n", "m", "wpscf", "wcwt"]].to_string(index=False))
+
+
+if __name__ == "__main__":
+    main()
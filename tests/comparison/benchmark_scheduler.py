@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Benchmark for the met-locality-aware batch scheduler.
+
+Creates synthetic daily GFS 0.25 met files and runs a batch whose worker
+reads the met files of each run, as hyts_std does. A met set larger than
+memory is emulated by keeping at most --cache-files files in the page cache
+(least recently used files are evicted with posix_fadvise). Reports the
+page-cache hit ratio and throughput of the naive iter_runs() order against
+the locality schedule.
+
+Usage:
+    python benchmark_scheduler.py [--locations N] [--days N] [--file-mb N] [--cache-files N] [--workers N]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import os
+import tempfile
+import time
+from datetime import datetime, timedelta
+
+from hysplit.workflows.batch import create_batch_config
+from hysplit.workflows.scheduler import met_files_for_run, page_cache_residency, run_scheduled
+
+
+def evict(path):
+    """Drop a file from the page cache."""
+    fd = os.open(path, os.O_RDONLY)
+    try:
+        os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+    finally:
+        os.close(fd)
+
+
+def read_met(params):
+    """Worker: read the run's met files, then enforce the emulated cache size."""
+    met_dir = Path(params["met_dir"])
+    for name in met_files_for_run(params):
+        with open(met_dir / name, "rb") as f:
+            while f.read(1 << 20):
+                pass
+        os.utime(met_dir / f"{name}.used")
+
+    # Least recently used files beyond the cache capacity leave the page cache
+    stamps = sorted(met_dir.glob("*.used"), key=lambda p: p.stat().st_mtime_ns, reverse=True)
+    for stamp in stamps[int(os.environ["CACHE_FILES"]):]:
+        evict(met_dir / stamp.stem)
+    return params["run_index"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--locations", type=int, default=8)
+    parser.add_argument("--days", type=int, default=21)
+    parser.add_argument("--file-mb", type=int, default=32)
+    parser.add_argument("--cache-files", type=int, default=3)
+    parser.add_argument("--workers", type=int, default=2)
+    args = parser.parse_args()
+    os.environ["CACHE_FILES"] = str(args.cache_files)
+
+    with tempfile.TemporaryDirectory() as met_dir:
+        config = create_batch_config(
+            locations=[{"lat": 40.0 + i, "lon": -80.0, "height": 50} for i in range(args.locations)],
+            dates=[datetime(2024, 1, 2) + timedelta(days=d) for d in range(args.days)],
+            daily_hours=[0, 6, 12, 18],
+            duration=24,
+            direction="backward",
+            met_type="gfs0.25",
+            met_dir=met_dir,
+        )
+        runs = list(config.iter_runs())
+        names = sorted({name for params in runs for name in met_files_for_run(params)})
+        for name in names:
+            with open(Path(met_dir) / name, "wb") as f:
+                f.write(os.urandom(args.file_mb << 20))
+            (Path(met_dir) / f"{name}.used").touch()
+
+        print("=" * 70)
+        print("MET-LOCALITY SCHEDULER BENCHMARK")
+        print("=" * 70)
+        print()
+        print("Configuration:")
+        print(f"  Runs: {len(runs)} ({args.locations} locations x {args.days} days x 4 hours)")
+        print(f"  Met files: {len(names)} x {args.file_mb} MB")
+        print(f"  Emulated page cache: {args.cache_files} files")
+        print(f"  Workers: {args.workers}")
+        print()
+
+        reports = {}
+        for schedule in ("naive", "locality"):
+            for name in names:
+                evict(Path(met_dir) / name)
+            _, report = run_scheduled(
+                read_met, runs, n_workers=args.workers, schedule=schedule,
+                met_dir=met_dir, measure_cache=True,
+            )
+            reports[schedule] = report
+            print(report.summary())
+
+        speedup = reports["locality"].throughput / reports["naive"].throughput
+        print()
+        print(f"Locality schedule speedup: {speedup:.2f}x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Benchmark for batch working directories and outputs on tmpfs scratch.
+
+Runs the same batch against the stand-in hyts_std (hysplit/bin/standin,
+built by ``python setup.py build_ext --inplace``) with the workers' working
+directories under the system temporary directory and every output written
+straight to ``output_dir``, then with both on a scratch root (default
+/dev/shm) and the outputs copied to ``output_dir`` in batches. Point
+--tmpdir and --output-dir at a network filesystem to see the cost the
+scratch avoids. Met downloads are stubbed out.
+
+Usage:
+    python benchmark_scratch.py [--runs 1000] [--workers 4] [--scratch /dev/shm] [--output-dir DIR] [--tmpdir DIR]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import math
+import os
+import shutil
+import tempfile
+import time
+from datetime import datetime, timedelta
+from unittest import mock
+
+from hysplit.workflows.batch import create_batch_config, run_batch_trajectories
+
+from bench_common import STANDIN, require_standin
+
+MET_FILES = ["gdas1.mar12.w2"]
+HOURS = [0, 6, 12, 18]
+
+
+def run_batch(n_runs, n_workers, output_dir, met_dir, scratch):
+    """Elapsed seconds, successes and scratch stats of a stand-in batch."""
+    n_days = 25
+    config = create_batch_config(
+        locations=[{"lat": 30.0 + i * 0.1, "lon": -100.0, "height": 50}
+                   for i in range(math.ceil(n_runs / (n_days * len(HOURS))))],
+        dates=[datetime(2012, 3, 1) + timedelta(days=d) for d in range(n_days)],
+        daily_hours=HOURS,
+        duration=12,
+        direction="backward",
+        met_type="gdas1",
+        met_dir=met_dir,
+        output_dir=output_dir,
+        binary_path=str(STANDIN),
+    )
+    with mock.patch("hysplit.met.download_met_files", return_value=MET_FILES):
+        t0 = time.perf_counter()
+        df = run_batch_trajectories(config, n_workers=n_workers, scratch=scratch,
+                                    progress_callback=lambda done, total: None)
+        elapsed = time.perf_counter() - t0
+    return elapsed, int(df["success"].sum()), len(df), df.attrs.get("scratch")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, default=1000)
+    parser.add_argument("--workers", type=int, default=4)
+    parser.add_argument("--scratch", default="/dev/shm", help="Scratch root (a tmpfs)")
+    parser.add_argument("--output-dir", help="Persistent output directory (default: a temporary one)")
+    parser.add_argument("--tmpdir", help="Temporary directory of the unscratched runs")
+    args = parser.parse_args()
+
+    require_standin()
+    os.environ["HYSPLIT_STANDIN_SLEEP"] = "0"
+    if args.tmpdir:
+        tempfile.tempdir = args.tmpdir
+
+    print("=" * 70)
+    print("SCRATCH DIRECTORY BENCHMARK")
+    print("=" * 70)
+    print(f"Runs: {args.runs}, workers: {args.workers}, scratch: {args.scratch}, "
+          f"temporary directory: {tempfile.gettempdir()}")
+    print()
+
+    rows = []
+    met_dir = tempfile.mkdtemp(prefix="hysplit_bench_met_")
+    output_root = Path(args.output_dir or tempfile.mkdtemp(prefix="hysplit_bench_out_"))
+    try:
+        for name, scratch in [("temporary dir", None), ("scratch", args.scratch)]:
+            output_dir = output_root / name.replace(" ", "_")
+            elapsed, ok, total, stats = run_batch(args.runs, args.workers, str(output_dir), met_dir, scratch)
+            rows.append((name, total, ok, elapsed, stats))
+            shutil.rmtree(output_dir, ignore_errors=True)
+            print()
+    finally:
+        shutil.rmtree(met_dir, ignore_errors=True)
+        if not args.output_dir:
+            shutil.rmtree(output_root, ignore_errors=True)
+
+    print(f"{'Working dirs':>14} {'Runs':>6} {'OK':>6} {'Elapsed':>9} {'Runs/s':>8} {'Flushes':>8}")
+    print("-" * 56)
+    for name, total, ok, elapsed, stats in rows:
+        flushes = stats["flushes"] if stats else 0
+        print(f"{name:>14} {total:>6} {ok:>6} {elapsed:>8.2f}s {total / elapsed:>8.1f} {flushes:>8}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+Latency benchmark for the persistent trajectory service.
+
+Starts a trajectory daemon on a synthetic met field and measures the
+round-trip latency of single trajectories and batches over one persistent
+connection, against the cold path of starting a new process that loads the
+met field and computes the same trajectory.
+
+Usage:
+    python benchmark_service.py [--requests N] [--batch N] [--hours N] [--cold N]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import os
+import subprocess
+import tempfile
+import time
+from datetime import datetime
+
+import numpy as np
+
+from hysplit.core.service import TrajectoryService, trajectory_requests
+from hysplit.met.field import uniform_met_field
+
+COLD_SCRIPT = """
+import sys
+from datetime import datetime
+from hysplit.met.field import MetField
+from hysplit.core.service import run_trajectories, trajectory_requests
+met = MetField.load(sys.argv[1])
+run_trajectories(met, trajectory_requests(40.0, -90.0, 500.0, datetime(2024, 1, 3), int(sys.argv[2])))
+"""
+
+
+def percentiles(samples):
+    """p50/p99/max of latency samples in milliseconds."""
+    ms = np.asarray(samples) * 1000
+    return f"p50 {np.percentile(ms, 50):.3f} ms, p99 {np.percentile(ms, 99):.3f} ms, max {ms.max():.3f} ms"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--requests", type=int, default=1000)
+    parser.add_argument("--batch", type=int, default=100)
+    parser.add_argument("--hours", type=int, default=48)
+    parser.add_argument("--cold", type=int, default=5)
+    args = parser.parse_args()
+
+    met = uniform_met_field(
+        datetime(2024, 1, 1), 72, lat_range=(0.0, 80.0), lon_range=(-150.0, -30.0),
+        spacing=0.5, heights=(0, 250, 500, 1000, 2000, 3000, 5000, 8000, 12000, 20000),
+        u=10.0, v=2.0,
+    )
+    size_mb = 3 * met.u.nbytes / 1e6
+
+    print("=" * 70)
+    print("TRAJECTORY SERVICE LATENCY BENCHMARK")
+    print("=" * 70)
+    print()
+    print("Configuration:")
+    print(f"  Met field: {met.u.shape} ({size_mb:.0f} MB of winds)")
+    print(f"  Trajectory duration: {args.hours} h backward")
+    print(f"  Requests: {args.requests}, batch size: {args.batch}")
+    print(f"  OMP_NUM_THREADS: {os.environ.get('OMP_NUM_THREADS', 'default')}")
+    print()
+
+    single = trajectory_requests(40.0, -90.0, 500.0, datetime(2024, 1, 3), args.hours)
+    rng = np.random.default_rng(0)
+    batch = trajectory_requests(
+        rng.uniform(20, 60, args.batch), rng.uniform(-120, -60, args.batch), 500.0,
+        datetime(2024, 1, 3), args.hours,
+    )
+
+    with tempfile.TemporaryDirectory() as tmp:
+        met_path = met.save(os.path.join(tmp, "met.npz"))
+
+        t0 = time.perf_counter()
+        service = TrajectoryService.start(met_path, socket_path=os.path.join(tmp, "traj.sock"))
+        print(f"Daemon startup (met load): {time.perf_counter() - t0:.2f}s")
+
+        with service, service.client() as client:
+            pings = [client.ping() for _ in range(args.requests)]
+            print(f"Ping round trip:           {percentiles(pings)}")
+
+            samples = []
+            for _ in range(args.requests):
+                t0 = time.perf_counter()
+                client.run(single)
+                samples.append(time.perf_counter() - t0)
+            print(f"Single trajectory:         {percentiles(samples)}")
+
+            samples = []
+            for _ in range(max(1, args.requests // 10)):
+                t0 = time.perf_counter()
+                client.run(batch)
+                samples.append(time.perf_counter() - t0)
+            print(f"Batch of {args.batch}:{' ' * (17 - len(str(args.batch)))}{percentiles(samples)}")
+
+        cold = []
+        for _ in range(args.cold):
+            t0 = time.perf_counter()
+            subprocess.run([sys.executable, "-c", COLD_SCRIPT, met_path, str(args.hours)], check=True)
+            cold.append(time.perf_counter() - t0)
+        print(f"Cold process per request:  {percentiles(cold)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Benchmark for the spatial-temporal trajectory index.
+
+Generates a synthetic archive of 72-hour back trajectories started at random
+hours over a year, builds a TrajectoryIndex (hysplit.core.spatial_index),
+saves it and opens it memory-mapped, then times radius, bbox and corridor
+queries against the brute-force pandas filter over every point. Checks that
+the radius query finds every trajectory the filter finds.
+
+Usage:
+    python benchmark_spatial_index.py [--runs 100000] [--hours 72] [--repeat 20]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import tempfile
+import time
+
+import numpy as np
+import pandas as pd
+
+from hysplit.core.cluster import EARTH_RADIUS_KM
+from hysplit.core.spatial_index import HAS_SPATIAL_INDEX, TrajectoryIndex
+
+from bench_common import synthetic_trajectories
+
+SITE = (49.0, -123.0)
+RADIUS_KM = 50.0
+HEIGHTS = (0.0, 1500.0)
+WINDOW = ("2015-07-01", "2015-08-01")
+
+
+def brute_force(df):
+    """Trajectories with a point near the site, the usual pandas filter."""
+    phi1, phi2 = np.radians(SITE[0]), np.radians(df["lat"].to_numpy())
+    h = (np.sin((phi2 - phi1) / 2) ** 2
+         + np.cos(phi1) * np.cos(phi2) * np.sin(np.radians(df["lon"].to_numpy() - SITE[1]) / 2) ** 2)
+    distance = 2 * EARTH_RADIUS_KM * np.arcsin(np.sqrt(h))
+    mask = ((distance <= RADIUS_KM) & df["height"].between(*HEIGHTS)
+            & df["traj_dt"].between(pd.Timestamp(WINDOW[0]), pd.Timestamp(WINDOW[1])))
+    return df.loc[mask].assign(distance_km=distance[mask]).groupby("run_index")["distance_km"].min()
+
+
+def timed(fn, repeat):
+    """Result and median seconds of repeated calls."""
+    times = []
+    for _ in range(repeat):
+        t0 = time.perf_counter()
+        result = fn()
+        times.append(time.perf_counter() - t0)
+    return result, float(np.median(times))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, default=100000)
+    parser.add_argument("--hours", type=int, default=72)
+    parser.add_argument("--resolution", type=float, default=1.0)
+    parser.add_argument("--repeat", type=int, default=20)
+    args = parser.parse_args()
+
+    if not HAS_SPATIAL_INDEX:
+        sys.exit("Native spatial index not found; run: python setup.py build_ext --inplace")
+
+    print("=" * 70)
+    print("SPATIAL-TEMPORAL TRAJECTORY INDEX BENCHMARK")
+    print("=" * 70)
+    archive = synthetic_trajectories(args.runs, args.hours, drift=(0.02, -0.25), spread=0.3,
+                                     origins=((30.0, 60.0), (-130.0, -60.0)), climb=40.0, start_times=True)
+    print(f"{args.runs} {args.hours}-hour trajectories, {len(archive)} points, "
+          f"{args.resolution} degree cells")
+    print()
+
+    t0 = time.perf_counter()
+    index = TrajectoryIndex.build(archive, resolution=args.resolution)
+    build = time.perf_counter() - t0
+    with tempfile.TemporaryDirectory() as tmp:
+        t0 = time.perf_counter()
+        index.save(Path(tmp) / "archive.idx")
+        save = time.perf_counter() - t0
+        t0 = time.perf_counter()
+        index = TrajectoryIndex.load(Path(tmp) / "archive.idx")
+        load = time.perf_counter() - t0
+        print(f"Build {build:.2f}s, save {save:.2f}s, load (mmap) {load * 1e3:.1f}ms, "
+              f"{len(index.arrays['entries'])} segment entries")
+        print()
+
+        queries = {
+            "radius 50 km, heights, month": lambda: index.within(
+                *SITE, radius_km=RADIUS_KM, start=WINDOW[0], end=WINDOW[1], heights=HEIGHTS),
+            "radius 50 km": lambda: index.within(*SITE, radius_km=RADIUS_KM),
+            "bbox 2x2 deg, month": lambda: index.in_bbox(
+                44.0, 46.0, -100.0, -98.0, start=WINDOW[0], end=WINDOW[1]),
+            "bbox 2x2 deg": lambda: index.in_bbox(44.0, 46.0, -100.0, -98.0),
+            "corridor 500 km x 25 km": lambda: index.in_corridor(
+                [45.0, 46.0, 47.5], [-95.0, -92.0, -90.0], width_km=25.0),
+        }
+        print(f"{'Query':<32} {'Hits':>8} {'Time':>10}")
+        print("-" * 52)
+        for name, query in queries.items():
+            hits, seconds = timed(query, args.repeat)
+            print(f"{name:<32} {len(hits):>8} {seconds * 1e3:>8.2f}ms")
+            if name.startswith("radius 50 km, heights"):
+                found = hits
+
+        reference, seconds = timed(lambda: brute_force(archive), 1)
+        print(f"{'pandas filter (radius, heights)':<32} {len(reference):>8} {seconds * 1e3:>8.2f}ms")
+
+    # Segments can pass the site between points, so the index finds a superset
+    missing = np.setdiff1d(reference.index, found["run_index"])
+    assert len(missing) == 0, f"{len(missing)} trajectories missing from the index"
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Benchmark for the batch makespan with straggling runs.
+
+Runs the same batch against the stand-in hyts_std (hysplit/bin/standin,
+built by ``python setup.py build_ext --inplace``) three ways: plain, with a
+per-run timeout, and with speculative re-execution of runs slower than the
+p99 of the batch. The stand-in sleeps HYSPLIT_STANDIN_SLEEP seconds per
+run, and a fraction of runs (--stall-rate) sleeps --stall seconds more, as
+a run stuck on slow storage or a corrupt met file would. Straggling is drawn
+per launch, so a duplicate of a straggler usually finishes on time.
+
+Usage:
+    python benchmark_stragglers.py [--runs 400] [--workers 4] [--stall 5] [--stall-rate 0.02]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import math
+import os
+import time
+from datetime import datetime, timedelta
+from unittest import mock
+
+from hysplit.workflows.batch import create_batch_config, run_batch_trajectories
+
+from bench_common import STANDIN, require_standin
+
+MET_FILES = ["gdas1.mar12.w2"]
+HOURS = [0, 6, 12, 18]
+
+
+def run_batch(n_runs, n_workers, **kwargs):
+    """Elapsed seconds, successes and schedule stats of a stand-in batch."""
+    n_days = 25
+    config = create_batch_config(
+        locations=[{"lat": 30.0 + i * 0.1, "lon": -100.0, "height": 50}
+                   for i in range(math.ceil(n_runs / (n_days * len(HOURS))))],
+        dates=[datetime(2012, 3, 1) + timedelta(days=d) for d in range(n_days)],
+        daily_hours=HOURS,
+        duration=12,
+        direction="backward",
+        met_type="gdas1",
+        binary_path=str(STANDIN),
+    )
+    with mock.patch("hysplit.met.download_met_files", return_value=MET_FILES):
+        t0 = time.perf_counter()
+        df = run_batch_trajectories(config, n_workers=n_workers,
+                                    progress_callback=lambda done, total: None, **kwargs)
+        elapsed = time.perf_counter() - t0
+    return elapsed, int(df["success"].sum()), len(df), df.attrs["schedule"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, default=400)
+    parser.add_argument("--workers", type=int, default=4)
+    parser.add_argument("--sleep", type=float, default=0.05, help="Seconds per normal run")
+    parser.add_argument("--stall", type=float, default=5.0, help="Extra seconds of a straggler")
+    parser.add_argument("--stall-rate", type=float, default=0.02, help="Fraction of straggling runs")
+    args = parser.parse_args()
+
+    require_standin()
+    os.environ["HYSPLIT_STANDIN_SLEEP"] = str(args.sleep)
+    os.environ["HYSPLIT_STANDIN_STALL"] = str(args.stall)
+    os.environ["HYSPLIT_STANDIN_STALL_RATE"] = str(args.stall_rate)
+
+    print("=" * 70)
+    print("BATCH STRAGGLER BENCHMARK")
+    print("=" * 70)
+    print(f"Workers: {args.workers}, run: {args.sleep * 1e3:.0f} ms, "
+          f"stragglers: {args.stall_rate:.1%} sleeping {args.stall:.1f} s more")
+    print()
+
+    modes = [
+        ("plain", {}),
+        (f"timeout {args.stall / 2:g}s", {"timeout": args.stall / 2}),
+        ("speculate", {"speculate": True}),
+    ]
+    rows = []
+    for name, kwargs in modes:
+        elapsed, ok, total, schedule = run_batch(args.runs, args.workers, **kwargs)
+        rows.append((name, total, ok, elapsed, schedule))
+        print()
+
+    print(f"{'Mode':>14} {'Runs':>6} {'OK':>6} {'Makespan':>10} {'Dups':>6} {'Dup wins':>9} {'Timeouts':>9}")
+    print("-" * 66)
+    for name, total, ok, elapsed, schedule in rows:
+        print(f"{name:>14} {total:>6} {ok:>6} {elapsed:>9.2f}s {schedule['speculated']:>6} "
+              f"{schedule['speculative_wins']:>9} {schedule['timed_out']:>9}")
+    print()
+    print("Timed-out runs fail; speculation keeps every run and only pays for the duplicates.")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Benchmark for rendering HYSPLIT input files.
+
+Compares the Python f-string renderers (HysplitConfig.to_string,
+TrajectoryModel._control_text) with the native precompiled layouts
+(hysplit.core.templates) for SETUP.CFG and for multi-start CONTROL files,
+and the cost of writing a CONTROL file per run.
+
+Usage:
+    python benchmark_templates.py [--iterations N] [--starts N]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import tempfile
+import time
+from datetime import datetime
+
+from hysplit.core import templates
+from hysplit.core.config import set_config
+from hysplit.core.launcher import ExecDir
+from hysplit.core.trajectory import TrajectoryModel
+
+
+def timeit(func, iterations):
+    """Mean microseconds per call."""
+    func()
+    t0 = time.perf_counter()
+    for _ in range(iterations):
+        func()
+    return (time.perf_counter() - t0) / iterations * 1e6
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--iterations", type=int, default=20000)
+    parser.add_argument("--starts", type=int, default=100)
+    args = parser.parse_args()
+
+    if not templates.HAS_NATIVE_TEMPLATES:
+        print("Native templates not built; run: python setup.py build_ext --inplace")
+        return
+
+    config = set_config(extended_met=True)
+    model = TrajectoryModel(duration=24, direction="backward")
+    exec_dir = Path("/tmp/hysplit_exec")
+    start = datetime(2024, 1, 1, 12)
+    met_files = ["gdas1.jan24.w1", "gdas1.dec23.w5"]
+    locations = [(40.0 + i * 0.01, -80.0 - i * 0.01, 50.0) for i in range(args.starts)]
+
+    def python_control(locs):
+        return model._control_text(exec_dir, start, locs, met_files, "tdump").encode()
+
+    def native_control(locs):
+        return templates.render_trajectory_control(model, exec_dir, start, locs, met_files, "tdump")
+
+    assert python_control(locations) == native_control(locations)
+    assert config.to_string().encode() == templates.render_setup(config)
+
+    print("=" * 70)
+    print("INPUT FILE RENDERING BENCHMARK")
+    print("=" * 70)
+    print()
+    print(f"{'File':<32} {'Python':>10} {'Native':>10} {'Speedup':>9}")
+    print("-" * 64)
+    rows = [
+        ("SETUP.CFG", lambda: config.to_string().encode(), lambda: templates.render_setup(config)),
+        ("CONTROL, 1 start", lambda: python_control(locations[:1]), lambda: native_control(locations[:1])),
+        (f"CONTROL, {args.starts} starts", lambda: python_control(locations),
+         lambda: native_control(locations)),
+    ]
+    for name, py, native in rows:
+        t_py = timeit(py, args.iterations)
+        t_native = timeit(native, args.iterations)
+        print(f"{name:<32} {t_py:>8.2f}us {t_native:>8.2f}us {t_py / t_native:>8.1f}x")
+
+    # Per-run cost of CONTROL + unchanged config files in a warm exec dir
+    with tempfile.TemporaryDirectory() as tmp:
+        workdir = ExecDir(tmp)
+
+        def python_run():
+            workdir.write("SETUP.CFG", config.to_string())
+            workdir.write("CONTROL", python_control(locations[:1]))
+
+        def native_run():
+            workdir.write("SETUP.CFG", templates.render_setup(config))
+            workdir.write("CONTROL", native_control(locations[:1]))
+
+        t_py = timeit(python_run, args.iterations // 4)
+        t_native = timeit(native_run, args.iterations // 4)
+        print(f"{'Per-run files (ExecDir)':<32} {t_py:>8.2f}us {t_native:>8.2f}us {t_py / t_native:>8.1f}x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+Benchmark for returning batch trajectories from worker processes.
+
+Each task builds a trajectory DataFrame with the columns of a parsed
+tdump file and hands it to the parent either by pickling it through
+ProcessPoolExecutor (then pd.concat) or through the shared-memory
+ResultArena (then a zero-copy DataFrame over the arena). Reports the time
+from submission to the combined DataFrame.
+
+Usage:
+    python benchmark_transport.py [--runs N] [--points N] [--workers N]
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import argparse
+import time
+from concurrent.futures import ProcessPoolExecutor
+
+import numpy as np
+import pandas as pd
+
+from hysplit.workflows.arena import ResultArena, arena_write, gather_results
+from hysplit.workflows.batch import trajectory_columns
+
+
+def make_trajectory(run_index, n_points):
+    """A parsed trajectory of n_points hourly points."""
+    rng = np.random.default_rng(run_index)
+    hours = np.arange(n_points)
+    times = pd.Timestamp("2024-01-01") + pd.to_timedelta(hours, unit="h")
+    return pd.DataFrame({
+        "year": times.year, "month": times.month, "day": times.day, "hour": times.hour,
+        "hour_along": -hours,
+        "lat": 40 + rng.normal(size=n_points).cumsum() * 0.1,
+        "lon": -80 + rng.normal(size=n_points).cumsum() * 0.1,
+        "height": rng.uniform(0, 3000, n_points),
+        "pressure": rng.uniform(500, 1000, n_points),
+        "traj_dt": times,
+    })
+
+
+def base_task(args):
+    run_index, n_points = args
+    return len(make_trajectory(run_index, n_points))
+
+
+def pickled_task(args):
+    run_index, n_points = args
+    return make_trajectory(run_index, n_points).assign(run_index=run_index)
+
+
+def arena_task(args):
+    run_index, n_points, handle = args
+    return arena_write(handle, make_trajectory(run_index, n_points), run_index=run_index)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--runs", type=int, default=2000)
+    parser.add_argument("--points", type=int, default=2000)
+    parser.add_argument("--workers", type=int, default=2)
+    args = parser.parse_args()
+    columns = trajectory_columns()
+
+    print("=" * 70)
+    print("BATCH RESULT TRANSPORT BENCHMARK")
+    print("=" * 70)
+    print()
+    print(f"Runs: {args.runs} x {args.points} points, {args.workers} workers")
+    print()
+
+    # Task cost without returning anything, to isolate the transport
+    with ProcessPoolExecutor(args.workers) as pool:
+        t0 = time.perf_counter()
+        list(pool.map(base_task, [(i, args.points) for i in range(args.runs)], chunksize=16))
+        base = time.perf_counter() - t0
+
+    with ProcessPoolExecutor(args.workers) as pool:
+        t0 = time.perf_counter()
+        frames = list(pool.map(pickled_task, [(i, args.points) for i in range(args.runs)], chunksize=16))
+        pickled = pd.concat(frames, ignore_index=True)[list(columns)].astype(columns)
+        t_pickle = time.perf_counter() - t0
+
+    arena = ResultArena.create(columns, capacity=args.runs * args.points)
+    with ProcessPoolExecutor(args.workers) as pool:
+        t0 = time.perf_counter()
+        tasks = [(i, args.points, arena.handle) for i in range(args.runs)]
+        extents = list(pool.map(arena_task, tasks, chunksize=16))
+        shared = gather_results(arena, extents, [])
+        t_arena = time.perf_counter() - t0
+    arena.unlink()
+
+    same = (
+        pickled.sort_values(["run_index", "hour_along"], ascending=[True, False], ignore_index=True)
+        .equals(shared.sort_values(["run_index", "hour_along"], ascending=[True, False], ignore_index=True))
+    )
+    zero_copy = np.shares_memory(shared["lat"].to_numpy(), arena.columns["lat"])
+
+    print(f"{'Transport':<20} {'Total':>10} {'Transport':>12}")
+    print("-" * 44)
+    print(f"{'tasks only':<20} {base:>9.2f}s {'-':>12}")
+    print(f"{'pickle + concat':<20} {t_pickle:>9.2f}s {t_pickle - base:>11.2f}s")
+    print(f"{'shared arena':<20} {t_arena:>9.2f}s {t_arena - base:>11.2f}s")
+    print()
+    print(f"Rows: {len(shared):,}, identical: {same}, zero-copy columns: {zero_copy}")
+
+
+if __name__ == "__main__":
+    main()
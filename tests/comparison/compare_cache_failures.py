@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Check that the run cache leaves out runs whose invocation failed.
+
+Runs a small trajectory set against a wrapper around the stand-in hyts_std
+(hysplit/bin/standin, built by ``python setup.py build_ext --inplace``).
+The wrapper cuts the tdump short and exits 1 whenever the CONTROL file
+holds the start latitude FAIL_LAT, as HYSPLIT does when it runs out of met
+data part way. The set runs twice with one cache, with multi-start
+invocations and with one run per invocation: the second pass must find
+every successful run in the cache and launch the failed ones again.
+
+Usage:
+    python compare_cache_failures.py
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import tempfile
+from datetime import datetime
+from unittest import mock
+
+from hysplit.core.cache import RunCache
+from hysplit.core.trajectory import TrajectoryModel
+
+from bench_common import STANDIN, require_standin
+
+MET_FILES = ["gdas1.mar12.w2"]
+LATS = [42.8, 89.5, 45.0]
+HOURS = [0, 12]
+FAIL_LAT = 89.5
+
+# The output file is the last two CONTROL lines, directory then name
+WRAPPER = f"""#!/bin/sh
+"{STANDIN}" "$@"
+if grep -q '^{FAIL_LAT:.4f} ' CONTROL; then
+    out="$(tail -n 2 CONTROL | head -n 1)$(tail -n 1 CONTROL)"
+    head -c 2000 "$out" > "$out.cut" && mv "$out.cut" "$out"
+    exit 1
+fi
+"""
+
+
+def run(binary, cache, max_starts):
+    """Cache counters after one pass over the trajectory set."""
+    model = TrajectoryModel(binary_path=str(binary), cache=cache)
+    model.max_starts = max_starts
+    model.add_trajectory_params(days=[datetime(2012, 3, 10)], daily_hours=HOURS, duration=12,
+                                direction="backward", met_type="gdas1")
+    model.lat, model.lon, model.height = LATS, [-80.3], [50.0]
+    cache.hits = cache.misses = cache.stores = 0
+    with mock.patch("hysplit.met.download_met_files", return_value=MET_FILES):
+        model.run()
+    return cache.hits, cache.misses, cache.stores
+
+
+def main():
+    require_standin()
+
+    print("=" * 60)
+    print("RUN CACHE WITH FAILING RUNS")
+    print("=" * 60)
+    n_runs = len(LATS) * len(HOURS)
+    n_failed = len(HOURS)
+    failures = []
+    with tempfile.TemporaryDirectory() as tmp:
+        binary = Path(tmp) / "hyts_std"
+        binary.write_text(WRAPPER)
+        binary.chmod(0o755)
+        for max_starts in (TrajectoryModel.max_starts, 1):
+            cache = RunCache(Path(tmp) / f"cache-{max_starts}")
+            first = run(binary, cache, max_starts)
+            second = run(binary, cache, max_starts)
+            expected = ((0, n_runs, n_runs - n_failed), (n_runs - n_failed, n_failed, 0))
+            status = "OK" if (first, second) == expected else "MISMATCH"
+            print(f"max_starts={max_starts}: first pass hits/misses/stores {first}, "
+                  f"second pass {second} {status}")
+            if status != "OK":
+                failures.append(max_starts)
+    print()
+    if failures:
+        sys.exit(f"Failed runs were cached or successful ones were not (max_starts {failures})")
+    print(f"Only the {n_runs - n_failed} successful runs of {n_runs} were cached")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Compare the C++ and Python EMITIMES parsers.
+
+Writes a valid EMITIMES file and malformed variants of it, reads each with
+both backends of emitimes_read(), and checks that they return the same
+rows or fail with the same message.
+
+Usage:
+    python compare_emitimes.py
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+import tempfile
+
+import pandas as pd
+
+from hysplit.cpp import HAS_CPP_EXTENSION
+from hysplit.io.readers import emitimes_read
+
+HEADER = "YYYY MM DD HH DURATION(hhhh) #RECORDS\nYYYY MM DD HH MM DURATION(hhmm) LAT LON HGT(m) RATE(/h) AREA(m2) HEAT(w)\n"
+
+VALID = HEADER + """2012 02 28 00 9999 3
+2012 02 28 00 00 0600 42.8 -80.3 10.0 1.0e+03 0.0 0.0
+2012 02 29 12 30 0130 42.8 -80.3 10.0 2.5e+02 0.0 0.0
+2012 02 28 06 00 0300 43.6 -79.3 50.0 5.0e+02 0.0 0.0
+"""
+
+# Name, (line, replacement) applied to VALID
+CASES = {
+    "valid": None,
+    "february 30": (4, "2012 02 30 12 30 0130 42.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "february 29, common year": (4, "2013 02 29 12 30 0130 42.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "april 31": (4, "2012 04 31 00 00 0100 42.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "month 13": (4, "2012 13 01 00 00 0100 42.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "hour 24": (4, "2012 02 29 24 00 0100 42.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "duration minutes": (4, "2012 02 29 12 30 0175 42.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "negative rate": (4, "2012 02 29 12 30 0130 42.8 -80.3 10.0 -1.0 0.0 0.0"),
+    "latitude": (4, "2012 02 29 12 30 0130 92.8 -80.3 10.0 2.5e+02 0.0 0.0"),
+    "short record": (4, "2012 02 29 12 30 0130 42.8 -80.3 10.0"),
+    "missing record": (5, ""),
+}
+
+
+def read(path, use_cpp):
+    try:
+        return emitimes_read(path, use_cpp=use_cpp), None
+    except ValueError as exc:
+        return None, str(exc)
+
+
+def main():
+    if not HAS_CPP_EXTENSION:
+        sys.exit("C++ parsers not found; run: python setup.py build_ext --inplace")
+
+    print("=" * 60)
+    print("COMPARISON OF C++ vs PYTHON EMITIMES PARSING")
+    print("=" * 60)
+    failures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, change in CASES.items():
+            lines = VALID.splitlines()
+            if change is not None:
+                lines[change[0] - 1] = change[1]
+            path = Path(tmp) / "EMITIMES"
+            path.write_text("\n".join(lines) + "\n")
+
+            cpp_df, cpp_error = read(path, True)
+            py_df, py_error = read(path, False)
+            if cpp_error is not None or py_error is not None:
+                same = cpp_error == py_error
+                outcome = cpp_error if same else f"C++: {cpp_error!r}, Python: {py_error!r}"
+            else:
+                try:
+                    pd.testing.assert_frame_equal(cpp_df, py_df)
+                    same = True
+                except AssertionError:
+                    same = False
+                outcome = f"{len(cpp_df)} rows" if same else f"{len(cpp_df)} vs {len(py_df)} rows differ"
+            failures += not same
+            print(f"{'OK  ' if same else 'FAIL'} {name:<26} {outcome}")
+
+    print()
+    if failures:
+        sys.exit(f"{failures} case(s) differ")
+    print("Both parsers agree on every case")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""
+Compare a transfer-matrix run with a direct native dispersion run.
+
+Runs three sources with very different emission rates once with
+engine="native" and once with engine="tcm" at the default SETUP.CFG
+(splitting every hour, merging every 6 hours), applies the rates to the
+transfer matrix and checks that it reproduces the direct concentrations.
+
+Usage:
+    python compare_tcm.py
+"""
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+from datetime import datetime
+
+import numpy as np
+
+from hysplit.core.dispersion import DispersionModel
+from hysplit.core.engine import HAS_PARTICLE_ENGINE
+from hysplit.met.field import uniform_met_field
+
+START = datetime(2020, 1, 1)
+SOURCES = [(45.0, -80.0), (45.5, -79.0), (44.0, -81.0)]
+RATES = np.array([1.0, 40.0, 0.2])
+
+
+def run(engine, met):
+    model = DispersionModel(start_time=START, duration=24)
+    for (lat, lon), rate in zip(SOURCES, RATES):
+        model.add_source(lat, lon, 100.0, rate=rate, duration_hours=12)
+    model.add_dispersion_params(
+        grid_center=(45.0, -75.0), grid_spacing=(0.25, 0.25), grid_span=(10.0, 20.0),
+        sampling_interval=6, engine=engine, met_field=met,
+    )
+    return model.run()
+
+
+def main():
+    if not HAS_PARTICLE_ENGINE:
+        sys.exit("Native particle engine not found; run: python setup.py build_ext --inplace")
+
+    print("=" * 60)
+    print("COMPARISON OF TRANSFER MATRIX vs DIRECT NATIVE RUN")
+    print("=" * 60)
+    met = uniform_met_field(START, 30, lat_range=(30.0, 60.0), lon_range=(-100.0, -60.0),
+                            mixing_depth=1000.0)
+    direct = run("native", met).concentration_grid
+    applied = run("tcm", met).transfer_matrix.apply(RATES)
+
+    error = float(np.abs(applied - direct).max() / np.abs(direct).max())
+    print(f"Rates: {RATES.tolist()}")
+    print(f"Total mass ratio (matrix / direct): {applied.sum() / direct.sum():.12f}")
+    print(f"Max cell difference / max concentration: {error:.3e}")
+    print()
+    if error > 1e-9:
+        sys.exit("The transfer matrix does not reproduce the direct run")
+    print("The transfer matrix reproduces the direct run")
+
+
+if __name__ == "__main__":
+    main()